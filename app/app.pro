@@ -161,6 +161,11 @@ unix:if(!macx|disable-prebuilts) {
             packagesExist(x11) {
                 DEFINES += HAS_X11
                 PKGCONFIG += x11
+
+                packagesExist(xcb-present) {
+                    CONFIG += x11-present
+                    PKGCONFIG += xcb xcb-present
+                }
             }
         }
     }
@@ -203,7 +208,9 @@ SOURCES += \
     backend/computerseeker.cpp \
     backend/identitymanager.cpp \
     backend/nvcomputer.cpp \
+    backend/hoststore.cpp \
     backend/nvhttp.cpp \
+    backend/nvxmlparser.cpp \
     backend/nvpairingmanager.cpp \
     backend/computermanager.cpp \
     backend/boxartmanager.cpp \
@@ -225,6 +232,7 @@ SOURCES += \
     streaming/input/reltouch.cpp \
     streaming/session.cpp \
     streaming/filemappingclient.cpp \
+    streaming/filemappingrpcchannel.cpp \
     streaming/filemappingwebsocket.cpp \
     streaming/filemappingprotocoladapter.cpp \
     streaming/filemappingux.cpp \
@@ -232,10 +240,13 @@ SOURCES += \
     streaming/clipboardipc.cpp \
     streaming/audio/audio.cpp \
     streaming/audio/dualsensehaptics.cpp \
+    streaming/audio/lossrecovery.cpp \
+    streaming/audio/renderers/jitterbuffer.cpp \
     streaming/audio/renderers/sdlaud.cpp \
     streaming/network/bandwidth.cpp \
     gui/computermodel.cpp \
     gui/appmodel.cpp \
+    streaming/abrcontroller.cpp \
     streaming/bwtracker.cpp \
     streaming/streamutils.cpp \
     backend/autoupdatechecker.cpp \
@@ -243,6 +254,7 @@ SOURCES += \
     path.cpp \
     settings/mappingmanager.cpp \
     gui/sdlgamepadkeynavigation.cpp \
+    gui/sdlgamepadinputthread.cpp \
     gui/windowplacement.cpp \
     gui/windowsdisplaygeometry.cpp \
     gui/windowswindowchrome.cpp \
@@ -267,7 +279,9 @@ HEADERS += \
     backend/computerseeker.h \
     backend/identitymanager.h \
     backend/nvcomputer.h \
+    backend/hoststore.h \
     backend/nvhttp.h \
+    backend/nvxmlparser.h \
     backend/nvpairingmanager.h \
     backend/computermanager.h \
     backend/boxartmanager.h \
@@ -281,6 +295,7 @@ HEADERS += \
     streaming/input/input.h \
     streaming/session.h \
     streaming/filemappingclient.h \
+    streaming/filemappingrpcchannel.h \
     streaming/filemappingwebsocket.h \
     streaming/filemappingprotocoladapter.h \
     streaming/filemappingux.h \
@@ -288,13 +303,16 @@ HEADERS += \
     streaming/clipboardipc.h \
     streaming/audio/renderers/renderer.h \
     streaming/audio/dualsensehaptics.h \
+    streaming/audio/lossrecovery.h \
     streaming/audio/dualsensehapticscalibration.h \
     streaming/audio/dualsensehapticsstream.h \
+    streaming/audio/renderers/jitterbuffer.h \
     streaming/audio/renderers/sdl.h \
     gui/computermodel.h \
     gui/appmodel.h \
     streaming/video/decoder.h \
     streaming/network/bandwidth.h \
+    streaming/abrcontroller.h \
     streaming/bwtracker.h \
     streaming/streamutils.h \
     backend/autoupdatechecker.h \
@@ -302,6 +320,7 @@ HEADERS += \
     path.h \
     settings/mappingmanager.h \
     gui/sdlgamepadkeynavigation.h \
+    gui/sdlgamepadinputthread.h \
     gui/windowplacement.h \
     gui/windowsdisplaygeometry.h \
     gui/windowswindowchrome.h \
@@ -334,19 +353,32 @@ ffmpeg {
     SOURCES += \
         streaming/video/ffmpeg.cpp \
         streaming/video/av1obu.cpp \
+        streaming/video/h264spsfixup.cpp \
+        streaming/video/decodethreadpolicy.cpp \
+        streaming/video/hdrmetadatastate.cpp \
+        streaming/video/framepool.cpp \
         streaming/video/ffmpeg-renderers/genhwaccel.cpp \
+        streaming/video/ffmpeg-renderers/nullrenderer.cpp \
         streaming/video/ffmpeg-renderers/sdlvid.cpp \
         streaming/video/ffmpeg-renderers/swframemapper.cpp \
-        streaming/video/ffmpeg-renderers/pacer/pacer.cpp
+        streaming/video/ffmpeg-renderers/pacer/pacer.cpp \
+        streaming/video/ffmpeg-renderers/pacer/syntheticvsyncsource.cpp
 
     HEADERS += \
         streaming/video/ffmpeg.h \
         streaming/video/av1obu.h \
+        streaming/video/h264spsfixup.h \
+        streaming/video/decodethreadpolicy.h \
+        streaming/video/hdrmetadatastate.h \
+        streaming/video/fixedqueue.h \
+        streaming/video/framepool.h \
         streaming/video/ffmpeg-renderers/renderer.h \
         streaming/video/ffmpeg-renderers/genhwaccel.h \
+        streaming/video/ffmpeg-renderers/nullrenderer.h \
         streaming/video/ffmpeg-renderers/sdlvid.h \
         streaming/video/ffmpeg-renderers/swframemapper.h \
-        streaming/video/ffmpeg-renderers/pacer/pacer.h
+        streaming/video/ffmpeg-renderers/pacer/pacer.h \
+        streaming/video/ffmpeg-renderers/pacer/syntheticvsyncsource.h
 }
 libva {
     message(VAAPI renderer selected)
@@ -475,7 +507,6 @@ config_SL {
 }
 win32 {
     HEADERS += streaming/video/ffmpeg-renderers/dxutil.h
-    LIBS += -liphlpapi
 }
 win32:!winrt {
     message(DXVA2 and D3D11VA renderers selected)
@@ -546,6 +577,13 @@ wayland {
     SOURCES += streaming/video/ffmpeg-renderers/pacer/waylandvsyncsource.cpp
     HEADERS += streaming/video/ffmpeg-renderers/pacer/waylandvsyncsource.h
 }
+x11-present {
+    message(X11 Present V-sync source enabled)
+
+    DEFINES += HAS_X11_PRESENT
+    SOURCES += streaming/video/ffmpeg-renderers/pacer/x11presentvsyncsource.cpp
+    HEADERS += streaming/video/ffmpeg-renderers/pacer/x11presentvsyncsource.h
+}
 
 RESOURCES += \
     resources.qrc \
@@ -12,8 +12,6 @@
 #include <QCoreApplication>
 #include <QRandomGenerator>
 
-#define SER_HOSTS "hosts"
-#define SER_HOSTS_BACKUP "hostsbackup"
 
 class PcMonitorThread : public QThread
 {
@@ -34,7 +32,7 @@ private:
     {
         NvHTTP http(address, 0, m_Computer->serverCert, !m_Computer->isNvidiaServerSoftware, nam, m_Computer->uuid);
 
-        QString serverInfo;
+        NvServerInfo serverInfo;
         try {
             serverInfo = http.getServerInfo(NvHTTP::NvLogLevel::NVLL_NONE, true);
         } catch (...) {
@@ -167,25 +165,11 @@ ComputerManager::ComputerManager(StreamingPreferences* prefs)
       m_CompatFetcher(nullptr),
       m_NeedsDelayedFlush(false)
 {
-    QSettings settings;
-
-    // If there's a hosts backup copy, we must have failed to commit
-    // a previous update before exiting. Restore the backup now.
-    int hosts = settings.beginReadArray(SER_HOSTS_BACKUP);
-    if (hosts == 0) {
-        // If there's no host backup, read from the primary location.
-        settings.endArray();
-        hosts = settings.beginReadArray(SER_HOSTS);
-    }
-
-    // Inflate our hosts from QSettings
-    for (int i = 0; i < hosts; i++) {
-        settings.setArrayIndex(i);
-        NvComputer* computer = new NvComputer(settings);
+    // Inflate our hosts from the host store
+    for (NvComputer* computer : m_HostStore.load()) {
         m_KnownHosts[computer->uuid] = computer;
         m_LastSerializedHosts[computer->uuid] = *computer;
     }
-    settings.endArray();
 
     // Fetch latest compatibility data asynchronously
     m_CompatFetcher.start();
@@ -250,6 +234,9 @@ ComputerManager::~ComputerManager()
 
 void DelayedFlushThread::run() {
     for (;;) {
+        QHash<QString, NvComputer> previousHosts;
+        QHash<QString, NvComputer> currentHosts;
+
         // Wait for a delayed flush request or an interruption
         {
             QMutexLocker locker(&m_ComputerManager->m_DelayedFlushMutex);
@@ -269,6 +256,7 @@ void DelayedFlushThread::run() {
             m_ComputerManager->m_NeedsDelayedFlush = false;
 
             // Update the last serialized hosts map under the delayed flush mutex
+            previousHosts.swap(m_ComputerManager->m_LastSerializedHosts);
             m_ComputerManager->m_LastSerializedHosts.clear();
             for (const NvComputer* computer : std::as_const(m_ComputerManager->m_KnownHosts)) {
                 // Copy the current state of the NvComputer to allow us to check later if we need
@@ -276,40 +264,27 @@ void DelayedFlushThread::run() {
                 QReadLocker computerLock(&computer->lock);
                 m_ComputerManager->m_LastSerializedHosts[computer->uuid] = *computer;
             }
+            currentHosts = m_ComputerManager->m_LastSerializedHosts;
         }
 
-        // Perform the flush
-        {
-            QSettings settings;
-
-            // First, write to the backup location
-            settings.beginWriteArray(SER_HOSTS_BACKUP);
-            {
-                QReadLocker lock(&m_ComputerManager->m_Lock);
-                int i = 0;
-                for (const NvComputer* computer : std::as_const(m_ComputerManager->m_KnownHosts)) {
-                    settings.setArrayIndex(i++);
-                    computer->serialize(settings, false);
-                }
+        // Perform the flush. Only hosts that changed since the last flush
+        // are re-encoded, and their app lists only if those changed too.
+        HostStore& store = m_ComputerManager->m_HostStore;
+        for (const QString& uuid : store.uuids()) {
+            if (!currentHosts.contains(uuid)) {
+                store.removeHost(uuid);
             }
-            settings.endArray();
-
-            // Next, write to the primary location
-            settings.remove(SER_HOSTS);
-            settings.beginWriteArray(SER_HOSTS);
-            {
-                QReadLocker lock(&m_ComputerManager->m_Lock);
-                int i = 0;
-                for (const NvComputer* computer : std::as_const(m_ComputerManager->m_KnownHosts)) {
-                    settings.setArrayIndex(i++);
-                    computer->serialize(settings, true);
-                }
+        }
+        for (const NvComputer& computer : std::as_const(currentHosts)) {
+            auto previous = previousHosts.constFind(computer.uuid);
+            if (previous == previousHosts.constEnd()) {
+                store.updateHost(computer, true);
+            }
+            else if (!previous->isEqualSerialized(computer)) {
+                store.updateHost(computer, previous->appList != computer.appList);
             }
-            settings.endArray();
-
-            // Finally, delete the backup copy
-            settings.remove(SER_HOSTS_BACKUP);
         }
+        store.commit();
     }
 }
 
@@ -317,8 +292,7 @@ void ComputerManager::saveHosts()
 {
     Q_ASSERT(m_DelayedFlushThread != nullptr && m_DelayedFlushThread->isRunning());
 
-    // Punt to a worker thread because QSettings on macOS can take ages (> 500 ms)
-    // to persist our host list to disk (especially when a host has a bunch of apps).
+    // Punt to a worker thread to keep disk I/O off the caller's thread.
     QMutexLocker locker(&m_DelayedFlushMutex);
     m_NeedsDelayedFlush = true;
     m_DelayedFlushCondition.wakeOne();
@@ -467,7 +441,7 @@ void ComputerManager::saveHost(NvComputer *computer)
     QMutexLocker lock(&m_DelayedFlushMutex);
     QReadLocker computerLock(&computer->lock);
     if (!m_LastSerializedHosts.value(computer->uuid).isEqualSerialized(*computer)) {
-        // Queue a request for a delayed flush to QSettings outside of the lock
+        // Queue a request for a delayed flush to the host store outside of the lock
         computerLock.unlock();
         lock.unlock();
         saveHosts();
@@ -779,13 +753,13 @@ private:
         m_AboutToQuit = true;
     }
 
-    QString fetchServerInfo(NvHTTP& http)
+    NvServerInfo fetchServerInfo(NvHTTP& http)
     {
-        QString serverInfo;
+        NvServerInfo serverInfo;
 
         // Do nothing if we're quitting
         if (m_AboutToQuit) {
-            return QString();
+            return NvServerInfo();
         }
 
         try {
@@ -824,7 +798,7 @@ private:
 
                 emit computerAddCompleted(false, portTestResult != 0 && portTestResult != ML_TEST_RESULT_INCONCLUSIVE);
             }
-            return QString();
+            return NvServerInfo();
         }
     }
 
@@ -847,13 +821,13 @@ private:
         }
 
         // Perform initial serverinfo fetch over HTTP since we don't know which cert to use
-        QString serverInfo = fetchServerInfo(http);
-        if (serverInfo.isEmpty() && !m_MdnsIpv6Address.isNull()) {
+        NvServerInfo serverInfo = fetchServerInfo(http);
+        if (serverInfo.isNull() && !m_MdnsIpv6Address.isNull()) {
             // Retry using the global IPv6 address if the IPv4 or link-local IPv6 address fails
             http.setAddress(m_MdnsIpv6Address);
             serverInfo = fetchServerInfo(http);
         }
-        if (serverInfo.isEmpty()) {
+        if (serverInfo.isNull()) {
             return;
         }
 
@@ -876,7 +850,7 @@ private:
         if (existingComputer != nullptr) {
             Q_ASSERT(http.httpsPort() != 0);
             serverInfo = fetchServerInfo(http);
-            if (serverInfo.isEmpty()) {
+            if (serverInfo.isNull()) {
                 return;
             }
 
@@ -0,0 +1,244 @@
+#include "hoststore.h"
+#include "path.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QSettings>
+
+// Legacy QSettings arrays. Read to migrate existing installs and to recover
+// from a damaged store, but never written or removed.
+#define SER_HOSTS "hosts"
+#define SER_HOSTS_BACKUP "hostsbackup"
+
+#define HOST_STORE_FILE "hosts.db"
+#define HOST_STORE_CORRUPT_SUFFIX ".corrupt"
+#define HOST_STORE_MAGIC 0x4D4C4844 // 'MLHD'
+#define HOST_STORE_VERSION 1
+
+// Pinned so the file stays readable across Qt versions
+#define HOST_STORE_STREAM_VERSION QDataStream::Qt_5_12
+
+HostStore::HostStore()
+    : m_Path(QDir(Path::getDataDir()).filePath(HOST_STORE_FILE)),
+      m_Dirty(false),
+      m_Unwritable(false)
+{
+
+}
+
+QVector<NvComputer*> HostStore::load()
+{
+    QVector<NvComputer*> hosts;
+
+    QFile file(m_Path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        if (file.exists()) {
+            qWarning() << "Failed to open host store" << m_Path << ":" << file.errorString();
+            setAside(false);
+            importFromSettings(hosts, "unreadable store");
+            return hosts;
+        }
+
+        importFromSettings(hosts, "first run");
+        return hosts;
+    }
+
+    QByteArray data = file.readAll();
+    file.close();
+
+    QDataStream stream(data);
+    stream.setVersion(HOST_STORE_STREAM_VERSION);
+
+    quint32 magic, count;
+    quint16 version;
+    stream >> magic >> version >> count;
+    if (stream.status() != QDataStream::Ok || magic != HOST_STORE_MAGIC || version != HOST_STORE_VERSION) {
+        qWarning() << "Unrecognized host store" << m_Path;
+        setAside(false);
+        importFromSettings(hosts, "unrecognized store");
+        return hosts;
+    }
+
+    bool damaged = false;
+    for (quint32 i = 0; i < count; i++) {
+        Record record;
+        stream >> record.host >> record.apps;
+        if (stream.status() != QDataStream::Ok) {
+            qWarning() << "Host store is truncated after" << hosts.count() << "hosts";
+            damaged = true;
+            break;
+        }
+
+        QDataStream hostStream(record.host);
+        QDataStream appsStream(record.apps);
+        hostStream.setVersion(HOST_STORE_STREAM_VERSION);
+        appsStream.setVersion(HOST_STORE_STREAM_VERSION);
+
+        NvComputer* computer = new NvComputer(hostStream, appsStream);
+        if (hostStream.status() != QDataStream::Ok || computer->uuid.isEmpty()) {
+            qWarning() << "Skipping corrupt host record" << i;
+            damaged = true;
+            delete computer;
+            continue;
+        }
+
+        m_Records[computer->uuid] = record;
+        hosts.append(computer);
+    }
+
+    qInfo() << "Loaded" << hosts.count() << "hosts from" << m_Path;
+
+    if (damaged) {
+        // The next commit only writes what we could read, so keep the
+        // original around and fill in the gaps from the legacy copy.
+        setAside(true);
+        importFromSettings(hosts, "damaged store");
+    }
+
+    return hosts;
+}
+
+QVector<NvComputer*> HostStore::readLegacySettings()
+{
+    QSettings settings;
+
+    // If there's a hosts backup copy, we must have failed to commit
+    // a previous update before exiting. Restore the backup now.
+    int count = settings.beginReadArray(SER_HOSTS_BACKUP);
+    if (count == 0) {
+        // If there's no host backup, read from the primary location.
+        settings.endArray();
+        count = settings.beginReadArray(SER_HOSTS);
+    }
+
+    QVector<NvComputer*> hosts;
+    for (int i = 0; i < count; i++) {
+        settings.setArrayIndex(i);
+        NvComputer* computer = new NvComputer(settings);
+        if (computer->uuid.isEmpty()) {
+            delete computer;
+            continue;
+        }
+        hosts.append(computer);
+    }
+    settings.endArray();
+
+    return hosts;
+}
+
+void HostStore::importFromSettings(QVector<NvComputer*>& hosts, const char* reason)
+{
+    int imported = 0;
+    for (NvComputer* computer : readLegacySettings()) {
+        if (m_Records.contains(computer->uuid)) {
+            delete computer;
+            continue;
+        }
+
+        updateHost(*computer, true);
+        hosts.append(computer);
+        imported++;
+    }
+
+    if (imported == 0) {
+        return;
+    }
+
+    // The legacy arrays stay put for older builds (see load())
+    if (commit()) {
+        qInfo() << "Imported" << imported << "hosts from settings to" << m_Path << "(" << reason << ")";
+    }
+}
+
+void HostStore::setAside(bool keepOriginal)
+{
+    QString corruptPath = m_Path + HOST_STORE_CORRUPT_SUFFIX;
+
+    // Only the most recent bad store is kept
+    QFile::remove(corruptPath);
+
+    bool ok = keepOriginal ? QFile::copy(m_Path, corruptPath) : QFile::rename(m_Path, corruptPath);
+    if (ok) {
+        qWarning() << "Saved damaged host store as" << corruptPath;
+    }
+    else {
+        // Overwriting it would lose whatever we couldn't read
+        qWarning() << "Failed to set aside damaged host store" << m_Path << ". It will not be overwritten.";
+        m_Unwritable = true;
+    }
+}
+
+void HostStore::updateHost(const NvComputer& computer, bool appsChanged)
+{
+    Record& record = m_Records[computer.uuid];
+
+    {
+        QByteArray host;
+        QDataStream stream(&host, QIODevice::WriteOnly);
+        stream.setVersion(HOST_STORE_STREAM_VERSION);
+        computer.serialize(stream);
+        record.host = host;
+    }
+
+    // Avoid deleting an existing applist if we couldn't get one
+    if (record.apps.isEmpty() || (appsChanged && !computer.appList.isEmpty())) {
+        QByteArray apps;
+        QDataStream stream(&apps, QIODevice::WriteOnly);
+        stream.setVersion(HOST_STORE_STREAM_VERSION);
+        computer.serializeApps(stream);
+        record.apps = apps;
+    }
+
+    m_Dirty = true;
+}
+
+void HostStore::removeHost(const QString& uuid)
+{
+    if (m_Records.remove(uuid) != 0) {
+        m_Dirty = true;
+    }
+}
+
+QList<QString> HostStore::uuids() const
+{
+    return m_Records.keys();
+}
+
+bool HostStore::commit()
+{
+    if (!m_Dirty) {
+        return true;
+    }
+
+    if (m_Unwritable) {
+        qWarning() << "Not overwriting unreadable host store" << m_Path;
+        return false;
+    }
+
+    QDir().mkpath(QFileInfo(m_Path).absolutePath());
+
+    // QSaveFile writes to a temporary file and renames it over the old
+    // store on commit(), so a crash mid-write leaves the old store intact.
+    QSaveFile file(m_Path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to open host store" << m_Path << "for writing:" << file.errorString();
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(HOST_STORE_STREAM_VERSION);
+    stream << (quint32)HOST_STORE_MAGIC << (quint16)HOST_STORE_VERSION << (quint32)m_Records.count();
+    for (const Record& record : std::as_const(m_Records)) {
+        stream << record.host << record.apps;
+    }
+
+    if (stream.status() != QDataStream::Ok || !file.commit()) {
+        qWarning() << "Failed to write host store" << m_Path << ":" << file.errorString();
+        return false;
+    }
+
+    m_Dirty = false;
+    return true;
+}
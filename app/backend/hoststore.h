@@ -0,0 +1,67 @@
+#pragma once
+
+#include "nvcomputer.h"
+
+#include <QByteArray>
+#include <QMap>
+#include <QString>
+#include <QVector>
+
+// Persists known hosts in a single binary file that is read in one pass at
+// startup and replaced atomically (write-then-rename) on every commit.
+//
+// Each host is kept as two pre-encoded records, one for its persisted
+// traits and one for its app list. Only the records of hosts that changed
+// are re-encoded, so a commit is little more than writing out the cached
+// bytes, regardless of how many hosts and apps are stored. The whole file
+// is still rewritten on each commit.
+//
+// A store that can't be read is never overwritten. It is renamed aside
+// (hosts.db.corrupt) and the hosts are recovered from the legacy QSettings
+// arrays when those exist. A truncated store keeps the hosts it could read,
+// and a copy of it is set aside the same way.
+//
+// Not thread-safe. ComputerManager uses it from its constructor and then
+// only from the delayed flush thread.
+class HostStore
+{
+public:
+    HostStore();
+
+    // Loads all stored hosts. On first run, imports them from the legacy
+    // QSettings arrays. Those are left in place so an older build that
+    // doesn't know about the store still finds its hosts after a downgrade.
+    QVector<NvComputer*> load();
+
+    // Re-encodes a host's record, and its app list too if appsChanged
+    void updateHost(const NvComputer& computer, bool appsChanged);
+
+    void removeHost(const QString& uuid);
+
+    QList<QString> uuids() const;
+
+    // Writes the store to disk if anything changed since the last commit.
+    // Fails if an unreadable store couldn't be moved out of the way.
+    bool commit();
+
+private:
+    struct Record
+    {
+        QByteArray host;
+        QByteArray apps;
+    };
+
+    // Reads the legacy QSettings arrays without modifying them
+    static QVector<NvComputer*> readLegacySettings();
+
+    // Adds legacy hosts missing from hosts to the store and to hosts
+    void importFromSettings(QVector<NvComputer*>& hosts, const char* reason);
+
+    // Moves (or copies, if keepOriginal) the store to m_Path.corrupt
+    void setAside(bool keepOriginal);
+
+    QString m_Path;
+    QMap<QString, Record> m_Records;
+    bool m_Dirty;
+    bool m_Unwritable;
+};
@@ -17,12 +17,15 @@ NvApp::NvApp(QSettings& settings)
     directLaunch = settings.value(SER_DIRECTLAUNCH).toBool();
 }
 
-void NvApp::serialize(QSettings& settings) const
+NvApp::NvApp(QDataStream& stream)
 {
-    settings.setValue(SER_APPNAME, name);
-    settings.setValue(SER_APPID, id);
-    settings.setValue(SER_APPHDR, hdrSupported);
-    settings.setValue(SER_APPCOLLECTOR, isAppCollectorGame);
-    settings.setValue(SER_HIDDEN, hidden);
-    settings.setValue(SER_DIRECTLAUNCH, directLaunch);
+    qint32 appId;
+
+    stream >> name >> appId >> hdrSupported >> isAppCollectorGame >> hidden >> directLaunch;
+    id = appId;
+}
+
+void NvApp::serialize(QDataStream& stream) const
+{
+    stream << name << (qint32)id << hdrSupported << isAppCollectorGame << hidden << directLaunch;
 }
@@ -40,10 +40,14 @@ public:
     // Caller is responsible for synchronizing read access to the other host
     NvComputer& operator=(const NvComputer &) = default;
 
-    explicit NvComputer(NvHTTP& http, QString serverInfo);
+    explicit NvComputer(NvHTTP& http, const NvServerInfo& serverInfo);
 
     explicit NvComputer(QSettings& settings);
 
+    // Inflates a host from the records written by serialize(QDataStream&)
+    // and serializeApps()
+    explicit NvComputer(QDataStream& hostRecord, QDataStream& appsRecord);
+
     void
     setRemoteAddress(QHostAddress);
 
@@ -78,8 +82,12 @@ public:
     bool
     hasAddressTestSucceeded(const NvAddress& address) const;
 
+    // Persisted traits other than the app list
+    void
+    serialize(QDataStream& stream) const;
+
     void
-    serialize(QSettings& settings, bool serializeApps) const;
+    serializeApps(QDataStream& stream) const;
 
     // Caller is responsible for synchronizing read access to both hosts
     bool
@@ -140,6 +148,8 @@ public:
     static QString getPairname(const QString& uuid);
 
 private:
+    void initEphemeralState();
+
     uint16_t externalPort;
     QVector<NvAddress> m_TestedAddresses;
     mutable bool m_HasActiveAddressReachability = false;
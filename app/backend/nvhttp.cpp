@@ -123,27 +123,10 @@ NvHTTP::parseQuad(QString quad)
     return ret;
 }
 
-int
-NvHTTP::getCurrentGame(QString serverInfo)
-{
-    // GFE 2.8 started keeping currentgame set to the last game played. As a result, it no longer
-    // has the semantics that its name would indicate. To contain the effects of this change as much
-    // as possible, we'll force the current game to zero if the server isn't in a streaming session.
-    QString serverState = getXmlString(serverInfo, "state");
-    if (serverState.endsWith("_SERVER_BUSY"))
-    {
-        return getXmlString(serverInfo, "currentgame").toInt();
-    }
-    else
-    {
-        return 0;
-    }
-}
-
-QString
+NvServerInfo
 NvHTTP::getServerInfo(NvLogLevel logLevel, bool fastFail)
 {
-    QString serverInfo;
+    NvServerInfo serverInfo;
 
     // Check if we have a pinned cert and HTTPS port for this host yet
     if (!m_ServerCert.isNull() && httpsPort() != 0)
@@ -152,25 +135,25 @@ NvHTTP::getServerInfo(NvLogLevel logLevel, bool fastFail)
         {
             // Always try HTTPS first, since it properly reports
             // pairing status (and a few other attributes).
-            serverInfo = openConnectionToString(m_BaseUrlHttps,
-                                                "serverinfo",
-                                                nullptr,
-                                                fastFail ? FAST_FAIL_TIMEOUT_MS : REQUEST_TIMEOUT_MS,
-                                                logLevel);
+            serverInfo = NvServerInfo::parse(openConnectionToBytes(m_BaseUrlHttps,
+                                                                   "serverinfo",
+                                                                   nullptr,
+                                                                   fastFail ? FAST_FAIL_TIMEOUT_MS : REQUEST_TIMEOUT_MS,
+                                                                   logLevel));
             // Throws if the request failed
-            verifyResponseStatus(serverInfo);
+            verifyResponseStatus(serverInfo.status);
         }
         catch (const GfeHttpResponseException& e)
         {
             if (e.getStatusCode() == 401)
             {
                 // Certificate validation error, fallback to HTTP
-                serverInfo = openConnectionToString(m_BaseUrlHttp,
-                                                    "serverinfo",
-                                                    nullptr,
-                                                    fastFail ? FAST_FAIL_TIMEOUT_MS : REQUEST_TIMEOUT_MS,
-                                                    logLevel);
-                verifyResponseStatus(serverInfo);
+                serverInfo = NvServerInfo::parse(openConnectionToBytes(m_BaseUrlHttp,
+                                                                       "serverinfo",
+                                                                       nullptr,
+                                                                       fastFail ? FAST_FAIL_TIMEOUT_MS : REQUEST_TIMEOUT_MS,
+                                                                       logLevel));
+                verifyResponseStatus(serverInfo.status);
             }
             else
             {
@@ -182,15 +165,15 @@ NvHTTP::getServerInfo(NvLogLevel logLevel, bool fastFail)
     else
     {
         // Only use HTTP prior to pairing or fetching HTTPS port
-        serverInfo = openConnectionToString(m_BaseUrlHttp,
-                                            "serverinfo",
-                                            nullptr,
-                                            fastFail ? FAST_FAIL_TIMEOUT_MS : REQUEST_TIMEOUT_MS,
-                                            logLevel);
-        verifyResponseStatus(serverInfo);
+        serverInfo = NvServerInfo::parse(openConnectionToBytes(m_BaseUrlHttp,
+                                                               "serverinfo",
+                                                               nullptr,
+                                                               fastFail ? FAST_FAIL_TIMEOUT_MS : REQUEST_TIMEOUT_MS,
+                                                               logLevel));
+        verifyResponseStatus(serverInfo.status);
 
         // Populate the HTTPS port
-        uint16_t httpsPort = getXmlString(serverInfo, "HttpsPort").toUShort();
+        uint16_t httpsPort = serverInfo.httpsPort.toUShort();
         if (httpsPort == 0) {
             httpsPort = DEFAULT_HTTPS_PORT;
         }
@@ -319,92 +302,37 @@ NvHTTP::quitApp()
 
     // Newer GFE versions will just return success even if quitting fails
     // if we're not the original requester.
-    if (getCurrentGame(getServerInfo(NvHTTP::NVLL_ERROR)) != 0) {
+    if (getServerInfo(NvHTTP::NVLL_ERROR).currentGameId() != 0) {
         // Generate a synthetic GfeResponseException letting the caller know
         // that they can't kill someone else's stream.
         throw GfeHttpResponseException(599, "");
     }
 }
 
-QVector<NvDisplayMode>
-NvHTTP::getDisplayModeList(QString serverInfo)
-{
-    QXmlStreamReader xmlReader(serverInfo);
-    QVector<NvDisplayMode> modes;
-
-    while (!xmlReader.atEnd()) {
-        while (xmlReader.readNextStartElement()) {
-            auto name = xmlReader.name();
-            if (XML_NAME_EQUALS(name, "DisplayMode")) {
-                modes.append(NvDisplayMode());
-            }
-            else if (!modes.isEmpty()) {
-                if (XML_NAME_EQUALS(name, "Width")) {
-                    modes.last().width = xmlReader.readElementText().toInt();
-                }
-                else if (XML_NAME_EQUALS(name, "Height")) {
-                    modes.last().height = xmlReader.readElementText().toInt();
-                }
-                else if (XML_NAME_EQUALS(name, "RefreshRate")) {
-                    modes.last().refreshRate = xmlReader.readElementText().toInt();
-                }
-            }
-        }
-    }
-
-    return modes;
-}
-
 QVector<NvApp>
 NvHTTP::getAppList()
 {
-    QString appxml = openConnectionToString(m_BaseUrlHttps,
-                                            "applist",
-                                            nullptr,
-                                            REQUEST_TIMEOUT_MS,
-                                            NvLogLevel::NVLL_ERROR);
-    verifyResponseStatus(appxml);
-
-    QXmlStreamReader xmlReader(appxml);
-    QVector<NvApp> apps;
-    while (!xmlReader.atEnd()) {
-        while (xmlReader.readNextStartElement()) {
-            auto name = xmlReader.name();
-            if (XML_NAME_EQUALS(name, "App")) {
-                // We must have a valid app before advancing to the next one
-                if (!apps.isEmpty() && !apps.last().isInitialized()) {
-                    qWarning() << "Invalid applist XML";
-                    throw std::runtime_error("Invalid applist XML");
-                }
-                apps.append(NvApp());
-            }
-            else if (!apps.isEmpty()) {
-                if (XML_NAME_EQUALS(name, "AppTitle")) {
-                    // If an app has no name, Sunshine may send us <AppTitle/>,
-                    // which readElementText() returns as a null QString.
-                    // We want to treat this as an empty QString instead, so we
-                    // will explicitly convert it. An empty string will satisfy
-                    // NvApp's isInitialized() check.
-                    QString name = xmlReader.readElementText();
-                    if (name.isNull()) {
-                        name = "";
-                    }
-                    apps.last().name = name;
-                }
-                else if (XML_NAME_EQUALS(name, "ID")) {
-                    apps.last().id = xmlReader.readElementText().toInt();
-                }
-                else if (XML_NAME_EQUALS(name, "IsHdrSupported")) {
-                    apps.last().hdrSupported = xmlReader.readElementText() == "1";
-                }
-                else if (XML_NAME_EQUALS(name, "IsAppCollectorGame")) {
-                    apps.last().isAppCollectorGame = xmlReader.readElementText() == "1";
-                }
-            }
-        }
+    // Parse the applist as it arrives rather than buffering the whole
+    // response first. Hosts with large libraries send hundreds of KB here.
+    NvAppListParser parser;
+    QNetworkReply* reply = openConnection(m_BaseUrlHttps,
+                                          "applist",
+                                          nullptr,
+                                          REQUEST_TIMEOUT_MS,
+                                          NvLogLevel::NVLL_ERROR,
+                                          [&parser](QNetworkReply* reply) {
+                                              parser.addData(reply->readAll());
+                                          });
+    parser.addData(reply->readAll());
+    delete reply;
+
+    bool valid = parser.finish();
+    verifyResponseStatus(parser.status());
+    if (!valid) {
+        throw std::runtime_error("Invalid applist XML");
     }
 
-    return apps;
+    return parser.takeApps();
 }
 
 QVariantList
@@ -469,6 +397,7 @@ void
 NvHTTP::verifyResponseStatus(QString xml)
 {
     QXmlStreamReader xmlReader(xml);
+    NvResponseStatus status;
 
     while (xmlReader.readNextStartElement())
     {
@@ -477,31 +406,42 @@ NvHTTP::verifyResponseStatus(QString xml)
             // Status code can be 0xFFFFFFFF in some rare cases on GFE 3.20.3, and
             // QString::toInt() will fail in that case, so use QString::toUInt()
             // and cast the result to an int instead.
-            int statusCode = (int)xmlReader.attributes().value("status_code").toUInt();
-            if (statusCode == 200)
-            {
-                // Successful
-                return;
-            }
-            else
-            {
-                QString statusMessage = xmlReader.attributes().value("status_message").toString();
-                if (statusCode != 401) {
-                    // 401 is expected for unpaired PCs when we fetch serverinfo over HTTPS
-                    qWarning() << "Request failed:" << statusCode << statusMessage;
-                }
-                if (statusCode == -1 && statusMessage == "Invalid") {
-                    // Special case handling an audio capture error which GFE doesn't
-                    // provide any useful status message for.
-                    statusCode = 418;
-                    statusMessage = tr("Missing audio capture device. Reinstalling GeForce Experience should resolve this error.");
-                }
-                throw GfeHttpResponseException(statusCode, statusMessage);
-            }
+            status.hasRoot = true;
+            status.code = (int)xmlReader.attributes().value("status_code").toUInt();
+            status.message = xmlReader.attributes().value("status_message").toString();
+            break;
         }
     }
 
-    throw GfeHttpResponseException(-1, "Malformed XML (missing root element)");
+    verifyResponseStatus(status);
+}
+
+void
+NvHTTP::verifyResponseStatus(const NvResponseStatus& status)
+{
+    if (!status.hasRoot)
+    {
+        throw GfeHttpResponseException(-1, "Malformed XML (missing root element)");
+    }
+    else if (status.code == 200)
+    {
+        // Successful
+        return;
+    }
+
+    int statusCode = status.code;
+    QString statusMessage = status.message;
+    if (statusCode != 401) {
+        // 401 is expected for unpaired PCs when we fetch serverinfo over HTTPS
+        qWarning() << "Request failed:" << statusCode << statusMessage;
+    }
+    if (statusCode == -1 && statusMessage == "Invalid") {
+        // Special case handling an audio capture error which GFE doesn't
+        // provide any useful status message for.
+        statusCode = 418;
+        statusMessage = tr("Missing audio capture device. Reinstalling GeForce Experience should resolve this error.");
+    }
+    throw GfeHttpResponseException(statusCode, statusMessage);
 }
 
 QImage
@@ -594,6 +534,22 @@ NvHTTP::openConnectionToString(QUrl baseUrl,
     return ret;
 }
 
+QByteArray
+NvHTTP::openConnectionToBytes(QUrl baseUrl,
+                              QString command,
+                              QString arguments,
+                              int timeoutMs,
+                              NvLogLevel logLevel)
+{
+    // QXmlStreamReader decodes the raw bytes itself, so this avoids
+    // transcoding the whole response to a QString up front.
+    QNetworkReply* reply = openConnection(baseUrl, command, arguments, timeoutMs, logLevel);
+    QByteArray ret = reply->readAll();
+    delete reply;
+
+    return ret;
+}
+
 bool
 NvHTTP::getAbrCapabilities(int* hostMaxBitrateKbps)
 {
@@ -661,7 +617,8 @@ NvHTTP::openConnection(QUrl baseUrl,
                        QString command,
                        QString arguments,
                        int timeoutMs,
-                       NvLogLevel logLevel)
+                       NvLogLevel logLevel,
+                       const std::function<void(QNetworkReply*)>& readyRead)
 {
     // Port must be set
     Q_ASSERT(baseUrl.port(0) != 0);
@@ -710,6 +667,11 @@ NvHTTP::openConnection(QUrl baseUrl,
     // Run the request with a timeout if requested
     QEventLoop loop;
     connect(reply, &QNetworkReply::finished, &loop, &QEventLoop::quit);
+    if (readyRead) {
+        connect(reply, &QNetworkReply::readyRead, &loop, [reply, &readyRead]() {
+            readyRead(reply);
+        });
+    }
     connect(QCoreApplication::instance(), &QCoreApplication::aboutToQuit, &loop, &QEventLoop::quit);
     if (timeoutMs) {
         QTimer::singleShot(timeoutMs, &loop, &QEventLoop::quit);
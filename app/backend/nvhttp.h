@@ -3,6 +3,7 @@
 #include "identitymanager.h"
 #include "nvapp.h"
 #include "nvaddress.h"
+#include "nvxmlparser.h"
 #include "remotecomputer.h"
 
 #include <Limelight.h>
@@ -13,26 +14,11 @@
 #include <QJsonObject>
 #include <QVariant>
 
+#include <functional>
 #include <optional>
 
 class NvComputer;
 
-class NvDisplayMode
-{
-public:
-    bool operator==(const NvDisplayMode& other) const
-    {
-        return width == other.width &&
-                height == other.height &&
-                refreshRate == other.refreshRate;
-    }
-
-    int width;
-    int height;
-    int refreshRate;
-};
-Q_DECLARE_TYPEINFO(NvDisplayMode, Q_PRIMITIVE_TYPE);
-
 class GfeHttpResponseException : public std::exception
 {
 public:
@@ -118,17 +104,17 @@ public:
 
     explicit NvHTTP(NvComputer* computer, QNetworkAccessManager* nam = nullptr);
 
-    static
-    int
-    getCurrentGame(QString serverInfo);
-
-    QString
+    NvServerInfo
     getServerInfo(NvLogLevel logLevel, bool fastFail = false);
 
     static
     void
     verifyResponseStatus(QString xml);
 
+    static
+    void
+    verifyResponseStatus(const NvResponseStatus& status);
+
     static
     QString
     getXmlString(QString xml,
@@ -209,10 +195,6 @@ public:
     QImage
     getBoxArt(int appId);
 
-    static
-    QVector<NvDisplayMode>
-    getDisplayModeList(QString serverInfo);
-
     QUrl m_BaseUrlHttp;
     QUrl m_BaseUrlHttps;
 private:
@@ -224,7 +206,15 @@ private:
                    QString command,
                    QString arguments,
                    int timeoutMs,
-                   NvLogLevel logLevel);
+                   NvLogLevel logLevel,
+                   const std::function<void(QNetworkReply*)>& readyRead = nullptr);
+
+    QByteArray
+    openConnectionToBytes(QUrl baseUrl,
+                          QString command,
+                          QString arguments,
+                          int timeoutMs,
+                          NvLogLevel logLevel);
 
     QNetworkReply*
     openJsonConnection(QUrl baseUrl,
@@ -0,0 +1,174 @@
+#include "nvxmlparser.h"
+
+#include <QDebug>
+
+namespace {
+
+struct ServerInfoField
+{
+    QLatin1String tag;
+    QString NvServerInfo::* member;
+};
+
+const ServerInfoField k_ServerInfoFields[] = {
+    { QLatin1String("hostname"), &NvServerInfo::hostname },
+    { QLatin1String("uniqueid"), &NvServerInfo::uniqueId },
+    { QLatin1String("mac"), &NvServerInfo::mac },
+    { QLatin1String("LocalIP"), &NvServerInfo::localIp },
+    { QLatin1String("ExternalIP"), &NvServerInfo::externalIp },
+    { QLatin1String("HttpsPort"), &NvServerInfo::httpsPort },
+    { QLatin1String("ExternalPort"), &NvServerInfo::externalPort },
+    { QLatin1String("state"), &NvServerInfo::state },
+    { QLatin1String("PairStatus"), &NvServerInfo::pairStatus },
+    { QLatin1String("currentgame"), &NvServerInfo::currentGame },
+    { QLatin1String("appversion"), &NvServerInfo::appVersion },
+    { QLatin1String("GfeVersion"), &NvServerInfo::gfeVersion },
+    { QLatin1String("gputype"), &NvServerInfo::gpuType },
+    { QLatin1String("ServerCodecModeSupport"), &NvServerInfo::serverCodecModeSupport },
+    { QLatin1String("MaxLumaPixelsHEVC"), &NvServerInfo::maxLumaPixelsHEVC },
+};
+
+void readRootStatus(const QXmlStreamReader& reader, NvResponseStatus& status)
+{
+    // Status code can be 0xFFFFFFFF in some rare cases on GFE 3.20.3, and
+    // QString::toInt() will fail in that case, so use QString::toUInt()
+    // and cast the result to an int instead.
+    status.hasRoot = true;
+    status.code = (int)reader.attributes().value(QLatin1String("status_code")).toUInt();
+    status.message = reader.attributes().value(QLatin1String("status_message")).toString();
+}
+
+}
+
+NvServerInfo NvServerInfo::parse(const QByteArray& xml)
+{
+    NvServerInfo info;
+    QXmlStreamReader reader(xml);
+
+    while (!reader.atEnd()) {
+        if (reader.readNext() != QXmlStreamReader::StartElement) {
+            continue;
+        }
+
+        auto name = reader.name();
+        if (!info.status.hasRoot && name == QLatin1String("root")) {
+            readRootStatus(reader, info.status);
+            continue;
+        }
+
+        if (name == QLatin1String("DisplayMode")) {
+            info.displayModes.append(NvDisplayMode());
+            continue;
+        }
+        else if (!info.displayModes.isEmpty()) {
+            if (name == QLatin1String("Width")) {
+                info.displayModes.last().width = reader.readElementText().toInt();
+                continue;
+            }
+            else if (name == QLatin1String("Height")) {
+                info.displayModes.last().height = reader.readElementText().toInt();
+                continue;
+            }
+            else if (name == QLatin1String("RefreshRate")) {
+                info.displayModes.last().refreshRate = reader.readElementText().toInt();
+                continue;
+            }
+        }
+
+        for (const ServerInfoField& field : k_ServerInfoFields) {
+            // Like the old per-tag lookup, the first occurrence wins
+            if (name == field.tag) {
+                QString& value = info.*field.member;
+                if (value.isNull()) {
+                    value = reader.readElementText();
+                }
+                break;
+            }
+        }
+    }
+
+    return info;
+}
+
+void NvAppListParser::addData(const QByteArray& data)
+{
+    m_Reader.addData(data);
+    pump();
+}
+
+bool NvAppListParser::finish()
+{
+    pump();
+    return !m_Invalid;
+}
+
+void NvAppListParser::pump()
+{
+    while (!m_Invalid && !m_Reader.atEnd()) {
+        switch (m_Reader.readNext()) {
+        case QXmlStreamReader::StartElement:
+        {
+            auto name = m_Reader.name();
+            if (!m_Status.hasRoot && name == QLatin1String("root")) {
+                readRootStatus(m_Reader, m_Status);
+            }
+            else if (name == QLatin1String("App")) {
+                // We must have a valid app before advancing to the next one
+                if (!m_Apps.isEmpty() && !m_Apps.last().isInitialized()) {
+                    qWarning() << "Invalid applist XML";
+                    m_Invalid = true;
+                    return;
+                }
+                m_Apps.append(NvApp());
+            }
+
+            m_Element = name.toString();
+            m_Text.clear();
+            break;
+        }
+
+        case QXmlStreamReader::Characters:
+            // Text can arrive split across chunks
+            m_Text += m_Reader.text();
+            break;
+
+        case QXmlStreamReader::EndElement:
+            if (!m_Apps.isEmpty() && !m_Element.isEmpty()) {
+                NvApp& app = m_Apps.last();
+                if (m_Element == QLatin1String("AppTitle")) {
+                    // If an app has no name, Sunshine may send us <AppTitle/>.
+                    // We want to treat this as an empty QString instead of a
+                    // null one, which will satisfy NvApp's isInitialized() check.
+                    app.name = m_Text.isNull() ? QString("") : m_Text;
+                }
+                else if (m_Element == QLatin1String("ID")) {
+                    app.id = m_Text.toInt();
+                }
+                else if (m_Element == QLatin1String("IsHdrSupported")) {
+                    app.hdrSupported = m_Text == QLatin1String("1");
+                }
+                else if (m_Element == QLatin1String("IsAppCollectorGame")) {
+                    app.isAppCollectorGame = m_Text == QLatin1String("1");
+                }
+            }
+
+            m_Element.clear();
+            m_Text.clear();
+            break;
+
+        case QXmlStreamReader::Invalid:
+            // Out of data for now. More will come via addData().
+            //
+            // Anything else is a malformed document. Like the old applist
+            // loop, keep the apps parsed up to that point rather than failing
+            // the whole list. The reader stays at end, so nothing more is parsed.
+            if (m_Reader.error() != QXmlStreamReader::PrematureEndOfDocumentError) {
+                qWarning() << "Malformed applist XML:" << m_Reader.errorString();
+            }
+            return;
+
+        default:
+            break;
+        }
+    }
+}
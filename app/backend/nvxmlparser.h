@@ -0,0 +1,107 @@
+#pragma once
+
+#include "nvapp.h"
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+#include <QXmlStreamReader>
+
+class NvDisplayMode
+{
+public:
+    bool operator==(const NvDisplayMode& other) const
+    {
+        return width == other.width &&
+                height == other.height &&
+                refreshRate == other.refreshRate;
+    }
+
+    int width;
+    int height;
+    int refreshRate;
+};
+Q_DECLARE_TYPEINFO(NvDisplayMode, Q_PRIMITIVE_TYPE);
+
+// The status attributes of a response's <root> element
+class NvResponseStatus
+{
+public:
+    bool hasRoot = false;
+    int code = 0;
+    QString message;
+};
+
+// Every /serverinfo field we use, extracted in a single pass over the raw
+// response bytes. Fields that are missing from the response are null.
+class NvServerInfo
+{
+public:
+    static NvServerInfo parse(const QByteArray& xml);
+
+    bool isNull() const
+    {
+        return !status.hasRoot;
+    }
+
+    // GFE 2.8 started keeping currentgame set to the last game played. As a result, it no longer
+    // has the semantics that its name would indicate. To contain the effects of this change as much
+    // as possible, we'll force the current game to zero if the server isn't in a streaming session.
+    int currentGameId() const
+    {
+        return state.endsWith("_SERVER_BUSY") ? currentGame.toInt() : 0;
+    }
+
+    NvResponseStatus status;
+
+    QString hostname;
+    QString uniqueId;
+    QString mac;
+    QString localIp;
+    QString externalIp;
+    QString httpsPort;
+    QString externalPort;
+    QString state;
+    QString pairStatus;
+    QString currentGame;
+    QString appVersion;
+    QString gfeVersion;
+    QString gpuType;
+    QString serverCodecModeSupport;
+    QString maxLumaPixelsHEVC;
+    QVector<NvDisplayMode> displayModes;
+};
+
+// Incremental /applist parser. Feed it response bytes as they arrive and
+// the apps are built as their elements complete, so parsing overlaps the
+// download instead of following it.
+class NvAppListParser
+{
+public:
+    void addData(const QByteArray& data);
+
+    // Call once the response is complete. Returns false if an <App> began
+    // before the previous one was complete. A malformed document keeps the
+    // apps parsed before the error, as the old applist parsing did.
+    bool finish();
+
+    const NvResponseStatus& status() const
+    {
+        return m_Status;
+    }
+
+    QVector<NvApp> takeApps()
+    {
+        return std::move(m_Apps);
+    }
+
+private:
+    void pump();
+
+    QXmlStreamReader m_Reader;
+    NvResponseStatus m_Status;
+    QVector<NvApp> m_Apps;
+    QString m_Element;
+    QString m_Text;
+    bool m_Invalid = false;
+};
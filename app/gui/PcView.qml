@@ -642,6 +642,8 @@ CenteredGridView {
         anchors.fill: parent
         source: ""
         fillMode: Image.PreserveAspectCrop
+        // 缓存图已按屏幕尺寸缩放，放到后台线程解码避免启动卡顿
+        asynchronous: true
         z: -2
         property string currentImageUrl: ""
 
@@ -671,8 +673,11 @@ CenteredGridView {
             settings.cachedImagePath = cachePath
             console.log("handleImageResponse: " + cachePath)
             var fileUrl = "file:///" + cachePath.replace(/\\/g, "/").replace(/^\/+/, "")
-            source = ""
-            source = fileUrl
+            // 文件名带内容哈希，同名即同一张图，无需重新加载。
+            // 新图就绪前一直显示旧图。
+            if (fileUrl !== currentImageUrl) {
+                source = fileUrl
+            }
             currentImageUrl = fileUrl
             pcGrid.currentBgUrl = fileUrl
             settings.lastRefreshTime = Date.now()
@@ -686,7 +691,10 @@ CenteredGridView {
         }
 
         Component.onCompleted: {
-            // 先检查缓存图是否存在
+            // 先检查缓存图是否存在，设置里的路径失效时退回到缓存目录里最新的一张
+            if (!settings.cachedImagePath || !imageUtils.fileExists(settings.cachedImagePath)) {
+                settings.cachedImagePath = imageUtils.latestCachedBackground()
+            }
             if (settings.cachedImagePath && imageUtils.fileExists(settings.cachedImagePath)) {
                 try {
                     var fileUrl = "file:///" + settings.cachedImagePath.replace(/\\/g, "/").replace(/^\/+/, "");
@@ -0,0 +1,490 @@
+#include "sdlgamepadinputthread.h"
+
+#include <QCoreApplication>
+#include <QMutexLocker>
+#include <QVarLengthArray>
+
+#include <chrono>
+#include <cstring>
+
+#include "settings/mappingmanager.h"
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+#define AXIS_NAVIGATION_REPEAT_DELAY 150
+#define AXIS_NAVIGATION_THRESHOLD 30000
+
+// Stick deflection that counts as the controller being in use
+#define AXIS_ACTIVITY_THRESHOLD 8000
+
+// While a controller is in use we poll fast enough that polling adds no
+// noticeable latency. After that we back off, but never past the 50 ms the
+// old fixed timer used, so the first press after a pause is no slower than
+// before. With no controller attached we only need to notice hotplug.
+#define ACTIVE_POLL_INTERVAL_MS 8
+#define IDLE_POLL_INTERVAL_MS 50
+#define NO_GAMEPAD_POLL_INTERVAL_MS 250
+#define ACTIVE_PERIOD_MS 1000
+
+// Waiting on device nodes still times out this often, in case the hotplug
+// watch misses a device SDL can see
+#define EVENT_DRIVEN_IDLE_TIMEOUT_MS 1000
+
+#define STATS_INTERVAL_US (10 * 1000 * 1000)
+
+SdlGamepadInputThread::SdlGamepadInputThread(QObject* parent)
+    : QThread(parent),
+      m_Active(false),
+      m_NeedsFlush(false),
+      m_Startup(StartupState::Pending),
+      m_LastAxisNavigationEventTime(0),
+      m_LastActivityTime(0),
+      m_EventDriven(false),
+      m_WakeupCount(0),
+      m_StatsStartUs(0),
+      m_HotplugFd(-1)
+{
+    m_WakePipe[0] = m_WakePipe[1] = -1;
+
+#ifdef Q_OS_LINUX
+    if (pipe2(m_WakePipe, O_NONBLOCK | O_CLOEXEC) < 0) {
+        m_WakePipe[0] = m_WakePipe[1] = -1;
+    }
+#endif
+}
+
+SdlGamepadInputThread::~SdlGamepadInputThread()
+{
+    stop();
+
+#ifdef Q_OS_LINUX
+    if (m_WakePipe[0] >= 0) {
+        close(m_WakePipe[0]);
+        close(m_WakePipe[1]);
+    }
+#endif
+}
+
+quint64 SdlGamepadInputThread::currentTimeUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool SdlGamepadInputThread::startInput()
+{
+    {
+        QMutexLocker locker(&m_Lock);
+        m_Startup = StartupState::Pending;
+    }
+
+    start();
+
+    // Callers expect the controllers to be visible as soon as this returns
+    QMutexLocker locker(&m_Lock);
+    while (m_Startup == StartupState::Pending) {
+        m_Cond.wait(&m_Lock);
+    }
+
+    return m_Startup == StartupState::Running;
+}
+
+void SdlGamepadInputThread::setActive(bool active)
+{
+    {
+        QMutexLocker locker(&m_Lock);
+        if (active && !m_Active) {
+            // Drop anything that happened while we weren't looking, like
+            // the quit combo from a stream that just ended
+            m_NeedsFlush = true;
+        }
+        m_Active = active;
+    }
+
+    wake();
+}
+
+void SdlGamepadInputThread::stop()
+{
+    if (!isRunning()) {
+        return;
+    }
+
+    requestInterruption();
+    wake();
+    wait();
+}
+
+void SdlGamepadInputThread::wake()
+{
+    {
+        QMutexLocker locker(&m_Lock);
+        m_Cond.wakeAll();
+    }
+
+#ifdef Q_OS_LINUX
+    if (m_WakePipe[1] >= 0) {
+        char c = 0;
+        (void)!write(m_WakePipe[1], &c, sizeof(c));
+    }
+#endif
+}
+
+void SdlGamepadInputThread::run()
+{
+    // We have to initialize and uninitialize this while the UI comes and
+    // goes because we need to get out of the way of the Session class. If it
+    // doesn't get to reinitialize the GC subsystem, it won't get initial
+    // arrival events. Additionally, there's a race condition between
+    // our QML objects being destroyed and SDL being deinitialized that
+    // this solves too.
+    if (SDL_InitSubSystem(SDL_INIT_GAMECONTROLLER) != 0) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "SDL_InitSubSystem(SDL_INIT_GAMECONTROLLER) failed: %s",
+                     SDL_GetError());
+
+        QMutexLocker locker(&m_Lock);
+        m_Startup = StartupState::Failed;
+        m_Cond.wakeAll();
+        return;
+    }
+
+    MappingManager mappingManager;
+    mappingManager.applyMappings();
+
+    // Drop all pending gamepad add events. SDL will generate these for us
+    // on first init of the GC subsystem. We can't depend on them due to
+    // overlapping lifetimes of SdlGamepadKeyNavigation instances, so we
+    // will attach ourselves.
+    //
+    // NB: We use SDL_JoystickUpdate() instead of SDL_PumpEvents() because
+    // the latter can do a bit more work that we want (like handling video
+    // events that we intentionally do not want to process yet).
+    SDL_JoystickUpdate();
+    SDL_FlushEvent(SDL_CONTROLLERDEVICEADDED);
+
+    // Open all currently attached game controllers
+    int numJoysticks = SDL_NumJoysticks();
+    for (int i = 0; i < numJoysticks; i++) {
+        handleControllerAdded(i);
+    }
+
+#ifdef Q_OS_LINUX
+    // Device nodes for controllers come and go here
+    m_HotplugFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_HotplugFd >= 0 && inotify_add_watch(m_HotplugFd, "/dev/input", IN_CREATE | IN_DELETE | IN_ATTRIB) < 0) {
+        close(m_HotplugFd);
+        m_HotplugFd = -1;
+    }
+#endif
+    rebuildReadinessSources();
+
+    {
+        QMutexLocker locker(&m_Lock);
+        m_Startup = StartupState::Running;
+        m_Cond.wakeAll();
+    }
+
+    m_LastActivityTime = SDL_GetTicks();
+    m_WakeupCount = 0;
+    m_StatsStartUs = currentTimeUs();
+    int timeoutMs = 0;
+    while (waitUntilActive()) {
+        waitForInput(timeoutMs);
+        if (isInterruptionRequested()) {
+            break;
+        }
+
+        m_WakeupCount++;
+        bool activity = pollControllers(currentTimeUs());
+        timeoutMs = nextTimeoutMs(activity);
+        logStats();
+    }
+
+    closeReadinessSources();
+#ifdef Q_OS_LINUX
+    if (m_HotplugFd >= 0) {
+        close(m_HotplugFd);
+        m_HotplugFd = -1;
+    }
+#endif
+
+    while (!m_Gamepads.isEmpty()) {
+        SDL_GameControllerClose(m_Gamepads.takeFirst());
+    }
+
+    SDL_QuitSubSystem(SDL_INIT_GAMECONTROLLER);
+}
+
+bool SdlGamepadInputThread::waitUntilActive()
+{
+    QMutexLocker locker(&m_Lock);
+
+    if (!m_Active && !isInterruptionRequested()) {
+        while (!m_Active && !isInterruptionRequested()) {
+            m_Cond.wait(&m_Lock);
+        }
+
+        // Time spent paused doesn't count towards the wakeup rate
+        m_WakeupCount = 0;
+        m_StatsStartUs = currentTimeUs();
+    }
+
+    return !isInterruptionRequested();
+}
+
+void SdlGamepadInputThread::waitForInput(int timeoutMs)
+{
+#ifdef Q_OS_LINUX
+    QVarLengthArray<pollfd, 8> fds;
+    if (m_WakePipe[0] >= 0) {
+        fds.append({ m_WakePipe[0], POLLIN, 0 });
+    }
+    if (m_EventDriven) {
+        fds.append({ m_HotplugFd, POLLIN, 0 });
+        for (int fd : std::as_const(m_ReadinessFds)) {
+            fds.append({ fd, POLLIN, 0 });
+        }
+    }
+
+    if (poll(fds.data(), fds.size(), timeoutMs) <= 0) {
+        return;
+    }
+
+    bool lostSource = false;
+    for (const pollfd& pfd : fds) {
+        if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) {
+            lostSource = true;
+        }
+        else if (pfd.revents & POLLIN) {
+            // We only use these to know when to look at SDL, so the
+            // contents don't matter. Our reads don't take input from SDL.
+            char buffer[4096];
+            while (read(pfd.fd, buffer, sizeof(buffer)) > 0);
+        }
+    }
+
+    if (lostSource) {
+        // Fall back to polling until SDL reports the device is gone
+        // and we rebuild the list
+        closeReadinessSources();
+    }
+#else
+    QMutexLocker locker(&m_Lock);
+    if (m_Active && !isInterruptionRequested()) {
+        m_Cond.wait(&m_Lock, timeoutMs);
+    }
+#endif
+}
+
+bool SdlGamepadInputThread::pollControllers(quint64 detectedUs)
+{
+    SDL_Event event;
+    bool activity = false;
+    bool devicesChanged = false;
+
+    // Update joystick state without pumping other events (see run() comment)
+    SDL_JoystickUpdate();
+
+    bool needsFlush;
+    {
+        QMutexLocker locker(&m_Lock);
+        needsFlush = m_NeedsFlush;
+        m_NeedsFlush = false;
+    }
+
+    // Discard any pending button events on the first poll to avoid picking up
+    // stale input data from the stream session (like the quit combo).
+    if (needsFlush) {
+        SDL_FlushEvent(SDL_CONTROLLERBUTTONDOWN);
+        SDL_FlushEvent(SDL_CONTROLLERBUTTONUP);
+    }
+
+    // Peep events rather than polling to avoid calling SDL_PumpEvents()
+    while (SDL_PeepEvents(&event, 1, SDL_GETEVENT, SDL_FIRSTEVENT, SDL_LASTEVENT) == 1) {
+        switch (event.type) {
+        case SDL_QUIT:
+            // SDL may send us a quit event since we initialize
+            // the video subsystem on startup. If we get one,
+            // forward it on for Qt to take care of.
+            QMetaObject::invokeMethod(QCoreApplication::instance(), []() {
+                QCoreApplication::quit();
+            }, Qt::QueuedConnection);
+            break;
+        case SDL_CONTROLLERBUTTONDOWN:
+        case SDL_CONTROLLERBUTTONUP:
+            emit buttonEvent(event.cbutton.button, event.type == SDL_CONTROLLERBUTTONDOWN, detectedUs);
+            activity = true;
+            break;
+        case SDL_CONTROLLERDEVICEADDED:
+            handleControllerAdded(event.cdevice.which);
+            devicesChanged = activity = true;
+            break;
+        case SDL_CONTROLLERDEVICEREMOVED:
+            handleControllerRemoved(event.cdevice.which);
+            devicesChanged = activity = true;
+            break;
+        }
+    }
+
+    if (devicesChanged) {
+        rebuildReadinessSources();
+    }
+
+    // Handle analog sticks by polling
+    for (auto gc : std::as_const(m_Gamepads)) {
+        short leftX = SDL_GameControllerGetAxis(gc, SDL_CONTROLLER_AXIS_LEFTX);
+        short leftY = SDL_GameControllerGetAxis(gc, SDL_CONTROLLER_AXIS_LEFTY);
+        if (qAbs((int)leftX) > AXIS_ACTIVITY_THRESHOLD || qAbs((int)leftY) > AXIS_ACTIVITY_THRESHOLD) {
+            activity = true;
+        }
+
+        int button = SDL_CONTROLLER_BUTTON_INVALID;
+        if (SDL_GetTicks() - m_LastAxisNavigationEventTime < AXIS_NAVIGATION_REPEAT_DELAY) {
+            // Do nothing
+        }
+        else if (leftY < -AXIS_NAVIGATION_THRESHOLD) {
+            button = SDL_CONTROLLER_BUTTON_DPAD_UP;
+        }
+        else if (leftY > AXIS_NAVIGATION_THRESHOLD) {
+            button = SDL_CONTROLLER_BUTTON_DPAD_DOWN;
+        }
+        else if (leftX < -AXIS_NAVIGATION_THRESHOLD) {
+            button = SDL_CONTROLLER_BUTTON_DPAD_LEFT;
+        }
+        else if (leftX > AXIS_NAVIGATION_THRESHOLD) {
+            button = SDL_CONTROLLER_BUTTON_DPAD_RIGHT;
+        }
+
+        if (button != SDL_CONTROLLER_BUTTON_INVALID) {
+            emit buttonEvent(button, true, detectedUs);
+            emit buttonEvent(button, false, detectedUs);
+            m_LastAxisNavigationEventTime = SDL_GetTicks();
+        }
+    }
+
+    if (activity) {
+        m_LastActivityTime = SDL_GetTicks();
+    }
+
+    return activity;
+}
+
+void SdlGamepadInputThread::handleControllerAdded(int deviceIndex)
+{
+    if (!SDL_IsGameController(deviceIndex)) {
+        return;
+    }
+
+    SDL_GameController* gc = SDL_GameControllerOpen(deviceIndex);
+    if (gc != nullptr) {
+        // SDL_CONTROLLERDEVICEADDED can be reported multiple times for the same
+        // gamepad in rare cases, because SDL doesn't fixup the device index in
+        // the SDL_CONTROLLERDEVICEADDED event if an unopened gamepad disappears
+        // before we've processed the add event.
+        if (!m_Gamepads.contains(gc)) {
+            m_Gamepads.append(gc);
+        }
+        else {
+            // We already have this game controller open
+            SDL_GameControllerClose(gc);
+        }
+    }
+}
+
+void SdlGamepadInputThread::handleControllerRemoved(SDL_JoystickID instanceId)
+{
+    for (int i = 0; i < m_Gamepads.size(); i++) {
+        if (SDL_JoystickInstanceID(SDL_GameControllerGetJoystick(m_Gamepads[i])) == instanceId) {
+            SDL_GameControllerClose(m_Gamepads.takeAt(i));
+            break;
+        }
+    }
+}
+
+void SdlGamepadInputThread::rebuildReadinessSources()
+{
+    closeReadinessSources();
+
+#if defined(Q_OS_LINUX) && SDL_VERSION_ATLEAST(2, 24, 0)
+    if (m_HotplugFd < 0) {
+        return;
+    }
+
+    // We can only sleep until input arrives if we can wait on every
+    // controller. We stick to evdev nodes, since they only report changes.
+    // HIDAPI drivers read hidraw nodes, and many controllers stream reports
+    // over those continuously, which would wake us as often as polling.
+    for (auto gc : std::as_const(m_Gamepads)) {
+        const char* path = SDL_JoystickPath(SDL_GameControllerGetJoystick(gc));
+        int fd = -1;
+        if (path != nullptr && strncmp(path, "/dev/input/", strlen("/dev/input/")) == 0) {
+            fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+        }
+
+        if (fd < 0) {
+            closeReadinessSources();
+            return;
+        }
+
+        m_ReadinessFds.append(fd);
+    }
+
+    m_EventDriven = true;
+#endif
+}
+
+void SdlGamepadInputThread::closeReadinessSources()
+{
+#ifdef Q_OS_LINUX
+    for (int fd : std::as_const(m_ReadinessFds)) {
+        close(fd);
+    }
+#endif
+
+    m_ReadinessFds.clear();
+    m_EventDriven = false;
+}
+
+int SdlGamepadInputThread::nextTimeoutMs(bool activity) const
+{
+    Uint32 idleMs = activity ? 0 : SDL_GetTicks() - m_LastActivityTime;
+
+    // Keep polling quickly while in use, even if we can wait on the
+    // devices, so a held stick repeats on time
+    if (idleMs < ACTIVE_PERIOD_MS) {
+        return ACTIVE_POLL_INTERVAL_MS;
+    }
+    else if (m_EventDriven) {
+        return EVENT_DRIVEN_IDLE_TIMEOUT_MS;
+    }
+    else if (m_Gamepads.isEmpty()) {
+        return NO_GAMEPAD_POLL_INTERVAL_MS;
+    }
+
+    // Double the interval for each second without input
+    Uint32 idleSteps = qMin<Uint32>(idleMs / ACTIVE_PERIOD_MS, 8);
+    return qMin(ACTIVE_POLL_INTERVAL_MS << idleSteps, IDLE_POLL_INTERVAL_MS);
+}
+
+void SdlGamepadInputThread::logStats()
+{
+    quint64 now = currentTimeUs();
+    if (now - m_StatsStartUs < STATS_INTERVAL_US) {
+        return;
+    }
+
+    SDL_LogDebug(SDL_LOG_CATEGORY_INPUT,
+                 "Gamepad UI navigation: %.1f wakeups/s with %d gamepad(s) (%s)",
+                 m_WakeupCount * 1000000.0 / (now - m_StatsStartUs),
+                 (int)m_Gamepads.size(),
+                 m_EventDriven ? "waiting on devices" : "polling");
+
+    m_WakeupCount = 0;
+    m_StatsStartUs = now;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <QList>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+#include "SDL_compat.h"
+
+// Owns the SDL game controller subsystem while the UI is shown and reports
+// button changes to the GUI thread.
+//
+// Everything that touches the subsystem runs on this thread, since some
+// joystick backends only deliver input to the thread that initialized them.
+// Where the platform lets us see the controllers' device nodes (Linux),
+// the thread sleeps until one of them has input. Otherwise it polls, quickly
+// while the controller is in use and backing off once it goes idle.
+class SdlGamepadInputThread : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit SdlGamepadInputThread(QObject* parent = nullptr);
+
+    ~SdlGamepadInputThread();
+
+    // Starts the thread and waits until the controllers are open.
+    // Returns false if the subsystem couldn't be initialized.
+    bool startInput();
+
+    // Pauses input handling while the window doesn't have focus.
+    // Button events from while we were paused are dropped.
+    void setActive(bool active);
+
+    // Stops the thread and waits for it to release the subsystem
+    void stop();
+
+    // Microseconds on the clock used for buttonEvent() timestamps
+    static quint64 currentTimeUs();
+
+signals:
+    // A button was pressed or released. The left stick is reported as
+    // D-pad presses. detectedUs is when this thread noticed the input.
+    void buttonEvent(int button, bool pressed, quint64 detectedUs);
+
+protected:
+    void run() override;
+
+private:
+    enum class StartupState {
+        Pending,
+        Running,
+        Failed
+    };
+
+    bool waitUntilActive();
+    void waitForInput(int timeoutMs);
+    void wake();
+    bool pollControllers(quint64 detectedUs);
+    void handleControllerAdded(int deviceIndex);
+    void handleControllerRemoved(SDL_JoystickID instanceId);
+    void rebuildReadinessSources();
+    void closeReadinessSources();
+    int nextTimeoutMs(bool activity) const;
+    void logStats();
+
+    QMutex m_Lock;
+    QWaitCondition m_Cond;
+    bool m_Active;
+    bool m_NeedsFlush;
+    StartupState m_Startup;
+
+    // Only touched by the input thread
+    QList<SDL_GameController*> m_Gamepads;
+    Uint32 m_LastAxisNavigationEventTime;
+    Uint32 m_LastActivityTime;
+    bool m_EventDriven;
+    int m_WakeupCount;
+    quint64 m_StatsStartUs;
+
+    // Device nodes we wait on, plus a hotplug watch and a self-pipe for
+    // wake(). Only used on Linux.
+    QList<int> m_ReadinessFds;
+    int m_HotplugFd;
+    int m_WakePipe[2];
+};
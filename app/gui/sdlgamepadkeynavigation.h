@@ -1,9 +1,8 @@
 #pragma once
 
-#include <QTimer>
 #include <QEvent>
 
-#include "SDL_compat.h"
+#include "sdlgamepadinputthread.h"
 
 #include "settings/streamingpreferences.h"
 
@@ -39,19 +38,20 @@ private:
 
     void sendKey(QEvent::Type type, Qt::Key key, Qt::KeyboardModifiers modifiers = Qt::NoModifier);
 
-    void updateTimerState();
-
 private slots:
-    void onPollingTimerFired();
+    void onButtonEvent(int button, bool pressed, quint64 detectedUs);
+
+    void onFocusObjectChanged();
 
 private:
     StreamingPreferences* m_Prefs;
-    QTimer* m_PollingTimer;
-    QList<SDL_GameController*> m_Gamepads;
+    SdlGamepadInputThread* m_InputThread;
     bool m_Enabled;
     bool m_UiNavMode;
     int m_UiNavSuspendCount;
-    bool m_FirstPoll;
     bool m_HasFocus;
-    Uint32 m_LastAxisNavigationEventTime;
+
+    // When the button press we're delivering was detected, so we can log
+    // how long it takes to move focus. Zero if none is in flight.
+    quint64 m_PendingFocusChangeUs;
 };
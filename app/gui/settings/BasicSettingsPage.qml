@@ -699,6 +699,13 @@ Column {
             checked: StreamingPreferences.enableSunshineAbr
             onToggled: function(value) { StreamingPreferences.enableSunshineAbr = value }
         }
+
+        ToggleRow {
+            title: qsTr("Lower bitrate when this device can't keep up")
+            description: qsTr("Lowers the stream bitrate while decoding or rendering falls behind, then raises it back up to the selected video bitrate once playback is smooth again.")
+            checked: StreamingPreferences.enableClientAbr
+            onToggled: function(value) { StreamingPreferences.enableClientAbr = value }
+        }
     }
 
     // ================= 画质增强 =================
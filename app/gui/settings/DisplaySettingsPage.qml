@@ -123,6 +123,14 @@ Column {
             checked: StreamingPreferences.enableVsync && StreamingPreferences.framePacing
             onToggled: function(value) { StreamingPreferences.framePacing = value }
         }
+
+        ToggleRow {
+            title: qsTr("Variable refresh rate pacing")
+            description: qsTr("For G-SYNC/FreeSync displays. Shows each frame as soon as it is decoded and caps the frame rate just below the display's maximum refresh rate")
+            controlEnabled: StreamingPreferences.enableVsync
+            checked: StreamingPreferences.enableVsync && StreamingPreferences.vrrPacing
+            onToggled: function(value) { StreamingPreferences.vrrPacing = value }
+        }
     }
 
     // ================= HDR =================
@@ -62,6 +62,20 @@ Column {
             checked: StreamingPreferences.enableMicrophone
             onToggled: function(value) { StreamingPreferences.enableMicrophone = value }
         }
+
+        ChoiceRow {
+            applicable: StreamingPreferences.enableMicrophone
+            title: qsTr("Microphone frame size")
+            description: qsTr("Shorter frames reduce voice latency at the cost of slightly higher bandwidth")
+            selectedValue: StreamingPreferences.micFrameDurationMs
+            onValueActivated: function(value) { StreamingPreferences.micFrameDurationMs = value }
+
+            model: ListModel {
+                ListElement { text: qsTr("20 ms"); val: 20 }
+                ListElement { text: qsTr("10 ms"); val: 10 }
+                ListElement { text: qsTr("5 ms"); val: 5 }
+            }
+        }
     }
 
     // ================= 主机 =================
@@ -402,6 +416,14 @@ Column {
             }
         }
 
+        ToggleRow {
+            title: qsTr("Frame-threaded software decoding")
+            description: qsTr("Lets software decoding keep up at high resolutions and frame rates by decoding several frames at once. Adds up to 17 ms of latency.")
+            controlEnabled: StreamingPreferences.videoDecoderSelection !== StreamingPreferences.VDS_FORCE_HARDWARE
+            checked: StreamingPreferences.softwareFrameThreading
+            onToggled: function(value) { StreamingPreferences.softwareFrameThreading = value }
+        }
+
         ChoiceRow {
             title: qsTr("Video codec")
             selectedValue: StreamingPreferences.videoCodecConfig
@@ -1,14 +1,19 @@
 #include "imageutils.h"
 
 #include <QBuffer>
+#include <QCryptographicHash>
 #include <QDateTime>
 #include <QDebug>
 #include <QDir>
 #include <QFile>
 #include <QFileInfo>
+#include <QGuiApplication>
 #include <QImage>
+#include <QImageReader>
 #include <QNetworkReply>
 #include <QNetworkRequest>
+#include <QSaveFile>
+#include <QScreen>
 #include <QStandardPaths>
 #include <QThread>
 #include <QTimer>
@@ -119,9 +124,11 @@ void ImageUtils::startBackgroundRequest()
             return;
         }
 
+        // Screens can only be queried from the GUI thread
+        const QSize targetSize = backgroundTargetSize();
         const auto result = std::make_shared<QString>();
-        QThread *worker = QThread::create([result, imageData]() {
-            *result = ImageUtils::decodeAndSaveBackground(imageData);
+        QThread *worker = QThread::create([result, imageData, targetSize]() {
+            *result = ImageUtils::decodeAndSaveBackground(imageData, targetSize);
         });
         connect(worker, &QThread::finished, this, [this, result]() {
             if (result->isEmpty()) {
@@ -152,49 +159,150 @@ void ImageUtils::retryOrFailBackground(const QString &errorMessage)
     emit backgroundError(errorMessage);
 }
 
-QString ImageUtils::decodeAndSaveBackground(const QByteArray &imageData)
+QSize ImageUtils::backgroundTargetSize()
 {
-    QByteArray decodableData = imageData;
-    QImage image;
-    if (!image.loadFromData(decodableData)) {
-        decodableData = convertToJpeg(decodableData);
-        if (decodableData.isEmpty() || !image.loadFromData(decodableData)) {
-            return QString();
+    // The background fills the window, so it never needs more pixels than
+    // the largest attached display has
+    QSize largest;
+    const QList<QScreen *> screens = QGuiApplication::screens();
+    for (const QScreen *screen : screens) {
+        const QSize size = screen->geometry().size() * screen->devicePixelRatio();
+        if (static_cast<qint64>(size.width()) * size.height() >
+                static_cast<qint64>(largest.width()) * largest.height()) {
+            largest = size;
         }
     }
+    return largest;
+}
+
+QString ImageUtils::backgroundCacheDir()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/backgrounds";
+}
 
-    const QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) +
-            "/backgrounds";
+QString ImageUtils::decodeAndSaveBackground(const QByteArray &imageData, const QSize &targetSize)
+{
+    const QString cacheDir = backgroundCacheDir();
     QDir().mkpath(cacheDir);
-    const QString filePath = cacheDir + "/background_" +
-            QString::number(QDateTime::currentMSecsSinceEpoch()) + ".jpg";
-    if (!image.save(filePath, "JPEG", 90)) {
+
+    // Name the result after its content and size, so a wallpaper we've
+    // already prepared for this display is reused without decoding it
+    const QString hash = QString::fromLatin1(
+            QCryptographicHash::hash(imageData, QCryptographicHash::Sha256).toHex().left(16));
+    const QString filePath = cacheDir + "/background_" + hash + "_" +
+            QString::number(targetSize.width()) + "x" + QString::number(targetSize.height()) + ".jpg";
+
+    const QFileInfo cached(filePath);
+    if (cached.exists() && cached.size() > 1024) {
+        // Refresh the timestamp that isValidCache() looks at
+        QFile cachedFile(filePath);
+        if (cachedFile.open(QIODevice::ReadWrite)) {
+            cachedFile.setFileTime(QDateTime::currentDateTime(), QFileDevice::FileModificationTime);
+        }
+        removeOtherBackgrounds(filePath);
+        return filePath;
+    }
+
+    QImage image = decodeScaled(imageData, targetSize);
+    if (image.isNull()) {
+        const QByteArray converted = convertToJpeg(imageData, targetSize);
+        if (converted.isEmpty()) {
+            return QString();
+        }
+        image = decodeScaled(converted, targetSize);
+        if (image.isNull()) {
+            return QString();
+        }
+    }
+
+    // Write to a temporary file first, so QML never sees a partial image
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly) || !image.save(&file, "JPEG", 90) || !file.commit()) {
         return QString();
     }
 
-    QDir bgDir(cacheDir);
+    removeOtherBackgrounds(filePath);
+    return filePath;
+}
+
+QImage ImageUtils::decodeScaled(const QByteArray &imageData, const QSize &targetSize)
+{
+    QBuffer buffer;
+    buffer.setData(imageData);
+    buffer.open(QIODevice::ReadOnly);
+
+    QImageReader reader(&buffer);
+    reader.setAutoTransform(true);
+
+    // Let the decoder scale while it decodes instead of producing the full
+    // image first. JPEG in particular decodes at a fraction of the size
+    // directly. The scaled size applies before the EXIF rotation.
+    QSize sourceSize = reader.size();
+    if (sourceSize.isValid() && targetSize.isValid()) {
+        QSize orientedTarget = targetSize;
+        if (reader.transformation() & QImageIOHandler::TransformationRotate90) {
+            orientedTarget.transpose();
+        }
+
+        const QSize scaledSize = coverSize(sourceSize, orientedTarget);
+        if (scaledSize != sourceSize) {
+            reader.setScaledSize(scaledSize);
+        }
+    }
+
+    return reader.read();
+}
+
+QSize ImageUtils::coverSize(const QSize &sourceSize, const QSize &targetSize)
+{
+    // Smallest size that still covers the target with the aspect ratio
+    // kept, matching Image.PreserveAspectCrop. Never scales up.
+    if (!sourceSize.isValid() || !targetSize.isValid() ||
+            sourceSize.width() <= 0 || sourceSize.height() <= 0) {
+        return sourceSize;
+    }
+
+    const qreal scale = qMax(static_cast<qreal>(targetSize.width()) / sourceSize.width(),
+                             static_cast<qreal>(targetSize.height()) / sourceSize.height());
+    if (scale >= 1.0) {
+        return sourceSize;
+    }
+
+    return QSize(qMax(1, qRound(sourceSize.width() * scale)),
+                 qMax(1, qRound(sourceSize.height() * scale)));
+}
+
+void ImageUtils::removeOtherBackgrounds(const QString &keepPath)
+{
+    QDir bgDir(backgroundCacheDir());
     QStringList filters;
     filters << "background_*.*";
     const QFileInfoList oldFiles = bgDir.entryInfoList(filters, QDir::Files, QDir::Time);
     for (const QFileInfo &oldFile : oldFiles) {
-        if (oldFile.absoluteFilePath() != filePath) {
+        if (oldFile.absoluteFilePath() != keepPath) {
             QFile::remove(oldFile.absoluteFilePath());
         }
     }
-    return filePath;
 }
 
-QByteArray ImageUtils::convertToJpeg(const QByteArray &imageData)
+QString ImageUtils::latestCachedBackground()
 {
-    QImage image;
-    if (image.loadFromData(imageData)) {
-        QByteArray result;
-        QBuffer buffer(&result);
-        buffer.open(QIODevice::WriteOnly);
-        image.save(&buffer, "JPEG", 90);
-        return result;
+    QDir bgDir(backgroundCacheDir());
+    QStringList filters;
+    filters << "background_*.jpg";
+    const QFileInfoList files = bgDir.entryInfoList(filters, QDir::Files, QDir::Time);
+    for (const QFileInfo &file : files) {
+        if (file.size() > 1024) {
+            return file.absoluteFilePath();
+        }
     }
+    return QString();
+}
 
+QByteArray ImageUtils::convertToJpeg(const QByteArray &imageData, const QSize &targetSize)
+{
+    // Only called for formats Qt can't read, so there's no point in
+    // trying QImage first
 #ifdef Q_OS_WIN
     const HRESULT comResult = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
     const bool shouldUninitialize = SUCCEEDED(comResult);
@@ -204,6 +312,8 @@ QByteArray ImageUtils::convertToJpeg(const QByteArray &imageData)
     IWICStream *stream = nullptr;
     IWICBitmapDecoder *decoder = nullptr;
     IWICBitmapFrameDecode *frame = nullptr;
+    IWICBitmapScaler *scaler = nullptr;
+    IWICBitmapSource *source = nullptr;
 
     HRESULT hr = CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER,
                                   IID_PPV_ARGS(&factory));
@@ -221,12 +331,34 @@ QByteArray ImageUtils::convertToJpeg(const QByteArray &imageData)
 
     hr = decoder->GetFrame(0, &frame);
     if (FAILED(hr)) goto cleanup;
+    source = frame;
 
     {
         UINT width = 0;
         UINT height = 0;
         frame->GetSize(&width, &height);
 
+        // Have WIC scale while decoding too, so we never hold the full
+        // size pixels
+        const QSize scaledSize = coverSize(QSize(static_cast<int>(width), static_cast<int>(height)), targetSize);
+        if (width <= static_cast<UINT>((std::numeric_limits<int>::max)()) &&
+                height <= static_cast<UINT>((std::numeric_limits<int>::max)()) &&
+                scaledSize.isValid() &&
+                (static_cast<UINT>(scaledSize.width()) != width ||
+                 static_cast<UINT>(scaledSize.height()) != height)) {
+            hr = factory->CreateBitmapScaler(&scaler);
+            if (FAILED(hr)) goto cleanup;
+
+            hr = scaler->Initialize(frame, static_cast<UINT>(scaledSize.width()),
+                                    static_cast<UINT>(scaledSize.height()),
+                                    WICBitmapInterpolationModeFant);
+            if (FAILED(hr)) goto cleanup;
+
+            source = scaler;
+            width = static_cast<UINT>(scaledSize.width());
+            height = static_cast<UINT>(scaledSize.height());
+        }
+
         const qint64 stride = static_cast<qint64>(width) * 4;
         const qint64 bufferSize = stride * static_cast<qint64>(height);
         static constexpr qint64 kMaximumDecodedBytes = 512LL * 1024 * 1024;
@@ -243,7 +375,7 @@ QByteArray ImageUtils::convertToJpeg(const QByteArray &imageData)
         hr = factory->CreateFormatConverter(&converter);
         if (FAILED(hr)) goto cleanup;
 
-        hr = converter->Initialize(frame, GUID_WICPixelFormat32bppBGRA,
+        hr = converter->Initialize(source, GUID_WICPixelFormat32bppBGRA,
                                    WICBitmapDitherTypeNone, nullptr, 0.0,
                                    WICBitmapPaletteTypeCustom);
         if (FAILED(hr)) {
@@ -267,6 +399,7 @@ QByteArray ImageUtils::convertToJpeg(const QByteArray &imageData)
     }
 
 cleanup:
+    if (scaler) scaler->Release();
     if (frame) frame->Release();
     if (decoder) decoder->Release();
     if (stream) stream->Release();
@@ -4,6 +4,9 @@
 #include <QObject>
 #include <QUrl>
 #include <QNetworkAccessManager>
+#include <QSize>
+
+class QImage;
 
 class ImageUtils : public QObject
 {
@@ -16,12 +19,18 @@ public:
     Q_INVOKABLE bool fileExists(const QString &path);
     Q_INVOKABLE bool isValidCache(const QString &cachePath);
     Q_INVOKABLE bool validateExtension(const QString &filePath);
+    Q_INVOKABLE QString latestCachedBackground();
 
 private:
     void startBackgroundRequest();
     void retryOrFailBackground(const QString &errorMessage);
-    static QString decodeAndSaveBackground(const QByteArray &imageData);
-    static QByteArray convertToJpeg(const QByteArray &imageData);
+    static QSize backgroundTargetSize();
+    static QString backgroundCacheDir();
+    static QString decodeAndSaveBackground(const QByteArray &imageData, const QSize &targetSize);
+    static QImage decodeScaled(const QByteArray &imageData, const QSize &targetSize);
+    static QSize coverSize(const QSize &sourceSize, const QSize &targetSize);
+    static void removeOtherBackgrounds(const QString &keepPath);
+    static QByteArray convertToJpeg(const QByteArray &imageData, const QSize &targetSize);
 
     QNetworkAccessManager m_backgroundNetworkManager;
     QUrl m_backgroundApiUrl;
@@ -11,6 +11,7 @@ QString Path::s_LogDir;
 QString Path::s_DumpDir;
 QString Path::s_BoxArtCacheDir;
 QString Path::s_QmlCacheDir;
+QString Path::s_DataDir;
 QString Path::s_PortableRootDir;
 
 QString Path::getLogDir()
@@ -37,6 +38,12 @@ QString Path::getQmlCacheDir()
     return s_QmlCacheDir;
 }
 
+QString Path::getDataDir()
+{
+    Q_ASSERT(!s_DataDir.isEmpty());
+    return s_DataDir;
+}
+
 QString Path::getPortableRootDir()
 {
     if (!s_PortableRootDir.isEmpty()) {
@@ -139,6 +146,7 @@ void Path::initialize(bool portable, const QString& portableRootDir)
         s_DumpDir = QDir(s_PortableRootDir).filePath("dumps");
         s_BoxArtCacheDir = s_PortableRootDir + "/boxart";
         s_QmlCacheDir = s_PortableRootDir + "/qmlcache";
+        s_DataDir = s_PortableRootDir;
 
         // In order for the If-Modified-Since logic to work in MappingFetcher,
         // the cache directory must be different than the current directory.
@@ -157,5 +165,6 @@ void Path::initialize(bool portable, const QString& portableRootDir)
         s_CacheDir = cacheDir;
         s_BoxArtCacheDir = cacheDir + "/boxart";
         s_QmlCacheDir = cacheDir + "/qmlcache";
+        s_DataDir = appStoragePath;
     }
 }
@@ -10,6 +10,7 @@ public:
     static QString getDumpDir();
     static QString getBoxArtCacheDir();
     static QString getQmlCacheDir();
+    static QString getDataDir();
     static QString getPortableRootDir();
 
     static QByteArray readDataFile(QString fileName);
@@ -28,5 +29,6 @@ private:
     static QString s_DumpDir;
     static QString s_BoxArtCacheDir;
     static QString s_QmlCacheDir;
+    static QString s_DataDir;
     static QString s_PortableRootDir;
 };
@@ -18,6 +18,7 @@
 
 #define SER_AUTOADJUSTBITRATE "autoadjustbitrate"
 #define SER_SUNSHINEABR "sunshineabr"
+#define SER_CLIENTABR "clientabr"
 #define SER_FULLSCREEN "fullscreen"
 #define SER_IGNORE_ASPECT_RATIO "ignoreaspectratio"
 #define SER_VSYNC "vsync"
@@ -38,6 +39,8 @@
 #define SER_DUALSENSEHAPTICSMODE "dualSenseHapticsMode"
 #define SER_STARTWINDOWED "startwindowed"
 #define SER_FRAMEPACING "framepacing"
+#define SER_VRRPACING "vrrpacing"
+#define SER_SWFRAMETHREADING "swframethreading"
 #define SER_VIDEOENHANCEMENT "videoenhancement"
 #define SER_STREAMRESOLUTIONSCALE "streamresolutionscale"
 #define SER_STREAMRESOLUTIONSCALERATIO "streamresolutionscaleratio"
@@ -71,6 +74,7 @@
 #define SER_LEGACY_CUSTOMVDDSCREENMODE "customvddscreenmode"
 #define SER_SHOWLOCALCURSOR "showLocalCursor"
 #define SER_MICROPHONE "microphone"
+#define SER_MICFRAMEDURATION "micframeduration"
 #define SER_OVERLAYMENUPLACEMENT "overlaymenuplacement"
 #define SER_LEGACY_OVERLAYMENUPOS "overlaymenuposition"
 #define SER_HDRMODE "hdrmode"
@@ -211,6 +215,7 @@ void StreamingPreferences::reload()
     bitrateKbps = settings.value(SER_BITRATE, getDefaultBitrate(width, height, fps, enableYUV444)).toInt();
     autoAdjustBitrate = settings.value(SER_AUTOADJUSTBITRATE, true).toBool();
     enableSunshineAbr = settings.value(SER_SUNSHINEABR, false).toBool();
+    enableClientAbr = settings.value(SER_CLIENTABR, false).toBool();
     ignoreAspectRatio = settings.value(SER_IGNORE_ASPECT_RATIO, true).toBool();
     enableVsync = settings.value(SER_VSYNC, true).toBool();
     gameOptimizations = settings.value(SER_GAMEOPTS, true).toBool();
@@ -240,8 +245,14 @@ void StreamingPreferences::reload()
     }
 #endif
     framePacing = settings.value(SER_FRAMEPACING, false).toBool();
+    vrrPacing = settings.value(SER_VRRPACING, false).toBool();
+    softwareFrameThreading = settings.value(SER_SWFRAMETHREADING, false).toBool();
     videoEnhancement = settings.value(SER_VIDEOENHANCEMENT, false).toBool();
     enableMicrophone = settings.value(SER_MICROPHONE, false).toBool();
+    micFrameDurationMs = settings.value(SER_MICFRAMEDURATION, 20).toInt();
+    if (micFrameDurationMs != 5 && micFrameDurationMs != 10 && micFrameDurationMs != 20) {
+        micFrameDurationMs = 20;
+    }
     overlayMenuPosition = loadOverlayMenuPlacement(settings);
     autoUpdateCheck = settings.value(SER_AUTOUPDATECHECK, true).toBool();
 
@@ -506,6 +517,7 @@ void StreamingPreferences::save()
     settings.setValue(SER_BITRATE, bitrateKbps);
     settings.setValue(SER_AUTOADJUSTBITRATE, autoAdjustBitrate);
     settings.setValue(SER_SUNSHINEABR, enableSunshineAbr);
+    settings.setValue(SER_CLIENTABR, enableClientAbr);
     settings.setValue(SER_IGNORE_ASPECT_RATIO, ignoreAspectRatio);
     settings.setValue(SER_VSYNC, enableVsync);
     settings.setValue(SER_GAMEOPTS, gameOptimizations);
@@ -519,6 +531,8 @@ void StreamingPreferences::save()
     settings.setValue(SER_NATIVETOUCHPAD, enableNativeTouchpad);
     settings.setValue(SER_DUALSENSEHAPTICSMODE, dualSenseHapticsMode);
     settings.setValue(SER_FRAMEPACING, framePacing);
+    settings.setValue(SER_VRRPACING, vrrPacing);
+    settings.setValue(SER_SWFRAMETHREADING, softwareFrameThreading);
     settings.setValue(SER_VIDEOENHANCEMENT, videoEnhancement);
     settings.setValue(SER_STREAMRESOLUTIONSCALE, streamResolutionScale);
     settings.setValue(SER_STREAMRESOLUTIONSCALERATIO, streamResolutionScaleRatio);
@@ -563,6 +577,7 @@ void StreamingPreferences::save()
     settings.remove(SER_LEGACY_CUSTOMSCREENMODE);
     settings.remove(SER_LEGACY_CUSTOMVDDSCREENMODE);
     settings.setValue(SER_MICROPHONE, enableMicrophone);
+    settings.setValue(SER_MICFRAMEDURATION, micFrameDurationMs);
     settings.setValue(SER_OVERLAYMENUPLACEMENT, static_cast<int>(overlayMenuPosition));
     settings.setValue(SER_AUTOUPDATECHECK, autoUpdateCheck);
 }
@@ -183,6 +183,7 @@ public:
     Q_PROPERTY(int bitrateKbps MEMBER bitrateKbps NOTIFY bitrateChanged)
     Q_PROPERTY(bool autoAdjustBitrate MEMBER autoAdjustBitrate NOTIFY autoAdjustBitrateChanged)
     Q_PROPERTY(bool enableSunshineAbr MEMBER enableSunshineAbr NOTIFY enableSunshineAbrChanged)
+    Q_PROPERTY(bool enableClientAbr MEMBER enableClientAbr NOTIFY enableClientAbrChanged)
     Q_PROPERTY(bool ignoreAspectRatio MEMBER ignoreAspectRatio NOTIFY ignoreAspectRatioChanged)
     Q_PROPERTY(bool enableVsync MEMBER enableVsync NOTIFY enableVsyncChanged)
     Q_PROPERTY(bool gameOptimizations MEMBER gameOptimizations NOTIFY gameOptimizationsChanged)
@@ -196,6 +197,8 @@ public:
     Q_PROPERTY(bool enableNativeTouchpad MEMBER enableNativeTouchpad NOTIFY enableNativeTouchpadChanged)
     Q_PROPERTY(DualSenseHapticsMode dualSenseHapticsMode MEMBER dualSenseHapticsMode NOTIFY dualSenseHapticsModeChanged)
     Q_PROPERTY(bool framePacing MEMBER framePacing NOTIFY framePacingChanged)
+    Q_PROPERTY(bool vrrPacing MEMBER vrrPacing NOTIFY vrrPacingChanged)
+    Q_PROPERTY(bool softwareFrameThreading MEMBER softwareFrameThreading NOTIFY softwareFrameThreadingChanged)
     Q_PROPERTY(bool videoEnhancement MEMBER videoEnhancement NOTIFY videoEnhancementChanged)
     Q_PROPERTY(bool streamResolutionScale MEMBER streamResolutionScale NOTIFY streamResolutionScaleChanged)
     Q_PROPERTY(int streamResolutionScaleRatio MEMBER streamResolutionScaleRatio NOTIFY streamResolutionScaleRatioChanged)
@@ -237,6 +240,7 @@ public:
     Q_PROPERTY(Language language MEMBER language NOTIFY languageChanged)
     Q_PROPERTY(ScreenCombinationMode screenCombinationMode MEMBER screenCombinationMode NOTIFY screenCombinationModeChanged)
     Q_PROPERTY(bool enableMicrophone MEMBER enableMicrophone NOTIFY enableMicrophoneChanged)
+    Q_PROPERTY(int micFrameDurationMs MEMBER micFrameDurationMs NOTIFY micFrameDurationMsChanged)
     Q_PROPERTY(OverlayMenuPosition overlayMenuPosition MEMBER overlayMenuPosition NOTIFY overlayMenuPositionChanged)
     Q_PROPERTY(bool autoUpdateCheck MEMBER autoUpdateCheck NOTIFY autoUpdateCheckChanged)
 
@@ -249,6 +253,7 @@ public:
     int bitrateKbps;
     bool autoAdjustBitrate;
     bool enableSunshineAbr;
+    bool enableClientAbr;
     bool ignoreAspectRatio;
     bool enableVsync;
     bool gameOptimizations;
@@ -262,6 +267,8 @@ public:
     bool enableNativeTouchpad;
     DualSenseHapticsMode dualSenseHapticsMode;
     bool framePacing;
+    bool vrrPacing;
+    bool softwareFrameThreading;
     bool videoEnhancement;
     bool streamResolutionScale;
     int streamResolutionScaleRatio;
@@ -303,6 +310,7 @@ public:
     CaptureSysKeysMode captureSysKeysMode;
     ScreenCombinationMode screenCombinationMode;
     bool enableMicrophone;
+    int micFrameDurationMs;
     OverlayMenuPosition overlayMenuPosition;
     bool autoUpdateCheck;
     RendererSelection rendererSelection;
@@ -312,6 +320,7 @@ signals:
     void bitrateChanged();
     void autoAdjustBitrateChanged();
     void enableSunshineAbrChanged();
+    void enableClientAbrChanged();
     void ignoreAspectRatioChanged();
     void enableVsyncChanged();
     void gameOptimizationsChanged();
@@ -337,6 +346,8 @@ signals:
     void rememberWindowPositionChanged();
     void windowModeChanged();
     void framePacingChanged();
+    void vrrPacingChanged();
+    void softwareFrameThreadingChanged();
     void videoEnhancementChanged();
     void streamResolutionScaleChanged();
     void streamResolutionScaleRatioChanged();
@@ -363,6 +374,7 @@ signals:
     void languageChanged();
     void screenCombinationModeChanged();
     void enableMicrophoneChanged();
+    void micFrameDurationMsChanged();
     void overlayMenuPositionChanged();
     void autoUpdateCheckChanged();
     void rendererSelectionChanged();
@@ -1,4 +1,9 @@
+#ifdef PLANE_TEXTURE_2D
+#define PLANE_SAMPLER sampler2D
+#else
 #extension GL_OES_EGL_image_external : require
+#define PLANE_SAMPLER samplerExternalOES
+#endif
 precision mediump float;
 
 varying vec2 vTexCoord;
@@ -6,8 +11,8 @@ varying vec2 vTexCoord;
 uniform mat3 yuvmat;
 uniform vec3 offset;
 uniform vec2 chromaOffset;
-uniform samplerExternalOES plane1;
-uniform samplerExternalOES plane2;
+uniform PLANE_SAMPLER plane1;
+uniform PLANE_SAMPLER plane2;
 
 void main() {
     vec3 YCbCr = vec3(
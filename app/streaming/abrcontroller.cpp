@@ -0,0 +1,204 @@
+#include "abrcontroller.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+AbrController::AbrController(const Config& config, int initialBitrateKbps)
+    : m_Config(config),
+      m_BitrateKbps(initialBitrateKbps),
+      m_StressedWindows(0),
+      m_HealthyWindows(0),
+      m_Changed(false),
+      m_LastChangeMs(0),
+      m_OverloadCeilingKbps(0),
+      m_OverloadCeilingMs(0)
+{
+    m_Config.minBitrateKbps = std::min(m_Config.minBitrateKbps, m_Config.maxBitrateKbps);
+}
+
+AbrController::Health AbrController::classify(const Sample& sample, char* detail, int detailLength) const
+{
+    detail[0] = 0;
+
+    // Nothing was decoded, like when the host only sends frames on change
+    if (sample.frameRate <= 0 || sample.decodedFrames == 0) {
+        return Health::Idle;
+    }
+
+    double budgetUs = 1000000.0 / sample.frameRate;
+    double decodeUs = (double)sample.totalDecodeTimeUs / sample.decodedFrames;
+    double queueUs = sample.receivedFrames != 0 ?
+                         (double)sample.totalDecodeQueueTimeUs / sample.receivedFrames : 0.0;
+    double pacerDropRatio = (double)sample.pacerDroppedFrames / sample.decodedFrames;
+    double backlogUs = sample.renderedFrames != 0 ?
+                           (double)sample.totalPacerTimeUs / sample.renderedFrames : 0.0;
+    double lossRatio = sample.totalFrames != 0 ?
+                           (double)sample.networkDroppedFrames / sample.totalFrames : 0.0;
+
+    double jitterUs = 0.0;
+    if (sample.presentIntervals > 1) {
+        double meanUs = (double)sample.totalPresentIntervalUs / sample.presentIntervals;
+        double varianceUs = (double)sample.totalPresentIntervalSqUs / sample.presentIntervals - meanUs * meanUs;
+        jitterUs = std::sqrt(std::max(varianceUs, 0.0));
+    }
+
+    // Overload comes first, since dropping frames locally can show up as
+    // network loss too, but not the other way around
+    if (queueUs > m_Config.overloadDecodeQueueFrames * budgetUs) {
+        snprintf(detail, detailLength, "frames waited %.1f ms for the decoder (%.1f ms budget)",
+                 queueUs / 1000.0, budgetUs / 1000.0);
+        return Health::Overloaded;
+    }
+    if (pacerDropRatio > m_Config.overloadPacerDropRatio) {
+        snprintf(detail, detailLength, "pacer dropped %u of %u frames",
+                 sample.pacerDroppedFrames, sample.decodedFrames);
+        return Health::Overloaded;
+    }
+    if (backlogUs > m_Config.overloadBacklogFrames * budgetUs) {
+        snprintf(detail, detailLength, "frames waited %.1f ms to render",
+                 backlogUs / 1000.0);
+        return Health::Overloaded;
+    }
+    if (lossRatio > m_Config.congestionLossRatio) {
+        snprintf(detail, detailLength, "network lost %u of %u frames",
+                 sample.networkDroppedFrames, sample.totalFrames);
+        return Health::Congested;
+    }
+
+    if (queueUs < m_Config.healthyDecodeQueueFrames * budgetUs &&
+            sample.pacerDroppedFrames == 0 &&
+            backlogUs < m_Config.healthyBacklogFrames * budgetUs &&
+            sample.networkDroppedFrames == 0 &&
+            jitterUs < m_Config.healthyJitter * budgetUs) {
+        snprintf(detail, detailLength, "decode latency %.1f ms with %.1f ms budget, jitter %.1f ms",
+                 decodeUs / 1000.0, budgetUs / 1000.0, jitterUs / 1000.0);
+        return Health::Healthy;
+    }
+
+    return Health::Neutral;
+}
+
+AbrController::Decision AbrController::update(const Sample& sample)
+{
+    Decision decision;
+    char detail[128];
+
+    decision.health = classify(sample, detail, sizeof(detail));
+    decision.bitrateKbps = m_BitrateKbps;
+
+    if (m_OverloadCeilingKbps != 0 &&
+            sample.timestampMs - m_OverloadCeilingMs >= m_Config.overloadCeilingMs) {
+        m_OverloadCeilingKbps = 0;
+    }
+
+    // Anything in between resets both streaks, which is the hysteresis that
+    // keeps a marginal client from flapping
+    switch (decision.health) {
+    case Health::Overloaded:
+    case Health::Congested:
+        m_StressedWindows++;
+        m_HealthyWindows = 0;
+        break;
+    case Health::Healthy:
+        m_HealthyWindows++;
+        m_StressedWindows = 0;
+        break;
+    case Health::Neutral:
+        m_StressedWindows = 0;
+        m_HealthyWindows = 0;
+        break;
+    case Health::Idle:
+        break;
+    }
+
+    if (m_Changed && sample.timestampMs - m_LastChangeMs < m_Config.minDwellMs) {
+        return decision;
+    }
+
+    if (m_StressedWindows >= m_Config.decreaseAfterWindows &&
+            (decision.health == Health::Overloaded || decision.health == Health::Congested) &&
+            m_BitrateKbps > m_Config.minBitrateKbps) {
+        bool overloaded = decision.health == Health::Overloaded;
+        double factor = overloaded ? m_Config.overloadDecreaseFactor : m_Config.congestionDecreaseFactor;
+
+        if (overloaded) {
+            m_OverloadCeilingKbps = m_BitrateKbps;
+            m_OverloadCeilingMs = sample.timestampMs;
+        }
+
+        decision.action = Action::Decrease;
+        decision.bitrateKbps = std::max(m_Config.minBitrateKbps, (int)(m_BitrateKbps * factor));
+        snprintf(decision.reason, sizeof(decision.reason), "%s for %d windows: %s",
+                 healthName(decision.health), m_StressedWindows, detail);
+    }
+    else if (m_HealthyWindows >= m_Config.increaseAfterWindows &&
+             decision.health == Health::Healthy) {
+        int limitKbps = m_Config.maxBitrateKbps;
+        if (m_OverloadCeilingKbps != 0) {
+            limitKbps = std::min(limitKbps, (int)(m_OverloadCeilingKbps * m_Config.overloadCeilingMargin));
+        }
+
+        int stepKbps = std::max(1, (int)(m_Config.maxBitrateKbps * m_Config.increaseStep));
+        int bitrateKbps = std::min(limitKbps, m_BitrateKbps + stepKbps);
+        if (bitrateKbps <= m_BitrateKbps) {
+            return decision;
+        }
+
+        decision.action = Action::Increase;
+        decision.bitrateKbps = bitrateKbps;
+        snprintf(decision.reason, sizeof(decision.reason), "%s for %d windows: %s",
+                 healthName(decision.health), m_HealthyWindows, detail);
+    }
+    else {
+        return decision;
+    }
+
+    m_BitrateKbps = decision.bitrateKbps;
+    m_StressedWindows = 0;
+    m_HealthyWindows = 0;
+    m_Changed = true;
+    m_LastChangeMs = sample.timestampMs;
+    return decision;
+}
+
+void AbrController::syncBitrateKbps(int bitrateKbps)
+{
+    if (bitrateKbps <= 0 || bitrateKbps == m_BitrateKbps) {
+        return;
+    }
+
+    m_BitrateKbps = bitrateKbps;
+    m_StressedWindows = 0;
+    m_HealthyWindows = 0;
+}
+
+void AbrController::setMaxBitrateKbps(int maxBitrateKbps)
+{
+    m_Config.maxBitrateKbps = maxBitrateKbps;
+    m_Config.minBitrateKbps = std::min(m_Config.minBitrateKbps, maxBitrateKbps);
+    m_OverloadCeilingKbps = 0;
+}
+
+int AbrController::bitrateKbps() const
+{
+    return m_BitrateKbps;
+}
+
+const char* AbrController::healthName(Health health)
+{
+    switch (health) {
+    case Health::Idle:
+        return "idle";
+    case Health::Neutral:
+        return "neutral";
+    case Health::Healthy:
+        return "healthy";
+    case Health::Congested:
+        return "congested";
+    case Health::Overloaded:
+        return "overloaded";
+    }
+
+    return "unknown";
+}
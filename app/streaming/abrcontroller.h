@@ -0,0 +1,155 @@
+#pragma once
+
+#include <cstdint>
+
+// Client-side adaptive bitrate control.
+//
+// The host's ABR only sees the network, but a weak client can stutter from
+// its own decoder or renderer falling behind at a bitrate the network carries
+// fine. This controller looks at one stats window (roughly a second) at a
+// time and classifies it as overloaded, congested, healthy or neither:
+//
+//   overloaded: frames queue up waiting for the decoder, the pacer is
+//               dropping frames, or frames wait more than a couple of frame
+//               times to be rendered
+//   congested:  frames are being lost on the network
+//   healthy:    comfortably within budget on every count, with steady
+//               presentation
+//
+// Decoder overload is judged on throughput, not on how long a frame takes
+// to come out. Frame threading and hardware decoders keep several frames in
+// flight, so their per-frame latency can exceed the frame budget while they
+// keep up just fine. What gives a decoder that can't keep up away is frames
+// waiting for it to take them.
+//
+// Bitrate decreases multiplicatively after a few consecutive stressed windows
+// and increases additively after many consecutive healthy ones, with a
+// minimum dwell time between any two changes. After backing off from an
+// overload, increases stop short of the bitrate that overloaded until that
+// ceiling expires, so the controller doesn't oscillate around it.
+//
+// There is no clock or I/O in here. Callers feed it windows stamped with their
+// own time and act on the decisions, which keeps it testable with synthetic
+// traces. Not thread-safe.
+class AbrController
+{
+public:
+    struct Config
+    {
+        int minBitrateKbps = 1000;
+        int maxBitrateKbps = 20000;
+
+        // Consecutive windows needed before acting
+        int decreaseAfterWindows = 2;
+        int increaseAfterWindows = 10;
+
+        // Minimum time between two changes
+        uint32_t minDwellMs = 5000;
+
+        // How long a bitrate that overloaded the client caps increases, and
+        // how far below it they stop
+        uint32_t overloadCeilingMs = 60000;
+        double overloadCeilingMargin = 0.9;
+
+        double overloadDecreaseFactor = 0.75;
+        double congestionDecreaseFactor = 0.85;
+
+        // Fraction of maxBitrateKbps added per increase
+        double increaseStep = 0.1;
+
+        // Average time frames wait for the decoder to take them, in frame
+        // budgets
+        double overloadDecodeQueueFrames = 1.0;
+        double healthyDecodeQueueFrames = 0.25;
+
+        // Fraction of decoded frames the pacer dropped
+        double overloadPacerDropRatio = 0.05;
+
+        // Average time from decode to render, in frame budgets
+        double overloadBacklogFrames = 2.0;
+        double healthyBacklogFrames = 1.0;
+
+        // Fraction of frames lost on the network
+        double congestionLossRatio = 0.02;
+
+        // Standard deviation of present intervals, as a fraction of the
+        // frame budget
+        double healthyJitter = 0.25;
+    };
+
+    // The counters of one stats window, as accumulated in VIDEO_STATS
+    struct Sample
+    {
+        uint32_t timestampMs = 0;
+        int frameRate = 0;
+
+        uint32_t totalFrames = 0;
+        uint32_t networkDroppedFrames = 0;
+        uint32_t receivedFrames = 0;
+        uint64_t totalDecodeQueueTimeUs = 0;
+        uint32_t decodedFrames = 0;
+
+        // Only reported in reasons. Pipelined decoders make it a measure of
+        // latency rather than load.
+        uint64_t totalDecodeTimeUs = 0;
+        uint32_t renderedFrames = 0;
+        uint32_t pacerDroppedFrames = 0;
+        uint64_t totalPacerTimeUs = 0;
+        uint32_t presentIntervals = 0;
+        uint64_t totalPresentIntervalUs = 0;
+        uint64_t totalPresentIntervalSqUs = 0;
+    };
+
+    enum class Health
+    {
+        Idle,
+        Neutral,
+        Healthy,
+        Congested,
+        Overloaded
+    };
+
+    enum class Action
+    {
+        Hold,
+        Decrease,
+        Increase
+    };
+
+    struct Decision
+    {
+        Action action = Action::Hold;
+        Health health = Health::Idle;
+        int bitrateKbps = 0;
+
+        // Why, with the numbers that triggered it. Empty when holding.
+        char reason[160] = {};
+    };
+
+    AbrController(const Config& config, int initialBitrateKbps);
+
+    Decision update(const Sample& sample);
+
+    // Adopts a bitrate set by someone else, like the host's ABR. The dwell
+    // time isn't reset, but the windows counted toward the next change are.
+    void syncBitrateKbps(int bitrateKbps);
+
+    // The user picked a new bitrate, which is as high as we'll go from now on
+    void setMaxBitrateKbps(int maxBitrateKbps);
+
+    int bitrateKbps() const;
+
+    static const char* healthName(Health health);
+
+private:
+    Health classify(const Sample& sample, char* detail, int detailLength) const;
+
+    Config m_Config;
+    int m_BitrateKbps;
+    int m_StressedWindows;
+    int m_HealthyWindows;
+    bool m_Changed;
+    uint32_t m_LastChangeMs;
+    int m_OverloadCeilingKbps;
+    uint32_t m_OverloadCeilingMs;
+};
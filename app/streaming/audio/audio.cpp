@@ -1,4 +1,5 @@
 #include "../session.h"
+#include "../network/bandwidth.h"
 #include "renderers/renderer.h"
 
 #ifdef HAVE_SLAUDIO
@@ -60,6 +61,9 @@ bool Session::initializeAudioRenderer()
     SDL_assert(m_OpusDecoder == nullptr);
 
     m_AudioRenderer = createAudioRenderer(&m_OriginalAudioConfig);
+    m_AudioLossRecovery.initialize(m_OriginalAudioConfig.sampleRate,
+                                   m_OriginalAudioConfig.samplesPerFrame,
+                                   m_OriginalAudioConfig.streams);
 
     // We may be unable to create an audio renderer right now
     if (m_AudioRenderer == nullptr) {
@@ -134,12 +138,39 @@ int Session::arInit(int /* audioConfiguration */,
                     void* /* arContext */, int /* arFlags */)
 {
     SDL_memcpy(&s_ActiveSession->m_OriginalAudioConfig, opusConfig, sizeof(*opusConfig));
+    SDL_AtomicSet(&s_ActiveSession->m_AudioFecFrames, 0);
+    SDL_AtomicSet(&s_ActiveSession->m_AudioConcealedFrames, 0);
+    SDL_AtomicSet(&s_ActiveSession->m_AudioLostFrames, 0);
     s_ActiveSession->initializeAudioRenderer();
     return 0;
 }
 
+bool Session::getAudioStats(AUDIO_STATS& stats)
+{
+    if (!SDL_AtomicGet(&m_AudioStatsValid)) {
+        return false;
+    }
+
+    stats.bufferedMs = SDL_AtomicGet(&m_AudioBufferedMs);
+    stats.targetMs = SDL_AtomicGet(&m_AudioTargetMs);
+    stats.underruns = SDL_AtomicGet(&m_AudioUnderruns);
+    stats.overruns = SDL_AtomicGet(&m_AudioOverruns);
+    stats.fecFrames = SDL_AtomicGet(&m_AudioFecFrames);
+    stats.concealedFrames = SDL_AtomicGet(&m_AudioConcealedFrames);
+    stats.lostFrames = SDL_AtomicGet(&m_AudioLostFrames);
+    return true;
+}
+
 void Session::arCleanup()
 {
+    SDL_AtomicSet(&s_ActiveSession->m_AudioStatsValid, 0);
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Audio loss recovery: %d FEC-recovered, %d concealed, %d lost frames",
+                SDL_AtomicGet(&s_ActiveSession->m_AudioFecFrames),
+                SDL_AtomicGet(&s_ActiveSession->m_AudioConcealedFrames),
+                SDL_AtomicGet(&s_ActiveSession->m_AudioLostFrames));
+
     delete s_ActiveSession->m_AudioRenderer;
     s_ActiveSession->m_AudioRenderer = nullptr;
 
@@ -147,10 +178,78 @@ void Session::arCleanup()
     s_ActiveSession->m_OpusDecoder = nullptr;
 }
 
-void Session::arDecodeAndPlaySample(char* sampleData, int sampleLength)
+bool Session::decodeAndSubmitAudio(const unsigned char* data, int length, bool decodeFec)
 {
     int samplesDecoded;
+    int sampleSize = m_AudioRenderer->getAudioBufferSampleSize();
+    int frameSize = sampleSize * m_ActiveAudioConfig.channelCount;
+    int desiredBufferSize = frameSize * m_ActiveAudioConfig.samplesPerFrame;
+    void* buffer = m_AudioRenderer->getAudioBuffer(&desiredBufferSize);
+    if (buffer == nullptr) {
+        return true;
+    }
+
+    // Concealment and FEC must produce exactly one lost frame's worth of audio
+    int maxSamples = desiredBufferSize / frameSize;
+    if (data == nullptr || decodeFec) {
+        maxSamples = SDL_min(maxSamples, m_ActiveAudioConfig.samplesPerFrame);
+    }
+
+    if (m_AudioRenderer->getAudioBufferFormat() == IAudioRenderer::AudioFormat::Float32NE) {
+        samplesDecoded = opus_multistream_decode_float(m_OpusDecoder,
+                                                       data,
+                                                       length,
+                                                       (float*)buffer,
+                                                       maxSamples,
+                                                       decodeFec ? 1 : 0);
+    }
+    else {
+        samplesDecoded = opus_multistream_decode(m_OpusDecoder,
+                                                 data,
+                                                 length,
+                                                 (short*)buffer,
+                                                 maxSamples,
+                                                 decodeFec ? 1 : 0);
+    }
+
+    // Update desiredSize with the number of bytes actually populated by the decoding operation
+    if (samplesDecoded > 0) {
+        SDL_assert(desiredBufferSize >= frameSize * samplesDecoded);
+        desiredBufferSize = frameSize * samplesDecoded;
+    }
+    else {
+        desiredBufferSize = 0;
+    }
+
+    return m_AudioRenderer->submitAudio(desiredBufferSize);
+}
+
+bool Session::recoverLostAudio(const unsigned char* nextPacket, int nextPacketLength)
+{
+    AudioLossRecovery::Plan plan = m_AudioLossRecovery.packetReceived(nextPacket, nextPacketLength);
+    if (plan.skippedFrames > 0) {
+        SDL_AtomicAdd(&m_AudioLostFrames, plan.skippedFrames);
+    }
 
+    for (int i = 0; i < plan.concealedFrames; i++) {
+        if (!decodeAndSubmitAudio(nullptr, 0, false)) {
+            return false;
+        }
+        SDL_AtomicIncRef(&m_AudioConcealedFrames);
+    }
+
+    if (plan.decodeFec) {
+        if (!decodeAndSubmitAudio(nextPacket, nextPacketLength, true)) {
+            return false;
+        }
+        SDL_AtomicIncRef(&m_AudioFecFrames);
+    }
+
+    return true;
+}
+
+void Session::arDecodeAndPlaySample(char* sampleData, int sampleLength)
+{
 #ifndef STEAM_LINK
     // Set this thread to high priority to reduce the chance of missing
     // our sample delivery time. On Steam Link, this causes starvation
@@ -165,6 +264,11 @@ void Session::arDecodeAndPlaySample(char* sampleData, int sampleLength)
     }
 #endif
 
+    // Lost packets are reported with no data
+    if (sampleData != nullptr) {
+        BandwidthCalculator::instance()->addBytes(BandwidthCalculator::Audio, sampleLength);
+    }
+
     // See if we need to drop this sample
     if (s_ActiveSession->m_DropAudioEndTime != 0) {
         if (SDL_TICKS_PASSED(SDL_GetTicks(), s_ActiveSession->m_DropAudioEndTime)) {
@@ -184,54 +288,42 @@ void Session::arDecodeAndPlaySample(char* sampleData, int sampleLength)
 
     // If audio is muted, don't decode or play the audio
     if (s_ActiveSession->m_AudioMuted) {
+        s_ActiveSession->m_AudioLossRecovery.reset();
         return;
     }
 
     if (s_ActiveSession->m_AudioRenderer != nullptr) {
-        int sampleSize = s_ActiveSession->m_AudioRenderer->getAudioBufferSampleSize();
-        int frameSize = sampleSize * s_ActiveSession->m_ActiveAudioConfig.channelCount;
-        int desiredBufferSize = frameSize * s_ActiveSession->m_ActiveAudioConfig.samplesPerFrame;
-        void* buffer = s_ActiveSession->m_AudioRenderer->getAudioBuffer(&desiredBufferSize);
-        if (buffer == nullptr) {
+        if (sampleData == nullptr) {
+            // moonlight-common-c reports each packet it couldn't receive or
+            // recover this way. Hold off until the next packet arrives,
+            // because it may carry FEC data for this one.
+            s_ActiveSession->m_AudioLossRecovery.packetLost();
             return;
         }
 
-        if (s_ActiveSession->m_AudioRenderer->getAudioBufferFormat() == IAudioRenderer::AudioFormat::Float32NE) {
-            samplesDecoded = opus_multistream_decode_float(s_ActiveSession->m_OpusDecoder,
-                                                           (unsigned char*)sampleData,
-                                                           sampleLength,
-                                                           (float*)buffer,
-                                                           desiredBufferSize / frameSize,
-                                                           0);
-        }
-        else {
-            samplesDecoded = opus_multistream_decode(s_ActiveSession->m_OpusDecoder,
-                                                     (unsigned char*)sampleData,
-                                                     sampleLength,
-                                                     (short*)buffer,
-                                                     desiredBufferSize / frameSize,
-                                                     0);
-        }
-
-        // Update desiredSize with the number of bytes actually populated by the decoding operation
-        if (samplesDecoded > 0) {
-            SDL_assert(desiredBufferSize >= frameSize * samplesDecoded);
-            desiredBufferSize = frameSize * samplesDecoded;
-        }
-        else {
-            desiredBufferSize = 0;
-        }
-
-        if (!s_ActiveSession->m_AudioRenderer->submitAudio(desiredBufferSize)) {
+        if (!s_ActiveSession->recoverLostAudio((unsigned char*)sampleData, sampleLength) ||
+                !s_ActiveSession->decodeAndSubmitAudio((unsigned char*)sampleData, sampleLength, false)) {
             SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
                         "Reinitializing audio renderer after failure");
 
+            SDL_AtomicSet(&s_ActiveSession->m_AudioStatsValid, 0);
+
             opus_multistream_decoder_destroy(s_ActiveSession->m_OpusDecoder);
             s_ActiveSession->m_OpusDecoder = nullptr;
 
             delete s_ActiveSession->m_AudioRenderer;
             s_ActiveSession->m_AudioRenderer = nullptr;
         }
+        else {
+            AUDIO_STATS audioStats;
+            if (s_ActiveSession->m_AudioRenderer->getAudioStats(audioStats)) {
+                SDL_AtomicSet(&s_ActiveSession->m_AudioBufferedMs, audioStats.bufferedMs);
+                SDL_AtomicSet(&s_ActiveSession->m_AudioTargetMs, audioStats.targetMs);
+                SDL_AtomicSet(&s_ActiveSession->m_AudioUnderruns, audioStats.underruns);
+                SDL_AtomicSet(&s_ActiveSession->m_AudioOverruns, audioStats.overruns);
+                SDL_AtomicSet(&s_ActiveSession->m_AudioStatsValid, 1);
+            }
+        }
     }
 
     // Only try to recreate the audio renderer every 200 samples (1 second)
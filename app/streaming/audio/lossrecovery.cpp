@@ -0,0 +1,144 @@
+#include "lossrecovery.h"
+
+#include <QtGlobal>
+
+#include <opus_multistream.h>
+
+// Conceal at most this much audio for a single loss burst. Opus PLC fades
+// to silence over longer gaps anyway, and there's no point in spending
+// decode time on it.
+#define MAX_CONCEALMENT_MS 100
+
+#ifdef OPUS_SET_DRED_DURATION_REQUEST
+// Returns the number of bytes taken by an Opus frame length (RFC 6716 3.2.1)
+static int opusFrameLengthSize(const unsigned char* data, int length)
+{
+    if (length < 1) {
+        return 0;
+    }
+    else if (data[0] < 252) {
+        return 1;
+    }
+    else {
+        return length < 2 ? 0 : 2;
+    }
+}
+#endif
+
+AudioLossRecovery::AudioLossRecovery()
+    : m_FrameDurationMs(1),
+      m_Streams(1),
+      m_PendingLostFrames(0)
+{
+
+}
+
+void AudioLossRecovery::initialize(int sampleRate, int samplesPerFrame, int streams)
+{
+    m_FrameDurationMs = qMax(1, samplesPerFrame * 1000 / sampleRate);
+    m_Streams = streams;
+    m_PendingLostFrames = 0;
+}
+
+void AudioLossRecovery::reset()
+{
+    m_PendingLostFrames = 0;
+}
+
+void AudioLossRecovery::packetLost()
+{
+    m_PendingLostFrames++;
+}
+
+AudioLossRecovery::Plan AudioLossRecovery::packetReceived(const unsigned char* packet, int length)
+{
+    Plan plan = {};
+    int lostFrames = m_PendingLostFrames;
+    if (lostFrames == 0) {
+        return plan;
+    }
+    m_PendingLostFrames = 0;
+
+    // The start of a long burst is left as a gap. Only the frames right
+    // before the packet we have can be reconstructed or blended into it.
+    int recoverableFrames = qMin(lostFrames, qMax(1, MAX_CONCEALMENT_MS / m_FrameDurationMs));
+    plan.skippedFrames = lostFrames - recoverableFrames;
+
+    // The last lost frame is rebuilt from the LBRR data in the packet that
+    // follows it, if the host encoded any. Everything else is concealed.
+    plan.decodeFec = packetHasLbrr(packet, length, m_Streams);
+    plan.concealedFrames = plan.decodeFec ? recoverableFrames - 1 : recoverableFrames;
+    return plan;
+}
+
+bool AudioLossRecovery::packetHasLbrr(const unsigned char* packet, int length, int streams)
+{
+#ifndef OPUS_SET_DRED_DURATION_REQUEST
+    // opus_packet_has_lbrr() arrived with DRED in libopus 1.5. Older ones can
+    // still decode the FEC data, we just can't tell when it's there.
+    Q_UNUSED(packet);
+    Q_UNUSED(length);
+    Q_UNUSED(streams);
+    return true;
+#else
+    if (streams <= 1) {
+        return opus_packet_has_lbrr(packet, length) > 0;
+    }
+
+    // Every stream but the last uses self-delimiting framing (RFC 6716
+    // appendix B), which opus_packet_has_lbrr() can't parse. It only needs
+    // the TOC byte and the first byte of the first frame though, so find
+    // that byte and hand it over as a one frame packet.
+    if (length < 2) {
+        return false;
+    }
+
+    int offset = 1;
+    int lengthCount;
+    switch (packet[0] & 0x3) {
+    case 0:
+    case 1:
+        // One length for the only frame, or for both equal sized frames
+        lengthCount = 1;
+        break;
+    case 2:
+        // The first frame's length, then the self-delimiting second one
+        lengthCount = 2;
+        break;
+    default:
+        // Frame count, then padding length bytes if padded, then
+        // every frame's length if VBR or a single shared one if CBR
+        {
+            unsigned char frameCountByte = packet[offset++];
+            if (frameCountByte & 0x40) {
+                while (offset < length && packet[offset] == 255) {
+                    offset++;
+                }
+                offset++;
+            }
+            lengthCount = (frameCountByte & 0x80) ? (frameCountByte & 0x3F) : 1;
+        }
+        break;
+    }
+
+    // The first length we skip is the first frame's, which is empty for DTX
+    if (offset >= length || packet[offset] == 0) {
+        return false;
+    }
+
+    for (int i = 0; i < lengthCount; i++) {
+        int size = opusFrameLengthSize(&packet[offset], length - offset);
+        if (size == 0) {
+            return false;
+        }
+        offset += size;
+    }
+
+    if (offset >= length) {
+        return false;
+    }
+
+    const unsigned char singleFramePacket[] = { (unsigned char)(packet[0] & ~0x3), packet[offset] };
+    return opus_packet_has_lbrr(singleFramePacket, sizeof(singleFramePacket)) > 0;
+#endif
+}
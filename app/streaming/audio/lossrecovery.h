@@ -0,0 +1,48 @@
+#pragma once
+
+// Decides how audio lost in transit is rebuilt. moonlight-common-c reports
+// each packet it couldn't receive or repair, but nothing can be done about
+// them until the next packet arrives, because that packet may carry in-band
+// FEC (LBRR) data for the last one.
+//
+// Nothing here decodes audio, so loss traces can be replayed through it
+// without a decoder or an audio device.
+class AudioLossRecovery
+{
+public:
+    struct Plan
+    {
+        // Frames at the start of a long burst that are left as a gap
+        int skippedFrames;
+
+        // Frames rebuilt with packet loss concealment, in order
+        int concealedFrames;
+
+        // The last lost frame is rebuilt from the FEC data in the packet
+        // that arrived. Otherwise it's one of the concealed frames.
+        bool decodeFec;
+    };
+
+    AudioLossRecovery();
+
+    void initialize(int sampleRate, int samplesPerFrame, int streams);
+
+    // Forgets any pending losses, such as while audio is muted
+    void reset();
+
+    void packetLost();
+
+    // Called with each packet that arrives, before it is decoded. Returns how
+    // to rebuild the frames lost right before it.
+    Plan packetReceived(const unsigned char* packet, int length);
+
+    // True if an Opus multistream packet carries LBRR data for the packet
+    // before it. Only the first stream is checked, since the host turns FEC
+    // on for the whole encoder.
+    static bool packetHasLbrr(const unsigned char* packet, int length, int streams);
+
+private:
+    int m_FrameDurationMs;
+    int m_Streams;
+    int m_PendingLostFrames;
+};
@@ -0,0 +1,219 @@
+#include "jitterbuffer.h"
+
+// Enough ring space to ride out any sane amount of jitter. The actual
+// playback depth is governed by the adaptive target, not by this.
+#define RING_DURATION_MS 500
+
+// Upper bound for the adaptive target depth
+#define MAX_TARGET_MS 100
+
+// Gaps between frames longer than this are discontinuities (drop windows,
+// mute, host stalls) rather than jitter and don't feed the estimate.
+#define MAX_JITTER_SAMPLE_US 250000
+
+// Resampling ratio used to drift towards the target depth. At 0.5% the
+// pitch change is below what listeners notice, and a 10 ms correction
+// takes about 2 seconds.
+#define STRETCH_RATIO 0.005
+
+// Don't stretch for depth errors smaller than this
+#define MIN_STRETCH_BAND_MS 2
+
+AudioJitterBuffer::AudioJitterBuffer()
+    : m_SampleRate(0),
+      m_Channels(0),
+      m_SamplesPerFrame(0),
+      m_DevicePeriodFrames(0),
+      m_Ring(nullptr),
+      m_RingFrames(0),
+      m_WriteIndex(0),
+      m_ReadIndex(0),
+      m_LastArrivalUs(0),
+      m_PeakJitterUs(0),
+      m_TargetFrames(0),
+      m_Scratch(nullptr),
+      m_PrevFrame(nullptr),
+      m_StretchPhase(0.0),
+      m_Priming(true),
+      m_Underruns(0),
+      m_Overruns(0)
+{
+
+}
+
+AudioJitterBuffer::~AudioJitterBuffer()
+{
+    SDL_free(m_Ring);
+    SDL_free(m_Scratch);
+    SDL_free(m_PrevFrame);
+}
+
+bool AudioJitterBuffer::initialize(Uint32 sampleRate, Uint32 channels, Uint32 samplesPerFrame, Uint32 devicePeriodFrames)
+{
+    m_SampleRate = sampleRate;
+    m_Channels = channels;
+    m_SamplesPerFrame = samplesPerFrame;
+    m_DevicePeriodFrames = devicePeriodFrames;
+
+    m_RingFrames = 1;
+    while (m_RingFrames < m_SampleRate * RING_DURATION_MS / 1000) {
+        m_RingFrames <<= 1;
+    }
+    m_Ring = (float*)SDL_calloc(m_RingFrames * m_Channels, sizeof(float));
+
+    // Reads work in chunks of at most one device period. Stretching reads
+    // slightly more than that, plus the previous frame for interpolation.
+    m_Scratch = (float*)SDL_calloc((m_DevicePeriodFrames * 2 + 4) * m_Channels, sizeof(float));
+    m_PrevFrame = (float*)SDL_calloc(m_Channels, sizeof(float));
+    if (m_Ring == nullptr || m_Scratch == nullptr || m_PrevFrame == nullptr) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Failed to allocate audio jitter buffer");
+        return false;
+    }
+
+    // Start with no measured jitter
+    updateTargetDepth(0);
+    return true;
+}
+
+void AudioJitterBuffer::updateTargetDepth(Uint64 nowUs)
+{
+    Uint32 frameDurationUs = m_SamplesPerFrame * 1000000ULL / m_SampleRate;
+
+    // Only late arrivals matter. The early ones that follow are the same
+    // burst catching up. The peak decays by half over a couple of seconds.
+    if (m_LastArrivalUs != 0 && nowUs > m_LastArrivalUs) {
+        Uint64 intervalUs = nowUs - m_LastArrivalUs;
+        if (intervalUs > frameDurationUs && intervalUs < MAX_JITTER_SAMPLE_US) {
+            m_PeakJitterUs = SDL_max(m_PeakJitterUs, (Uint32)(intervalUs - frameDurationUs));
+        }
+    }
+    m_PeakJitterUs -= m_PeakJitterUs / 512;
+    m_LastArrivalUs = nowUs;
+
+    // Enough for the device to pull a full period, one frame in flight,
+    // and the worst recent lateness
+    Uint64 targetUs = m_DevicePeriodFrames * 1000000ULL / m_SampleRate + frameDurationUs + m_PeakJitterUs;
+    targetUs = SDL_min(targetUs, (Uint64)MAX_TARGET_MS * 1000);
+
+    m_TargetFrames.store((Uint32)(targetUs * m_SampleRate / 1000000), std::memory_order_relaxed);
+}
+
+void AudioJitterBuffer::write(const float* samples, Uint32 frames, Uint64 nowUs)
+{
+    updateTargetDepth(nowUs);
+
+    Uint32 writeIndex = m_WriteIndex.load(std::memory_order_relaxed);
+    Uint32 readIndex = m_ReadIndex.load(std::memory_order_acquire);
+
+    if (m_RingFrames - (writeIndex - readIndex) < frames) {
+        // The device has stopped pulling audio. Drop the new frame rather
+        // than blocking the receive thread.
+        m_Overruns.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Uint32 offset = writeIndex & (m_RingFrames - 1);
+    Uint32 firstPart = SDL_min(frames, m_RingFrames - offset);
+    SDL_memcpy(&m_Ring[offset * m_Channels], samples, firstPart * m_Channels * sizeof(float));
+    SDL_memcpy(m_Ring, samples + firstPart * m_Channels, (frames - firstPart) * m_Channels * sizeof(float));
+
+    m_WriteIndex.store(writeIndex + frames, std::memory_order_release);
+}
+
+void AudioJitterBuffer::readRing(Uint32 readIndex, float* dst, Uint32 frames)
+{
+    Uint32 offset = readIndex & (m_RingFrames - 1);
+    Uint32 firstPart = SDL_min(frames, m_RingFrames - offset);
+    SDL_memcpy(dst, &m_Ring[offset * m_Channels], firstPart * m_Channels * sizeof(float));
+    SDL_memcpy(dst + firstPart * m_Channels, m_Ring, (frames - firstPart) * m_Channels * sizeof(float));
+}
+
+void AudioJitterBuffer::read(float* output, Uint32 frames)
+{
+    Uint32 readIndex = m_ReadIndex.load(std::memory_order_relaxed);
+    Uint32 available = m_WriteIndex.load(std::memory_order_acquire) - readIndex;
+    Uint32 target = m_TargetFrames.load(std::memory_order_relaxed);
+
+    // After an underrun (and at startup), refill to the target before
+    // playing again rather than stuttering on every frame that arrives.
+    if (m_Priming) {
+        if (available < target) {
+            SDL_memset(output, 0, frames * m_Channels * sizeof(float));
+            return;
+        }
+        m_Priming = false;
+    }
+
+    // Far more than we want is queued, typically after the device stalled.
+    // Stretching would take too long, so skip straight back to the target.
+    if (available > target * 2 + m_DevicePeriodFrames) {
+        readIndex += available - target;
+        available = target;
+        m_Overruns.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    Uint32 band = SDL_max(m_SamplesPerFrame, m_SampleRate * MIN_STRETCH_BAND_MS / 1000);
+    double step = 1.0;
+    if (available > target + band) {
+        step = 1.0 + STRETCH_RATIO;
+    }
+    else if (available + band < target) {
+        step = 1.0 - STRETCH_RATIO;
+    }
+
+    // Output frame i is interpolated at position phase + i * step in the
+    // input, where input 0 is the last frame of the previous read.
+    // The frame after the final consumed one is peeked for interpolation.
+    Uint32 consumed = (Uint32)(m_StretchPhase + frames * step);
+    Uint32 needed = consumed + 1;
+    if (needed > available) {
+        SDL_memset(output, 0, frames * m_Channels * sizeof(float));
+        SDL_memset(m_PrevFrame, 0, m_Channels * sizeof(float));
+        m_StretchPhase = 0.0;
+        m_Priming = true;
+        m_Underruns.fetch_add(1, std::memory_order_relaxed);
+        m_ReadIndex.store(readIndex, std::memory_order_release);
+        return;
+    }
+
+    SDL_memcpy(m_Scratch, m_PrevFrame, m_Channels * sizeof(float));
+    readRing(readIndex, m_Scratch + m_Channels, needed);
+
+    for (Uint32 i = 0; i < frames; i++) {
+        double pos = m_StretchPhase + i * step;
+        Uint32 index = (Uint32)pos;
+        float frac = (float)(pos - index);
+        const float* a = &m_Scratch[index * m_Channels];
+        const float* b = a + m_Channels;
+
+        for (Uint32 ch = 0; ch < m_Channels; ch++) {
+            output[i * m_Channels + ch] = a[ch] + (b[ch] - a[ch]) * frac;
+        }
+    }
+
+    SDL_memcpy(m_PrevFrame, &m_Scratch[consumed * m_Channels], m_Channels * sizeof(float));
+    m_StretchPhase = m_StretchPhase + frames * step - consumed;
+
+    m_ReadIndex.store(readIndex + consumed, std::memory_order_release);
+}
+
+Uint32 AudioJitterBuffer::getBufferedFrames() const
+{
+    return m_WriteIndex.load(std::memory_order_relaxed) - m_ReadIndex.load(std::memory_order_relaxed);
+}
+
+Uint32 AudioJitterBuffer::getTargetFrames() const
+{
+    return m_TargetFrames.load(std::memory_order_relaxed);
+}
+
+Uint32 AudioJitterBuffer::getUnderruns() const
+{
+    return m_Underruns.load(std::memory_order_relaxed);
+}
+
+Uint32 AudioJitterBuffer::getOverruns() const
+{
+    return m_Overruns.load(std::memory_order_relaxed);
+}
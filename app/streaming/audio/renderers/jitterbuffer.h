@@ -0,0 +1,78 @@
+#pragma once
+
+#include "SDL_compat.h"
+
+#include <atomic>
+
+// Adaptive jitter buffer for the pull-model SDL audio renderer. Decoded
+// frames are written into a single-producer/single-consumer ring on the
+// audio receive thread and the audio device thread pulls from it, so
+// neither side ever blocks.
+//
+// The amount of audio kept in the ring adapts to the measured arrival
+// jitter of incoming frames. Reads converge on that target by resampling a
+// fraction of a percent faster or slower, which is inaudible, and only drop
+// audio outright when they are far behind.
+//
+// Nothing here touches an audio device, so the buffering can be driven from
+// any pair of threads.
+class AudioJitterBuffer
+{
+public:
+    AudioJitterBuffer();
+
+    ~AudioJitterBuffer();
+
+    // devicePeriodFrames is the most a single read() will ask for
+    bool initialize(Uint32 sampleRate, Uint32 channels, Uint32 samplesPerFrame, Uint32 devicePeriodFrames);
+
+    // Receive thread only. Records a frame arriving at nowUs and queues its
+    // interleaved samples. A frame that doesn't fit is dropped and counted
+    // as an overrun.
+    void write(const float* samples, Uint32 frames, Uint64 nowUs);
+
+    // Device thread only. Must not block or allocate. frames must not
+    // exceed the device period.
+    void read(float* output, Uint32 frames);
+
+    Uint32 getBufferedFrames() const;
+
+    Uint32 getTargetFrames() const;
+
+    Uint32 getUnderruns() const;
+
+    Uint32 getOverruns() const;
+
+private:
+    void updateTargetDepth(Uint64 nowUs);
+
+    void readRing(Uint32 readIndex, float* dst, Uint32 frames);
+
+    Uint32 m_SampleRate;
+    Uint32 m_Channels;
+    Uint32 m_SamplesPerFrame;
+    Uint32 m_DevicePeriodFrames;
+
+    // Ring of interleaved float samples. Capacity is a power of two in
+    // sample frames, and the indices count frames and wrap naturally.
+    float* m_Ring;
+    Uint32 m_RingFrames;
+    std::atomic<Uint32> m_WriteIndex;
+    std::atomic<Uint32> m_ReadIndex;
+
+    // Jitter estimation (receive thread only)
+    Uint64 m_LastArrivalUs;
+    Uint32 m_PeakJitterUs;
+
+    // Target ring depth in sample frames, written by the receive thread
+    std::atomic<Uint32> m_TargetFrames;
+
+    // Device-thread-only resampler state
+    float* m_Scratch;
+    float* m_PrevFrame;
+    double m_StretchPhase;
+    bool m_Priming;
+
+    std::atomic<Uint32> m_Underruns;
+    std::atomic<Uint32> m_Overruns;
+};
@@ -3,6 +3,19 @@
 #include <Limelight.h>
 #include <QtGlobal>
 
+typedef struct _AUDIO_STATS {
+    // Filled by the renderer
+    uint32_t bufferedMs;        // audio currently queued for playback
+    uint32_t targetMs;          // queue depth the renderer is steering towards
+    uint32_t underruns;         // playback ran out of audio
+    uint32_t overruns;          // audio was discarded because too much was queued
+
+    // Filled by the session's loss recovery
+    uint32_t fecFrames;         // lost frames rebuilt from the next packet's FEC data
+    uint32_t concealedFrames;   // lost frames synthesized by packet loss concealment
+    uint32_t lostFrames;        // lost frames left as a gap
+} AUDIO_STATS, *PAUDIO_STATS;
+
 class IAudioRenderer
 {
 public:
@@ -31,6 +44,11 @@ public:
     };
     virtual AudioFormat getAudioBufferFormat() = 0;
 
+    // Return false if the renderer doesn't track playback statistics
+    virtual bool getAudioStats(AUDIO_STATS&) {
+        return false;
+    }
+
     int getAudioBufferSampleSize() {
         switch (getAudioBufferFormat()) {
         case IAudioRenderer::AudioFormat::Sint16NE:
@@ -1,8 +1,12 @@
 #pragma once
 
 #include "renderer.h"
+#include "jitterbuffer.h"
 #include "SDL_compat.h"
 
+// Pull-model SDL audio renderer. Decoded frames go into an AudioJitterBuffer
+// on the audio receive thread and SDL's audio callback pulls from it, so
+// neither side ever blocks.
 class SdlAudioRenderer : public IAudioRenderer
 {
 public:
@@ -18,9 +22,17 @@ public:
 
     virtual AudioFormat getAudioBufferFormat();
 
+    virtual bool getAudioStats(AUDIO_STATS& stats);
+
 private:
+    static void SDLCALL audioCallback(void* userdata, Uint8* stream, int len);
+
     SDL_AudioDeviceID m_AudioDevice;
     void* m_AudioBuffer;
     Uint32 m_FrameSize;
-    Uint32 m_FrameDurationMs;
+    Uint32 m_SampleRate;
+    Uint32 m_Channels;
+    Uint32 m_DevicePeriodFrames;
+
+    AudioJitterBuffer m_JitterBuffer;
 };
@@ -4,7 +4,11 @@
 
 SdlAudioRenderer::SdlAudioRenderer()
     : m_AudioDevice(0),
-      m_AudioBuffer(nullptr)
+      m_AudioBuffer(nullptr),
+      m_FrameSize(0),
+      m_SampleRate(0),
+      m_Channels(0),
+      m_DevicePeriodFrames(0)
 {
     SDL_assert(!SDL_WasInit(SDL_INIT_AUDIO));
 
@@ -24,19 +28,28 @@ bool SdlAudioRenderer::prepareForPlayback(const OPUS_MULTISTREAM_CONFIGURATION*
     want.freq = opusConfig->sampleRate;
     want.format = AUDIO_F32SYS;
     want.channels = opusConfig->channelCount;
+    want.callback = audioCallback;
+    want.userdata = this;
 
     // On PulseAudio systems, setting a value too small can cause underruns for other
     // applications sharing this output device. We impose a floor of 480 samples (10 ms)
-    // to mitigate this issue. Otherwise, we will buffer up to 3 frames of audio which
-    // is 15 ms at regular 5 ms frames and 30 ms at 10 ms frames for slow connections.
-    // The buffering helps avoid audio underruns due to network jitter.
-    want.samples = SDL_max(480, opusConfig->samplesPerFrame * 3);
+    // to mitigate this issue. Network jitter is absorbed by our own adaptive buffer,
+    // so the device period doesn't need to cover it.
+    want.samples = SDL_max(480, opusConfig->samplesPerFrame);
 
-    m_FrameDurationMs = opusConfig->samplesPerFrame / (opusConfig->sampleRate / 1000);
+    m_SampleRate = opusConfig->sampleRate;
+    m_Channels = opusConfig->channelCount;
     m_FrameSize = opusConfig->samplesPerFrame *
                   opusConfig->channelCount *
                   getAudioBufferSampleSize();
 
+    m_AudioBuffer = SDL_malloc(m_FrameSize);
+    if (m_AudioBuffer == nullptr) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Failed to allocate audio buffer");
+        return false;
+    }
+
     m_AudioDevice = SDL_OpenAudioDevice(NULL, 0, &want, &have, 0);
     if (m_AudioDevice == 0) {
         SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
@@ -45,10 +58,10 @@ bool SdlAudioRenderer::prepareForPlayback(const OPUS_MULTISTREAM_CONFIGURATION*
         return false;
     }
 
-    m_AudioBuffer = SDL_malloc(m_FrameSize);
-    if (m_AudioBuffer == nullptr) {
-        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
-                     "Failed to allocate audio buffer");
+    m_DevicePeriodFrames = have.samples;
+
+    // The device opens paused, so the callback can't run before this
+    if (!m_JitterBuffer.initialize(m_SampleRate, m_Channels, opusConfig->samplesPerFrame, m_DevicePeriodFrames)) {
         return false;
     }
 
@@ -75,7 +88,7 @@ bool SdlAudioRenderer::prepareForPlayback(const OPUS_MULTISTREAM_CONFIGURATION*
 SdlAudioRenderer::~SdlAudioRenderer()
 {
     if (m_AudioDevice != 0) {
-        // Stop playback
+        // Stop playback. Once closed, the callback is guaranteed not to run.
         SDL_PauseAudioDevice(m_AudioDevice, 1);
         SDL_CloseAudioDevice(m_AudioDevice);
     }
@@ -106,30 +119,38 @@ bool SdlAudioRenderer::submitAudio(int bytesWritten)
         return true;
     }
 
-    // Provide backpressure on the queue to ensure too many frames don't build up
-    // in SDL's audio queue, but don't wait forever to avoid a deadlock if the
-    // audio device fails.
-    for (int i = 0; i < 100; i++) {
-        // Our device may enter a permanent error status upon removal, so we need
-        // to recreate the audio device to pick up the new default audio device.
-        if (SDL_GetAudioDeviceStatus(m_AudioDevice) == SDL_AUDIO_STOPPED) {
-            return false;
-        }
-
-        // Only queue more samples where there is 50 ms or less in SDL's queue
-        if (SDL_GetQueuedAudioSize(m_AudioDevice) / m_FrameSize * m_FrameDurationMs <= 50) {
-            break;
-        }
-
-        SDL_Delay(1);
+    // Our device may enter a permanent error status upon removal, so we need
+    // to recreate the audio device to pick up the new default audio device.
+    if (SDL_GetAudioDeviceStatus(m_AudioDevice) == SDL_AUDIO_STOPPED) {
+        return false;
     }
 
-    if (SDL_QueueAudio(m_AudioDevice, m_AudioBuffer, bytesWritten) < 0) {
-        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
-                     "Failed to queue audio sample: %s",
-                     SDL_GetError());
+    m_JitterBuffer.write((const float*)m_AudioBuffer,
+                         bytesWritten / (m_Channels * sizeof(float)),
+                         LiGetMicroseconds());
+    return true;
+}
+
+void SDLCALL SdlAudioRenderer::audioCallback(void* userdata, Uint8* stream, int len)
+{
+    auto me = (SdlAudioRenderer*)userdata;
+    float* output = (float*)stream;
+    Uint32 frames = len / (me->m_Channels * sizeof(float));
+
+    while (frames > 0) {
+        Uint32 chunk = SDL_min(frames, me->m_DevicePeriodFrames);
+        me->m_JitterBuffer.read(output, chunk);
+        output += chunk * me->m_Channels;
+        frames -= chunk;
     }
+}
 
+bool SdlAudioRenderer::getAudioStats(AUDIO_STATS& stats)
+{
+    stats.bufferedMs = m_JitterBuffer.getBufferedFrames() * 1000ULL / m_SampleRate;
+    stats.targetMs = m_JitterBuffer.getTargetFrames() * 1000ULL / m_SampleRate;
+    stats.underruns = m_JitterBuffer.getUnderruns();
+    stats.overruns = m_JitterBuffer.getOverruns();
     return true;
 }
 
@@ -1,69 +1,78 @@
 #include "bwtracker.h"
 
+#include <algorithm>
+
 using namespace std::chrono;
 
+static uint32_t sanitizeBucketInterval(uint32_t bucketIntervalMs) {
+    return bucketIntervalMs != 0 ? bucketIntervalMs : 250;
+}
+
+static uint32_t averageBucketCount(uint32_t bucketCount) {
+    return std::max(bucketCount / 4, 1u);
+}
+
 BandwidthTracker::BandwidthTracker(uint32_t windowSeconds, uint32_t bucketIntervalMs)
   : windowSeconds(seconds(windowSeconds)),
-    bucketIntervalMs(bucketIntervalMs)
+    bucketIntervalMs(sanitizeBucketInterval(bucketIntervalMs)),
+    bucketCount(std::max((windowSeconds * 1000) / sanitizeBucketInterval(bucketIntervalMs), 1u)),
+    // Weighting with the same span as the average, the usual
+    // equivalence between an EWMA and an N sample moving average
+    ewmaAlpha(2.0 / (averageBucketCount(bucketCount) + 1)),
+    buckets(new Bucket[bucketCount])
 {
-    if (bucketIntervalMs <= 0) {
-        bucketIntervalMs = 250;
-    }
-    bucketCount = (windowSeconds * 1000) / bucketIntervalMs;
-    buckets.resize(bucketCount);
+    Reset();
 }
 
 // Add bytes recorded at the current time.
 void BandwidthTracker::AddBytes(size_t bytes) {
-    std::lock_guard<std::mutex> lock(mtx);
-    auto now = steady_clock::now();
-    updateBucket(bytes, now);
+    int64_t interval = currentInterval();
+    uint64_t epoch = (uint64_t)interval & EPOCH_MASK;
+    Bucket &bucket = buckets[interval % bucketCount];
+
+    uint64_t word = bucket.load(std::memory_order_relaxed);
+    while ((word >> BYTES_BITS) != epoch) {
+        // This is the first data for this interval, so the bucket still holds
+        // data from a whole window ago. Whoever wins the exchange starts it
+        // over and everyone else adds to it.
+        uint64_t fresh = (epoch << BYTES_BITS) | std::min<uint64_t>(bytes, BYTES_MASK);
+        if (bucket.compare_exchange_weak(word, fresh, std::memory_order_relaxed)) {
+            return;
+        }
+    }
+
+    // A full window would have to pass between the check above and this add
+    // for the bytes to land in the wrong interval
+    bucket.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void BandwidthTracker::Reset() {
+    firstInterval.store(currentInterval(), std::memory_order_relaxed);
+    for (uint32_t i = 0; i < bucketCount; i++) {
+        buckets[i].store(0, std::memory_order_relaxed);
+    }
 }
 
 // We don't want to average the entire window used for peak,
 // so average only the newest 25% of complete buckets
 double BandwidthTracker::GetAverageMbps() {
-    std::lock_guard<std::mutex> lock(mtx);
-    auto now = steady_clock::now();
-    auto ms = duration_cast<milliseconds>(now.time_since_epoch());
-    int currentIndex = (ms.count() / bucketIntervalMs) % bucketCount;
-    int maxBuckets = bucketCount / 4;
-    size_t totalBytes = 0;
-    steady_clock::time_point oldestBucket = now;
-
-    // Sum bytes from 25% most recent buckets as long as they are completed
-    for (int i = 0; i < maxBuckets; i++) {
-        int idx = (currentIndex - i + bucketCount) % bucketCount;
-        const Bucket &bucket = buckets[idx];
-        if (isValid(bucket, now) && (now - bucket.start >= milliseconds(bucketIntervalMs))) {
-            totalBytes += bucket.bytes;
-            if (bucket.start < oldestBucket) {
-                oldestBucket = bucket.start;
-            }
-        }
-    }
+    return computeStats().averageMbps;
+}
 
-    double elapsed = duration<double>(now - oldestBucket).count();
-    if (elapsed <= 0.0) {
-        return 0.0;
-    }
+double BandwidthTracker::GetPeakMbps() {
+    return computeStats().peakMbps;
+}
 
-    return totalBytes * 8.0 / 1000000.0 / elapsed;
+double BandwidthTracker::GetEwmaMbps() {
+    return computeStats().ewmaMbps;
 }
 
-double BandwidthTracker::GetPeakMbps() {
-    std::lock_guard<std::mutex> lock(mtx);
-    auto now = steady_clock::now();
-    double peak = 0.0;
-    for (const auto& bucket : buckets) {
-        if (isValid(bucket, now)) {
-            double throughput = getBucketMbps(bucket);
-            if (throughput > peak) {
-                peak = throughput;
-            }
-        }
-    }
-    return peak;
+double BandwidthTracker::GetEwmaVarianceMbps2() {
+    return computeStats().ewmaVarianceMbps2;
+}
+
+BandwidthTracker::Stats BandwidthTracker::GetStats() {
+    return computeStats();
 }
 
 unsigned int BandwidthTracker::GetWindowSeconds() {
@@ -72,33 +81,67 @@ unsigned int BandwidthTracker::GetWindowSeconds() {
 
 /// private methods
 
-inline double BandwidthTracker::getBucketMbps(const Bucket &bucket) const {
-    return bucket.bytes * 8.0 / 1000000.0 / (bucketIntervalMs / 1000.0);
+inline int64_t BandwidthTracker::currentInterval() const {
+    auto ms = duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+    return ms / bucketIntervalMs;
 }
 
-// Check if a bucket's data is still valid (within the window)
-inline bool BandwidthTracker::isValid(const Bucket &bucket, steady_clock::time_point now) const {
-    return (now - bucket.start) <= windowSeconds;
+// Returns the bytes recorded during an interval, or 0 if its bucket has
+// since been reused or was never written
+inline uint64_t BandwidthTracker::bucketBytes(int64_t interval) const {
+    uint64_t word = buckets[interval % bucketCount].load(std::memory_order_relaxed);
+    if ((word >> BYTES_BITS) != ((uint64_t)interval & EPOCH_MASK)) {
+        return 0;
+    }
+    return word & BYTES_MASK;
+}
+
+inline double BandwidthTracker::bytesToMbps(uint64_t bytes, uint32_t intervals) const {
+    return bytes * 8.0 / 1000000.0 / (intervals * bucketIntervalMs / 1000.0);
 }
 
-void BandwidthTracker::updateBucket(size_t bytes, steady_clock::time_point now) {
-    auto ms          = duration_cast<milliseconds>(now.time_since_epoch()).count();
-    int bucketIndex  = (ms / bucketIntervalMs) % bucketCount;
-    auto aligned_ms  = ms - (ms % bucketIntervalMs);
-    auto bucketStart = steady_clock::time_point(milliseconds(aligned_ms));
+BandwidthTracker::Stats BandwidthTracker::computeStats() {
+    Stats stats;
+    int64_t now = currentInterval();
 
-    Bucket &bucket = buckets[bucketIndex];
+    // Intervals before the tracker started carry no data rather than zero
+    // bandwidth, so leave them out of the averages while warming up
+    int64_t oldest = std::max(now - (int64_t)bucketCount + 1,
+                              firstInterval.load(std::memory_order_relaxed));
+    int64_t newestAverage = now - (int64_t)averageBucketCount(bucketCount);
 
-    if (now - bucket.start > windowSeconds) {
-        bucket.bytes = 0;
-        bucket.start = bucketStart;
-    }
+    // The in-progress bucket counts toward the peak but not the averages
+    stats.peakMbps = bytesToMbps(bucketBytes(now), 1);
 
-    if (bucket.start != bucketStart) {
-        bucket.bytes = bytes;
-        bucket.start = bucketStart;
+    uint64_t averageBytes = 0;
+    uint32_t averageIntervals = 0;
+    bool ewmaStarted = false;
+    for (int64_t interval = oldest; interval < now; interval++) {
+        uint64_t bytes = bucketBytes(interval);
+        double mbps = bytesToMbps(bytes, 1);
+
+        stats.peakMbps = std::max(stats.peakMbps, mbps);
+
+        if (interval > newestAverage) {
+            averageBytes += bytes;
+            averageIntervals++;
+        }
+
+        if (!ewmaStarted) {
+            stats.ewmaMbps = mbps;
+            ewmaStarted = true;
+        }
+        else {
+            double diff = mbps - stats.ewmaMbps;
+            double increment = ewmaAlpha * diff;
+            stats.ewmaMbps += increment;
+            stats.ewmaVarianceMbps2 = (1.0 - ewmaAlpha) * (stats.ewmaVarianceMbps2 + diff * increment);
+        }
     }
-    else {
-        bucket.bytes += bytes;
+
+    if (averageIntervals != 0) {
+        stats.averageMbps = bytesToMbps(averageBytes, averageIntervals);
     }
+
+    return stats;
 }
@@ -1,9 +1,9 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
 #include <cstdint>
-#include <mutex>
-#include <vector>
+#include <memory>
 
 /**
  * @brief The BandwidthTracker class tracks network bandwidth usage over a sliding time window (default 10s).
@@ -17,8 +17,13 @@
  *
  * GetPeakMbps() returns the peak bandwidth seen during any one bucket interval across the full time window.
  *
- * All public methods are thread safe. A typical use case is calling AddBytes() in a data processing thread while
- * calling GetAverageMbps() from a UI thread.
+ * GetEwmaMbps() and GetEwmaVarianceMbps2() return an exponentially weighted moving average of the completed
+ * buckets and its variance, weighted with the same span as the average. Rate controllers can use these directly.
+ *
+ * All public methods are thread safe and lock-free. Each bucket is a single atomic word holding both the interval
+ * it belongs to and its byte count, so AddBytes() is one atomic add except for the first call in a new interval.
+ * A typical use case is calling AddBytes() in a data processing thread while calling GetAverageMbps() from a UI
+ * thread.
  *
  * Example usage:
  * @code
@@ -32,6 +37,16 @@
 class BandwidthTracker
 {
 public:
+    /**
+     * @brief A snapshot of every statistic, computed in a single pass over the buckets.
+     */
+    struct Stats {
+        double averageMbps = 0.0;       ///< Same as GetAverageMbps().
+        double peakMbps = 0.0;          ///< Same as GetPeakMbps().
+        double ewmaMbps = 0.0;          ///< Same as GetEwmaMbps().
+        double ewmaVarianceMbps2 = 0.0; ///< Same as GetEwmaVarianceMbps2().
+    };
+
     /**
      * @brief Constructs a new BandwidthTracker object.
      *
@@ -47,14 +62,21 @@ public:
      * @brief Record bytes that were received or sent.
      *
      * This method updates the corresponding bucket for the current time interval with the new data.
-     * It is thread-safe. Bytes are associated with the bucket for "now" and it is not possible to
-     * submit data for old buckets. This function should be called as needed at the time the bytes
-     * were received. Callers should not maintain their own byte totals.
+     * It is thread-safe and never blocks. Bytes are associated with the bucket for "now" and it is not
+     * possible to submit data for old buckets. This function should be called as needed at the time the
+     * bytes were received. Callers should not maintain their own byte totals.
      *
      * @param bytes The number of bytes to add.
      */
     void AddBytes(size_t bytes);
 
+    /**
+     * @brief Discards all recorded data, as if the tracker had just been constructed.
+     *
+     * Bytes added concurrently with a reset may or may not be counted.
+     */
+    void Reset();
+
     /**
      * @brief Computes and returns the average bandwidth in Mbps for the most recent 25% of buckets.
      *
@@ -71,6 +93,27 @@ public:
      */
     double GetPeakMbps();
 
+    /**
+     * @brief Returns the exponentially weighted moving average of the completed buckets' bandwidth.
+     *
+     * @return The smoothed bandwidth in megabits per second.
+     */
+    double GetEwmaMbps();
+
+    /**
+     * @brief Returns the exponentially weighted variance of the completed buckets' bandwidth around GetEwmaMbps().
+     *
+     * @return The variance in megabits per second, squared.
+     */
+    double GetEwmaVarianceMbps2();
+
+    /**
+     * @brief Returns all statistics at once. Cheaper than calling each getter when more than one is needed.
+     *
+     * @return The current statistics.
+     */
+    Stats GetStats();
+
     /**
      * @brief Retrieves the duration of the tracking window.
      *
@@ -86,22 +129,27 @@ public:
 
 private:
     /**
-     * @brief A structure representing a single time bucket.
+     * @brief A single time bucket, packed into one word so it can be updated atomically.
      *
-     * Each bucket holds the start time of the interval and the total number of bytes recorded during that interval.
+     * The upper EPOCH_BITS hold the low bits of the bucket's interval number and the rest hold the number
+     * of bytes recorded during that interval.
      */
-    struct Bucket {
-        std::chrono::steady_clock::time_point start{}; ///< The start time of the bucket's interval.
-        size_t bytes = 0;                              ///< The number of bytes recorded in this bucket.
-    };
+    typedef std::atomic<std::uint64_t> Bucket;
+
+    static constexpr int EPOCH_BITS = 24;
+    static constexpr int BYTES_BITS = 64 - EPOCH_BITS;
+    static constexpr std::uint64_t EPOCH_MASK = (1ULL << EPOCH_BITS) - 1;
+    static constexpr std::uint64_t BYTES_MASK = (1ULL << BYTES_BITS) - 1;
 
-    const std::chrono::seconds windowSeconds;          ///< T he duration of the tracking window.
-    const int bucketIntervalMs;                        ///< The duration of each bucket (in milliseconds).
-    std::uint32_t bucketCount;                         ///< The total number of buckets covering the window.
-    std::vector<Bucket> buckets;                       ///< Fixed-size circular buffer of buckets.
-    std::mutex mtx;                                    ///< Mutex to ensure thread-safe access.
+    const std::chrono::seconds windowSeconds;          ///< The duration of the tracking window.
+    const std::uint32_t bucketIntervalMs;              ///< The duration of each bucket (in milliseconds).
+    const std::uint32_t bucketCount;                   ///< The total number of buckets covering the window.
+    const double ewmaAlpha;                            ///< The weight given to each new bucket by the EWMA.
+    std::unique_ptr<Bucket[]> buckets;                 ///< Fixed-size circular buffer of buckets.
+    std::atomic<std::int64_t> firstInterval;           ///< The interval number at construction or the last reset.
 
-    bool isValid(const Bucket &bucket, std::chrono::steady_clock::time_point now) const;
-    void updateBucket(size_t bytes, std::chrono::steady_clock::time_point now);
-    double getBucketMbps(const Bucket &bucket) const;
+    std::int64_t currentInterval() const;
+    std::uint64_t bucketBytes(std::int64_t interval) const;
+    double bytesToMbps(std::uint64_t bytes, std::uint32_t intervals) const;
+    Stats computeStats();
 };
@@ -0,0 +1,651 @@
+#include "clipboardblobtransfer.h"
+#include "clipboardhash.h"
+#include "clipboardlogging.h"
+
+#include <QDir>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QTemporaryFile>
+#include <QTimer>
+
+namespace {
+int httpStatus(QNetworkReply* reply)
+{
+    return reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+}
+
+// The host predates the chunked upload endpoints.
+bool isUnsupportedStatus(int status)
+{
+    return status == 404 || status == 405 || status == 501;
+}
+}
+
+ClipboardBlobTransfer::ClipboardBlobTransfer(QNetworkAccessManager* nam,
+                                             const QUrl& blobUrl,
+                                             const QSslConfiguration& sslConfig,
+                                             QObject* parent)
+    : QObject(parent),
+      m_Nam(nam),
+      m_BlobUrl(blobUrl),
+      m_SslConfig(sslConfig),
+      m_RetryTimer(new QTimer(this))
+{
+    m_RetryTimer->setSingleShot(true);
+    connect(m_RetryTimer, &QTimer::timeout, this, [this]() {
+        if (m_Upload) {
+            pumpUploadChunks();
+        }
+        else {
+            pumpDownloadChunks();
+        }
+    });
+}
+
+ClipboardBlobTransfer::~ClipboardBlobTransfer()
+{
+    abort();
+}
+
+QString ClipboardBlobTransfer::chunkHashHex(const char* data, qint64 length)
+{
+    return QString::number(ClipboardHash::hash64(data, static_cast<size_t>(length)), 16)
+            .rightJustified(16, QLatin1Char('0'));
+}
+
+QNetworkRequest ClipboardBlobTransfer::makeRequest(const QString& tail) const
+{
+    QUrl url(m_BlobUrl);
+    url.setPath(m_BlobUrl.path() + tail);
+
+    QNetworkRequest req(url);
+    // Sunshine pins clipboard blob endpoint to its mTLS server (cert
+    // required); reuse the same paired client identity nvhttp does, or
+    // every fetch/upload fails with a TLS 'certificate required' alert.
+    req.setSslConfiguration(m_SslConfig);
+    // Multiplex chunk requests over one connection when the host speaks h2.
+    // HTTP/1.1 hosts get at most MAX_PARALLEL_CHUNKS keep-alive connections.
+    req.setAttribute(QNetworkRequest::Http2AllowedAttribute, true);
+    return req;
+}
+
+void ClipboardBlobTransfer::initChunks(qint64 total)
+{
+    m_Chunks.clear();
+    for (qint64 offset = 0; offset < total; offset += CHUNK_BYTES) {
+        Chunk chunk;
+        chunk.offset = offset;
+        chunk.length = qMin(CHUNK_BYTES, total - offset);
+        m_Chunks.append(chunk);
+    }
+}
+
+QTemporaryFile* ClipboardBlobTransfer::createTempFile()
+{
+    delete m_File;
+    m_File = new QTemporaryFile(QDir::temp().filePath(QStringLiteral("moonlight-clipboard-XXXXXX")), this);
+    if (!m_File->open()) {
+        return nullptr;
+    }
+    return m_File;
+}
+
+void ClipboardBlobTransfer::deferRetry(Chunk& chunk)
+{
+    chunk.retryAtMs = m_Clock.elapsed() + chunk.attempts * RETRY_BACKOFF_MS;
+    armRetryTimer(chunk.retryAtMs);
+}
+
+bool ClipboardBlobTransfer::waitingForRetry(const Chunk& chunk, qint64& nextRetryMs) const
+{
+    if (chunk.retryAtMs <= m_Clock.elapsed()) {
+        return false;
+    }
+    if (nextRetryMs < 0 || chunk.retryAtMs < nextRetryMs) {
+        nextRetryMs = chunk.retryAtMs;
+    }
+    return true;
+}
+
+void ClipboardBlobTransfer::armRetryTimer(qint64 nextRetryMs)
+{
+    // One timer serves every backed-off chunk; keep it on the earliest one.
+    const qint64 delayMs = qMax<qint64>(0, nextRetryMs - m_Clock.elapsed());
+    if (!m_RetryTimer->isActive() || m_RetryTimer->remainingTime() > delayMs) {
+        m_RetryTimer->start(static_cast<int>(delayMs));
+    }
+}
+
+void ClipboardBlobTransfer::reportProgress(bool force)
+{
+    if (!force && m_ProgressTimer.isValid() && m_ProgressTimer.elapsed() < PROGRESS_INTERVAL_MS) {
+        return;
+    }
+    m_ProgressTimer.restart();
+    emit progress(m_Transferred, m_Total);
+}
+
+void ClipboardBlobTransfer::abort()
+{
+    m_Finished = true;
+    m_RetryTimer->stop();
+
+    if (m_ControlReply != nullptr) {
+        m_ControlReply->abort();
+    }
+    for (Chunk& chunk : m_Chunks) {
+        if (chunk.reply != nullptr) {
+            chunk.reply->abort();
+        }
+    }
+    m_InFlight = 0;
+
+    delete m_File;
+    m_File = nullptr;
+}
+
+void ClipboardBlobTransfer::fail(const char* reason)
+{
+    if (m_Finished) {
+        return;
+    }
+
+    ClipboardLog::warn("ClipboardSync: blob %s failed: %s",
+                m_Upload ? "upload" : "download",
+                reason);
+    const bool upload = m_Upload;
+    abort();
+    if (upload) {
+        emit uploadFinished(false, QString());
+    }
+    else {
+        emit downloadFinished(false);
+    }
+}
+
+void ClipboardBlobTransfer::startUpload(const QByteArray& payload, uint64_t payloadHash, const QString& mime)
+{
+    m_Upload = true;
+    m_Finished = false;
+    m_PayloadHash = payloadHash;
+    m_Mime = mime;
+    m_Total = payload.size();
+    m_Transferred = 0;
+    m_Clock.start();
+    m_ProgressTimer.invalidate();
+
+    if (createTempFile() == nullptr || m_File->write(payload) != payload.size() || !m_File->flush()) {
+        fail("cannot write temporary file");
+        return;
+    }
+
+    if (m_Total < CHUNKED_THRESHOLD) {
+        startSingleUpload();
+        return;
+    }
+
+    QJsonObject body;
+    body.insert(QStringLiteral("mime"), mime);
+    body.insert(QStringLiteral("size"), static_cast<double>(m_Total));
+    body.insert(QStringLiteral("chunkSize"), static_cast<double>(CHUNK_BYTES));
+    body.insert(QStringLiteral("hash"), QString::number(payloadHash, 16).rightJustified(16, QLatin1Char('0')));
+
+    QNetworkRequest req = makeRequest(QStringLiteral("/upload"));
+    req.setHeader(QNetworkRequest::ContentTypeHeader, QStringLiteral("application/json"));
+    QNetworkReply* reply = m_Nam->post(req, QJsonDocument(body).toJson(QJsonDocument::Compact));
+    m_ControlReply = reply;
+    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
+        reply->deleteLater();
+        onUploadSessionReply(reply);
+    });
+}
+
+void ClipboardBlobTransfer::startSingleUpload()
+{
+    QNetworkRequest req = makeRequest(QString());
+    req.setHeader(QNetworkRequest::ContentTypeHeader,
+                  QStringLiteral("application/octet-stream"));
+    req.setRawHeader("X-Clipboard-Mime", m_Mime.toUtf8());
+
+    // The reply streams the body straight from the spooled file.
+    if (!m_File->seek(0)) {
+        fail("cannot read temporary file");
+        return;
+    }
+    QNetworkReply* reply = m_Nam->post(req, m_File);
+    m_ControlReply = reply;
+    connect(reply, &QNetworkReply::uploadProgress, this, [this](qint64 sent, qint64) {
+        m_Transferred = sent;
+        reportProgress(false);
+    });
+    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
+        reply->deleteLater();
+        if (m_Finished) {
+            return;
+        }
+        if (reply->error() != QNetworkReply::NoError) {
+            fail(reply->errorString().toUtf8().constData());
+            return;
+        }
+
+        QJsonParseError jerr{};
+        QJsonDocument doc = QJsonDocument::fromJson(reply->readAll(), &jerr);
+        const QString id = doc.object().value(QStringLiteral("id")).toString();
+        if (jerr.error != QJsonParseError::NoError || id.isEmpty()) {
+            fail("response missing blob id");
+            return;
+        }
+
+        m_Finished = true;
+        m_Transferred = m_Total;
+        reportProgress(true);
+        emit uploadFinished(true, id);
+    });
+}
+
+void ClipboardBlobTransfer::onUploadSessionReply(QNetworkReply* reply)
+{
+    if (m_Finished) {
+        return;
+    }
+
+    if (reply->error() != QNetworkReply::NoError) {
+        if (isUnsupportedStatus(httpStatus(reply))) {
+            ClipboardLog::debug("ClipboardSync: host has no chunked blob upload; using single POST");
+            startSingleUpload();
+            return;
+        }
+        fail(reply->errorString().toUtf8().constData());
+        return;
+    }
+
+    QJsonParseError jerr{};
+    const QJsonObject obj = QJsonDocument::fromJson(reply->readAll(), &jerr).object();
+    m_UploadId = obj.value(QStringLiteral("upload")).toString();
+    if (jerr.error != QJsonParseError::NoError || m_UploadId.isEmpty()) {
+        fail("upload session response missing id");
+        return;
+    }
+
+    initChunks(m_Total);
+    const QJsonArray received = obj.value(QStringLiteral("received")).toArray();
+    for (const QJsonValue& value : received) {
+        const int index = value.toInt(-1);
+        if (index >= 0 && index < m_Chunks.size() && !m_Chunks[index].done) {
+            m_Chunks[index].done = true;
+            m_Transferred += m_Chunks[index].length;
+        }
+    }
+
+    if (m_Transferred > 0) {
+        ClipboardLog::info("ClipboardSync: resuming blob upload at %lld/%lld bytes",
+                    static_cast<long long>(m_Transferred),
+                    static_cast<long long>(m_Total));
+    }
+
+    reportProgress(true);
+    pumpUploadChunks();
+}
+
+void ClipboardBlobTransfer::pumpUploadChunks()
+{
+    if (m_Finished) {
+        return;
+    }
+
+    bool allDone = true;
+    qint64 nextRetryMs = -1;
+    for (int i = 0; i < m_Chunks.size() && m_InFlight < MAX_PARALLEL_CHUNKS; ++i) {
+        Chunk& chunk = m_Chunks[i];
+        if (chunk.done) {
+            continue;
+        }
+        allDone = false;
+        if (chunk.reply != nullptr || waitingForRetry(chunk, nextRetryMs)) {
+            continue;
+        }
+
+        // Only the chunks in flight are ever read back into memory.
+        QByteArray body;
+        if (m_File->seek(chunk.offset)) {
+            body = m_File->read(chunk.length);
+        }
+        if (body.size() != chunk.length) {
+            fail("cannot read temporary file");
+            return;
+        }
+        QNetworkRequest req = makeRequest(QStringLiteral("/upload/%1/%2").arg(m_UploadId).arg(i));
+        req.setHeader(QNetworkRequest::ContentTypeHeader, QStringLiteral("application/octet-stream"));
+        req.setRawHeader("X-Chunk-Hash", chunkHashHex(body.constData(), body.size()).toLatin1());
+
+        QNetworkReply* reply = m_Nam->put(req, body);
+        chunk.reply = reply;
+        chunk.attempts++;
+        m_InFlight++;
+        connect(reply, &QNetworkReply::finished, this, [this, i, reply]() {
+            reply->deleteLater();
+            onUploadChunkReply(i, reply);
+        });
+    }
+
+    if (nextRetryMs >= 0) {
+        armRetryTimer(nextRetryMs);
+    }
+
+    if (allDone) {
+        for (const Chunk& chunk : m_Chunks) {
+            if (!chunk.done) {
+                allDone = false;
+                break;
+            }
+        }
+    }
+
+    if (allDone && m_InFlight == 0) {
+        commitUpload();
+    }
+}
+
+void ClipboardBlobTransfer::onUploadChunkReply(int index, QNetworkReply* reply)
+{
+    if (m_Finished) {
+        return;
+    }
+
+    Chunk& chunk = m_Chunks[index];
+    chunk.reply = nullptr;
+    m_InFlight--;
+
+    if (reply->error() != QNetworkReply::NoError) {
+        const int status = httpStatus(reply);
+        // 404 means the host dropped the upload session; retrying the chunk
+        // cannot succeed.
+        if (status == 404 || chunk.attempts >= MAX_CHUNK_ATTEMPTS) {
+            fail(reply->errorString().toUtf8().constData());
+            return;
+        }
+
+        ClipboardLog::debug("ClipboardSync: blob chunk %d upload attempt %d failed: %s",
+                     index,
+                     chunk.attempts,
+                     reply->errorString().toUtf8().constData());
+        deferRetry(chunk);
+        pumpUploadChunks();
+        return;
+    }
+
+    chunk.done = true;
+    m_Transferred += chunk.length;
+    reportProgress(false);
+    pumpUploadChunks();
+}
+
+void ClipboardBlobTransfer::commitUpload()
+{
+    QNetworkRequest req = makeRequest(QStringLiteral("/upload/%1/commit").arg(m_UploadId));
+    req.setHeader(QNetworkRequest::ContentTypeHeader, QStringLiteral("application/json"));
+    QNetworkReply* reply = m_Nam->post(req, QByteArray());
+    m_ControlReply = reply;
+    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
+        reply->deleteLater();
+        if (m_Finished) {
+            return;
+        }
+        if (reply->error() != QNetworkReply::NoError) {
+            fail(reply->errorString().toUtf8().constData());
+            return;
+        }
+
+        QJsonParseError jerr{};
+        const QString id = QJsonDocument::fromJson(reply->readAll(), &jerr)
+                .object().value(QStringLiteral("id")).toString();
+        if (jerr.error != QJsonParseError::NoError || id.isEmpty()) {
+            fail("commit response missing blob id");
+            return;
+        }
+
+        m_Finished = true;
+        reportProgress(true);
+        emit uploadFinished(true, id);
+    });
+}
+
+void ClipboardBlobTransfer::startDownload(const QString& id, qint64 advertisedSize, qint64 maxBytes)
+{
+    m_Upload = false;
+    m_Finished = false;
+    m_BlobId = id;
+    m_Total = advertisedSize;
+    m_MaxBytes = maxBytes;
+    m_Transferred = 0;
+    m_Clock.start();
+    m_ProgressTimer.invalidate();
+
+    if (createTempFile() == nullptr) {
+        fail("cannot create temporary file");
+        return;
+    }
+
+    if (m_Total > m_MaxBytes) {
+        fail("advertised size exceeds maximum");
+        return;
+    }
+
+    if (m_Total < CHUNKED_THRESHOLD) {
+        startSingleDownload();
+        return;
+    }
+
+    m_File->resize(m_Total);
+    initChunks(m_Total);
+    pumpDownloadChunks();
+}
+
+void ClipboardBlobTransfer::startSingleDownload()
+{
+    // One open-ended chunk; length stays unknown (-1) when the REF did not
+    // declare a size. Swap the old chunks out first so the finished()
+    // handlers of the aborted replies no longer match any chunk.
+    QVector<Chunk> previous;
+    previous.swap(m_Chunks);
+    m_InFlight = 0;
+    for (Chunk& chunk : previous) {
+        if (chunk.reply != nullptr) {
+            chunk.reply->abort();
+        }
+    }
+
+    m_Transferred = 0;
+    m_File->resize(0);
+
+    Chunk chunk;
+    chunk.length = m_Total > 0 ? m_Total : -1;
+    m_Chunks.append(chunk);
+    pumpDownloadChunks();
+}
+
+void ClipboardBlobTransfer::pumpDownloadChunks()
+{
+    if (m_Finished) {
+        return;
+    }
+
+    bool allDone = true;
+    qint64 nextRetryMs = -1;
+    const bool ranged = m_Chunks.size() > 1;
+    for (int i = 0; i < m_Chunks.size() && m_InFlight < MAX_PARALLEL_CHUNKS; ++i) {
+        Chunk& chunk = m_Chunks[i];
+        if (chunk.done) {
+            continue;
+        }
+        allDone = false;
+        if (chunk.reply != nullptr || waitingForRetry(chunk, nextRetryMs)) {
+            continue;
+        }
+
+        QNetworkRequest req = makeRequest(QStringLiteral("/") + m_BlobId);
+        const qint64 start = chunk.offset + chunk.received;
+        if (ranged) {
+            req.setRawHeader("Range", QStringLiteral("bytes=%1-%2")
+                             .arg(start).arg(chunk.offset + chunk.length - 1).toLatin1());
+        }
+        else if (chunk.received > 0) {
+            // Resume an interrupted single download where it stopped.
+            req.setRawHeader("Range", QStringLiteral("bytes=%1-").arg(start).toLatin1());
+        }
+
+        QNetworkReply* reply = m_Nam->get(req);
+        chunk.reply = reply;
+        chunk.requestStart = chunk.received;
+        chunk.attempts++;
+        m_InFlight++;
+        connect(reply, &QNetworkReply::readyRead, this, [this, i, reply]() {
+            onDownloadChunkData(i, reply);
+        });
+        connect(reply, &QNetworkReply::finished, this, [this, i, reply]() {
+            reply->deleteLater();
+            onDownloadChunkFinished(i, reply);
+        });
+    }
+
+    if (nextRetryMs >= 0) {
+        armRetryTimer(nextRetryMs);
+    }
+
+    if (allDone && m_InFlight == 0) {
+        for (const Chunk& chunk : m_Chunks) {
+            if (!chunk.done) {
+                return;
+            }
+        }
+
+        if (m_Total > 0 && m_File->size() != m_Total) {
+            fail("downloaded size does not match advertised size");
+            return;
+        }
+
+        m_Finished = true;
+        m_File->flush();
+        reportProgress(true);
+        emit downloadFinished(true);
+    }
+}
+
+void ClipboardBlobTransfer::onDownloadChunkData(int index, QNetworkReply* reply)
+{
+    if (m_Finished || index >= m_Chunks.size() || m_Chunks[index].reply != reply) {
+        return;
+    }
+
+    Chunk& chunk = m_Chunks[index];
+    const bool rangeRequested = !reply->request().rawHeader("Range").isEmpty();
+    if (rangeRequested && httpStatus(reply) == 200) {
+        if (m_Chunks.size() > 1) {
+            // The host ignores Range; fetch the blob as a single stream.
+            ClipboardLog::debug("ClipboardSync: host ignored ranged blob request; using single GET");
+            startSingleDownload();
+            return;
+        }
+
+        // A resumed single download came back from the start.
+        chunk.received = 0;
+        chunk.requestStart = 0;
+        m_Transferred = 0;
+        m_File->resize(0);
+    }
+
+    const QByteArray data = reply->readAll();
+    if (data.isEmpty()) {
+        return;
+    }
+
+    const qint64 end = chunk.offset + chunk.received + data.size();
+    if ((chunk.length >= 0 && chunk.received + data.size() > chunk.length) || end > m_MaxBytes) {
+        fail("blob exceeds declared or maximum size");
+        return;
+    }
+
+    if (!m_File->seek(chunk.offset + chunk.received) || m_File->write(data) != data.size()) {
+        fail("cannot write temporary file");
+        return;
+    }
+
+    chunk.received += data.size();
+    m_Transferred += data.size();
+    reportProgress(false);
+}
+
+void ClipboardBlobTransfer::onDownloadChunkFinished(int index, QNetworkReply* reply)
+{
+    if (m_Finished || index >= m_Chunks.size() || m_Chunks[index].reply != reply) {
+        return;
+    }
+
+    // Drain anything still buffered; this can switch to a single download.
+    onDownloadChunkData(index, reply);
+    if (m_Finished || m_Chunks.size() <= index || m_Chunks[index].reply != reply) {
+        return;
+    }
+
+    Chunk& chunk = m_Chunks[index];
+    chunk.reply = nullptr;
+    m_InFlight--;
+
+    bool ok = reply->error() == QNetworkReply::NoError;
+    if (ok && chunk.length >= 0 && chunk.received != chunk.length) {
+        ok = false;
+    }
+
+    const QByteArray expectedHash = reply->rawHeader("X-Chunk-Hash");
+    if (ok && !expectedHash.isEmpty()) {
+        const qint64 responseBytes = chunk.received - chunk.requestStart;
+        m_File->seek(chunk.offset + chunk.requestStart);
+        const QByteArray written = m_File->read(responseBytes);
+        if (chunkHashHex(written.constData(), written.size()).toLatin1() != expectedHash.toLower()) {
+            ClipboardLog::warn("ClipboardSync: blob chunk %d failed hash check; refetching", index);
+            m_Transferred -= responseBytes;
+            chunk.received = chunk.requestStart;
+            ok = false;
+        }
+    }
+
+    if (!ok) {
+        if (httpStatus(reply) == 404 || chunk.attempts >= MAX_CHUNK_ATTEMPTS) {
+            fail(reply->error() != QNetworkReply::NoError
+                     ? reply->errorString().toUtf8().constData()
+                     : "chunk incomplete");
+            return;
+        }
+
+        ClipboardLog::debug("ClipboardSync: blob chunk %d download attempt %d failed at %lld/%lld bytes",
+                     index,
+                     chunk.attempts,
+                     static_cast<long long>(chunk.received),
+                     static_cast<long long>(chunk.length));
+        deferRetry(chunk);
+        pumpDownloadChunks();
+        return;
+    }
+
+    if (chunk.length < 0) {
+        chunk.length = chunk.received;
+    }
+    chunk.done = true;
+    pumpDownloadChunks();
+}
+
+std::unique_ptr<QTemporaryFile> ClipboardBlobTransfer::takeDownloadedFile()
+{
+    if (m_Upload || m_File == nullptr || !m_File->seek(0)) {
+        return nullptr;
+    }
+
+    std::unique_ptr<QTemporaryFile> file(m_File);
+    m_File = nullptr;
+    file->setParent(nullptr);
+    return file;
+}
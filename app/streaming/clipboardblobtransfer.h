@@ -0,0 +1,142 @@
+#pragma once
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QObject>
+#include <QPointer>
+#include <QSslConfiguration>
+#include <QString>
+#include <QUrl>
+#include <QVector>
+
+#include <cstdint>
+#include <memory>
+
+class QNetworkAccessManager;
+class QNetworkReply;
+class QNetworkRequest;
+class QTemporaryFile;
+class QTimer;
+
+// ClipboardBlobTransfer moves one clipboard blob between the helper and the
+// host's /api/v1/clipboard/blob endpoints. Large payloads are split into
+// CHUNK_BYTES pieces with at most MAX_PARALLEL_CHUNKS requests in flight, so
+// a dropped connection only costs the chunks that were in flight rather
+// than the whole transfer.
+//
+// Upload (chunked protocol, falls back to a single POST /blob when the host
+// answers 404/405/501 to the session request):
+//   POST /blob/upload                {"mime","size","chunkSize","hash"}
+//                                    -> {"upload":"<uid>","received":[i...]}
+//   PUT  /blob/upload/<uid>/<index>  X-Chunk-Hash: <xxh64 hex>, raw bytes
+//   POST /blob/upload/<uid>/commit   -> {"id":"<blob id>"}
+// "received" lists chunks the host already holds for an upload with the same
+// hash, which lets a retried copy resume from the last acknowledged chunk.
+//
+// Download: ranged GET /blob/<id> requests written straight into a temporary
+// file at their offsets. A failed range is retried from the last byte
+// received. If the host answers a ranged request with 200, the transfer
+// degrades to a single streamed GET. An X-Chunk-Hash response header, when
+// present, covers the bytes of that response and is verified on completion.
+//
+// A failed chunk waits out its own backoff before it is sent again, while
+// the other chunks keep going.
+//
+// Both directions go through a temporary file: uploads spool the payload
+// once and read each chunk from disk as it is sent, and downloads hand the
+// file itself to the caller, so the transfer never holds more than the
+// chunks currently in flight.
+//
+// Must be used on the thread that owns the QNetworkAccessManager.
+class ClipboardBlobTransfer : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr qint64 CHUNK_BYTES = 1024 * 1024;
+    static constexpr int    MAX_PARALLEL_CHUNKS = 3;
+    static constexpr int    MAX_CHUNK_ATTEMPTS = 4;
+    // A chunk's nth retry waits n times this long.
+    static constexpr int    RETRY_BACKOFF_MS = 250;
+    // Below this a single request is cheaper than session setup.
+    static constexpr qint64 CHUNKED_THRESHOLD = 2 * CHUNK_BYTES;
+    static constexpr int    PROGRESS_INTERVAL_MS = 250;
+
+    // blobUrl is the host's .../api/v1/clipboard/blob endpoint; sslConfig
+    // carries the paired client identity for the mTLS handshake.
+    ClipboardBlobTransfer(QNetworkAccessManager* nam,
+                          const QUrl& blobUrl,
+                          const QSslConfiguration& sslConfig,
+                          QObject* parent = nullptr);
+    ~ClipboardBlobTransfer() override;
+
+    // Writes payload to a temporary file; the caller's copy can go right away.
+    void startUpload(const QByteArray& payload, uint64_t payloadHash, const QString& mime);
+    void startDownload(const QString& id, qint64 advertisedSize, qint64 maxBytes);
+    void abort();
+
+    // Valid after downloadFinished(true). Returns the open temporary file
+    // positioned at the start, with no parent; it is removed when deleted.
+    std::unique_ptr<QTemporaryFile> takeDownloadedFile();
+
+    static QString chunkHashHex(const char* data, qint64 length);
+
+signals:
+    void progress(qint64 transferred, qint64 total);
+    void uploadFinished(bool ok, QString blobId);
+    void downloadFinished(bool ok);
+
+private:
+    struct Chunk
+    {
+        qint64 offset = 0;
+        qint64 length = 0;
+        qint64 received = 0;  // downloads: bytes already written
+        qint64 requestStart = 0;  // downloads: chunk-relative start of the current request
+        int attempts = 0;
+        qint64 retryAtMs = 0;  // m_Clock time before which this chunk is not resent
+        bool done = false;
+        QPointer<QNetworkReply> reply;
+    };
+
+    QNetworkRequest makeRequest(const QString& tail) const;
+    void initChunks(qint64 total);
+    void reportProgress(bool force);
+    void fail(const char* reason);
+    QTemporaryFile* createTempFile();
+    void deferRetry(Chunk& chunk);
+    bool waitingForRetry(const Chunk& chunk, qint64& nextRetryMs) const;
+    void armRetryTimer(qint64 nextRetryMs);
+
+    void startSingleUpload();
+    void onUploadSessionReply(QNetworkReply* reply);
+    void pumpUploadChunks();
+    void onUploadChunkReply(int index, QNetworkReply* reply);
+    void commitUpload();
+
+    void startSingleDownload();
+    void pumpDownloadChunks();
+    void onDownloadChunkData(int index, QNetworkReply* reply);
+    void onDownloadChunkFinished(int index, QNetworkReply* reply);
+
+    QNetworkAccessManager* m_Nam;
+    QUrl m_BlobUrl;
+    QSslConfiguration m_SslConfig;
+
+    bool m_Upload = false;
+    bool m_Finished = false;
+    uint64_t m_PayloadHash = 0;
+    QString m_Mime;
+    QString m_UploadId;
+    QString m_BlobId;
+    qint64 m_Total = 0;
+    qint64 m_MaxBytes = 0;
+    qint64 m_Transferred = 0;
+    QVector<Chunk> m_Chunks;
+    int m_InFlight = 0;
+    QPointer<QNetworkReply> m_ControlReply;
+    QTemporaryFile* m_File = nullptr;
+    QTimer* m_RetryTimer;
+    QElapsedTimer m_Clock;
+    QElapsedTimer m_ProgressTimer;
+};
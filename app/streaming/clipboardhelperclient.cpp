@@ -3,6 +3,7 @@
 #include "backend/identitymanager.h"
 #include "backend/nvcomputer.h"
 #include "clipboardipc.h"
+#include "network/bandwidth.h"
 
 #include <QCoreApplication>
 #include <QDir>
@@ -101,7 +102,7 @@ void ClipboardHelperClient::stop()
     }
 
     if (m_Process->state() != QProcess::NotRunning) {
-        writeLine(ClipboardIpc::encodeStop(nextSequence()));
+        writeMessage(ClipboardIpc::encodeStop(nextSequence()));
         flushProcessInput();
         if (m_Process != nullptr) {
             m_Process->closeWriteChannel();
@@ -283,7 +284,7 @@ bool ClipboardHelperClient::sendCurrentConfig()
 
     m_HelperReady = false;
     m_ConfigSequence = nextSequence();
-    return writeLine(ClipboardIpc::encodeConfigure(m_ConfigSequence, config));
+    return writeMessage(ClipboardIpc::encodeConfigure(m_ConfigSequence, config));
 }
 
 void ClipboardHelperClient::flushQueuedHostFrames()
@@ -304,7 +305,7 @@ void ClipboardHelperClient::flushQueuedHostFrames()
     }
 
     while (!frames.isEmpty()) {
-        if (!writeLine(ClipboardIpc::encodeHostFrame(nextSequence(), frames.dequeue()))) {
+        if (!writeMessage(ClipboardIpc::encodeHostFrame(nextSequence(), frames.dequeue()))) {
             return;
         }
     }
@@ -317,21 +318,36 @@ void ClipboardHelperClient::readHelperOutput()
     }
 
     m_StdoutBuffer += m_Process->readAllStandardOutput();
-    if (m_StdoutBuffer.size() > ClipboardIpc::MAX_LINE_BYTES) {
-        handleProtocolError(QStringLiteral("helper stdout line exceeded protocol limit"));
-        m_StdoutBuffer.clear();
-        return;
-    }
 
-    int newlineIndex = -1;
-    while ((newlineIndex = m_StdoutBuffer.indexOf('\n')) >= 0) {
-        QByteArray line = m_StdoutBuffer.left(newlineIndex);
-        m_StdoutBuffer.remove(0, newlineIndex + 1);
-        while (line.endsWith('\r')) {
-            line.chop(1);
+    // Decode every complete message in place, then drop them from the
+    // buffer in one go. The header bounds each payload, so a partial
+    // message never grows the buffer beyond MAX_MESSAGE_BYTES.
+    qsizetype offset = 0;
+    while (offset < m_StdoutBuffer.size()) {
+        ClipboardIpc::Message message;
+        qsizetype consumed = 0;
+        QString error;
+        ClipboardIpc::DecodeResult result =
+                ClipboardIpc::decodeMessage(m_StdoutBuffer.constData() + offset,
+                                            m_StdoutBuffer.size() - offset,
+                                            message, consumed, error);
+        if (result == ClipboardIpc::DecodeResult::NeedMore) {
+            break;
+        }
+        if (result == ClipboardIpc::DecodeResult::Invalid) {
+            m_StdoutBuffer.clear();
+            handleProtocolError(error);
+            return;
+        }
+
+        offset += consumed;
+        processProtocolMessage(message);
+        if (m_Process == nullptr) {
+            // A message handler restarted the helper and reset the buffer.
+            return;
         }
-        processProtocolLine(line);
     }
+    m_StdoutBuffer.remove(0, offset);
 }
 
 void ClipboardHelperClient::readHelperErrors()
@@ -341,7 +357,7 @@ void ClipboardHelperClient::readHelperErrors()
     }
 
     m_StderrBuffer += m_Process->readAllStandardError();
-    if (m_StderrBuffer.size() > ClipboardIpc::MAX_LINE_BYTES) {
+    if (m_StderrBuffer.size() > ClipboardIpc::MAX_MESSAGE_BYTES) {
         SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
                     "Clipboard helper stderr line exceeded protocol limit; discarding buffered stderr");
         m_StderrBuffer.clear();
@@ -382,15 +398,8 @@ void ClipboardHelperClient::logHelperStderrLine(const QByteArray& line)
                  line.constData());
 }
 
-void ClipboardHelperClient::processProtocolLine(const QByteArray& line)
+void ClipboardHelperClient::processProtocolMessage(const ClipboardIpc::Message& message)
 {
-    ClipboardIpc::Message message;
-    QString error;
-    if (!ClipboardIpc::decodeLine(line, message, error)) {
-        handleProtocolError(error);
-        return;
-    }
-
     if (message.type == ClipboardIpc::MessageType::Ready) {
         if (message.sequence != m_ConfigSequence) {
             SDL_LogDebug(SDL_LOG_CATEGORY_APPLICATION,
@@ -405,7 +414,10 @@ void ClipboardHelperClient::processProtocolLine(const QByteArray& line)
 
     if (message.type == ClipboardIpc::MessageType::LocalFrame) {
         int rc = LiSendClipboardData(message.frame.constData(), message.frame.size());
-        if (rc != 0) {
+        if (rc == 0) {
+            BandwidthCalculator::instance()->addBytes(BandwidthCalculator::Clipboard, message.frame.size());
+        }
+        else {
             SDL_LogDebug(SDL_LOG_CATEGORY_APPLICATION,
                          "LiSendClipboardData(helper, %d bytes) -> %d",
                          static_cast<int>(message.frame.size()),
@@ -414,6 +426,11 @@ void ClipboardHelperClient::processProtocolLine(const QByteArray& line)
         return;
     }
 
+    if (message.type == ClipboardIpc::MessageType::Progress) {
+        emit transferProgress(message.upload, message.transferred, message.total);
+        return;
+    }
+
     if (message.type == ClipboardIpc::MessageType::Error) {
         SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
                     "Clipboard helper error [%s]: %s",
@@ -480,22 +497,20 @@ bool ClipboardHelperClient::flushProcessInput()
     return true;
 }
 
-bool ClipboardHelperClient::writeLine(const QByteArray& line)
+bool ClipboardHelperClient::writeMessage(const QByteArray& message)
 {
     if (m_Process == nullptr || m_Process->state() == QProcess::NotRunning) {
         return false;
     }
 
-    QByteArray out = line;
-    out.append('\n');
-    if (m_StdinBuffer.size() + out.size() > MAX_PENDING_STDIN_BYTES) {
+    if (m_StdinBuffer.size() + message.size() > MAX_PENDING_STDIN_BYTES) {
         SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
                     "Clipboard helper stdin backlog exceeded protocol limit");
         restartHelper("pipe backlog exceeded");
         return false;
     }
 
-    m_StdinBuffer.append(out);
+    m_StdinBuffer.append(message);
     return flushProcessInput();
 }
 
@@ -9,6 +9,10 @@
 class NvComputer;
 class QProcess;
 
+namespace ClipboardIpc {
+struct Message;
+}
+
 class ClipboardHelperClient : public QObject
 {
     Q_OBJECT
@@ -29,6 +33,10 @@ public:
 
     bool isRunning() const;
 
+signals:
+    // Forwarded from the helper while a large clipboard blob is moving.
+    void transferProgress(bool upload, qint64 transferred, qint64 total);
+
 private:
     static constexpr int MAX_QUEUED_HOST_FRAMES = 32;
     static constexpr int MAX_PENDING_STDIN_BYTES = 4 * 1024 * 1024;
@@ -44,11 +52,11 @@ private:
     void readHelperOutput();
     void readHelperErrors();
     void logHelperStderrLine(const QByteArray& line);
-    void processProtocolLine(const QByteArray& line);
+    void processProtocolMessage(const ClipboardIpc::Message& message);
     void handleProtocolError(const QString& error);
     void restartHelper(const char* reason);
     bool flushProcessInput();
-    bool writeLine(const QByteArray& line);
+    bool writeMessage(const QByteArray& message);
     quint32 nextSequence();
 
     NvComputer* m_Computer;
@@ -3,78 +3,117 @@
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonValue>
+#include <QtEndian>
+
+#include <cstring>
 
 namespace ClipboardIpc {
 namespace {
 
-QString typeToString(MessageType type)
+constexpr quint8 FRAME_MAGIC = 0xC1;
+constexpr int PROGRESS_PAYLOAD_BYTES = 1 + 8 + 8;
+
+bool isKnownType(quint8 type)
 {
-    switch (type) {
-    case MessageType::Configure:
-        return QStringLiteral("configure");
-    case MessageType::HostFrame:
-        return QStringLiteral("hostFrame");
-    case MessageType::LocalFrame:
-        return QStringLiteral("localFrame");
-    case MessageType::Ready:
-        return QStringLiteral("ready");
-    case MessageType::Error:
-        return QStringLiteral("error");
-    case MessageType::Stop:
-        return QStringLiteral("stop");
-    case MessageType::Unknown:
-        break;
-    }
-    return QStringLiteral("unknown");
+    return type >= static_cast<quint8>(MessageType::Configure) &&
+           type <= static_cast<quint8>(MessageType::Progress);
 }
 
-MessageType stringToType(const QString& type)
+// One allocation per message: header and payload are written in place.
+QByteArray encodeMessage(MessageType type, quint32 sequence, const char* payload, qsizetype payloadSize)
 {
-    if (type == QStringLiteral("configure")) {
-        return MessageType::Configure;
-    }
-    if (type == QStringLiteral("hostFrame")) {
-        return MessageType::HostFrame;
-    }
-    if (type == QStringLiteral("localFrame")) {
-        return MessageType::LocalFrame;
+    QByteArray out(HEADER_BYTES + payloadSize, Qt::Uninitialized);
+    uchar* p = reinterpret_cast<uchar*>(out.data());
+    p[0] = FRAME_MAGIC;
+    p[1] = static_cast<uchar>(PROTOCOL_VERSION);
+    p[2] = static_cast<uchar>(type);
+    p[3] = 0;
+    qToLittleEndian<quint32>(sequence, p + 4);
+    qToLittleEndian<quint32>(static_cast<quint32>(payloadSize), p + 8);
+    if (payloadSize > 0) {
+        memcpy(p + HEADER_BYTES, payload, static_cast<size_t>(payloadSize));
     }
-    if (type == QStringLiteral("ready")) {
-        return MessageType::Ready;
-    }
-    if (type == QStringLiteral("error")) {
-        return MessageType::Error;
-    }
-    if (type == QStringLiteral("stop")) {
-        return MessageType::Stop;
-    }
-    return MessageType::Unknown;
+    return out;
 }
 
-QByteArray encodeObject(QJsonObject obj)
+QByteArray encodeMessage(MessageType type, quint32 sequence, const QByteArray& payload = QByteArray())
 {
-    obj.insert(QStringLiteral("version"), PROTOCOL_VERSION);
-    return QJsonDocument(obj).toJson(QJsonDocument::Compact);
+    return encodeMessage(type, sequence, payload.constData(), payload.size());
 }
 
-QJsonObject baseMessage(MessageType type, quint32 sequence)
+QByteArray encodeJson(MessageType type, quint32 sequence, const QJsonObject& obj)
 {
-    QJsonObject obj;
-    obj.insert(QStringLiteral("type"), typeToString(type));
-    obj.insert(QStringLiteral("sequence"), static_cast<double>(sequence));
-    return obj;
+    return encodeMessage(type, sequence, QJsonDocument(obj).toJson(QJsonDocument::Compact));
 }
 
-bool readBase64Payload(const QJsonObject& obj, const QString& key, QByteArray& out)
+bool decodeJson(const char* payload, quint32 payloadLength, QJsonObject& outObject, QString& outError)
 {
-    QString encoded = obj.value(key).toString();
-    if (encoded.isEmpty()) {
-        out.clear();
+    QJsonParseError parseError{};
+    QJsonDocument doc = QJsonDocument::fromJson(QByteArray::fromRawData(payload, static_cast<int>(payloadLength)),
+                                                &parseError);
+    if (parseError.error != QJsonParseError::NoError || !doc.isObject()) {
+        outError = QStringLiteral("invalid JSON payload: %1").arg(parseError.errorString());
         return false;
     }
+    outObject = doc.object();
+    return true;
+}
 
-    out = QByteArray::fromBase64(encoded.toLatin1());
-    return !out.isEmpty();
+bool decodePayload(const char* payload, quint32 payloadLength, Message& outMessage, QString& outError)
+{
+    switch (outMessage.type) {
+    case MessageType::Configure:
+        {
+            QJsonObject host;
+            if (!decodeJson(payload, payloadLength, host, outError)) {
+                return false;
+            }
+            outMessage.config.address = host.value(QStringLiteral("address")).toString();
+            outMessage.config.httpsPort = static_cast<quint16>(host.value(QStringLiteral("httpsPort")).toInt());
+            outMessage.config.serverCertPem = host.value(QStringLiteral("serverCertPem")).toString().toLatin1();
+            outMessage.config.clientCertPem = host.value(QStringLiteral("clientCertPem")).toString().toLatin1();
+            outMessage.config.clientKeyPem = host.value(QStringLiteral("clientKeyPem")).toString().toLatin1();
+            return true;
+        }
+    case MessageType::HostFrame:
+    case MessageType::LocalFrame:
+        if (payloadLength == 0) {
+            outError = QStringLiteral("missing frame payload");
+            return false;
+        }
+        outMessage.frame = QByteArray(payload, static_cast<int>(payloadLength));
+        return true;
+    case MessageType::Error:
+        {
+            QJsonObject obj;
+            if (!decodeJson(payload, payloadLength, obj, outError)) {
+                return false;
+            }
+            outMessage.code = obj.value(QStringLiteral("code")).toString();
+            outMessage.text = obj.value(QStringLiteral("text")).toString();
+            return true;
+        }
+    case MessageType::Progress:
+        {
+            if (payloadLength != PROGRESS_PAYLOAD_BYTES) {
+                outError = QStringLiteral("invalid progress payload");
+                return false;
+            }
+            const uchar* p = reinterpret_cast<const uchar*>(payload);
+            outMessage.upload = p[0] != 0;
+            outMessage.transferred = qFromLittleEndian<qint64>(p + 1);
+            outMessage.total = qFromLittleEndian<qint64>(p + 9);
+            return true;
+        }
+    case MessageType::Ready:
+    case MessageType::Stop:
+        return true;
+    case MessageType::Unknown:
+        break;
+    }
+
+    outError = QStringLiteral("unhandled message type");
+    return false;
 }
 
 }
@@ -84,120 +123,117 @@ QByteArray encodeConfigure(quint32 sequence, const HostConfig& config)
     QJsonObject host;
     host.insert(QStringLiteral("address"), config.address);
     host.insert(QStringLiteral("httpsPort"), static_cast<int>(config.httpsPort));
-    host.insert(QStringLiteral("serverCertPem"),
-                QString::fromLatin1(config.serverCertPem.toBase64()));
-    host.insert(QStringLiteral("clientCertPem"),
-                QString::fromLatin1(config.clientCertPem.toBase64()));
-    host.insert(QStringLiteral("clientKeyPem"),
-                QString::fromLatin1(config.clientKeyPem.toBase64()));
-
-    QJsonObject obj = baseMessage(MessageType::Configure, sequence);
-    obj.insert(QStringLiteral("host"), host);
-    return encodeObject(obj);
+    host.insert(QStringLiteral("serverCertPem"), QString::fromLatin1(config.serverCertPem));
+    host.insert(QStringLiteral("clientCertPem"), QString::fromLatin1(config.clientCertPem));
+    host.insert(QStringLiteral("clientKeyPem"), QString::fromLatin1(config.clientKeyPem));
+    return encodeJson(MessageType::Configure, sequence, host);
 }
 
 QByteArray encodeHostFrame(quint32 sequence, const QByteArray& frame)
 {
-    QJsonObject obj = baseMessage(MessageType::HostFrame, sequence);
-    obj.insert(QStringLiteral("payload"), QString::fromLatin1(frame.toBase64()));
-    return encodeObject(obj);
+    return encodeMessage(MessageType::HostFrame, sequence, frame);
 }
 
 QByteArray encodeLocalFrame(quint32 sequence, const QByteArray& frame)
 {
-    QJsonObject obj = baseMessage(MessageType::LocalFrame, sequence);
-    obj.insert(QStringLiteral("payload"), QString::fromLatin1(frame.toBase64()));
-    return encodeObject(obj);
+    return encodeMessage(MessageType::LocalFrame, sequence, frame);
 }
 
 QByteArray encodeReady(quint32 sequence)
 {
-    return encodeObject(baseMessage(MessageType::Ready, sequence));
+    return encodeMessage(MessageType::Ready, sequence);
 }
 
 QByteArray encodeError(quint32 sequence, const QString& code, const QString& text)
 {
-    QJsonObject obj = baseMessage(MessageType::Error, sequence);
+    QJsonObject obj;
     obj.insert(QStringLiteral("code"), code);
     obj.insert(QStringLiteral("text"), text);
-    return encodeObject(obj);
+    return encodeJson(MessageType::Error, sequence, obj);
 }
 
 QByteArray encodeStop(quint32 sequence)
 {
-    return encodeObject(baseMessage(MessageType::Stop, sequence));
+    return encodeMessage(MessageType::Stop, sequence);
 }
 
-bool decodeLine(const QByteArray& line, Message& outMessage, QString& outError)
+QByteArray encodeProgress(quint32 sequence, bool upload, qint64 transferred, qint64 total)
 {
-    outMessage = Message();
-    outError.clear();
+    uchar payload[PROGRESS_PAYLOAD_BYTES];
+    payload[0] = upload ? 1 : 0;
+    qToLittleEndian<qint64>(transferred, payload + 1);
+    qToLittleEndian<qint64>(total, payload + 9);
+    return encodeMessage(MessageType::Progress, sequence,
+                         reinterpret_cast<const char*>(payload), PROGRESS_PAYLOAD_BYTES);
+}
 
-    if (line.size() > MAX_LINE_BYTES) {
-        outError = QStringLiteral("message line too large");
+bool readHeader(const char* header, quint32& outPayloadLength, QString& outError)
+{
+    const uchar* p = reinterpret_cast<const uchar*>(header);
+    if (p[0] != FRAME_MAGIC) {
+        outError = QStringLiteral("bad message magic");
         return false;
     }
-
-    QJsonParseError parseError{};
-    QJsonDocument doc = QJsonDocument::fromJson(line, &parseError);
-    if (parseError.error != QJsonParseError::NoError || !doc.isObject()) {
-        outError = QStringLiteral("invalid JSON message: %1").arg(parseError.errorString());
+    if (p[1] != PROTOCOL_VERSION) {
+        outError = QStringLiteral("unsupported protocol version");
         return false;
     }
-
-    QJsonObject obj = doc.object();
-    if (obj.value(QStringLiteral("version")).toInt() != PROTOCOL_VERSION) {
-        outError = QStringLiteral("unsupported protocol version");
+    if (!isKnownType(p[2])) {
+        outError = QStringLiteral("unknown message type");
         return false;
     }
 
-    outMessage.type = stringToType(obj.value(QStringLiteral("type")).toString());
-    QJsonValue sequenceValue = obj.value(QStringLiteral("sequence"));
-    double sequence = sequenceValue.toDouble(-1);
-    if (!sequenceValue.isDouble() ||
-            sequence < 0 ||
-            sequence > 4294967295.0 ||
-            static_cast<double>(static_cast<quint32>(sequence)) != sequence) {
-        outError = QStringLiteral("invalid sequence number");
+    outPayloadLength = qFromLittleEndian<quint32>(p + 8);
+    if (outPayloadLength > static_cast<quint32>(MAX_MESSAGE_BYTES - HEADER_BYTES)) {
+        outError = QStringLiteral("message too large");
         return false;
     }
-    outMessage.sequence = static_cast<quint32>(sequence);
-    if (outMessage.type == MessageType::Unknown) {
-        outError = QStringLiteral("unknown message type");
-        return false;
+    return true;
+}
+
+DecodeResult decodeMessage(const char* data, qsizetype size,
+                           Message& outMessage, qsizetype& outConsumed, QString& outError)
+{
+    outMessage = Message();
+    outConsumed = 0;
+    outError.clear();
+
+    if (size < HEADER_BYTES) {
+        return DecodeResult::NeedMore;
     }
 
-    switch (outMessage.type) {
-    case MessageType::Configure:
-        {
-            QJsonObject host = obj.value(QStringLiteral("host")).toObject();
-            outMessage.config.address = host.value(QStringLiteral("address")).toString();
-            outMessage.config.httpsPort = static_cast<quint16>(host.value(QStringLiteral("httpsPort")).toInt());
-            readBase64Payload(host, QStringLiteral("serverCertPem"), outMessage.config.serverCertPem);
-            readBase64Payload(host, QStringLiteral("clientCertPem"), outMessage.config.clientCertPem);
-            readBase64Payload(host, QStringLiteral("clientKeyPem"), outMessage.config.clientKeyPem);
-            return true;
-        }
-    case MessageType::HostFrame:
-    case MessageType::LocalFrame:
-        if (!readBase64Payload(obj, QStringLiteral("payload"), outMessage.frame)) {
-            outError = QStringLiteral("missing or invalid frame payload");
-            return false;
-        }
-        return true;
-    case MessageType::Error:
-        outMessage.code = obj.value(QStringLiteral("code")).toString();
-        outMessage.text = obj.value(QStringLiteral("text")).toString();
-        return true;
-    case MessageType::Ready:
-    case MessageType::Stop:
-        return true;
-    case MessageType::Unknown:
-        break;
+    quint32 payloadLength = 0;
+    if (!readHeader(data, payloadLength, outError)) {
+        return DecodeResult::Invalid;
+    }
+    if (size - HEADER_BYTES < static_cast<qsizetype>(payloadLength)) {
+        return DecodeResult::NeedMore;
     }
 
-    outError = QStringLiteral("unhandled message type");
-    return false;
+    const uchar* p = reinterpret_cast<const uchar*>(data);
+    outMessage.type = static_cast<MessageType>(p[2]);
+    outMessage.sequence = qFromLittleEndian<quint32>(p + 4);
+    if (!decodePayload(data + HEADER_BYTES, payloadLength, outMessage, outError)) {
+        return DecodeResult::Invalid;
+    }
+
+    outConsumed = HEADER_BYTES + static_cast<qsizetype>(payloadLength);
+    return DecodeResult::Complete;
+}
+
+bool decodeMessage(const QByteArray& bytes, Message& outMessage, QString& outError)
+{
+    qsizetype consumed = 0;
+    DecodeResult result = decodeMessage(bytes.constData(), bytes.size(), outMessage, consumed, outError);
+    if (result == DecodeResult::NeedMore) {
+        outError = QStringLiteral("truncated message");
+        return false;
+    }
+    if (result == DecodeResult::Complete && consumed != bytes.size()) {
+        outError = QStringLiteral("trailing bytes after message");
+        return false;
+    }
+    return result == DecodeResult::Complete;
 }
 
 }
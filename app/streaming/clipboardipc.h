@@ -3,19 +3,36 @@
 #include <QByteArray>
 #include <QString>
 
+// Binary framed protocol between the main process and the clipboard helper
+// over the helper's stdin/stdout pipes. Every message is a fixed header
+// followed by its payload:
+//
+//   u8  magic (0xC1)
+//   u8  protocol version
+//   u8  message type
+//   u8  reserved (0)
+//   u32 sequence        (little-endian)
+//   u32 payload length  (little-endian)
+//
+// HostFrame/LocalFrame payloads are the raw clipboard wire frame and
+// Progress is a fixed 17-byte record, so the hot path does no text encoding
+// at all. The rare control messages (Configure, Error) carry compact JSON.
+// A peer speaking another version is rejected on its first header.
 namespace ClipboardIpc {
 
-static constexpr int PROTOCOL_VERSION = 1;
-static constexpr int MAX_LINE_BYTES = 1024 * 1024;
+static constexpr int PROTOCOL_VERSION = 3;
+static constexpr int HEADER_BYTES = 12;
+static constexpr int MAX_MESSAGE_BYTES = 1024 * 1024;
 
 enum class MessageType {
-    Unknown,
-    Configure,
-    HostFrame,
-    LocalFrame,
-    Ready,
-    Error,
-    Stop,
+    Unknown = 0,
+    Configure = 1,
+    HostFrame = 2,
+    LocalFrame = 3,
+    Ready = 4,
+    Error = 5,
+    Stop = 6,
+    Progress = 7,
 };
 
 struct HostConfig {
@@ -33,6 +50,15 @@ struct Message {
     QByteArray frame;
     QString code;
     QString text;
+    bool upload = false;
+    qint64 transferred = 0;
+    qint64 total = 0;
+};
+
+enum class DecodeResult {
+    NeedMore,
+    Complete,
+    Invalid,
 };
 
 QByteArray encodeConfigure(quint32 sequence, const HostConfig& config);
@@ -41,7 +67,19 @@ QByteArray encodeLocalFrame(quint32 sequence, const QByteArray& frame);
 QByteArray encodeReady(quint32 sequence);
 QByteArray encodeError(quint32 sequence, const QString& code, const QString& text);
 QByteArray encodeStop(quint32 sequence);
+QByteArray encodeProgress(quint32 sequence, bool upload, qint64 transferred, qint64 total);
+
+// Validates a HEADER_BYTES header and returns the payload length that
+// follows it. Lets a blocking reader size its next read.
+bool readHeader(const char* header, quint32& outPayloadLength, QString& outError);
+
+// Decodes the message at the front of [data, data + size). On Complete,
+// outConsumed holds the number of bytes it occupied; NeedMore means the
+// buffer ends inside the message.
+DecodeResult decodeMessage(const char* data, qsizetype size,
+                           Message& outMessage, qsizetype& outConsumed, QString& outError);
 
-bool decodeLine(const QByteArray& line, Message& outMessage, QString& outError);
+// Decodes a buffer holding exactly one message.
+bool decodeMessage(const QByteArray& bytes, Message& outMessage, QString& outError);
 
 }
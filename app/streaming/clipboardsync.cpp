@@ -1,26 +1,39 @@
 #include "clipboardsync.h"
+#include "clipboardblobtransfer.h"
+#include "clipboardhash.h"
 #include "clipboardlogging.h"
 
 #include <QBuffer>
 #include <QClipboard>
 #include <QDateTime>
+#include <QElapsedTimer>
 #include <QGuiApplication>
 #include <QImage>
+#include <QImageReader>
+#include <QImageWriter>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QMetaObject>
 #include <QMimeData>
+#include <QMutexLocker>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QNetworkRequest>
+#include <QPointer>
 #include <QRegularExpression>
 #include <QSslConfiguration>
 #include <QSslError>
+#include <QTemporaryFile>
+#include <QThread>
+#include <QThreadPool>
 #include <QTimer>
 #include <QUrl>
+#include <QVariant>
+#include <QWaitCondition>
 #include <QtEndian>
 
 #include <cstring>
+#include <memory>
 
 #ifdef Q_OS_MACOS
 extern "C" int ClipboardHelperPasteboardChangeCount();
@@ -74,7 +87,228 @@ bool looksLikePngBytes(const QByteArray& bytes)
     return bytes.size() >= 8
             && memcmp(bytes.constData(), kMagic, sizeof(kMagic)) == 0;
 }
+
+const QString QT_IMAGE_MIME = QStringLiteral("application/x-qt-image");
+
+// Hashes a downloaded blob in place when the file can be mapped, so it is
+// not read into memory just to be remembered.
+uint64_t hashFile(QFile& file)
+{
+    const qint64 size = file.size();
+    if (uchar* mapped = size > 0 ? file.map(0, size) : nullptr) {
+        const uint64_t hash = ClipboardHash::hash64(mapped, static_cast<size_t>(size));
+        file.unmap(mapped);
+        return hash;
+    }
+
+    file.seek(0);
+    const QByteArray bytes = file.readAll();
+    return ClipboardHash::hash64(bytes.constData(), static_cast<size_t>(bytes.size()));
 }
+}
+
+// Outcome of fetching a deferred blob, shared between the fetch thread and
+// the promise waiting on it. The promise may be gone before the fetch ends.
+struct ClipboardPromiseFetch
+{
+    QMutex lock;
+    QWaitCondition finishedCondition;
+    bool finished = false;
+    bool timedOut = false;
+    bool cancelled = false;
+    // Owned by the GUI thread once published; null if the fetch failed.
+    std::shared_ptr<QTemporaryFile> file;
+    qint64 elapsedMs = 0;
+
+    // Returns false if the fetch is still running after timeoutMs.
+    bool wait(int timeoutMs, std::shared_ptr<QTemporaryFile>& outFile)
+    {
+        QMutexLocker locker(&lock);
+        if (!finished) {
+            finishedCondition.wait(&lock, static_cast<unsigned long>(timeoutMs));
+        }
+        if (!finished) {
+            return false;
+        }
+        outFile = file;
+        return true;
+    }
+};
+
+// Downloads one deferred blob with its own QNetworkAccessManager, so a paste
+// waiting on it never has to spin the GUI thread's event loop.
+class ClipboardPromiseFetchThread : public QThread
+{
+public:
+    ClipboardPromiseFetchThread(ClipboardSync* sync, const QUrl& url, const QSslConfiguration& sslConfig,
+                                const QString& id, qint64 advertisedSize,
+                                std::shared_ptr<ClipboardPromiseFetch> fetch)
+        : QThread(nullptr),
+          m_Sync(sync),
+          m_Url(url),
+          m_SslConfig(sslConfig),
+          m_Id(id),
+          m_AdvertisedSize(advertisedSize),
+          m_Fetch(std::move(fetch))
+    {
+        setObjectName("Clipboard Blob Fetch");
+    }
+
+private:
+    void run() override
+    {
+        QElapsedTimer timer;
+        timer.start();
+
+        bool finished = false;
+        bool ok = false;
+        std::unique_ptr<QTemporaryFile> file;
+        {
+            QNetworkAccessManager nam;
+            ClipboardBlobTransfer transfer(&nam, m_Url, m_SslConfig);
+            ClipboardSync* sync = m_Sync;
+            QObject::connect(&transfer, &ClipboardBlobTransfer::progress, sync, [sync](qint64 transferred, qint64 total) {
+                emit sync->transferProgress(false, transferred, total);
+            });
+            QObject::connect(&transfer, &ClipboardBlobTransfer::downloadFinished, &transfer, [&](bool success) {
+                finished = true;
+                ok = success;
+                quit();
+            });
+            QTimer::singleShot(ClipboardSync::LAZY_FETCH_TIMEOUT_MS, &transfer, [this]() {
+                quit();
+            });
+
+            transfer.startDownload(m_Id, m_AdvertisedSize, ClipboardSync::MAX_BLOB_BYTES);
+            if (!finished) {
+                exec();
+            }
+            if (ok) {
+                file = transfer.takeDownloadedFile();
+            }
+        }
+
+        // The promise reads the file and drops it on the GUI thread
+        if (file != nullptr) {
+            file->moveToThread(m_Sync->thread());
+        }
+
+        QMutexLocker locker(&m_Fetch->lock);
+        m_Fetch->finished = true;
+        m_Fetch->cancelled = !finished && isInterruptionRequested();
+        m_Fetch->timedOut = !finished && !m_Fetch->cancelled;
+        m_Fetch->file = std::move(file);
+        m_Fetch->elapsedMs = timer.elapsed();
+        m_Fetch->finishedCondition.wakeAll();
+    }
+
+    ClipboardSync* m_Sync;
+    QUrl m_Url;
+    QSslConfiguration m_SslConfig;
+    QString m_Id;
+    qint64 m_AdvertisedSize;
+    std::shared_ptr<ClipboardPromiseFetch> m_Fetch;
+};
+
+// Clipboard content for a host blob that has not been downloaded yet. Only
+// the formats are advertised. The first retrieveData() call starts fetching
+// the blob and waits briefly for it; a paste that arrives before the blob
+// gets nothing, and the next one uses the finished fetch.
+class ClipboardPromiseMimeData : public QMimeData
+{
+public:
+    ClipboardPromiseMimeData(ClipboardSync* sync, const QString& id, const QString& mime, qint64 advertisedSize)
+        : m_Sync(sync),
+          m_Id(id),
+          m_Mime(mime),
+          m_AdvertisedSize(advertisedSize)
+    {
+    }
+
+    ~ClipboardPromiseMimeData() override
+    {
+        if (!m_Sync.isNull()) {
+            m_Sync->onPromiseReleased(m_Id, m_AdvertisedSize, m_File != nullptr ? m_File->size() : 0, m_Pasted);
+        }
+    }
+
+    QStringList formats() const override
+    {
+        if (m_Mime == QStringLiteral("image/png")) {
+            return { m_Mime, QT_IMAGE_MIME };
+        }
+        return { QStringLiteral("text/plain") };
+    }
+
+protected:
+    QVariant retrieveData(const QString& format, QMetaType type) const override
+    {
+        if (!formats().contains(format) || !materialize()) {
+            return QVariant();
+        }
+
+        if (format == QT_IMAGE_MIME) {
+            // Decode from the file; the PNG bytes are read only if asked for
+            if (m_Image.isNull()) {
+                QImageReader reader(m_File.get(), "PNG");
+                if (!m_File->seek(0) || !reader.read(&m_Image)) {
+                    return QVariant();
+                }
+            }
+            m_Pasted += m_File->size();
+            return m_Image;
+        }
+
+        if (m_Bytes.isEmpty() && m_File->seek(0)) {
+            m_Bytes = m_File->readAll();
+        }
+        m_Pasted += m_Bytes.size();
+        if (format == QStringLiteral("text/plain") && type.id() == QMetaType::QString) {
+            return QString::fromUtf8(m_Bytes);
+        }
+        return m_Bytes;
+    }
+
+private:
+    bool materialize() const
+    {
+        if (m_Done) {
+            return m_File != nullptr;
+        }
+
+        // One fetch per promise: a paste may ask for several formats and
+        // each must not start over on a host that already failed once.
+        if (m_Fetch == nullptr) {
+            if (m_Sync.isNull()) {
+                return false;
+            }
+            m_Fetch = m_Sync->startPromiseFetch(m_Id, m_Mime, m_AdvertisedSize);
+            if (m_Fetch == nullptr) {
+                m_Done = true;
+                return false;
+            }
+        }
+
+        if (!m_Fetch->wait(ClipboardSync::LAZY_FETCH_WAIT_MS, m_File)) {
+            ClipboardLog::info("ClipboardSync: deferred blob %s is still downloading; paste again once it lands",
+                               m_Id.toUtf8().constData());
+            return false;
+        }
+        m_Done = true;
+        return m_File != nullptr;
+    }
+
+    QPointer<ClipboardSync> m_Sync;
+    QString m_Id;
+    QString m_Mime;
+    qint64 m_AdvertisedSize;
+    mutable std::shared_ptr<ClipboardPromiseFetch> m_Fetch;
+    mutable bool m_Done = false;
+    mutable std::shared_ptr<QTemporaryFile> m_File;
+    mutable QByteArray m_Bytes;
+    mutable QImage m_Image;
+    mutable qint64 m_Pasted = 0;
+};
 
 ClipboardSync::ClipboardSync(const ClipboardSyncHostContext& hostContext, QObject* parent)
     : QObject(parent),
@@ -86,11 +320,20 @@ ClipboardSync::ClipboardSync(const ClipboardSyncHostContext& hostContext, QObjec
 ClipboardSync::~ClipboardSync()
 {
     stop();
+    cancelPromiseFetch();
+
+    // Worker jobs post results back to this object, so none may outlive it.
+    if (m_ImagePool != nullptr) {
+        m_ImagePool->waitForDone();
+    }
 }
 
 void ClipboardSync::setHostContext(const ClipboardSyncHostContext& hostContext)
 {
     m_HostContext = hostContext;
+
+    // Blob ids are only meaningful to the host that issued them.
+    m_KnownBlobs.clear();
 }
 
 void ClipboardSync::start()
@@ -145,6 +388,7 @@ void ClipboardSync::stop()
 
     m_EchoCache.clear();
     m_PendingSelfWrites = 0;
+    cancelPromiseFetch();
 #ifdef Q_OS_MACOS
     if (m_PasteboardPollTimer != nullptr) {
         m_PasteboardPollTimer->stop();
@@ -250,7 +494,18 @@ void ClipboardSync::onIncomingFrame(QByteArray frame)
                         static_cast<long long>(size), static_cast<long long>(MAX_BLOB_BYTES));
             return;
         }
-        fetchRefAndApply(id, mime, size);
+        // Trust the REF descriptor's mime over Content-Type.
+        if (!isSupportedRefMime(mime)) {
+            ClipboardLog::info("ClipboardSync: ignoring inbound REF with unsupported mime '%s'",
+                        mime.toUtf8().constData());
+            return;
+        }
+        if (shouldPrefetchRef(size)) {
+            fetchRefAndApply(id, mime, size);
+        }
+        else {
+            publishPromise(id, mime, size);
+        }
         return;
     }
 
@@ -269,49 +524,77 @@ void ClipboardSync::applyInboundText(const QByteArray& payload)
         return;
     }
 
+    // Supersede any inbound PNG still decoding on the worker pool.
+    ++m_InboundGeneration;
+
     // Record hash *before* writing so the dataChanged echo we're about to
     // trigger is suppressed.
     uint64_t hash = hashBytes(payload);
     recordHash(hash);
-    ++m_PendingSelfWrites;
-    cb->setText(QString::fromUtf8(payload));
+
+    QMimeData* mime = new QMimeData();
+    mime->setText(QString::fromUtf8(payload));
+    publishMimeData(mime);
 }
 
 void ClipboardSync::applyInboundPng(const QByteArray& payload)
 {
-    QImage image;
-    if (!image.loadFromData(payload, "PNG") || image.isNull()) {
-        ClipboardLog::warn("ClipboardSync: dropping inbound PNG payload (decode failed, %d bytes)",
-                    static_cast<int>(payload.size()));
-        return;
-    }
+    const quint64 generation = ++m_InboundGeneration;
+    QPointer<ClipboardSync> self(this);
 
-    QClipboard* cb = QGuiApplication::clipboard();
-    if (cb == nullptr) {
-        return;
-    }
+    // Decoding a multi-megapixel PNG takes long enough to stall inbound
+    // frame processing, so do it on the pool and apply on the GUI thread.
+    imagePool()->start([self, generation, payload]() {
+        QImage image;
+        const bool decoded = image.loadFromData(payload, "PNG") && !image.isNull();
+        const uint64_t hash = hashBytes(payload);
 
-    // Hash the wire bytes (not the decoded pixels) so the echo we suppress
-    // matches what we'd re-encode if QClipboard hands the image straight back.
-    uint64_t hash = hashBytes(payload);
-    recordHash(hash);
-    ++m_PendingSelfWrites;
+        QMetaObject::invokeMethod(self.data(), [self, generation, payload, image, decoded, hash]() {
+            if (self.isNull() || !self->m_Active || generation != self->m_InboundGeneration) {
+                return;
+            }
 
-    QMimeData* mime = new QMimeData();
-    mime->setImageData(image);
-    // Provide raw PNG bytes too so apps that prefer image/png over CF_DIB
-    // (browsers, modern image editors) get the lossless copy verbatim.
-    // Intentionally NOT setting HTML: pasting a giant base64 data: URI into
-    // CF_HTML adds nothing useful (Office takes the bitmap path anyway) and
-    // some Windows clipboard hooks reject oversize CF_HTML, dropping the
-    // entire mime data set on the floor.
-    mime->setData(QStringLiteral("image/png"), payload);
-    cb->setMimeData(mime);
+            if (!decoded) {
+                ClipboardLog::warn("ClipboardSync: dropping inbound PNG payload (decode failed, %d bytes)",
+                            static_cast<int>(payload.size()));
+                return;
+            }
+
+            QClipboard* cb = QGuiApplication::clipboard();
+            if (cb == nullptr) {
+                return;
+            }
+
+            // Hash the wire bytes (not the decoded pixels) so the echo we suppress
+            // matches what we'd re-encode if QClipboard hands the image straight back.
+            self->recordHash(hash);
+
+            QMimeData* mime = new QMimeData();
+            mime->setImageData(image);
+            // Provide raw PNG bytes too so apps that prefer image/png over CF_DIB
+            // (browsers, modern image editors) get the lossless copy verbatim.
+            // Intentionally NOT setting HTML: pasting a giant base64 data: URI into
+            // CF_HTML adds nothing useful (Office takes the bitmap path anyway) and
+            // some Windows clipboard hooks reject oversize CF_HTML, dropping the
+            // entire mime data set on the floor.
+            mime->setData(QStringLiteral("image/png"), payload);
+            self->publishMimeData(mime);
+        }, Qt::QueuedConnection);
+    });
+}
+
+QThreadPool* ClipboardSync::imagePool()
+{
+    if (m_ImagePool == nullptr) {
+        m_ImagePool = new QThreadPool(this);
+        m_ImagePool->setMaxThreadCount(IMAGE_WORKER_THREADS);
+    }
+    return m_ImagePool;
 }
 
 bool ClipboardSync::encodeImageAsPng(const QImage& image,
                                      QByteArray& outPng,
-                                     const char* sourceDescription) const
+                                     const char* sourceDescription)
 {
     const qint64 pixels = static_cast<qint64>(image.width()) * image.height();
     if (pixels <= 0 || pixels > MAX_IMAGE_PIXELS) {
@@ -326,7 +609,17 @@ bool ClipboardSync::encodeImageAsPng(const QImage& image,
     outPng.reserve(64 * 1024);
     QBuffer buf(&outPng);
     buf.open(QIODevice::WriteOnly);
-    if (!image.save(&buf, "PNG") || outPng.isEmpty()) {
+
+    // The default zlib level spends most of its time on large screenshots
+    // for a few percent of size, so drop to level 1 once the image gets big.
+    // PNG compression is the zlib level directly. Don't go through quality,
+    // where anything above 89 maps to level 0 and stores the image raw.
+    QImageWriter writer(&buf, "PNG");
+    if (pixels >= FAST_PNG_PIXELS) {
+        writer.setCompression(1);
+    }
+
+    if (!writer.write(image) || outPng.isEmpty()) {
         ClipboardLog::warn("ClipboardSync: PNG encode failed for %s (%dx%d)",
                     sourceDescription,
                     image.width(),
@@ -339,6 +632,7 @@ bool ClipboardSync::encodeImageAsPng(const QImage& image,
 }
 
 void ClipboardSync::sendClipboardPng(const QByteArray& png,
+                                     uint64_t pngHash,
                                      const QString& sourceDescription)
 {
     const QByteArray sourceUtf8 = sourceDescription.isEmpty()
@@ -357,20 +651,18 @@ void ClipboardSync::sendClipboardPng(const QByteArray& png,
         // Out-of-band path. Record the underlying PNG hash before
         // upload so the echo we'll see when the host loops the REF
         // back (and we fetch the same bytes) is suppressed.
-        uint64_t hash = hashBytes(png);
-        if (seenRecently(hash)) {
+        if (seenRecently(pngHash)) {
             return;
         }
-        recordHash(hash);
-        uploadAndSendRef(png, QStringLiteral("image/png"));
+        recordHash(pngHash);
+        uploadAndSendRef(png, pngHash, QStringLiteral("image/png"));
         return;
     }
 
-    uint64_t hash = hashBytes(png);
-    if (seenRecently(hash)) {
+    if (seenRecently(pngHash)) {
         return;
     }
-    recordHash(hash);
+    recordHash(pngHash);
 
     QByteArray frame;
     if (encodeFrame(KIND_PNG, png, frame)) {
@@ -381,16 +673,31 @@ void ClipboardSync::sendClipboardPng(const QByteArray& png,
     }
 }
 
-bool ClipboardSync::tryExtractImageBytes(const QMimeData* mime,
-                                         const QStringList& preferredFormats,
-                                         QByteArray& outPng,
-                                         QString* outSourceDescription) const
+void ClipboardSync::snapshotImageSources(const QMimeData* mime,
+                                         ClipboardImageSnapshot& outSnapshot)
 {
+    outSnapshot = ClipboardImageSnapshot();
     if (mime == nullptr) {
-        return false;
+        return;
     }
 
-    QStringList candidateFormats = preferredFormats;
+    // Prefer raw image bytes attached by the producer (including our own
+    // applyInboundPng which sets "image/png" verbatim) BEFORE falling back
+    // to re-encoding mime->imageData(). This keeps echoed inbound PNGs
+    // byte-identical so the content hash matches the echo cache and we
+    // don't ping-pong the same image back to the host.
+    QStringList candidateFormats {
+        QStringLiteral("image/png"),
+        QStringLiteral("application/x-qt-windows-mime;value=\"PNG\""),
+        QStringLiteral("application/x-qt-windows-mime;value=\"image/png\""),
+        QStringLiteral("image/tiff"),
+        QStringLiteral("image/jpeg"),
+        QStringLiteral("image/jpg"),
+        QStringLiteral("image/bmp"),
+        QStringLiteral("image/webp"),
+        QStringLiteral("application/x-qt-image")
+    };
+
     for (const QString& format : mime->formats()) {
         if (!isImageLikeMimeFormat(format) || candidateFormats.contains(format, Qt::CaseInsensitive)) {
             continue;
@@ -400,30 +707,71 @@ bool ClipboardSync::tryExtractImageBytes(const QMimeData* mime,
 
     for (const QString& format : candidateFormats) {
         QByteArray bytes = mime->data(format);
-        if (bytes.isEmpty()) {
-            continue;
+        if (!bytes.isEmpty()) {
+            outSnapshot.formatBytes.append(qMakePair(format, bytes));
         }
+    }
 
-        QImage image;
-        if (!image.loadFromData(bytes)) {
-            continue;
+    if (mime->hasImage()) {
+        outSnapshot.imageData = qvariant_cast<QImage>(mime->imageData());
+    }
+
+    if (mime->hasUrls()) {
+        const QList<QUrl> urls = mime->urls();
+        for (const QUrl& url : urls) {
+            if (url.isLocalFile()) {
+                outSnapshot.localFiles.append(url.toLocalFile());
+            }
         }
+    }
+
+    if (mime->hasHtml()) {
+        outSnapshot.html = mime->html();
+    }
+}
+
+bool ClipboardSync::tryExtractImageBytes(const ClipboardImageSnapshot& snapshot,
+                                         QByteArray& outPng,
+                                         QString* outSourceDescription)
+{
+    for (const auto& entry : snapshot.formatBytes) {
+        const QString& format = entry.first;
+        const QByteArray& bytes = entry.second;
 
         if ((format.compare(QStringLiteral("image/png"), Qt::CaseInsensitive) == 0
                 || format.compare(QStringLiteral("application/x-qt-windows-mime;value=\"PNG\""), Qt::CaseInsensitive) == 0
                 || format.compare(QStringLiteral("application/x-qt-windows-mime;value=\"image/png\""), Qt::CaseInsensitive) == 0)
                 && looksLikePngBytes(bytes)) {
-            const qint64 pixels = static_cast<qint64>(image.width()) * image.height();
-            if (pixels <= 0 || pixels > MAX_IMAGE_PIXELS) {
-                ClipboardLog::info("ClipboardSync: image too large from mime %s (%dx%d), dropping",
-                            format.toUtf8().constData(),
-                            image.width(),
-                            image.height());
-                return false;
+            // Wire-ready PNG: the IHDR chunk is enough to enforce the pixel
+            // cap, so skip the full decode entirely.
+            QBuffer buffer;
+            buffer.setData(bytes);
+            buffer.open(QIODevice::ReadOnly);
+            QImageReader reader(&buffer, "PNG");
+            const QSize size = reader.size();
+            if (size.isValid()) {
+                const qint64 pixels = static_cast<qint64>(size.width()) * size.height();
+                if (pixels <= 0 || pixels > MAX_IMAGE_PIXELS) {
+                    ClipboardLog::info("ClipboardSync: image too large from mime %s (%dx%d), dropping",
+                                format.toUtf8().constData(),
+                                size.width(),
+                                size.height());
+                    return false;
+                }
+                outPng = bytes;
+                if (outSourceDescription != nullptr) {
+                    *outSourceDescription = format;
+                }
+                return true;
             }
-            outPng = bytes;
         }
-        else if (!encodeImageAsPng(image, outPng, format.toUtf8().constData())) {
+
+        QImage image;
+        if (!image.loadFromData(bytes)) {
+            continue;
+        }
+
+        if (!encodeImageAsPng(image, outPng, format.toUtf8().constData())) {
             continue;
         }
 
@@ -436,21 +784,12 @@ bool ClipboardSync::tryExtractImageBytes(const QMimeData* mime,
     return false;
 }
 
-bool ClipboardSync::tryExtractImageFromUrls(const QMimeData* mime,
+bool ClipboardSync::tryExtractImageFromUrls(const ClipboardImageSnapshot& snapshot,
                                             QByteArray& outPng,
-                                            QString* outSourceDescription) const
+                                            QString* outSourceDescription)
 {
-    if (mime == nullptr || !mime->hasUrls()) {
-        return false;
-    }
-
-    const QList<QUrl> urls = mime->urls();
-    for (const QUrl& url : urls) {
-        if (!url.isLocalFile()) {
-            continue;
-        }
-
-        QImage image(url.toLocalFile());
+    for (const QString& localFile : snapshot.localFiles) {
+        QImage image(localFile);
         if (image.isNull()) {
             continue;
         }
@@ -460,7 +799,7 @@ bool ClipboardSync::tryExtractImageFromUrls(const QMimeData* mime,
         }
 
         if (outSourceDescription != nullptr) {
-            *outSourceDescription = QStringLiteral("url:%1").arg(url.toLocalFile());
+            *outSourceDescription = QStringLiteral("url:%1").arg(localFile);
         }
         return true;
     }
@@ -468,15 +807,11 @@ bool ClipboardSync::tryExtractImageFromUrls(const QMimeData* mime,
     return false;
 }
 
-bool ClipboardSync::tryExtractImageFromHtml(const QMimeData* mime,
+bool ClipboardSync::tryExtractImageFromHtml(const ClipboardImageSnapshot& snapshot,
                                             QByteArray& outPng,
-                                            QString* outSourceDescription) const
+                                            QString* outSourceDescription)
 {
-    if (mime == nullptr || !mime->hasHtml()) {
-        return false;
-    }
-
-    const QString html = mime->html();
+    const QString& html = snapshot.html;
     if (html.isEmpty()) {
         return false;
     }
@@ -551,55 +886,31 @@ bool ClipboardSync::tryExtractImageFromHtml(const QMimeData* mime,
     return false;
 }
 
-bool ClipboardSync::extractClipboardPng(const QMimeData* mime,
+bool ClipboardSync::extractClipboardPng(const ClipboardImageSnapshot& snapshot,
                                         QByteArray& outPng,
-                                        QString* outSourceDescription) const
+                                        QString* outSourceDescription)
 {
     outPng.clear();
     if (outSourceDescription != nullptr) {
         outSourceDescription->clear();
     }
 
-    if (mime == nullptr) {
-        return false;
-    }
-
-    // Prefer raw image bytes attached by the producer (including our own
-    // applyInboundPng which sets "image/png" verbatim) BEFORE falling back
-    // to re-encoding mime->imageData(). This keeps echoed inbound PNGs
-    // byte-identical so the FNV-1a hash matches the echo cache and we
-    // don't ping-pong the same image back to the host.
-    const QStringList preferredFormats {
-        QStringLiteral("image/png"),
-        QStringLiteral("application/x-qt-windows-mime;value=\"PNG\""),
-        QStringLiteral("application/x-qt-windows-mime;value=\"image/png\""),
-        QStringLiteral("image/tiff"),
-        QStringLiteral("image/jpeg"),
-        QStringLiteral("image/jpg"),
-        QStringLiteral("image/bmp"),
-        QStringLiteral("image/webp"),
-        QStringLiteral("application/x-qt-image")
-    };
-
-    if (tryExtractImageBytes(mime, preferredFormats, outPng, outSourceDescription)) {
+    if (tryExtractImageBytes(snapshot, outPng, outSourceDescription)) {
         return true;
     }
 
-    if (mime->hasImage()) {
-        QImage image = qvariant_cast<QImage>(mime->imageData());
-        if (!image.isNull() && encodeImageAsPng(image, outPng, "mime imageData")) {
-            if (outSourceDescription != nullptr) {
-                *outSourceDescription = QStringLiteral("imageData");
-            }
-            return true;
+    if (!snapshot.imageData.isNull() && encodeImageAsPng(snapshot.imageData, outPng, "mime imageData")) {
+        if (outSourceDescription != nullptr) {
+            *outSourceDescription = QStringLiteral("imageData");
         }
+        return true;
     }
 
-    if (tryExtractImageFromUrls(mime, outPng, outSourceDescription)) {
+    if (tryExtractImageFromUrls(snapshot, outPng, outSourceDescription)) {
         return true;
     }
 
-    if (tryExtractImageFromHtml(mime, outPng, outSourceDescription)) {
+    if (tryExtractImageFromHtml(snapshot, outPng, outSourceDescription)) {
         return true;
     }
 
@@ -623,37 +934,74 @@ void ClipboardSync::onLocalClipboardChanged()
     }
 
     const QMimeData* mime = cb->mimeData();
+    if (mime != nullptr && mime == m_Promise.data()) {
+        // Host content we have not fetched; reading it would download the
+        // blob just to echo it back.
+        return;
+    }
+    const quint64 generation = ++m_OutboundGeneration;
 
     // Image takes precedence — some applications attach a fallback text label
     // (file path, alt text) alongside the bitmap; we want the picture, not the
     // path. To match HarmonyOS' record iteration behavior more closely, try
     // multiple extraction paths rather than only mime->imageData().
-    QByteArray png;
-    QString imageSourceDescription;
-    if (extractClipboardPng(mime, png, &imageSourceDescription)) {
-        sendClipboardPng(png, imageSourceDescription);
+    ClipboardImageSnapshot snapshot;
+    snapshotImageSources(mime, snapshot);
+    const QString text = cb->text();
+
+    if (snapshot.isEmpty()) {
+        sendClipboardText(text);
         return;
     }
 
-    if (mime != nullptr) {
-        bool hasImageLikeHints = mime->hasImage() || mime->hasUrls() || mime->hasHtml();
-        if (!hasImageLikeHints) {
-            for (const QString& format : mime->formats()) {
-                if (isImageLikeMimeFormat(format)) {
-                    hasImageLikeHints = true;
-                    break;
-                }
+    // Decode/encode can take hundreds of milliseconds for a 4K screenshot.
+    // Hand the snapshot to the pool and finish on the GUI thread; the text
+    // is captured now so the fallback matches the same clipboard contents.
+    QPointer<ClipboardSync> self(this);
+    imagePool()->start([self, generation, snapshot, text]() {
+        QByteArray png;
+        QString sourceDescription;
+        const bool extracted = extractClipboardPng(snapshot, png, &sourceDescription);
+        const uint64_t pngHash = extracted ? hashBytes(png) : 0;
+        if (!extracted) {
+            QStringList formats;
+            for (const auto& entry : snapshot.formatBytes) {
+                formats.append(entry.first);
             }
-        }
-
-        if (hasImageLikeHints) {
-            const QString formatsSummary = mime->formats().join(QStringLiteral(", "));
             ClipboardLog::debug("ClipboardSync: no transferable image found in clipboard formats [%s]",
-                         formatsSummary.toUtf8().constData());
+                         formats.join(QStringLiteral(", ")).toUtf8().constData());
         }
+
+        QMetaObject::invokeMethod(self.data(), [self, generation, extracted, png, pngHash, sourceDescription, text]() {
+            if (!self.isNull()) {
+                self->onOutboundImageReady(generation, extracted, png, pngHash, sourceDescription, text);
+            }
+        }, Qt::QueuedConnection);
+    });
+}
+
+void ClipboardSync::onOutboundImageReady(quint64 generation,
+                                         bool extracted,
+                                         const QByteArray& png,
+                                         uint64_t pngHash,
+                                         const QString& sourceDescription,
+                                         const QString& fallbackText)
+{
+    if (!m_Active || generation != m_OutboundGeneration) {
+        // The clipboard changed again while we were encoding.
+        return;
     }
 
-    QString text = cb->text();
+    if (extracted) {
+        sendClipboardPng(png, pngHash, sourceDescription);
+        return;
+    }
+
+    sendClipboardText(fallbackText);
+}
+
+void ClipboardSync::sendClipboardText(const QString& text)
+{
     if (text.isEmpty()) {
         return;
     }
@@ -683,7 +1031,7 @@ void ClipboardSync::onLocalClipboardChanged()
         // Sunshine's blob endpoint intentionally accepts only a bare
         // RFC 6838 type/subtype without parameters. KIND_TEXT already
         // defines the blob bytes as UTF-8.
-        uploadAndSendRef(utf8, QStringLiteral("text/plain"));
+        uploadAndSendRef(utf8, hash, QStringLiteral("text/plain"));
         return;
     }
 
@@ -779,13 +1127,37 @@ void ClipboardSync::recordHash(uint64_t hash)
 
 uint64_t ClipboardSync::hashBytes(const QByteArray& bytes)
 {
-    // FNV-1a 64-bit. Cheap and good enough for echo suppression.
-    uint64_t h = 0xcbf29ce484222325ULL;
-    for (int i = 0; i < bytes.size(); ++i) {
-        h ^= static_cast<uint8_t>(bytes[i]);
-        h *= 0x100000001b3ULL;
+    return ClipboardHash::hash64(bytes.constData(), static_cast<size_t>(bytes.size()));
+}
+
+const ClipboardSync::KnownBlob* ClipboardSync::findKnownBlob(uint64_t hash, qint64 size, const QString& mime)
+{
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    while (!m_KnownBlobs.isEmpty() && (now - m_KnownBlobs.last().timestampMs) > BLOB_REUSE_TTL_MS) {
+        m_KnownBlobs.removeLast();
+    }
+
+    for (const KnownBlob& blob : m_KnownBlobs) {
+        if (blob.hash == hash && blob.size == size && blob.mime == mime) {
+            return &blob;
+        }
+    }
+    return nullptr;
+}
+
+void ClipboardSync::rememberBlob(uint64_t hash, qint64 size, const QString& mime, const QString& id)
+{
+    for (int i = 0; i < m_KnownBlobs.size(); ++i) {
+        if (m_KnownBlobs[i].hash == hash && m_KnownBlobs[i].size == size && m_KnownBlobs[i].mime == mime) {
+            m_KnownBlobs.removeAt(i);
+            break;
+        }
+    }
+
+    m_KnownBlobs.prepend(KnownBlob { hash, size, mime, id, QDateTime::currentMSecsSinceEpoch() });
+    while (m_KnownBlobs.size() > BLOB_REUSE_MAX) {
+        m_KnownBlobs.removeLast();
     }
-    return h;
 }
 
 QNetworkAccessManager* ClipboardSync::nam()
@@ -825,112 +1197,232 @@ bool ClipboardSync::buildBlobUrl(const QString& tail, QUrl& outUrl) const
     return outUrl.isValid();
 }
 
-void ClipboardSync::uploadAndSendRef(const QByteArray& payload, const QString& mime)
+void ClipboardSync::uploadAndSendRef(const QByteArray& payload, uint64_t payloadHash, const QString& mime)
 {
+    // The host already holds these exact bytes (we uploaded or fetched them
+    // recently), so point it at the existing blob instead of re-POSTing.
+    if (const KnownBlob* known = findKnownBlob(payloadHash, payload.size(), mime)) {
+        ClipboardLog::debug("ClipboardSync: reusing host blob %s for %lld bytes",
+                     known->id.toUtf8().constData(),
+                     static_cast<long long>(payload.size()));
+        sendRefFrame(known->id, mime, payload.size());
+        return;
+    }
+
     QUrl url;
     if (!buildBlobUrl(QStringLiteral("/blob"), url)) {
         ClipboardLog::warn("ClipboardSync: cannot upload blob (no host context)");
         return;
     }
 
-    QNetworkRequest req(url);
-    req.setHeader(QNetworkRequest::ContentTypeHeader,
-                  QStringLiteral("application/octet-stream"));
-    req.setRawHeader("X-Clipboard-Mime", mime.toUtf8());
+    // A newer local copy supersedes whatever is still uploading.
+    if (m_ActiveUpload != nullptr) {
+        m_ActiveUpload->abort();
+        m_ActiveUpload->deleteLater();
+    }
+
+    auto transfer = new ClipboardBlobTransfer(nam(), url, blobSslConfiguration(), this);
+    m_ActiveUpload = transfer;
+    connect(transfer, &ClipboardBlobTransfer::progress, this, [this](qint64 transferred, qint64 total) {
+        emit transferProgress(true, transferred, total);
+    });
+    connect(transfer, &ClipboardBlobTransfer::uploadFinished, this,
+            [this, transfer, mime, payloadHash, payloadSize = payload.size()](bool ok, const QString& id) {
+        transfer->deleteLater();
+        if (m_ActiveUpload == transfer) {
+            m_ActiveUpload = nullptr;
+        }
+        if (!ok) {
+            return;
+        }
+
+        rememberBlob(payloadHash, payloadSize, mime, id);
+        sendRefFrame(id, mime, payloadSize);
+    });
+    transfer->startUpload(payload, payloadHash, mime);
+}
+
+QSslConfiguration ClipboardSync::blobSslConfiguration() const
+{
     // Sunshine pins clipboard blob endpoint to its mTLS server (cert
     // required); reuse the same paired client identity nvhttp does, or
     // every fetch/upload fails with a TLS 'certificate required' alert.
     QSslConfiguration sslConfig(QSslConfiguration::defaultConfiguration());
     sslConfig.setLocalCertificate(m_HostContext.clientCertificate);
     sslConfig.setPrivateKey(m_HostContext.clientPrivateKey);
-    req.setSslConfiguration(sslConfig);
-
-    QNetworkReply* reply = nam()->post(req, payload);
-    connect(reply, &QNetworkReply::finished, this, [this, reply, mime, payloadSize = payload.size()]() {
-        reply->deleteLater();
-        if (reply->error() != QNetworkReply::NoError) {
-            ClipboardLog::warn("ClipboardSync: blob upload failed: %s",
-                        reply->errorString().toUtf8().constData());
-            return;
-        }
-        QJsonParseError jerr{};
-        QJsonDocument doc = QJsonDocument::fromJson(reply->readAll(), &jerr);
-        if (jerr.error != QJsonParseError::NoError || !doc.isObject()) {
-            ClipboardLog::warn("ClipboardSync: blob upload response not JSON: %s",
-                        jerr.errorString().toUtf8().constData());
-            return;
-        }
-        QString id = doc.object().value(QStringLiteral("id")).toString();
-        if (id.isEmpty()) {
-            ClipboardLog::warn("ClipboardSync: blob upload response missing id");
-            return;
-        }
+    return sslConfig;
+}
 
-        QJsonObject meta;
-        meta.insert(QStringLiteral("id"), id);
-        meta.insert(QStringLiteral("mime"), mime);
-        meta.insert(QStringLiteral("size"), static_cast<double>(payloadSize));
-        QByteArray json = QJsonDocument(meta).toJson(QJsonDocument::Compact);
+void ClipboardSync::sendRefFrame(const QString& id, const QString& mime, qint64 size)
+{
+    QJsonObject meta;
+    meta.insert(QStringLiteral("id"), id);
+    meta.insert(QStringLiteral("mime"), mime);
+    meta.insert(QStringLiteral("size"), static_cast<double>(size));
+    QByteArray json = QJsonDocument(meta).toJson(QJsonDocument::Compact);
 
-        QByteArray frame;
-        if (!encodeFrame(KIND_REF, json, frame)) {
-            return;
-        }
-        ClipboardLog::debug("ClipboardSync: outbound REF frame queued (%d bytes)",
-                     static_cast<int>(frame.size()));
-        emit outboundFrame(frame);
-    });
+    QByteArray frame;
+    if (!encodeFrame(KIND_REF, json, frame)) {
+        return;
+    }
+    ClipboardLog::debug("ClipboardSync: outbound REF frame queued (%d bytes)",
+                 static_cast<int>(frame.size()));
+    emit outboundFrame(frame);
 }
 
 void ClipboardSync::fetchRefAndApply(const QString& id, const QString& mime, qint64 advertisedSize)
 {
     QUrl url;
-    if (!buildBlobUrl(QStringLiteral("/blob/") + id, url)) {
+    if (!buildBlobUrl(QStringLiteral("/blob"), url)) {
         ClipboardLog::warn("ClipboardSync: cannot fetch blob (no host context)");
         return;
     }
 
-    QNetworkRequest req(url);
-    QSslConfiguration sslConfig(QSslConfiguration::defaultConfiguration());
-    sslConfig.setLocalCertificate(m_HostContext.clientCertificate);
-    sslConfig.setPrivateKey(m_HostContext.clientPrivateKey);
-    req.setSslConfiguration(sslConfig);
-
-    QNetworkReply* reply = nam()->get(req);
-    connect(reply, &QNetworkReply::finished, this, [this, reply, mime, advertisedSize]() {
-        reply->deleteLater();
-        if (reply->error() != QNetworkReply::NoError) {
-            ClipboardLog::warn("ClipboardSync: blob fetch failed: %s",
-                        reply->errorString().toUtf8().constData());
-            return;
+    // Only the most recent host copy matters.
+    if (m_ActiveDownload != nullptr) {
+        m_ActiveDownload->abort();
+        m_ActiveDownload->deleteLater();
+    }
+
+    auto transfer = new ClipboardBlobTransfer(nam(), url, blobSslConfiguration(), this);
+    m_ActiveDownload = transfer;
+    connect(transfer, &ClipboardBlobTransfer::progress, this, [this](qint64 transferred, qint64 total) {
+        emit transferProgress(false, transferred, total);
+    });
+    connect(transfer, &ClipboardBlobTransfer::downloadFinished, this,
+            [this, transfer, id, mime, advertisedSize](bool ok) {
+        transfer->deleteLater();
+        if (m_ActiveDownload == transfer) {
+            m_ActiveDownload = nullptr;
         }
-        QByteArray bytes = reply->readAll();
-        if (bytes.isEmpty()) {
+        if (!ok) {
             return;
         }
-        // Defense: cap actual download size in case the server lied about
-        // advertised size or QNAM streamed past the declared length.
-        if (bytes.size() > MAX_BLOB_BYTES) {
-            ClipboardLog::warn("ClipboardSync: dropping fetched blob, actual size %lld exceeds %lld cap",
-                        static_cast<long long>(bytes.size()),
-                        static_cast<long long>(MAX_BLOB_BYTES));
+
+        // The transfer already enforced MAX_BLOB_BYTES and the advertised
+        // size while streaming into its temporary file.
+        std::unique_ptr<QTemporaryFile> file = transfer->takeDownloadedFile();
+        if (file == nullptr || file->size() == 0) {
             return;
         }
         // Hard-fail on advertised/actual mismatch when REF declared a size.
-        if (advertisedSize > 0 && bytes.size() != advertisedSize) {
+        if (advertisedSize > 0 && file->size() != advertisedSize) {
             ClipboardLog::warn("ClipboardSync: dropping fetched blob, size mismatch (got %lld, advertised %lld)",
-                        static_cast<long long>(bytes.size()),
+                        static_cast<long long>(file->size()),
                         static_cast<long long>(advertisedSize));
             return;
         }
-        // Trust the REF descriptor's mime over Content-Type.
+
+        // Both formats are published with their raw bytes, so read it once here
+        const QByteArray bytes = file->readAll();
+        file.reset();
+        rememberBlob(hashBytes(bytes), bytes.size(), mime, id);
+
         if (mime == QStringLiteral("image/png")) {
             applyInboundPng(bytes);
-        } else if (mime.startsWith(QStringLiteral("text/"))) {
-            applyInboundText(bytes);
         } else {
-            ClipboardLog::info("ClipboardSync: dropping fetched blob with unsupported mime '%s'",
-                        mime.toUtf8().constData());
+            applyInboundText(bytes);
         }
     });
+    transfer->startDownload(id, advertisedSize, MAX_BLOB_BYTES);
+}
+
+void ClipboardSync::publishMimeData(QMimeData* mime)
+{
+    QClipboard* cb = QGuiApplication::clipboard();
+    if (cb == nullptr) {
+        delete mime;
+        return;
+    }
+
+    ++m_PendingSelfWrites;
+    cb->setMimeData(mime);
+}
+
+void ClipboardSync::publishPromise(const QString& id, const QString& mime, qint64 advertisedSize)
+{
+    // Supersede a prefetch or PNG decode for an older host copy.
+    ++m_InboundGeneration;
+    if (m_ActiveDownload != nullptr) {
+        m_ActiveDownload->abort();
+        m_ActiveDownload->deleteLater();
+    }
+    cancelPromiseFetch();
+
+    auto promise = new ClipboardPromiseMimeData(this, id, mime, advertisedSize);
+    m_Promise = promise;
+    m_LazyBytesAdvertised += qMax<qint64>(advertisedSize, 0);
+    ClipboardLog::debug("ClipboardSync: deferring blob %s (%s, %lld bytes) until paste",
+                 id.toUtf8().constData(),
+                 mime.toUtf8().constData(),
+                 static_cast<long long>(advertisedSize));
+    publishMimeData(promise);
+}
+
+std::shared_ptr<ClipboardPromiseFetch> ClipboardSync::startPromiseFetch(const QString& id, const QString& mime,
+                                                                      qint64 advertisedSize)
+{
+    QUrl url;
+    if (!m_Active || !buildBlobUrl(QStringLiteral("/blob"), url)) {
+        ClipboardLog::warn("ClipboardSync: cannot fetch deferred blob %s (session ended)",
+                    id.toUtf8().constData());
+        return nullptr;
+    }
+
+    cancelPromiseFetch();
+
+    auto fetch = std::make_shared<ClipboardPromiseFetch>();
+    auto thread = new ClipboardPromiseFetchThread(this, url, blobSslConfiguration(), id, advertisedSize, fetch);
+    connect(thread, &QThread::finished, this, [this, fetch, id, mime]() {
+        QMutexLocker locker(&fetch->lock);
+        if (fetch->cancelled) {
+            return;
+        }
+        if (fetch->file == nullptr) {
+            ClipboardLog::warn("ClipboardSync: deferred blob %s fetch %s after %lld ms",
+                        id.toUtf8().constData(),
+                        fetch->timedOut ? "timed out" : "failed",
+                        static_cast<long long>(fetch->elapsedMs));
+            return;
+        }
+
+        const qint64 size = fetch->file->size();
+        m_LazyBytesFetched += size;
+        rememberBlob(hashFile(*fetch->file), size, mime, id);
+        ClipboardLog::info("ClipboardSync: fetched deferred blob %s on paste (%lld bytes in %lld ms)",
+                    id.toUtf8().constData(),
+                    static_cast<long long>(size),
+                    static_cast<long long>(fetch->elapsedMs));
+    });
+    connect(thread, &QThread::finished, thread, &QObject::deleteLater);
+    m_PromiseFetch = thread;
+    thread->start();
+    return fetch;
+}
+
+void ClipboardSync::cancelPromiseFetch()
+{
+    if (m_PromiseFetch.isNull()) {
+        return;
+    }
+
+    // Ends the download early; the promise sees a failed fetch
+    m_PromiseFetch->requestInterruption();
+    m_PromiseFetch->quit();
+    m_PromiseFetch->wait();
+    m_PromiseFetch = nullptr;
+}
+
+void ClipboardSync::onPromiseReleased(const QString& id, qint64 advertisedSize, qint64 fetched, qint64 pasted)
+{
+    m_LazyBytesPasted += pasted;
+    ClipboardLog::info("ClipboardSync: deferred blob %s released: advertised %lld, fetched %lld, pasted %lld bytes "
+                "(session: advertised %lld, fetched %lld, pasted %lld)",
+                id.toUtf8().constData(),
+                static_cast<long long>(advertisedSize),
+                static_cast<long long>(fetched),
+                static_cast<long long>(pasted),
+                static_cast<long long>(m_LazyBytesAdvertised),
+                static_cast<long long>(m_LazyBytesFetched),
+                static_cast<long long>(m_LazyBytesPasted));
 }
@@ -2,20 +2,29 @@
 
 #include <QObject>
 #include <QByteArray>
+#include <QImage>
+#include <QList>
 #include <QMutex>
 #include <QPair>
+#include <QPointer>
 #include <QQueue>
 #include <QSslCertificate>
+#include <QSslConfiguration>
 #include <QSslKey>
 #include <QString>
 #include <QStringList>
 #include <cstdint>
+#include <memory>
 
-class QImage;
+class ClipboardBlobTransfer;
+class ClipboardPromiseMimeData;
+struct ClipboardPromiseFetch;
 class QMimeData;
 class QNetworkAccessManager;
 class QNetworkReply;
 class QSslError;
+class QThread;
+class QThreadPool;
 class QTimer;
 
 struct ClipboardSyncHostContext
@@ -27,6 +36,23 @@ struct ClipboardSyncHostContext
     QSslKey clientPrivateKey;
 };
 
+// Image sources copied out of a QMimeData on the GUI thread. QMimeData and
+// QClipboard are GUI-thread only, but QByteArray/QImage/QString are
+// reentrant, so a snapshot can be decoded and PNG-encoded on a worker.
+struct ClipboardImageSnapshot
+{
+    QList<QPair<QString, QByteArray>> formatBytes; // in preference order
+    QImage imageData;
+    QStringList localFiles;
+    QString html;
+
+    bool isEmpty() const
+    {
+        return formatBytes.isEmpty() && imageData.isNull() &&
+               localFiles.isEmpty() && html.isEmpty();
+    }
+};
+
 // ClipboardSync owns the local clipboard state inside the clipboard helper
 // process. It implements the v1 wire format (u8 version=1, u8 kind, u32
 // token, u32 length, bytes payload, little-endian) used by the Limelight
@@ -40,6 +66,28 @@ struct ClipboardSyncHostContext
 // 65 KB single-packet cap are switched to KIND_REF transparently.
 // File / other payloads are accepted on the wire but ignored.
 //
+// Image decode and PNG encode never run on the GUI thread. Outbound images
+// are snapshotted from QMimeData and converted on a small private thread
+// pool; inbound PNGs are decoded there before being placed on the clipboard.
+// Generation counters discard results that a newer clipboard change has
+// already superseded.
+//
+// Blob transfers go through ClipboardBlobTransfer, which chunks large
+// payloads, retries failed chunks and streams downloads to a temp file.
+//
+// Deferred fetch: an inbound KIND_REF above LAZY_PREFETCH_BYTES (or of
+// unknown size) is not downloaded on arrival. The helper takes clipboard
+// ownership with a promise that only advertises the formats, and the blob
+// is fetched when a paste asks for the data through
+// QMimeData::retrieveData() (X11 selection conversion, Wayland data-offer
+// send, OLE GetData, pasteboard promise). The fetch runs on its own thread
+// and the paste only waits LAZY_FETCH_WAIT_MS for it, returning no data if
+// the blob hasn't landed yet. Smaller REFs are prefetched as before.
+//
+// Blob dedupe: every blob uploaded to (or fetched from) the host is
+// remembered by content hash for BLOB_REUSE_TTL_MS. Sending identical bytes
+// again references the existing blob id instead of re-POSTing it.
+//
 // Echo suppression: when we either write a payload to the local clipboard
 // (because the host pushed it) or send a payload to the host (because we
 // detected a local change), we record a (hash, timestamp_ms) pair into a
@@ -76,12 +124,37 @@ public:
     // Mirror the Android client's cap (32 Mpx) so a stray full-screen capture
     // doesn't try to PNG-encode a 100 MB bitmap and stall the GUI thread.
     static constexpr qint64  MAX_IMAGE_PIXELS = 32LL * 1024 * 1024;
+    // Images at/above this size are PNG-encoded at a fast zlib level. The
+    // result is a little larger, but encode time drops several-fold.
+    static constexpr qint64  FAST_PNG_PIXELS  = 4LL * 1024 * 1024;
+    static constexpr int     IMAGE_WORKER_THREADS = 2;
+    static constexpr int     BLOB_REUSE_TTL_MS = 5 * 60 * 1000;
+    static constexpr int     BLOB_REUSE_MAX    = 8;
+    // Inbound REFs up to this size are fetched on arrival; larger ones wait
+    // for a paste.
+    static constexpr qint64  LAZY_PREFETCH_BYTES = 1024 * 1024;
+    // Upper bound on how long a deferred blob fetch may run.
+    static constexpr int     LAZY_FETCH_TIMEOUT_MS = 20000;
+    // How long a paste blocks waiting for that fetch before returning no
+    // data. The fetch carries on, so the next paste can use it.
+    static constexpr int     LAZY_FETCH_WAIT_MS = 250;
 
     static constexpr bool shouldTransferOutOfBand(qint64 payloadBytes)
     {
         return payloadBytes >= INLINE_THRESHOLD;
     }
 
+    static constexpr bool shouldPrefetchRef(qint64 advertisedSize)
+    {
+        return advertisedSize > 0 && advertisedSize <= LAZY_PREFETCH_BYTES;
+    }
+
+    // Inbound REF payloads we know how to place on the clipboard.
+    static bool isSupportedRefMime(const QString& mime)
+    {
+        return mime == QStringLiteral("image/png") || mime.startsWith(QStringLiteral("text/"));
+    }
+
     explicit ClipboardSync(const ClipboardSyncHostContext& hostContext = ClipboardSyncHostContext(),
                            QObject* parent = nullptr);
     ~ClipboardSync() override;
@@ -105,6 +178,10 @@ signals:
     // run in a helper process without direct access to the Limelight session.
     void outboundFrame(QByteArray frame);
 
+    // Throttled progress of the blob transfer in flight, for the stream
+    // overlay toast.
+    void transferProgress(bool upload, qint64 transferred, qint64 total);
+
 private slots:
 #ifdef Q_OS_MACOS
     // QClipboard::dataChanged wrapper that keeps the native pasteboard
@@ -125,6 +202,8 @@ private slots:
     void onIncomingFrame(QByteArray frame);
 
 private:
+    friend class ClipboardPromiseMimeData;
+
     bool encodeFrame(uint8_t kind, const QByteArray& payload, QByteArray& outFrame) const;
     bool decodeFrame(const QByteArray& frame,
                      uint8_t& outKind,
@@ -136,36 +215,91 @@ private:
 
     static uint64_t hashBytes(const QByteArray& bytes);
 
-    bool encodeImageAsPng(const QImage& image,
-                          QByteArray& outPng,
-                          const char* sourceDescription) const;
+    // GUI thread: copy every image-bearing representation out of mime.
+    static void snapshotImageSources(const QMimeData* mime,
+                                     ClipboardImageSnapshot& outSnapshot);
+
+    // Worker-safe: these touch no QObject state.
+    static bool encodeImageAsPng(const QImage& image,
+                                 QByteArray& outPng,
+                                 const char* sourceDescription);
+    static bool extractClipboardPng(const ClipboardImageSnapshot& snapshot,
+                                    QByteArray& outPng,
+                                    QString* outSourceDescription = nullptr);
+    static bool tryExtractImageBytes(const ClipboardImageSnapshot& snapshot,
+                                     QByteArray& outPng,
+                                     QString* outSourceDescription);
+    static bool tryExtractImageFromUrls(const ClipboardImageSnapshot& snapshot,
+                                        QByteArray& outPng,
+                                        QString* outSourceDescription);
+    static bool tryExtractImageFromHtml(const ClipboardImageSnapshot& snapshot,
+                                        QByteArray& outPng,
+                                        QString* outSourceDescription);
+
+    QThreadPool* imagePool();
+    void onOutboundImageReady(quint64 generation,
+                              bool extracted,
+                              const QByteArray& png,
+                              uint64_t pngHash,
+                              const QString& sourceDescription,
+                              const QString& fallbackText);
     void sendClipboardPng(const QByteArray& png,
+                          uint64_t pngHash,
                           const QString& sourceDescription);
-    bool extractClipboardPng(const QMimeData* mime,
-                             QByteArray& outPng,
-                             QString* outSourceDescription = nullptr) const;
-    bool tryExtractImageBytes(const QMimeData* mime,
-                              const QStringList& preferredFormats,
-                              QByteArray& outPng,
-                              QString* outSourceDescription) const;
-    bool tryExtractImageFromUrls(const QMimeData* mime,
-                                 QByteArray& outPng,
-                                 QString* outSourceDescription) const;
-    bool tryExtractImageFromHtml(const QMimeData* mime,
-                                 QByteArray& outPng,
-                                 QString* outSourceDescription) const;
+    void sendClipboardText(const QString& text);
 
     // Out-of-band blob helpers. Both run on the GUI thread; the
     // QNetworkAccessManager event-loop callbacks land back on the GUI thread.
     bool buildBlobUrl(const QString& tail, QUrl& outUrl) const;
     QNetworkAccessManager* nam();
-    void uploadAndSendRef(const QByteArray& payload, const QString& mime);
+    QSslConfiguration blobSslConfiguration() const;
+    void uploadAndSendRef(const QByteArray& payload, uint64_t payloadHash, const QString& mime);
+    void sendRefFrame(const QString& id, const QString& mime, qint64 size);
     void fetchRefAndApply(const QString& id, const QString& mime, qint64 advertisedSize);
     void applyInboundText(const QByteArray& payload);
     void applyInboundPng(const QByteArray& payload);
 
+    // Takes ownership of mime.
+    void publishMimeData(QMimeData* mime);
+    void publishPromise(const QString& id, const QString& mime, qint64 advertisedSize);
+    // GUI thread, called from ClipboardPromiseMimeData::retrieveData().
+    // Starts downloading the blob on a fetch thread and returns at once.
+    std::shared_ptr<ClipboardPromiseFetch> startPromiseFetch(const QString& id, const QString& mime,
+                                                             qint64 advertisedSize);
+    // Stops the fetch thread, if any, and waits for it
+    void cancelPromiseFetch();
+    void onPromiseReleased(const QString& id, qint64 advertisedSize, qint64 fetched, qint64 pasted);
+
+    // Content-addressed record of blobs the host already holds.
+    struct KnownBlob
+    {
+        uint64_t hash;
+        qint64 size;
+        QString mime;
+        QString id;
+        qint64 timestampMs;
+    };
+    const KnownBlob* findKnownBlob(uint64_t hash, qint64 size, const QString& mime);
+    void rememberBlob(uint64_t hash, qint64 size, const QString& mime, const QString& id);
+
     ClipboardSyncHostContext m_HostContext;
     QNetworkAccessManager* m_Nam = nullptr;
+    QThreadPool* m_ImagePool = nullptr;
+    QPointer<ClipboardBlobTransfer> m_ActiveUpload;
+    QPointer<ClipboardBlobTransfer> m_ActiveDownload;
+
+    // Bumped on every local clipboard change / inbound apply so stale
+    // worker results are dropped instead of clobbering newer content.
+    quint64 m_OutboundGeneration = 0;
+    quint64 m_InboundGeneration = 0;
+
+    QList<KnownBlob> m_KnownBlobs; // most recent first
+
+    QPointer<QMimeData> m_Promise; // clipboard content we own but have not fetched
+    QPointer<QThread> m_PromiseFetch;
+    qint64 m_LazyBytesAdvertised = 0;
+    qint64 m_LazyBytesFetched = 0;
+    qint64 m_LazyBytesPasted = 0;
 
     bool m_Active = false;
     QQueue<QPair<uint64_t, qint64>> m_EchoCache; // (hash, timestamp_ms)
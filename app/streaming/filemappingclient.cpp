@@ -1,6 +1,7 @@
 #include "filemappingclient.h"
 
 #include "backend/identitymanager.h"
+#include "filemappingrpcchannel.h"
 #include "filemappingwebsocket.h"
 
 #include <QCryptographicHash>
@@ -281,7 +282,14 @@ bool FileMappingClient::connectSession(const Capability& capability, int timeout
         return false;
     }
 
-    m_NextRequestId = 1;
+    // From here on the socket belongs to the RPC channel's thread, so any
+    // thread can make requests and several can be in flight at once
+    m_Socket->disconnect(this);
+    m_Socket->setParent(nullptr);
+    m_Channel.reset(new FileMappingRpcChannel(m_Socket, m_WsBuffer));
+    m_Socket = nullptr;
+    m_WsBuffer.clear();
+
     m_SessionConnected = true;
     return true;
 }
@@ -394,8 +402,7 @@ FileMappingClient::RpcResult FileMappingClient::sendRpc(QJsonObject message, int
         return result;
     }
 
-    message.insert(QStringLiteral("id"), static_cast<double>(m_NextRequestId++));
-    if (!sendAndWait(message, result.reply, timeoutMs, &result.error)) {
+    if (!m_Channel->call(message, result.reply, timeoutMs, &result.error)) {
         return result;
     }
 
@@ -414,7 +421,7 @@ void FileMappingClient::closeSession()
     m_SessionConnected = false;
     m_WsBuffer.clear();
     m_LastHello = {};
-    m_NextRequestId = 1;
+    m_Channel.reset();
     if (m_Socket != nullptr) {
         m_Socket->close();
         delete m_Socket;
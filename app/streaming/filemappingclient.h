@@ -12,6 +12,9 @@
 #include <QString>
 #include <QUrl>
 
+#include <memory>
+
+class FileMappingRpcChannel;
 class QSslSocket;
 
 class FileMappingClient : public QObject
@@ -52,6 +55,9 @@ public:
     Capability fetchCapability(int timeoutMs = 3000);
     bool connectSession(const Capability& capability, int timeoutMs, QString* error = nullptr);
     QJsonObject lastHello() const { return m_LastHello; }
+
+    // Once connected, list(), stat() and read() may be called from any
+    // thread, and concurrent calls are pipelined over the one session
     RpcResult list(const QString& mappingId, const QString& path, int timeoutMs = 5000);
     RpcResult stat(const QString& mappingId, const QString& path, int timeoutMs = 5000);
     RpcResult read(const QString& mappingId,
@@ -79,7 +85,7 @@ private:
     QNetworkAccessManager* m_Nam = nullptr;
     QSslSocket* m_Socket = nullptr;
     QByteArray m_WsBuffer;
+    std::unique_ptr<FileMappingRpcChannel> m_Channel;
     QJsonObject m_LastHello;
-    quint64 m_NextRequestId = 1;
     bool m_SessionConnected = false;
 };
@@ -215,6 +215,13 @@ FileMapping::ReadResult FileMappingProtocolAdapter::read(const QString& mappingI
     return result;
 }
 
+int FileMappingProtocolAdapter::maxConcurrentRequests() const
+{
+    // Requests are pipelined over the session, so this only bounds how many
+    // replies the host is asked to queue up at once
+    return 8;
+}
+
 FileMappingClient& FileMappingProtocolAdapter::client()
 {
     if (!m_Client) {
@@ -23,6 +23,7 @@ public:
                                  quint64 offset,
                                  quint32 length,
                                  int timeoutMs) override;
+    int maxConcurrentRequests() const override;
 
 private:
     FileMappingClient& client();
@@ -0,0 +1,192 @@
+#include "filemappingrpcchannel.h"
+
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonParseError>
+#include <QJsonValue>
+#include <QMutexLocker>
+#include <QObject>
+#include <QSslSocket>
+#include <QThread>
+
+#include <utility>
+
+FileMappingRpcChannel::FileMappingRpcChannel(QSslSocket* socket, QByteArray buffered)
+    : m_Thread(new QThread()),
+      m_Context(new QObject()),
+      m_Socket(socket),
+      m_Buffer(std::move(buffered))
+{
+    m_Thread->setObjectName("File Mapping RPC Thread");
+    m_Context->moveToThread(m_Thread);
+    m_Socket->moveToThread(m_Thread);
+    m_Thread->start();
+
+    QMetaObject::invokeMethod(m_Context, [this]() {
+        QObject::connect(m_Socket, &QIODevice::readyRead, m_Context, [this]() {
+            readAvailable();
+        });
+        QObject::connect(m_Socket, &QAbstractSocket::disconnected, m_Context, [this]() {
+            failAll(QObject::tr("File mapping WebSocket session was closed"));
+        });
+
+        // Data that arrived before the move won't signal readyRead again
+        readAvailable();
+    }, Qt::BlockingQueuedConnection);
+}
+
+FileMappingRpcChannel::~FileMappingRpcChannel()
+{
+    QMetaObject::invokeMethod(m_Context, [this]() {
+        m_Socket->disconnect(m_Context);
+        m_Socket->close();
+        delete m_Socket;
+        m_Socket = nullptr;
+    }, Qt::BlockingQueuedConnection);
+
+    failAll(QObject::tr("File mapping WebSocket session was closed"));
+
+    m_Thread->quit();
+    m_Thread->wait();
+    delete m_Context;
+    delete m_Thread;
+}
+
+bool FileMappingRpcChannel::call(QJsonObject message, QJsonObject& reply, int timeoutMs, QString* error)
+{
+    QMutexLocker locker(&m_Lock);
+    if (!m_Error.isEmpty()) {
+        if (error != nullptr) {
+            *error = m_Error;
+        }
+        return false;
+    }
+
+    const quint64 requestId = m_NextRequestId++;
+    message.insert(QStringLiteral("id"), static_cast<double>(requestId));
+    m_Pending.insert(requestId, PendingCall());
+
+    // Queued while holding the lock, so requests go out in id order
+    const QByteArray payload = QJsonDocument(message).toJson(QJsonDocument::Compact);
+    QMetaObject::invokeMethod(m_Context, [this, payload]() {
+        write(payload);
+    }, Qt::QueuedConnection);
+
+    QElapsedTimer timer;
+    timer.start();
+    for (;;) {
+        if (m_Pending.value(requestId).done) {
+            const PendingCall call = m_Pending.take(requestId);
+            if (!call.error.isEmpty()) {
+                if (error != nullptr) {
+                    *error = call.error;
+                }
+                return false;
+            }
+            reply = call.reply;
+            return true;
+        }
+
+        const qint64 remainingMs = timeoutMs - timer.elapsed();
+        if (remainingMs <= 0) {
+            // A late reply to this id is dropped when it arrives
+            m_Pending.remove(requestId);
+            if (error != nullptr) {
+                *error = QObject::tr("Timed out waiting for WebSocket frame");
+            }
+            return false;
+        }
+        m_Replied.wait(&m_Lock, static_cast<unsigned long>(remainingMs));
+    }
+}
+
+void FileMappingRpcChannel::write(const QByteArray& payload)
+{
+    if (m_Socket == nullptr) {
+        return;
+    }
+
+    if (!FileMappingWebSocket::writeText(*m_Socket, payload)) {
+        failAll(m_Socket->errorString().isEmpty()
+                ? QObject::tr("Failed to write file mapping WebSocket message")
+                : m_Socket->errorString());
+    }
+}
+
+void FileMappingRpcChannel::readAvailable()
+{
+    m_Buffer += m_Socket->readAll();
+
+    for (;;) {
+        QByteArray payload;
+        bool needMore = false;
+        QList<QByteArray> pongPayloads;
+        const QString readError = m_Reader.read(m_Buffer, payload, needMore, &pongPayloads);
+        if (!readError.isEmpty()) {
+            failAll(readError);
+            return;
+        }
+        for (const QByteArray& pongPayload : pongPayloads) {
+            if (!FileMappingWebSocket::writePong(*m_Socket, pongPayload)) {
+                failAll(m_Socket->errorString().isEmpty()
+                        ? QObject::tr("Failed to write WebSocket pong")
+                        : m_Socket->errorString());
+                return;
+            }
+        }
+        if (needMore) {
+            return;
+        }
+
+        QJsonParseError parseError {};
+        const QJsonDocument doc = QJsonDocument::fromJson(payload, &parseError);
+        if (parseError.error != QJsonParseError::NoError || !doc.isObject()) {
+            // There's no telling whose reply this was
+            failAll(QObject::tr("WebSocket reply was not valid JSON: %1").arg(parseError.errorString()));
+            return;
+        }
+        complete(doc.object());
+    }
+}
+
+void FileMappingRpcChannel::complete(const QJsonObject& reply)
+{
+    QMutexLocker locker(&m_Lock);
+
+    auto call = m_Pending.end();
+    const QJsonValue id = reply.value(QStringLiteral("id"));
+    if (id.isDouble()) {
+        call = m_Pending.find(static_cast<quint64>(id.toDouble()));
+    }
+    else if (id.isString()) {
+        call = m_Pending.find(id.toString().toULongLong());
+    }
+    else {
+        // Requests are written in id order, so a host that doesn't echo
+        // the id is answering the oldest one still waiting
+        for (call = m_Pending.begin(); call != m_Pending.end() && call->done; ++call) {
+        }
+    }
+
+    // Otherwise it's a reply to a request that already timed out
+    if (call != m_Pending.end() && !call->done) {
+        call->done = true;
+        call->reply = reply;
+        m_Replied.wakeAll();
+    }
+}
+
+void FileMappingRpcChannel::failAll(const QString& error)
+{
+    QMutexLocker locker(&m_Lock);
+    if (m_Error.isEmpty()) {
+        m_Error = error;
+    }
+    for (PendingCall& call : m_Pending) {
+        if (!call.done) {
+            call.done = true;
+            call.error = m_Error;
+        }
+    }
+    m_Replied.wakeAll();
+}
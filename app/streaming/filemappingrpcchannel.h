@@ -0,0 +1,57 @@
+#pragma once
+
+#include "filemappingwebsocket.h"
+
+#include <QByteArray>
+#include <QJsonObject>
+#include <QMap>
+#include <QMutex>
+#include <QString>
+#include <QWaitCondition>
+
+class QObject;
+class QSslSocket;
+class QThread;
+
+// Carries file mapping RPCs over an established WebSocket session so that
+// callers on any thread can have requests in flight at once. Each request
+// is tagged with an id and written from the channel's own thread, which
+// owns the socket, and replies are matched back to their caller by id.
+// A host that omits the id is assumed to answer in order.
+class FileMappingRpcChannel
+{
+public:
+    // Takes over a connected socket, which must have no parent and belong
+    // to the calling thread. buffered is anything already read past the
+    // last reply.
+    FileMappingRpcChannel(QSslSocket* socket, QByteArray buffered);
+    ~FileMappingRpcChannel();
+
+    // Sends message with a fresh id and waits for its reply
+    bool call(QJsonObject message, QJsonObject& reply, int timeoutMs, QString* error = nullptr);
+
+private:
+    struct PendingCall {
+        bool done = false;
+        QJsonObject reply;
+        QString error;
+    };
+
+    // These run on the channel thread
+    void write(const QByteArray& payload);
+    void readAvailable();
+    void complete(const QJsonObject& reply);
+    void failAll(const QString& error);
+
+    QThread* m_Thread;
+    QObject* m_Context;
+    QSslSocket* m_Socket;
+    QByteArray m_Buffer;
+    FileMappingWebSocket::TextMessageReader m_Reader;
+
+    QMutex m_Lock;
+    QWaitCondition m_Replied;
+    QMap<quint64, PendingCall> m_Pending;
+    quint64 m_NextRequestId = 1;
+    QString m_Error;
+};
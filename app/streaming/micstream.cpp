@@ -1,5 +1,6 @@
 #include "micstream.h"
 #include "macpermissions.h"
+#include "network/bandwidth.h"
 
 #include <opus.h>
 #include <QAudio>
@@ -10,7 +11,6 @@
 #include <QElapsedTimer>
 #include <QIODevice>
 #include <QMediaDevices>
-#include <QQueue>
 #include <QThread>
 #include <QTimer>
 
@@ -23,33 +23,123 @@ void destroyMicrophoneStream(void);
 int sendMicrophoneOpusData(const unsigned char* opusData, int opusLength);
 }
 
-static const int PCM_FRAME_SAMPLES = 960; // 20 ms at 48 kHz
-static const int PCM_FRAME_SIZE = PCM_FRAME_SAMPLES * 2; // mono 16-bit
+static const int SAMPLE_RATE = 48000;
+static const int BYTES_PER_SAMPLE = 2; // mono 16-bit
+static const int DEFAULT_FRAME_DURATION_MS = 20;
 static const int MAX_OPUS_SIZE = 4000;
-static const int MAX_PENDING_PCM_FRAMES = 10;
-static const int MAX_PENDING_OPUS_FRAMES = 10;
-static const int MAX_ENCODE_FRAMES_PER_PASS = 4;
-static const int MAX_SEND_FRAMES_PER_PASS = 4;
+// sendMicrophoneOpusData() encrypts in 16-byte blocks and may read past the
+// payload length up to the next block boundary.
+static const int OPUS_SEND_ALIGNMENT = 16;
+static const int OPUS_SLOT_SIZE = ((MAX_OPUS_SIZE + OPUS_SEND_ALIGNMENT - 1) / OPUS_SEND_ALIGNMENT) * OPUS_SEND_ALIGNMENT;
+// Encoded packets rotate through a small fixed pool so the buffer handed to
+// sendMicrophoneOpusData() is not rewritten by the very next encode.
+static const int OPUS_PACKET_POOL_SIZE = 4;
+static const int MAX_PENDING_PCM_MS = 200;
+
+static int sanitizeFrameDurationMs(int frameDurationMs)
+{
+    switch (frameDurationMs) {
+    case 5:
+    case 10:
+    case 20:
+        return frameDurationMs;
+    default:
+        return DEFAULT_FRAME_DURATION_MS;
+    }
+}
+
+// Fixed-size byte ring holding captured PCM. The capacity is a whole number
+// of frames and the read position only ever advances by whole frames, so a
+// complete frame is always contiguous and can be handed to the encoder
+// without copying.
+class PcmRing
+{
+public:
+    PcmRing()
+        : m_capacity(0),
+          m_frameBytes(0),
+          m_readPos(0),
+          m_used(0)
+    {
+    }
+
+    void reset(int frameBytes, int frameCount)
+    {
+        m_frameBytes = frameBytes;
+        m_capacity = frameBytes * frameCount;
+        m_storage.resize(m_capacity);
+        clear();
+    }
+
+    void clear()
+    {
+        m_readPos = 0;
+        m_used = 0;
+    }
+
+    int used() const { return m_used; }
+    int freeBytes() const { return m_capacity - m_used; }
+    bool hasFrame() const { return m_used >= m_frameBytes; }
+
+    // Largest span that can be written without wrapping
+    char* writePointer(int& contiguousBytes)
+    {
+        const int writePos = (m_readPos + m_used) % m_capacity;
+        contiguousBytes = qMin(freeBytes(), m_capacity - writePos);
+        return m_storage.data() + writePos;
+    }
+
+    void commitWrite(int bytes)
+    {
+        Q_ASSERT(bytes <= freeBytes());
+        m_used += bytes;
+    }
+
+    const opus_int16* frontFrame() const
+    {
+        Q_ASSERT(hasFrame());
+        return reinterpret_cast<const opus_int16*>(m_storage.constData() + m_readPos);
+    }
+
+    void popFrames(int frames)
+    {
+        Q_ASSERT(frames * m_frameBytes <= m_used);
+        m_readPos = (m_readPos + frames * m_frameBytes) % m_capacity;
+        m_used -= frames * m_frameBytes;
+    }
+
+private:
+    QByteArray m_storage;
+    int m_capacity;
+    int m_frameBytes;
+    int m_readPos;
+    int m_used;
+};
 
 class MicStreamWorker : public QObject
 {
 public:
-    MicStreamWorker()
+    explicit MicStreamWorker(int frameDurationMs)
         : m_audioInput(nullptr),
           m_audioDevice(nullptr),
           m_encoder(nullptr),
-          m_sendTimer(nullptr),
           m_logTimer(nullptr),
+          m_frameDurationMs(sanitizeFrameDurationMs(frameDurationMs)),
+          m_frameSamples(SAMPLE_RATE / 1000 * m_frameDurationMs),
+          m_frameBytes(m_frameSamples * BYTES_PER_SAMPLE),
+          m_maxPendingFrames(MAX_PENDING_PCM_MS / m_frameDurationMs),
+          m_nextPacketSlot(0),
           m_streamInitialized(false),
-          m_audioContinuationPending(false),
           m_pcmBytes(0),
           m_opusBytes(0),
           m_sentBytes(0),
           m_sentPackets(0),
-          m_idleLoops(0),
+          m_failedPackets(0),
           m_droppedPcmFrames(0),
-          m_droppedOpusFrames(0),
-          m_maxAudioCallbackMs(0)
+          m_maxAudioCallbackMs(0),
+          m_totalLatencyUs(0),
+          m_maxLatencyUs(0),
+          m_maxEncodeUs(0)
     {
     }
 
@@ -60,7 +150,7 @@ public:
             return false;
 
         int err;
-        m_encoder = opus_encoder_create(48000, 1, OPUS_APPLICATION_VOIP, &err);
+        m_encoder = opus_encoder_create(SAMPLE_RATE, 1, OPUS_APPLICATION_VOIP, &err);
         if (err != OPUS_OK) {
             m_encoder = nullptr;
             return false;
@@ -68,7 +158,7 @@ public:
         opus_encoder_ctl(m_encoder, OPUS_SET_BITRATE(64000));
 
         QAudioFormat fmt;
-        fmt.setSampleRate(48000);
+        fmt.setSampleRate(SAMPLE_RATE);
         fmt.setChannelCount(1);
         fmt.setSampleFormat(QAudioFormat::Int16);
 
@@ -91,10 +181,16 @@ public:
         }
 
         qInfo() << "[MicStream] Using audio input device:" << device.description()
-                << "format=" << fmt.sampleRate() << "Hz" << fmt.channelCount() << "channels";
+                << "format=" << fmt.sampleRate() << "Hz" << fmt.channelCount() << "channels"
+                << "frame=" << m_frameDurationMs << "ms";
+
+        // The ring and packet pool are sized once here. Nothing on the
+        // capture -> encode -> send path allocates after this point.
+        m_pcmRing.reset(m_frameBytes, m_maxPendingFrames);
+        m_nextPacketSlot = 0;
 
         m_audioInput = new QAudioSource(device, fmt, this);
-        m_audioInput->setBufferSize(PCM_FRAME_SIZE * 4);
+        m_audioInput->setBufferSize(m_frameBytes * 4);
         connect(m_audioInput, &QAudioSource::stateChanged, this, [this](QAudio::State state) {
             qInfo() << "[MicStream] Audio state changed state=" << state
                     << "error=" << m_audioInput->error();
@@ -118,14 +214,7 @@ public:
         m_streamInitialized = true;
 
         resetStatistics();
-        m_partialBuffer.clear();
-        m_queue.clear();
-        m_audioContinuationPending = false;
-
-        m_sendTimer = new QTimer(this);
-        m_sendTimer->setInterval(20);
-        connect(m_sendTimer, &QTimer::timeout, this, &MicStreamWorker::sendLoop);
-        m_sendTimer->start();
+        m_clock.start();
 
         m_logTimer = new QTimer(this);
         m_logTimer->setInterval(5000);
@@ -142,8 +231,6 @@ public:
         if (!m_audioInput && !m_encoder && !m_streamInitialized)
             return;
 
-        if (m_sendTimer)
-            m_sendTimer->stop();
         if (m_logTimer)
             m_logTimer->stop();
         logSummary();
@@ -154,13 +241,16 @@ public:
             m_streamInitialized = false;
         }
 
-        m_partialBuffer.clear();
-        m_queue.clear();
-        m_audioContinuationPending = false;
+        m_pcmRing.clear();
         qInfo() << "[MicStream] stop";
     }
 
 private:
+    struct OpusPacketSlot
+    {
+        alignas(OPUS_SEND_ALIGNMENT) unsigned char data[OPUS_SLOT_SIZE];
+    };
+
     void cleanupAudioResources()
     {
         if (m_audioInput) {
@@ -175,6 +265,11 @@ private:
         }
     }
 
+    qint64 bytesToNs(qint64 bytes) const
+    {
+        return bytes * 1000000000LL / (SAMPLE_RATE * BYTES_PER_SAMPLE);
+    }
+
     void onAudio()
     {
         if (!m_audioDevice || !m_encoder)
@@ -183,11 +278,31 @@ private:
         QElapsedTimer callbackTimer;
         callbackTimer.start();
 
-        QByteArray chunk = m_audioDevice->readAll();
-        if (!chunk.isEmpty()) {
-            m_partialBuffer.append(chunk);
-            trimPcmBacklog();
-            processPendingAudio();
+        trimPcmBacklog();
+
+        for (;;) {
+            int contiguousBytes;
+            char* writePtr = m_pcmRing.writePointer(contiguousBytes);
+            if (contiguousBytes == 0) {
+                // Every complete frame is encoded as soon as it lands, so the
+                // ring can only be full if the encoder is failing. Drop the
+                // oldest frame rather than stalling capture.
+                m_pcmRing.popFrames(1);
+                m_droppedPcmFrames++;
+                continue;
+            }
+
+            const qint64 bytesRead = m_audioDevice->read(writePtr, contiguousBytes);
+            if (bytesRead <= 0)
+                break;
+
+            m_pcmRing.commitWrite(static_cast<int>(bytesRead));
+            m_pcmBytes += bytesRead;
+
+            // The newest byte in the ring was captured roughly now, less
+            // whatever is still waiting in the audio source behind it.
+            const qint64 newestCaptureNs = m_clock.nsecsElapsed() - bytesToNs(m_audioDevice->bytesAvailable());
+            encodeAndSendFrames(newestCaptureNs);
         }
 
         m_maxAudioCallbackMs = qMax(m_maxAudioCallbackMs, callbackTimer.elapsed());
@@ -195,79 +310,58 @@ private:
 
     void trimPcmBacklog()
     {
-        const int maxBytes = MAX_PENDING_PCM_FRAMES * PCM_FRAME_SIZE;
-        if (m_partialBuffer.size() <= maxBytes)
+        // After a stall, sending a backlog of stale audio only adds latency.
+        // Skip whole frames in the source so at most m_maxPendingFrames
+        // remain to be encoded.
+        const qint64 maxBytes = static_cast<qint64>(m_maxPendingFrames) * m_frameBytes;
+        const qint64 pendingBytes = m_pcmRing.used() + m_audioDevice->bytesAvailable();
+        if (pendingBytes <= maxBytes)
             return;
 
-        const int excessBytes = m_partialBuffer.size() - maxBytes;
-        const int framesToDrop = (excessBytes + PCM_FRAME_SIZE - 1) / PCM_FRAME_SIZE;
-        const int completeBytes = m_partialBuffer.size() - (m_partialBuffer.size() % PCM_FRAME_SIZE);
-        const int bytesToDrop = qMin(framesToDrop * PCM_FRAME_SIZE, completeBytes);
-        m_partialBuffer.remove(0, bytesToDrop);
-        m_droppedPcmFrames += bytesToDrop / PCM_FRAME_SIZE;
+        const qint64 framesToDrop = (pendingBytes - maxBytes + m_frameBytes - 1) / m_frameBytes;
+        const qint64 skipped = m_audioDevice->skip(framesToDrop * m_frameBytes);
+        if (skipped > 0) {
+            m_droppedPcmFrames += static_cast<int>(skipped / m_frameBytes);
+        }
     }
 
-    void processPendingAudio()
+    void encodeAndSendFrames(qint64 newestCaptureNs)
     {
-        if (!m_encoder)
-            return;
-
-        int processedFrames = 0;
-        while (m_partialBuffer.size() >= PCM_FRAME_SIZE &&
-               processedFrames < MAX_ENCODE_FRAMES_PER_PASS) {
-            QByteArray pcm = m_partialBuffer.left(PCM_FRAME_SIZE);
-            m_partialBuffer.remove(0, PCM_FRAME_SIZE);
-            m_pcmBytes += pcm.size();
-
-            unsigned char encoded[MAX_OPUS_SIZE];
-            int len = opus_encode(m_encoder,
-                                  reinterpret_cast<const opus_int16*>(pcm.constData()),
-                                  PCM_FRAME_SAMPLES,
-                                  encoded,
-                                  MAX_OPUS_SIZE);
-            if (len > 0) {
-                while (m_queue.size() >= MAX_PENDING_OPUS_FRAMES) {
-                    m_queue.dequeue();
-                    m_droppedOpusFrames++;
-                }
-                m_queue.enqueue(QByteArray(reinterpret_cast<char*>(encoded), len));
-                m_opusBytes += len;
-            } else {
+        while (m_pcmRing.hasFrame()) {
+            // Capture time of the last sample in the frame at the front
+            const qint64 frameCaptureNs = newestCaptureNs - bytesToNs(m_pcmRing.used() - m_frameBytes);
+
+            OpusPacketSlot& slot = m_packetPool[m_nextPacketSlot];
+            m_nextPacketSlot = (m_nextPacketSlot + 1) % OPUS_PACKET_POOL_SIZE;
+
+            const qint64 encodeStartNs = m_clock.nsecsElapsed();
+            const int len = opus_encode(m_encoder,
+                                        m_pcmRing.frontFrame(),
+                                        m_frameSamples,
+                                        slot.data,
+                                        MAX_OPUS_SIZE);
+            m_pcmRing.popFrames(1);
+            m_maxEncodeUs = qMax(m_maxEncodeUs, (m_clock.nsecsElapsed() - encodeStartNs) / 1000);
+
+            if (len <= 0) {
                 qWarning() << "[MicStream] opus_encode failed len=" << len;
+                continue;
             }
-            processedFrames++;
-        }
-
-        if (m_partialBuffer.size() >= PCM_FRAME_SIZE && !m_audioContinuationPending) {
-            m_audioContinuationPending = true;
-            QTimer::singleShot(0, this, [this]() {
-                m_audioContinuationPending = false;
-                processPendingAudio();
-            });
-        }
-    }
+            m_opusBytes += len;
 
-    void sendLoop()
-    {
-        if (m_queue.isEmpty()) {
-            m_idleLoops++;
-            return;
-        }
-
-        int processedFrames = 0;
-        while (!m_queue.isEmpty() && processedFrames < MAX_SEND_FRAMES_PER_PASS) {
-            QByteArray opus = m_queue.dequeue();
-            int opusLen = opus.size();
-
-            opus.resize(((opusLen + 15) / 16) * 16);
-            int rc = sendMicrophoneOpusData(reinterpret_cast<const unsigned char*>(opus.data()), opusLen);
+            const int rc = sendMicrophoneOpusData(slot.data, len);
             if (rc < 0) {
                 qWarning() << "[MicStream] sendMicrophoneOpusData failed rc=" << rc;
-            } else {
-                m_sentPackets++;
-                m_sentBytes += opusLen;
+                m_failedPackets++;
+                continue;
             }
-            processedFrames++;
+            BandwidthCalculator::instance()->addBytes(BandwidthCalculator::Microphone, len);
+
+            const qint64 latencyUs = (m_clock.nsecsElapsed() - frameCaptureNs) / 1000;
+            m_totalLatencyUs += latencyUs;
+            m_maxLatencyUs = qMax(m_maxLatencyUs, latencyUs);
+            m_sentPackets++;
+            m_sentBytes += len;
         }
     }
 
@@ -275,13 +369,15 @@ private:
     {
         const int state = m_audioInput ? static_cast<int>(m_audioInput->state()) : -1;
         const int error = m_audioInput ? static_cast<int>(m_audioInput->error()) : -1;
+        const qint64 avgLatencyUs = m_sentPackets > 0 ? m_totalLatencyUs / m_sentPackets : 0;
         qInfo() << "[MicStream] 5s summary pcm=" << m_pcmBytes
                 << "B opus=" << m_opusBytes
                 << "B sent=" << m_sentPackets << "/" << m_sentBytes
-                << "B idle=" << m_idleLoops
-                << "queue=" << m_queue.size()
+                << "B failed=" << m_failedPackets
                 << "pcmDrop=" << m_droppedPcmFrames
-                << "opusDrop=" << m_droppedOpusFrames
+                << "latencyUs avg=" << avgLatencyUs
+                << "max=" << m_maxLatencyUs
+                << "encodeUs max=" << m_maxEncodeUs
                 << "maxAudioMs=" << m_maxAudioCallbackMs
                 << "state=" << state
                 << "error=" << error;
@@ -294,35 +390,44 @@ private:
         m_opusBytes = 0;
         m_sentBytes = 0;
         m_sentPackets = 0;
-        m_idleLoops = 0;
+        m_failedPackets = 0;
         m_droppedPcmFrames = 0;
-        m_droppedOpusFrames = 0;
         m_maxAudioCallbackMs = 0;
+        m_totalLatencyUs = 0;
+        m_maxLatencyUs = 0;
+        m_maxEncodeUs = 0;
     }
 
     QAudioSource *m_audioInput;
     QIODevice *m_audioDevice;
     OpusEncoder *m_encoder;
-    QTimer *m_sendTimer;
     QTimer *m_logTimer;
-    QQueue<QByteArray> m_queue;
+    QElapsedTimer m_clock;
+    const int m_frameDurationMs;
+    const int m_frameSamples;
+    const int m_frameBytes;
+    const int m_maxPendingFrames;
+    PcmRing m_pcmRing;
+    OpusPacketSlot m_packetPool[OPUS_PACKET_POOL_SIZE];
+    int m_nextPacketSlot;
     bool m_streamInitialized;
-    bool m_audioContinuationPending;
     quint64 m_pcmBytes;
     quint64 m_opusBytes;
     quint64 m_sentBytes;
     int m_sentPackets;
-    int m_idleLoops;
+    int m_failedPackets;
     int m_droppedPcmFrames;
-    int m_droppedOpusFrames;
     qint64 m_maxAudioCallbackMs;
-    QByteArray m_partialBuffer;
+    qint64 m_totalLatencyUs;
+    qint64 m_maxLatencyUs;
+    qint64 m_maxEncodeUs;
 };
 
-MicStream::MicStream(QObject *parent)
+MicStream::MicStream(int frameDurationMs, QObject *parent)
     : QObject(parent),
       m_thread(nullptr),
-      m_worker(nullptr)
+      m_worker(nullptr),
+      m_frameDurationMs(frameDurationMs)
 {
 }
 
@@ -345,7 +450,7 @@ bool MicStream::start()
 
     QThread *thread = new QThread(this);
     thread->setObjectName("Microphone Streaming Thread");
-    MicStreamWorker *worker = new MicStreamWorker();
+    MicStreamWorker *worker = new MicStreamWorker(m_frameDurationMs);
     worker->moveToThread(thread);
     connect(thread, &QThread::finished, worker, &QObject::deleteLater);
     thread->start();
@@ -9,7 +9,9 @@ class MicStream : public QObject
     Q_OBJECT
 
 public:
-    explicit MicStream(QObject *parent = nullptr);
+    // frameDurationMs selects the Opus frame size. Only 20, 10 and 5 ms
+    // are supported; anything else falls back to 20 ms.
+    explicit MicStream(int frameDurationMs = 20, QObject *parent = nullptr);
     ~MicStream();
 
     bool start();
@@ -18,4 +20,5 @@ public:
 private:
     QThread *m_thread;
     MicStreamWorker *m_worker;
+    int m_frameDurationMs;
 };
@@ -1,37 +1,40 @@
 #pragma once
 
-#include <QObject>
-#include <QTimer>
-#include <QElapsedTimer>
+#include "../bwtracker.h"
+
 #include <atomic>
 
-class BandwidthCalculator : public QObject
+// The one place streaming traffic is counted. Each kind of traffic has its
+// own BandwidthTracker, so the threads recording them never touch the same
+// memory, and recording is wait-free so it is safe on the receive paths.
+class BandwidthCalculator
 {
-    Q_OBJECT
-
 public:
+    enum Traffic
+    {
+        Video,
+        Audio,
+        Microphone,
+        Clipboard,
+        TrafficCount
+    };
+
     static BandwidthCalculator* instance();
-    
-    void addBytes(qint64 bytes);
+
+    void addBytes(Traffic traffic, size_t bytes);
+
+    // For the EWMA and peak statistics of a single kind of traffic
+    BandwidthTracker& tracker(Traffic traffic);
+
+    // The sum of the average bandwidth of every kind of traffic
     int getCurrentBandwidthKbps();
-    
+
     void start();
     void stop();
 
 private:
     BandwidthCalculator();
-    ~BandwidthCalculator();
-    
-    static BandwidthCalculator *s_instance;
-    
-    std::atomic<qint64> m_bytesReceived;
-    qint64 m_lastBytesReceived;
-    std::atomic<int> m_currentBandwidthKbps;
-    bool m_running;
-    
-    QTimer m_updateTimer;
-    QElapsedTimer m_elapsedTimer;
-    
-private slots:
-    void updateBandwidth();
+
+    BandwidthTracker m_trackers[TrafficCount];
+    std::atomic<bool> m_running;
 };
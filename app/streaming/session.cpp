@@ -364,6 +364,84 @@ private:
     std::shared_ptr<std::atomic_int> m_CurrentBitrateKbps;
 };
 
+class RuntimeBitrateTask : public QRunnable
+{
+public:
+    RuntimeBitrateTask(NvAddress address,
+                       uint16_t httpsPort,
+                       QSslCertificate serverCert,
+                       bool useTrueUid,
+                       QString uuid,
+                       QString clientname,
+                       int bitrateKbps,
+                       std::shared_ptr<std::atomic_int> inFlight,
+                       std::shared_ptr<std::atomic_int> currentBitrateKbps)
+        : m_Address(address),
+          m_HttpsPort(httpsPort),
+          m_ServerCert(serverCert),
+          m_UseTrueUid(useTrueUid),
+          m_Uuid(uuid),
+          m_Clientname(clientname),
+          m_BitrateKbps(bitrateKbps),
+          m_InFlight(inFlight),
+          m_CurrentBitrateKbps(currentBitrateKbps)
+    {
+        m_InFlight->fetch_add(1);
+    }
+
+    virtual void run() override
+    {
+        try {
+            NvHTTP http(m_Address, m_HttpsPort, m_ServerCert, m_UseTrueUid, nullptr, m_Uuid);
+
+            QString args = QString("bitrate=%1&clientname=%2")
+                               .arg(m_BitrateKbps)
+                               .arg(m_Clientname);
+
+            QString response = http.openConnectionToString(
+                http.m_BaseUrlHttps,
+                "bitrate",
+                args,
+                5000,
+                NvHTTP::NVLL_VERBOSE);
+
+            SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                        "Runtime bitrate change to %d kbps: %s",
+                        m_BitrateKbps,
+                        response.toUtf8().constData());
+
+            m_CurrentBitrateKbps->store(m_BitrateKbps);
+        }
+        catch (const GfeHttpResponseException& e) {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                         "Runtime bitrate change failed (HTTP): %s",
+                         e.toQString().toUtf8().constData());
+        }
+        catch (const QtNetworkReplyException& e) {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                         "Runtime bitrate change failed (Network): %s",
+                         e.toQString().toUtf8().constData());
+        }
+        catch (...) {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                         "Runtime bitrate change failed: unknown error");
+        }
+
+        m_InFlight->fetch_sub(1);
+    }
+
+private:
+    NvAddress m_Address;
+    uint16_t m_HttpsPort;
+    QSslCertificate m_ServerCert;
+    bool m_UseTrueUid;
+    QString m_Uuid;
+    QString m_Clientname;
+    int m_BitrateKbps;
+    std::shared_ptr<std::atomic_int> m_InFlight;
+    std::shared_ptr<std::atomic_int> m_CurrentBitrateKbps;
+};
+
 QString fileMappingStateName(OverlayMenuPanel::FileMappingState state)
 {
     return FileMappingUx::stateName(state);
@@ -691,6 +769,8 @@ void Session::clSetHdrMode(bool enabled, void* hdrMetadata)
 
 void Session::clClipboardData(const char* data, int length)
 {
+    BandwidthCalculator::instance()->addBytes(BandwidthCalculator::Clipboard, length);
+
     Session* session = s_ActiveSession;
     if (session == nullptr || session->m_ClipboardHelper == nullptr) {
         return;
@@ -834,7 +914,7 @@ void Session::clSetAdaptiveTriggers(uint16_t controllerNumber, uint8_t eventFlag
 bool Session::chooseDecoder(StreamingPreferences::VideoDecoderSelection vds,
                             StreamingPreferences::RendererSelection renderer,
                             SDL_Window* window, int videoFormat, int width, int height,
-                            int frameRate, bool enableVsync, bool enableFramePacing, bool enableVideoEnhancement, bool ignoreAspectRatio, bool testOnly, IVideoDecoder*& chosenDecoder)
+                            int frameRate, bool enableVsync, bool enableFramePacing, bool enableVrrPacing, bool enableFrameThreading, bool enableVideoEnhancement, bool ignoreAspectRatio, bool testOnly, IVideoDecoder*& chosenDecoder, bool startParked)
 {
     DECODER_PARAMETERS params;
 
@@ -850,12 +930,15 @@ bool Session::chooseDecoder(StreamingPreferences::VideoDecoderSelection vds,
     params.window = window;
     params.enableVsync = enableVsync;
     params.enableFramePacing = enableFramePacing;
+    params.enableVrrPacing = enableVrrPacing;
+    params.enableFrameThreading = enableFrameThreading;
     // Preserve the saved preference while making the effective decoder state
     // match the UI: video enhancement is unavailable with software decoding.
     params.enableVideoEnhancement = enableVideoEnhancement &&
                                     vds != StreamingPreferences::VDS_FORCE_SOFTWARE;
     params.ignoreAspectRatio = ignoreAspectRatio;
     params.testOnly = testOnly;
+    params.startParked = startParked;
     params.vds = vds;
     params.renderer = renderer;
 
@@ -949,6 +1032,229 @@ int Session::drSubmitDecodeUnit(PDECODE_UNIT du)
     }
 }
 
+void Session::notifyFirstFrameDecoded()
+{
+    // Only the first frame after the connection (re)starts is interesting
+    if (SDL_AtomicCAS(&m_FirstFramePending, 1, 0)) {
+        const char* decoderSource;
+        switch (m_FirstFrameDecoder) {
+        case FirstFrameDecoder::Adopted:
+            decoderSource = "parked decoder adopted";
+            break;
+        case FirstFrameDecoder::Discarded:
+            decoderSource = "parked decoder discarded";
+            break;
+        default:
+            decoderSource = "no parked decoder";
+            break;
+        }
+
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "Time to first frame: %u ms (%s)",
+                    SDL_GetTicks() - m_FirstFrameStartTicks,
+                    decoderSource);
+    }
+}
+
+bool Session::shouldEnableVsync()
+{
+    // If the stream exceeds the display refresh rate (plus some slack),
+    // forcefully disable V-sync to allow the stream to render faster
+    // than the display.
+    int displayHz = StreamUtils::getDisplayRefreshRate(m_Window);
+    if (displayHz + 5 < m_StreamConfig.fps) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Disabling V-sync because refresh rate limit exceeded");
+        return false;
+    }
+
+    return m_Preferences->enableVsync;
+}
+
+class DecoderPrewarmThread : public QThread
+{
+public:
+    DecoderPrewarmThread(Session* session, bool enableVsync) :
+        QThread(nullptr),
+        m_Session(session),
+        m_EnableVsync(enableVsync)
+    {
+        setObjectName("Decoder Pre-warm");
+    }
+
+    void run() override
+    {
+        m_Session->buildParkedDecoder(m_EnableVsync);
+    }
+
+    Session* m_Session;
+    bool m_EnableVsync;
+};
+
+void Session::prewarmVideoDecoder()
+{
+    SDL_assert(m_Window == nullptr);
+    SDL_assert(m_ParkedDecoder == nullptr);
+    SDL_assert(m_PrewarmThread == nullptr);
+
+    // Qt owns the only display plane on EGLFS until we start streaming
+    if (QGuiApplication::platformName() == "eglfs") {
+        return;
+    }
+
+#ifdef Q_OS_DARWIN
+    // The VideoToolbox renderers attach a view to the window, which AppKit
+    // only allows on the main thread, and that would freeze the loading page.
+    return;
+#endif
+
+    // Entering exclusive full-screen performs a modeset, which would change
+    // the refresh rate and swapchain that the renderer was built against.
+    if (m_IsFullScreen && m_FullScreenFlag == SDL_WINDOW_FULLSCREEN) {
+        return;
+    }
+
+    // The decoder needs the window it will render to, so create the streaming
+    // window now. It stays hidden until exec() shows it. The window is never
+    // hidden again after that, which is what breaks pointer hiding on Windows.
+    int x, y, width, height;
+    getWindowDimensions(x, y, width, height);
+    if (!createStreamWindow(x, y, width, height, SDL_WINDOW_HIDDEN)) {
+        return;
+    }
+
+    // Query the window on this thread and leave the slow part (device
+    // creation, renderer setup and the test decode) to the pre-warm thread
+    // so the loading page keeps animating. Only finishDecoderPrewarm() may
+    // touch the window or the parked decoder until the thread is joined.
+    bool enableVsync = shouldEnableVsync();
+    m_ParkedDisplayIndex = SDL_GetWindowDisplayIndex(m_Window);
+    m_ParkedDisplayHz = StreamUtils::getDisplayRefreshRate(m_Window);
+
+    m_PrewarmThread = new DecoderPrewarmThread(this, enableVsync);
+    m_PrewarmThread->start();
+}
+
+// Called on the pre-warm thread
+void Session::buildParkedDecoder(bool enableVsync)
+{
+    Uint32 startTicks = SDL_GetTicks();
+
+    // The video format was locked in by initialize(), so the only way
+    // the host can surprise us is a different resolution or frame rate.
+    IVideoDecoder* decoder = nullptr;
+    if (!chooseDecoder(m_Preferences->videoDecoderSelection,
+                       m_Preferences->rendererSelection,
+                       m_Window,
+                       m_StreamConfig.supportedVideoFormats,
+                       m_StreamConfig.width,
+                       m_StreamConfig.height,
+                       m_StreamConfig.fps,
+                       enableVsync,
+                       enableVsync && m_Preferences->framePacing,
+                       enableVsync && m_Preferences->vrrPacing,
+                       m_Preferences->softwareFrameThreading,
+                       m_Preferences->videoEnhancement,
+                       m_Preferences->ignoreAspectRatio,
+                       false,
+                       decoder,
+                       true)) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Decoder pre-warm failed. It will be created after the connection starts.");
+        return;
+    }
+
+    m_ParkedDecoder = decoder;
+    m_ParkedVideoFormat = m_StreamConfig.supportedVideoFormats;
+    m_ParkedVideoWidth = m_StreamConfig.width;
+    m_ParkedVideoHeight = m_StreamConfig.height;
+    m_ParkedVideoFrameRate = m_StreamConfig.fps;
+    m_ParkedEnableVsync = enableVsync;
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Pre-warmed decoder for %dx%dx%d (format 0x%x) in %u ms",
+                m_ParkedVideoWidth, m_ParkedVideoHeight, m_ParkedVideoFrameRate,
+                m_ParkedVideoFormat, SDL_GetTicks() - startTicks);
+}
+
+void Session::finishDecoderPrewarm()
+{
+    if (m_PrewarmThread == nullptr) {
+        return;
+    }
+
+    // The host usually takes far longer to launch the app than we take to
+    // build the decoder, so this rarely waits at all.
+    Uint32 waitStartTicks = SDL_GetTicks();
+    m_PrewarmThread->wait();
+    delete m_PrewarmThread;
+    m_PrewarmThread = nullptr;
+
+    Uint32 waitedMs = SDL_GetTicks() - waitStartTicks;
+    if (waitedMs > 0) {
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "Waited %u ms for decoder pre-warm to finish",
+                    waitedMs);
+    }
+
+    if (m_ParkedDecoder == nullptr) {
+        // Leave exec() to create the window as it normally would
+        SDL_DestroyWindow(m_Window);
+        m_Window = nullptr;
+        return;
+    }
+
+    // Renderers can't pump events off the main thread, so drop any window
+    // events from SDL_CreateRenderer() recreating the window here instead.
+    // See flushWindowEvents().
+    SDL_PumpEvents();
+    SDL_FlushEvent(SDL_WINDOWEVENT);
+}
+
+bool Session::adoptParkedDecoder(bool enableVsync)
+{
+    if (m_ParkedDecoder == nullptr) {
+        return false;
+    }
+
+    if (m_ParkedVideoFormat != m_ActiveVideoFormat ||
+            m_ParkedVideoWidth != m_ActiveVideoWidth ||
+            m_ParkedVideoHeight != m_ActiveVideoHeight ||
+            m_ParkedVideoFrameRate != m_ActiveVideoFrameRate ||
+            m_ParkedEnableVsync != enableVsync ||
+            m_ParkedDisplayIndex != SDL_GetWindowDisplayIndex(m_Window) ||
+            m_ParkedDisplayHz != StreamUtils::getDisplayRefreshRate(m_Window)) {
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "Discarding parked decoder built for %dx%dx%d (format 0x%x)",
+                    m_ParkedVideoWidth, m_ParkedVideoHeight,
+                    m_ParkedVideoFrameRate, m_ParkedVideoFormat);
+        discardParkedDecoder();
+        m_FirstFrameDecoder = FirstFrameDecoder::Discarded;
+        return false;
+    }
+
+    IVideoDecoder* decoder = m_ParkedDecoder;
+    m_ParkedDecoder = nullptr;
+
+    if (!decoder->resume()) {
+        delete decoder;
+        m_FirstFrameDecoder = FirstFrameDecoder::Discarded;
+        return false;
+    }
+    m_FirstFrameDecoder = FirstFrameDecoder::Adopted;
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Adopted parked decoder");
+    m_VideoDecoder = decoder;
+    return true;
+}
+
+void Session::discardParkedDecoder()
+{
+    delete m_ParkedDecoder;
+    m_ParkedDecoder = nullptr;
+}
+
 void Session::getDecoderInfo(SDL_Window* window,
                              bool& isHardwareAccelerated, bool& isFullScreenOnly,
                              bool& isHdrSupported, QSize& maxResolution)
@@ -963,7 +1269,7 @@ void Session::getDecoderInfo(SDL_Window* window,
     if (chooseDecoder(StreamingPreferences::VDS_FORCE_HARDWARE,
                       StreamingPreferences::RS_PROBE_ONLY,
                       window, VIDEO_FORMAT_H265_MAIN10, 1920, 1080, 60,
-                      false, false, false, false, true, decoder)) {
+                      false, false, false, false, false, false, true, decoder)) {
         isHardwareAccelerated = decoder->isHardwareAccelerated();
         isFullScreenOnly = decoder->isAlwaysFullScreen();
         isHdrSupported = decoder->isHdrSupported();
@@ -977,7 +1283,7 @@ void Session::getDecoderInfo(SDL_Window* window,
     if (chooseDecoder(StreamingPreferences::VDS_FORCE_HARDWARE,
                       StreamingPreferences::RS_PROBE_ONLY,
                       window, VIDEO_FORMAT_AV1_MAIN10, 1920, 1080, 60,
-                      false, false, false, false, true, decoder)) {
+                      false, false, false, false, false, false, true, decoder)) {
         // If we've got a working AV1 Main 10-bit decoder, we'll enable the HDR checkbox
         // but we will still continue probing to get other attributes for HEVC or H.264
         // decoders. See the AV1 comment at the top of the function for more info.
@@ -990,11 +1296,11 @@ void Session::getDecoderInfo(SDL_Window* window,
         if (chooseDecoder(StreamingPreferences::VDS_FORCE_SOFTWARE,
                           StreamingPreferences::RS_PROBE_ONLY,
                           window, VIDEO_FORMAT_H265_MAIN10, 1920, 1080, 60,
-                          false, false, false, false, true, decoder) ||
+                          false, false, false, false, false, false, true, decoder) ||
             chooseDecoder(StreamingPreferences::VDS_FORCE_SOFTWARE,
                           StreamingPreferences::RS_PROBE_ONLY,
                           window, VIDEO_FORMAT_AV1_MAIN10, 1920, 1080, 60,
-                          false, false, false, false, true, decoder)) {
+                          false, false, false, false, false, false, true, decoder)) {
             isHdrSupported = decoder->isHdrSupported();
             delete decoder;
         }
@@ -1009,7 +1315,7 @@ void Session::getDecoderInfo(SDL_Window* window,
     if (chooseDecoder(StreamingPreferences::VDS_FORCE_HARDWARE,
                       StreamingPreferences::RS_PROBE_ONLY,
                       window, VIDEO_FORMAT_H265, 1920, 1080, 60,
-                      false, false, false, false, true, decoder)) {
+                      false, false, false, false, false, false, true, decoder)) {
         isHardwareAccelerated = decoder->isHardwareAccelerated();
         isFullScreenOnly = decoder->isAlwaysFullScreen();
         maxResolution = decoder->getDecoderMaxResolution();
@@ -1023,7 +1329,7 @@ void Session::getDecoderInfo(SDL_Window* window,
     if (chooseDecoder(StreamingPreferences::VDS_FORCE_HARDWARE,
                       StreamingPreferences::RS_PROBE_ONLY,
                       window, VIDEO_FORMAT_AV1_MAIN8, 1920, 1080, 60,
-                      false, false, false, false, true, decoder)) {
+                      false, false, false, false, false, false, true, decoder)) {
         isHardwareAccelerated = decoder->isHardwareAccelerated();
         isFullScreenOnly = decoder->isAlwaysFullScreen();
         maxResolution = decoder->getDecoderMaxResolution();
@@ -1038,7 +1344,7 @@ void Session::getDecoderInfo(SDL_Window* window,
     if (chooseDecoder(StreamingPreferences::VDS_AUTO,
                       StreamingPreferences::RS_PROBE_ONLY,
                       window, VIDEO_FORMAT_H264, 1920, 1080, 60,
-                      false, false, false, false, true, decoder)) {
+                      false, false, false, false, false, false, true, decoder)) {
         isHardwareAccelerated = decoder->isHardwareAccelerated();
         isFullScreenOnly = decoder->isAlwaysFullScreen();
         maxResolution = decoder->getDecoderMaxResolution();
@@ -1061,7 +1367,7 @@ Session::getDecoderAvailability(SDL_Window* window,
     if (!chooseDecoder(vds,
                        StreamingPreferences::RS_PROBE_ONLY,
                        window, videoFormat, width, height, frameRate,
-                       false, false, false, false, true, decoder)) {
+                       false, false, false, false, false, false, true, decoder)) {
         return DecoderAvailability::None;
     }
 
@@ -1087,7 +1393,7 @@ bool Session::populateDecoderProperties(SDL_Window* window)
                        m_StreamConfig.width,
                        m_StreamConfig.height,
                        m_StreamConfig.fps,
-                       false, false, false, false, true, decoder)) {
+                       false, false, false, false, false, false, true, decoder)) {
         return false;
     }
 
@@ -1154,6 +1460,17 @@ Session::Session(NvComputer* computer,
       m_LastTerminationErrorCode(0),
       m_AsyncConnectionSuccess(false),
       m_PortTestResults(0),
+      m_PrewarmThread(nullptr),
+      m_ParkedDecoder(nullptr),
+      m_ParkedVideoFormat(0),
+      m_ParkedVideoWidth(0),
+      m_ParkedVideoHeight(0),
+      m_ParkedVideoFrameRate(0),
+      m_ParkedEnableVsync(false),
+      m_ParkedDisplayIndex(-1),
+      m_ParkedDisplayHz(0),
+      m_FirstFrameStartTicks(0),
+      m_FirstFrameDecoder(FirstFrameDecoder::Cold),
       m_OpusDecoder(nullptr),
       m_AudioRenderer(nullptr),
       m_DualSenseHapticsRenderer(nullptr),
@@ -1166,6 +1483,8 @@ Session::Session(NvComputer* computer,
             m_LastAbrFeedbackTicks(0),
             m_AbrFeedbackInFlight(std::make_shared<std::atomic_bool>(false)),
             m_AbrCurrentBitrateKbps(std::make_shared<std::atomic_int>(0)),
+            m_BitrateChangesInFlight(std::make_shared<std::atomic_int>(0)),
+            m_PendingClientAbrBitrateKbps(0),
       m_Toast(nullptr),
       m_FileMappingState(OverlayMenuPanel::FileMappingState::Unknown),
       m_FileMappingDetail(tr("Checking")),
@@ -1180,6 +1499,11 @@ Session::Session(NvComputer* computer,
 {
     memset(&m_LastAbrVideoStats, 0, sizeof(m_LastAbrVideoStats));
     m_ClipboardHelper = nullptr;
+    SDL_AtomicSet(&m_FirstFramePending, 0);
+    SDL_AtomicSet(&m_AudioStatsValid, 0);
+    SDL_AtomicSet(&m_AudioFecFrames, 0);
+    SDL_AtomicSet(&m_AudioConcealedFrames, 0);
+    SDL_AtomicSet(&m_AudioLostFrames, 0);
 }
 
 Session::~Session()
@@ -2463,6 +2787,13 @@ void Session::dispatchQtMenuAction(OverlayMenuPanel::MenuAction action)
             m_Preferences->save();
             // Try to change bitrate in the current session via Sunshine API
             requestRuntimeBitrateChange(newBitrate);
+            {
+                // The client ABR never goes above what the user picked
+                std::lock_guard<std::mutex> lock(m_ClientAbrMutex);
+                if (m_ClientAbr) {
+                    m_ClientAbr->setMaxBitrateKbps(newBitrate);
+                }
+            }
             // Show toast notification
             if (newBitrate >= 1000) {
                 showStreamingToast(QString("Bitrate: %1 Mbps").arg(newBitrate / 1000));
@@ -2604,50 +2935,26 @@ void Session::requestRuntimeBitrateChange(int bitrateKbps)
         return;
     }
 
-    try {
-        NvHTTP http(m_Computer);
-
-        // Build clientname the same way as openConnection() does for /launch
-        QString clientname = QHostInfo::localHostName();
-        if (!m_Computer->uuid.isEmpty()) {
-            QString pairname = NvComputer::getPairname(m_Computer->uuid);
-            if (!pairname.isEmpty()) {
-                clientname = pairname;
-            }
+    // Build clientname the same way as openConnection() does for /launch
+    QString clientname = QHostInfo::localHostName();
+    if (!m_Computer->uuid.isEmpty()) {
+        QString pairname = NvComputer::getPairname(m_Computer->uuid);
+        if (!pairname.isEmpty()) {
+            clientname = pairname;
         }
-
-        QString args = QString("bitrate=%1&clientname=%2")
-                           .arg(bitrateKbps)
-                           .arg(clientname);
-
-        QString response = http.openConnectionToString(
-            http.m_BaseUrlHttps,
-            "bitrate",
-            args,
-            5000,
-            NvHTTP::NVLL_VERBOSE);
-
-        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
-                    "Runtime bitrate change to %d kbps: %s",
-                    bitrateKbps,
-                    response.toUtf8().constData());
-
-        m_AbrCurrentBitrateKbps->store(bitrateKbps);
-    }
-    catch (const GfeHttpResponseException& e) {
-        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
-                     "Runtime bitrate change failed (HTTP): %s",
-                     e.toQString().toUtf8().constData());
-    }
-    catch (const QtNetworkReplyException& e) {
-        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
-                     "Runtime bitrate change failed (Network): %s",
-                     e.toQString().toUtf8().constData());
-    }
-    catch (...) {
-        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
-                     "Runtime bitrate change failed: unknown error");
     }
+
+    // The request can take seconds against an unresponsive host, which is
+    // too long to stall the event loop for
+    QThreadPool::globalInstance()->start(new RuntimeBitrateTask(m_Computer->activeAddress,
+                                                                m_Computer->activeHttpsPort,
+                                                                m_Computer->serverCert,
+                                                                !m_Computer->isNvidiaServerSoftware,
+                                                                m_Computer->uuid,
+                                                                clientname,
+                                                                bitrateKbps,
+                                                                m_BitrateChangesInFlight,
+                                                                m_AbrCurrentBitrateKbps));
 }
 
 void Session::startSunshineAbr()
@@ -2735,6 +3042,94 @@ void Session::stopSunshineAbr()
     }
 }
 
+void Session::startClientAbr()
+{
+    std::lock_guard<std::mutex> lock(m_ClientAbrMutex);
+
+    m_ClientAbr.reset();
+    m_PendingClientAbrBitrateKbps = 0;
+
+    if (!m_Preferences->enableClientAbr || !m_Computer) {
+        return;
+    }
+
+    // Sunshine's ABR picks its own starting point. Otherwise the stream
+    // starts at the configured bitrate, even after a runtime change.
+    if (!m_SunshineAbrEnabled) {
+        m_AbrCurrentBitrateKbps->store(m_StreamConfig.bitrate);
+    }
+
+    AbrController::Config config;
+    config.maxBitrateKbps = m_StreamConfig.bitrate;
+    config.minBitrateKbps = qMax(1000, m_StreamConfig.bitrate / 4);
+    m_ClientAbr.reset(new AbrController(config, m_AbrCurrentBitrateKbps->load()));
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Client ABR enabled: initial=%d Kbps, range=%d-%d Kbps",
+                m_ClientAbr->bitrateKbps(),
+                qMin(config.minBitrateKbps, config.maxBitrateKbps),
+                config.maxBitrateKbps);
+}
+
+void Session::stopClientAbr()
+{
+    std::lock_guard<std::mutex> lock(m_ClientAbrMutex);
+
+    m_ClientAbr.reset();
+    m_PendingClientAbrBitrateKbps = 0;
+}
+
+void Session::submitClientAbrSample(const AbrController::Sample& sample)
+{
+    AbrController::Decision decision;
+    {
+        std::lock_guard<std::mutex> lock(m_ClientAbrMutex);
+
+        if (!m_ClientAbr) {
+            return;
+        }
+
+        // Follow changes made by Sunshine's ABR or the user, but not while
+        // one of our own is on its way
+        if (m_PendingClientAbrBitrateKbps == 0 && m_BitrateChangesInFlight->load() == 0) {
+            m_ClientAbr->syncBitrateKbps(m_AbrCurrentBitrateKbps->load());
+        }
+
+        decision = m_ClientAbr->update(sample);
+        if (decision.action == AbrController::Action::Hold) {
+            return;
+        }
+
+        // The main loop makes the request
+        m_PendingClientAbrBitrateKbps = decision.bitrateKbps;
+    }
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Client ABR %s bitrate to %d Kbps: %s",
+                decision.action == AbrController::Action::Increase ? "raising" : "lowering",
+                decision.bitrateKbps,
+                decision.reason);
+}
+
+void Session::processClientAbr()
+{
+    // One request at a time, so a change can't overtake the one before it
+    if (m_BitrateChangesInFlight->load() != 0) {
+        return;
+    }
+
+    int bitrateKbps;
+    {
+        std::lock_guard<std::mutex> lock(m_ClientAbrMutex);
+        bitrateKbps = m_PendingClientAbrBitrateKbps;
+        m_PendingClientAbrBitrateKbps = 0;
+    }
+
+    if (bitrateKbps != 0) {
+        requestRuntimeBitrateChange(bitrateKbps);
+    }
+}
+
 void Session::startFileMappingUxProbe()
 {
     appendFileMappingDiagnostic(
@@ -3098,15 +3493,35 @@ bool Session::tryReconnect()
         m_InputHandler->raiseAllKeys(false);
     }
 
-    // The decoder can only be used between LiStartConnection() and
-    // LiStopConnection(), so tear it down before stopping the dead connection.
+    // The decoder can only pull frames between LiStartConnection() and
+    // LiStopConnection(), so park it before stopping the dead connection.
+    // The stream parameters almost never change across a reconnect, so
+    // keeping the hardware contexts, swapchain and pacer threads alive lets
+    // the reset after drSetup() skip the whole chooseDecoder() path.
     SDL_LockMutex(m_DecoderLock);
-    delete m_VideoDecoder;
-    m_VideoDecoder = nullptr;
+    if (m_VideoDecoder != nullptr) {
+        m_VideoDecoder->park();
+
+        discardParkedDecoder();
+        m_ParkedDecoder = m_VideoDecoder;
+        m_ParkedVideoFormat = m_ActiveVideoFormat;
+        m_ParkedVideoWidth = m_ActiveVideoWidth;
+        m_ParkedVideoHeight = m_ActiveVideoHeight;
+        m_ParkedVideoFrameRate = m_ActiveVideoFrameRate;
+        m_ParkedEnableVsync = shouldEnableVsync();
+        m_ParkedDisplayIndex = SDL_GetWindowDisplayIndex(m_Window);
+        m_ParkedDisplayHz = StreamUtils::getDisplayRefreshRate(m_Window);
+        m_VideoDecoder = nullptr;
+    }
     SDL_UnlockMutex(m_DecoderLock);
 
+    m_FirstFrameStartTicks = SDL_GetTicks();
+    m_FirstFrameDecoder = FirstFrameDecoder::Cold;
+    SDL_AtomicSet(&m_FirstFramePending, 1);
+
     // Stop ABR feedback (startConnectionAsync() restarts it) and the dead connection
     stopSunshineAbr();
+    stopClientAbr();
     LiStopConnection();
 
     // Total time budget for reconnect attempts before giving up
@@ -3206,7 +3621,8 @@ bool Session::tryReconnect()
 
     if (reconnected) {
         // moonlight-common-c has already called drSetup() with the new video
-        // format. Recreate the decoder through the normal reset path.
+        // format. The normal reset path resumes the parked decoder if it still
+        // matches and recreates it otherwise.
         SDL_Event resetEvent = {};
         resetEvent.type = SDL_RENDER_DEVICE_RESET;
         SDL_PushEvent(&resetEvent);
@@ -3267,14 +3683,14 @@ HostConnectionInfoSnapshot captureHostConnectionInfoSnapshot(NvComputer* compute
     return snapshot;
 }
 
-void updateHostConnectionInfoFromServerInfo(const QString& serverInfo,
+void updateHostConnectionInfoFromServerInfo(const NvServerInfo& serverInfo,
                                             NvComputer* computer,
                                             HostConnectionInfoSnapshot* snapshot,
                                             bool resumingSession)
 {
-    QString refreshedCodecSupport = NvHTTP::getXmlString(serverInfo, "ServerCodecModeSupport");
-    QString refreshedAppVersion = NvHTTP::getXmlString(serverInfo, "appversion");
-    QString refreshedGfeVersion = NvHTTP::getXmlString(serverInfo, "GfeVersion");
+    const QString& refreshedCodecSupport = serverInfo.serverCodecModeSupport;
+    const QString& refreshedAppVersion = serverInfo.appVersion;
+    const QString& refreshedGfeVersion = serverInfo.gfeVersion;
 
     if (!refreshedCodecSupport.isEmpty()) {
         int refreshedServerCodecModeSupport = refreshedCodecSupport.toInt();
@@ -3298,7 +3714,7 @@ void updateHostConnectionInfoFromServerInfo(const QString& serverInfo,
         snapshot->gfeVersion = refreshedGfeVersion;
     }
 
-    snapshot->currentGameId = NvHTTP::getCurrentGame(serverInfo);
+    snapshot->currentGameId = serverInfo.currentGameId();
 
     QWriteLocker lock(&computer->lock);
     computer->serverCodecModeSupport = snapshot->serverCodecModeSupport;
@@ -3533,6 +3949,7 @@ bool Session::startConnectionAsync()
 
     emit connectionStarted();
     startSunshineAbr();
+    startClientAbr();
     startFileMappingUxProbe();
     startFileMappingSmokeProbe();
     if (m_Preferences->enableMicrophone) {
@@ -3545,6 +3962,12 @@ bool Session::startConnectionAsync()
 
 void Session::flushWindowEvents()
 {
+    // The pre-warm thread can't pump events. finishDecoderPrewarm()
+    // flushes the window events on the main thread instead.
+    if (m_PrewarmThread != nullptr && QThread::currentThread() == m_PrewarmThread) {
+        return;
+    }
+
     // Pump events to ensure all pending OS events are posted
     SDL_PumpEvents();
 
@@ -3587,6 +4010,16 @@ void Session::start()
     // ClipboardHelperClient and flushed from the SDL loop.
     if (m_ClipboardHelper == nullptr) {
         m_ClipboardHelper = new ClipboardHelperClient(m_Computer, this);
+        connect(m_ClipboardHelper, &ClipboardHelperClient::transferProgress,
+                this, [this](bool upload, qint64 transferred, qint64 total) {
+            if (total <= 0) {
+                return;
+            }
+            int percent = static_cast<int>(qBound<qint64>(0, transferred * 100 / total, 100));
+            showStreamingToast(upload ? tr("Sending clipboard... %1%").arg(percent)
+                                      : tr("Receiving clipboard... %1%").arg(percent),
+                               percent >= 100 ? 1000 : 2000);
+        });
         m_ClipboardHelper->start();
     }
 #endif
@@ -3617,11 +4050,21 @@ void Session::start()
     m_InputHandler = new SdlInputHandler(*m_Preferences, m_StreamConfig.width,
                                          m_StreamConfig.height, enablePhysicalDualSenseHaptics);
 
+    m_FirstFrameStartTicks = SDL_GetTicks();
+    m_FirstFrameDecoder = FirstFrameDecoder::Cold;
+    SDL_AtomicSet(&m_FirstFramePending, 1);
+
     // Kick off the async connection thread then return to the caller to pump the event loop
     auto thread = new AsyncConnectionStartThread(this);
     QObject::connect(thread, &QThread::finished, this, &Session::exec);
     QObject::connect(thread, &QThread::finished, thread, &QThread::deleteLater);
     thread->start();
+
+#ifndef STEAM_LINK
+    // Bring up the decoder and renderer while the host launches the app.
+    // This returns once the window exists, so the loading page keeps running.
+    prewarmVideoDecoder();
+#endif
 }
 
 void Session::interrupt()
@@ -3691,6 +4134,56 @@ void Session::queryDisplayHdrBrightness(float& maxNits, float& minNits, float& m
 }
 #endif
 
+bool Session::createStreamWindow(int x, int y, int width, int height, Uint32 flags)
+{
+    // Request at least 8 bits per color for GL
+    SDL_GL_SetAttribute(SDL_GL_RED_SIZE, 8);
+    SDL_GL_SetAttribute(SDL_GL_GREEN_SIZE, 8);
+    SDL_GL_SetAttribute(SDL_GL_BLUE_SIZE, 8);
+
+    // Disable depth and stencil buffers
+    SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 0);
+    SDL_GL_SetAttribute(SDL_GL_STENCIL_SIZE, 0);
+
+    // We always want a resizable window with High DPI enabled
+    flags |= SDL_WINDOW_ALLOW_HIGHDPI | SDL_WINDOW_RESIZABLE;
+
+    // We use only the computer name on macOS to match Apple conventions where the
+    // app name is featured in the menu bar and the document name is in the title bar.
+#ifdef Q_OS_DARWIN
+    std::string windowName = QString(m_Computer->name).toStdString();
+#else
+    std::string windowName = QString(m_Computer->name + " - Moonlight").toStdString();
+#endif
+
+    m_Window = SDL_CreateWindow(windowName.c_str(),
+                                x,
+                                y,
+                                width,
+                                height,
+                                flags | StreamUtils::getPlatformWindowFlags());
+    if (!m_Window) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "SDL_CreateWindow() failed with platform flags: %s",
+                    SDL_GetError());
+
+        m_Window = SDL_CreateWindow(windowName.c_str(),
+                                    x,
+                                    y,
+                                    width,
+                                    height,
+                                    flags);
+        if (!m_Window) {
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                         "SDL_CreateWindow() failed: %s",
+                         SDL_GetError());
+            return false;
+        }
+    }
+
+    return true;
+}
+
 // 加载页退场淡幕的时长上限，比 StreamSegue.qml 里那条 340ms 动画留一点余量。
 // 两边要一起改。
 static const int k_StreamEnterVeilMs = 380;
@@ -3701,6 +4194,9 @@ static const Uint32 k_FullScreenEntryTimeoutMs = 1200;
 
 void Session::exec()
 {
+    // Join the pre-warm thread before anything touches the window
+    finishDecoderPrewarm();
+
     // If the connection failed, clean up and abort the connection.
     if (!m_AsyncConnectionSuccess) {
         if (m_ClipboardHelper != nullptr) {
@@ -3710,6 +4206,13 @@ void Session::exec()
         }
         delete m_InputHandler;
         m_InputHandler = nullptr;
+
+        // The pre-warmed decoder must go before the window it renders to
+        discardParkedDecoder();
+        if (m_Window != nullptr) {
+            SDL_DestroyWindow(m_Window);
+            m_Window = nullptr;
+        }
         SDL_QuitSubSystem(SDL_INIT_VIDEO);
         QThreadPool::globalInstance()->start(new DeferredSessionCleanupTask(this));
         return;
@@ -3771,17 +4274,7 @@ void Session::exec()
     SDL_Delay(500);
 #endif
 
-    // Request at least 8 bits per color for GL
-    SDL_GL_SetAttribute(SDL_GL_RED_SIZE, 8);
-    SDL_GL_SetAttribute(SDL_GL_GREEN_SIZE, 8);
-    SDL_GL_SetAttribute(SDL_GL_BLUE_SIZE, 8);
-
-    // Disable depth and stencil buffers
-    SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 0);
-    SDL_GL_SetAttribute(SDL_GL_STENCIL_SIZE, 0);
-
-    // We always want a resizable window with High DPI enabled
-    Uint32 defaultWindowFlags = SDL_WINDOW_ALLOW_HIGHDPI | SDL_WINDOW_RESIZABLE;
+    Uint32 windowStateFlags = 0;
 
     // If we're starting in windowed mode and the Moonlight GUI is maximized or
     // minimized, match that with the streaming window.
@@ -3789,63 +4282,46 @@ void Session::exec()
 #if QT_VERSION >= QT_VERSION_CHECK(5, 10, 0)
         // Qt 5.10+ can propagate multiple states together
         if (m_QtWindow->windowStates() & Qt::WindowMaximized) {
-            defaultWindowFlags |= SDL_WINDOW_MAXIMIZED;
+            windowStateFlags |= SDL_WINDOW_MAXIMIZED;
         }
         if (m_QtWindow->windowStates() & Qt::WindowMinimized) {
-            defaultWindowFlags |= SDL_WINDOW_MINIMIZED;
+            windowStateFlags |= SDL_WINDOW_MINIMIZED;
         }
 #else
         // Qt 5.9 only supports a single state at a time
         if (m_QtWindow->windowState() == Qt::WindowMaximized) {
-            defaultWindowFlags |= SDL_WINDOW_MAXIMIZED;
+            windowStateFlags |= SDL_WINDOW_MAXIMIZED;
         }
         else if (m_QtWindow->windowState() == Qt::WindowMinimized) {
-            defaultWindowFlags |= SDL_WINDOW_MINIMIZED;
+            windowStateFlags |= SDL_WINDOW_MINIMIZED;
         }
 #endif
     }
 
-    // We use only the computer name on macOS to match Apple conventions where the
-    // app name is featured in the menu bar and the document name is in the title bar.
-#ifdef Q_OS_DARWIN
-    std::string windowName = QString(m_Computer->name).toStdString();
-#else
-    std::string windowName = QString(m_Computer->name + " - Moonlight").toStdString();
-#endif
-
-    m_Window = SDL_CreateWindow(windowName.c_str(),
-                                x,
-                                y,
-                                width,
-                                height,
-                                defaultWindowFlags | StreamUtils::getPlatformWindowFlags());
-    if (!m_Window) {
-        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
-                    "SDL_CreateWindow() failed with platform flags: %s",
-                    SDL_GetError());
-
-        m_Window = SDL_CreateWindow(windowName.c_str(),
-                                    x,
-                                    y,
-                                    width,
-                                    height,
-                                    defaultWindowFlags);
-        if (!m_Window) {
-            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
-                         "SDL_CreateWindow() failed: %s",
-                         SDL_GetError());
-
-            if (m_ClipboardHelper != nullptr) {
-                m_ClipboardHelper->stop();
-                delete m_ClipboardHelper;
-                m_ClipboardHelper = nullptr;
-            }
-            delete m_InputHandler;
-            m_InputHandler = nullptr;
-            SDL_QuitSubSystem(SDL_INIT_VIDEO);
-            QThreadPool::globalInstance()->start(new DeferredSessionCleanupTask(this));
-            return;
+    if (m_Window != nullptr) {
+        // The window was created hidden for the pre-warmed decoder. Move it
+        // where it would have been created and show it.
+        SDL_SetWindowPosition(m_Window, x, y);
+        SDL_SetWindowSize(m_Window, width, height);
+        SDL_ShowWindow(m_Window);
+        if (windowStateFlags & SDL_WINDOW_MAXIMIZED) {
+            SDL_MaximizeWindow(m_Window);
+        }
+        if (windowStateFlags & SDL_WINDOW_MINIMIZED) {
+            SDL_MinimizeWindow(m_Window);
+        }
+    }
+    else if (!createStreamWindow(x, y, width, height, windowStateFlags)) {
+        if (m_ClipboardHelper != nullptr) {
+            m_ClipboardHelper->stop();
+            delete m_ClipboardHelper;
+            m_ClipboardHelper = nullptr;
         }
+        delete m_InputHandler;
+        m_InputHandler = nullptr;
+        SDL_QuitSubSystem(SDL_INIT_VIDEO);
+        QThreadPool::globalInstance()->start(new DeferredSessionCleanupTask(this));
+        return;
     }
 
     m_InputHandler->setWindow(m_Window);
@@ -4074,6 +4550,7 @@ void Session::exec()
     for (;;) {
         hideGuiWindowWhenSettled(false);
         processSunshineAbrFeedback();
+        processClientAbr();
         processFileMappingUxProbeResult();
         processFileMappingMountResult();
         processClipboardHelperMessages();
@@ -4099,6 +4576,7 @@ void Session::exec()
             processFileMappingMountResult();
             processQtEventsDuringStream(true);
             processSunshineAbrFeedback();
+            processClientAbr();
             continue;
         }
 #else
@@ -4120,6 +4598,7 @@ void Session::exec()
             processFileMappingMountResult();
             processQtEventsDuringStream();
             processSunshineAbrFeedback();
+            processClientAbr();
             continue;
         }
 #endif
@@ -4380,29 +4859,25 @@ void Session::exec()
             SDL_FlushEvent(SDL_RENDER_DEVICE_RESET);
 
             {
-                // If the stream exceeds the display refresh rate (plus some slack),
-                // forcefully disable V-sync to allow the stream to render faster
-                // than the display.
-                int displayHz = StreamUtils::getDisplayRefreshRate(m_Window);
-                bool enableVsync = m_Preferences->enableVsync;
-                if (displayHz + 5 < m_StreamConfig.fps) {
-                    SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
-                                "Disabling V-sync because refresh rate limit exceeded");
-                    enableVsync = false;
-                }
-
-                // Choose a new decoder (hopefully the same one, but possibly
-                // not if a GPU was removed or something).
-                if (!chooseDecoder(m_Preferences->videoDecoderSelection,
-                                   m_Preferences->rendererSelection,
-                                   m_Window, m_ActiveVideoFormat, m_ActiveVideoWidth,
-                                   m_ActiveVideoHeight, m_ActiveVideoFrameRate,
-                                   enableVsync,
-                                   enableVsync && m_Preferences->framePacing,
-                                   m_Preferences->videoEnhancement,
-                                   m_Preferences->ignoreAspectRatio,
-                                   false,
-                                   s_ActiveSession->m_VideoDecoder)) {
+                bool enableVsync = shouldEnableVsync();
+
+                // Use the parked decoder if it was built for this stream. Otherwise
+                // choose a new decoder (hopefully the same one, but possibly not
+                // if a GPU was removed or something).
+                m_FirstFrameDecoder = FirstFrameDecoder::Cold;
+                if (!adoptParkedDecoder(enableVsync) &&
+                        !chooseDecoder(m_Preferences->videoDecoderSelection,
+                                       m_Preferences->rendererSelection,
+                                       m_Window, m_ActiveVideoFormat, m_ActiveVideoWidth,
+                                       m_ActiveVideoHeight, m_ActiveVideoFrameRate,
+                                       enableVsync,
+                                       enableVsync && m_Preferences->framePacing,
+                                       enableVsync && m_Preferences->vrrPacing,
+                                       m_Preferences->softwareFrameThreading,
+                                       m_Preferences->videoEnhancement,
+                                       m_Preferences->ignoreAspectRatio,
+                                       false,
+                                       s_ActiveSession->m_VideoDecoder)) {
                     SDL_UnlockMutex(m_DecoderLock);
                     SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
                                  "Failed to recreate decoder after reset");
@@ -4665,10 +5140,12 @@ DispatchDeferredCleanup:
     // NB: This must happen before LiStopConnection() for pull-based
     // decoders.
     stopSunshineAbr();
+    stopClientAbr();
     SDL_LockMutex(m_DecoderLock);
     delete m_VideoDecoder;
     m_VideoDecoder = nullptr;
     SDL_UnlockMutex(m_DecoderLock);
+    discardParkedDecoder();
 
     // Propagate state changes from the SDL window back to the Qt window
     //
@@ -4718,7 +5195,7 @@ DispatchDeferredCleanup:
 void Session::startMicrophone()
 {
     if (!m_MicStream) {
-        m_MicStream = new MicStream(this);
+        m_MicStream = new MicStream(m_Preferences->micFrameDurationMs, this);
         if (!m_MicStream->start()) {
             delete m_MicStream;
             m_MicStream = nullptr;
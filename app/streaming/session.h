@@ -12,8 +12,10 @@
 #include <Limelight.h>
 #include <opus_multistream.h>
 #include "settings/streamingpreferences.h"
+#include "abrcontroller.h"
 #include "input/input.h"
 #include "video/decoder.h"
+#include "audio/lossrecovery.h"
 #include "audio/renderers/renderer.h"
 #include "video/overlaymanager.h"
 #include "video/overlaymenupanel.h"
@@ -29,6 +31,7 @@ struct MountState;
 }
 
 class DualSenseHapticsRenderer;
+class QThread;
 
 class SupportedVideoFormatList : public QList<int>
 {
@@ -115,6 +118,7 @@ class Session : public QObject
     friend class SdlInputHandler;
     friend class DeferredSessionCleanupTask;
     friend class AsyncConnectionStartThread;
+    friend class DecoderPrewarmThread;
 
 public:
     explicit Session(NvComputer* computer,
@@ -146,6 +150,17 @@ public:
 
     void flushWindowEvents();
 
+    // Called by the decoder when it outputs its first frame
+    void notifyFirstFrameDecoded();
+
+    // Latest playback statistics from the audio renderer. Safe to call
+    // from any thread. Returns false if none are available.
+    bool getAudioStats(AUDIO_STATS& stats);
+
+    // Called by the decoder each time it closes a stats window. Safe to call
+    // from any thread.
+    void submitClientAbrSample(const AbrController::Sample& sample);
+
     void setShouldExit(bool quitHostApp = false);
 
 signals:
@@ -188,6 +203,10 @@ private:
 
     bool initializeAudioRenderer();
 
+    bool decodeAndSubmitAudio(const unsigned char* data, int length, bool decodeFec);
+
+    bool recoverLostAudio(const unsigned char* nextPacket, int nextPacketLength);
+
     bool testAudio(int audioConfiguration);
 
     int getAudioRendererCapabilities(int audioConfiguration);
@@ -197,6 +216,27 @@ private:
 
     void toggleFullscreen();
 
+    bool createStreamWindow(int x, int y, int width, int height, Uint32 flags);
+
+    bool shouldEnableVsync();
+
+    // Creates the streaming window and starts building a parked decoder for
+    // the stream we expect to negotiate while the host is still launching
+    // the app.
+    void prewarmVideoDecoder();
+
+    // Runs on the pre-warm thread
+    void buildParkedDecoder(bool enableVsync);
+
+    // Waits for the pre-warm thread and destroys the window if it failed
+    void finishDecoderPrewarm();
+
+    // Hands the parked decoder over to m_VideoDecoder if it was built for
+    // the current stream, window and V-sync state. Otherwise it is destroyed.
+    bool adoptParkedDecoder(bool enableVsync);
+
+    void discardParkedDecoder();
+
     // Qt-based overlay menu
     void showQtOverlayMenu(std::optional<QPoint> pointerGlobalPosition = std::nullopt,
                            bool closeWhenPointerOutside = true);
@@ -239,8 +279,8 @@ private:
                        StreamingPreferences::RendererSelection renderer,
                        SDL_Window* window, int videoFormat, int width, int height,
                        int frameRate, bool enableVsync, bool enableFramePacing,
-                       bool enableVideoEnhancement, bool ignoreAspectRatio, bool testOnly,
-                       IVideoDecoder*& chosenDecoder);
+                       bool enableVrrPacing, bool enableFrameThreading, bool enableVideoEnhancement, bool ignoreAspectRatio, bool testOnly,
+                       IVideoDecoder*& chosenDecoder, bool startParked = false);
 
     static
     void clStageStarting(int stage);
@@ -310,6 +350,9 @@ private:
     void startSunshineAbr();
     void stopSunshineAbr();
     void sendSunshineAbrFeedback();
+    void startClientAbr();
+    void stopClientAbr();
+    void processClientAbr();
     void startFileMappingUxProbe();
     void processFileMappingUxProbeResult();
     void startFileMappingMount();
@@ -358,12 +401,50 @@ private:
     int m_ActiveVideoHeight;
     int m_ActiveVideoFrameRate;
 
+    // Builds m_ParkedDecoder off the main thread during start()
+    QThread* m_PrewarmThread;
+
+    // A fully initialized decoder that isn't consuming frames yet, along with
+    // what it was built for. Main thread only, once m_PrewarmThread is joined.
+    IVideoDecoder* m_ParkedDecoder;
+    int m_ParkedVideoFormat;
+    int m_ParkedVideoWidth;
+    int m_ParkedVideoHeight;
+    int m_ParkedVideoFrameRate;
+    bool m_ParkedEnableVsync;
+    int m_ParkedDisplayIndex;
+    int m_ParkedDisplayHz;
+
+    // Time-to-first-frame bookkeeping for the current connection attempt
+    enum class FirstFrameDecoder {
+        Cold,      // No parked decoder was waiting
+        Adopted,   // The parked decoder was used
+        Discarded, // A parked decoder didn't match and was rebuilt
+    };
+    Uint32 m_FirstFrameStartTicks;
+    FirstFrameDecoder m_FirstFrameDecoder;
+    SDL_atomic_t m_FirstFramePending;
+
     OpusMSDecoder* m_OpusDecoder;
     IAudioRenderer* m_AudioRenderer;
     DualSenseHapticsRenderer* m_DualSenseHapticsRenderer;
     OPUS_MULTISTREAM_CONFIGURATION m_ActiveAudioConfig;
     OPUS_MULTISTREAM_CONFIGURATION m_OriginalAudioConfig;
     int m_AudioSampleCount;
+
+    // Published by the audio thread for getAudioStats()
+    SDL_atomic_t m_AudioStatsValid;
+    SDL_atomic_t m_AudioBufferedMs;
+    SDL_atomic_t m_AudioTargetMs;
+    SDL_atomic_t m_AudioUnderruns;
+    SDL_atomic_t m_AudioOverruns;
+
+    // Loss recovery. Missing packets are held until the next packet arrives
+    // so its in-band FEC can rebuild the last one.
+    AudioLossRecovery m_AudioLossRecovery;
+    SDL_atomic_t m_AudioFecFrames;
+    SDL_atomic_t m_AudioConcealedFrames;
+    SDL_atomic_t m_AudioLostFrames;
     Uint32 m_DropAudioEndTime;
 
     Overlay::OverlayManager m_OverlayManager;
@@ -375,6 +456,10 @@ private:
     RTP_VIDEO_STATS m_LastAbrVideoStats;
     std::shared_ptr<std::atomic_bool> m_AbrFeedbackInFlight;
     std::shared_ptr<std::atomic_int> m_AbrCurrentBitrateKbps;
+    std::shared_ptr<std::atomic_int> m_BitrateChangesInFlight;
+    std::mutex m_ClientAbrMutex;
+    std::unique_ptr<AbrController> m_ClientAbr; // nullptr unless enabled; guarded by m_ClientAbrMutex
+    int m_PendingClientAbrBitrateKbps;          // guarded by m_ClientAbrMutex
     OverlayMenuPanel* m_MenuPanel; // Qt-based overlay menu window
     OverlayMenuButton* m_MenuButton; // Qt-based floating menu button
     OverlayToast* m_Toast;           // Qt-based toast notification
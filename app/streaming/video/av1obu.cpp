@@ -2,31 +2,14 @@
 
 #include <string.h>
 
-// OBU types we care about (AV1 spec 6.2.2)
-#define OBU_TEMPORAL_DELIMITER 2
-#define OBU_FRAME_HEADER       3
-#define OBU_TILE_GROUP         4
-#define OBU_METADATA           5
-#define OBU_FRAME              6
-
-// A temporal unit from a streaming host is a handful of OBUs. Anything longer is
-// not the layout we rewrite, so we can bail out rather than grow this.
-#define MAX_OBUS 16
-
 // Metadata OBUs that need hoisting are HDR10+ ITU-T T.35, mastering display, and
 // content light level payloads - all well under 100 bytes. They have to be stashed
 // because they move backwards past the frame header while the frame header's own
 // payload moves forwards past them.
 #define MAX_HOISTED_METADATA 512
 
-struct Obu {
-    int type;
-    int headerOffset;   // start of the OBU header
-    int headerLength;   // header + leb128 size field
-    int sizeBytes;      // length of the leb128 size field as actually encoded
-    int payloadOffset;
-    int payloadLength;
-};
+// metadata_type for ITU-T T.35 payloads (AV1 spec 6.7.1)
+#define METADATA_TYPE_ITUT_T35 4
 
 static int leb128Size(uint64_t value)
 {
@@ -52,77 +35,129 @@ static int writeLeb128(uint8_t* out, uint64_t value)
     return size;
 }
 
-// Parses the temporal unit into obus[]. Returns the OBU count, or -1 if the data
-// is malformed or uses a form we can't safely rewrite (missing size fields).
-static int parseObus(const uint8_t* data, int length, Obu* obus)
+// Reads a leb128 value of at most 8 bytes from [data, data + length). Returns the
+// number of bytes it occupied, or 0 if it runs past the end.
+static int readLeb128(const uint8_t* data, int length, uint64_t* value)
+{
+    *value = 0;
+    for (int i = 0; i < 8 && i < length; i++) {
+        *value |= (uint64_t)(data[i] & 0x7F) << (7 * i);
+        if (!(data[i] & 0x80)) {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+bool scanAv1TemporalUnit(const uint8_t* data, int length, Av1TemporalUnitIndex* index)
 {
     int count = 0;
     int pos = 0;
 
     while (pos < length) {
-        if (count == MAX_OBUS) {
-            return -1;
+        if (count == AV1_MAX_OBUS) {
+            return false;
         }
 
         uint8_t header = data[pos];
         if (header & 0x80) {
             // obu_forbidden_bit must be zero
-            return -1;
+            return false;
         }
 
+        Av1Obu& obu = index->obus[count];
+        obu.type = (header >> 3) & 0x0F;
+        obu.temporalId = 0;
+        obu.spatialId = 0;
+
         int headerLength = 1;
         if (header & 0x04) {
             // obu_extension_flag: one more byte of temporal_id/spatial_id
+            if (pos + 1 >= length) {
+                return false;
+            }
+            obu.temporalId = data[pos + 1] >> 5;
+            obu.spatialId = (data[pos + 1] >> 3) & 0x03;
             headerLength++;
         }
         if (!(header & 0x02)) {
             // No obu_size field, so the OBU runs to the end of the buffer and we
             // can't rewrite anything around it.
-            return -1;
+            return false;
         }
         if (pos + headerLength >= length) {
-            return -1;
+            return false;
         }
 
-        // leb128 obu_size
-        uint64_t size = 0;
-        int sizeBytes = 0;
-        for (;;) {
-            if (sizeBytes == 8 || pos + headerLength + sizeBytes >= length) {
-                return -1;
-            }
-            uint8_t byte = data[pos + headerLength + sizeBytes];
-            size |= (uint64_t)(byte & 0x7F) << (7 * sizeBytes);
-            sizeBytes++;
-            if (!(byte & 0x80)) {
-                break;
-            }
+        uint64_t size;
+        int sizeBytes = readLeb128(data + pos + headerLength, length - (pos + headerLength), &size);
+        if (sizeBytes == 0) {
+            return false;
         }
         headerLength += sizeBytes;
 
         if (size > (uint64_t)(length - (pos + headerLength))) {
-            return -1;
+            return false;
         }
 
-        obus[count].type = (header >> 3) & 0x0F;
-        obus[count].headerOffset = pos;
-        obus[count].headerLength = headerLength;
-        obus[count].sizeBytes = sizeBytes;
-        obus[count].payloadOffset = pos + headerLength;
-        obus[count].payloadLength = (int)size;
+        obu.headerOffset = pos;
+        obu.headerLength = headerLength;
+        obu.sizeBytes = sizeBytes;
+        obu.payloadOffset = pos + headerLength;
+        obu.payloadLength = (int)size;
         count++;
 
         pos += headerLength + (int)size;
     }
 
-    return count;
+    index->count = count;
+    return true;
+}
+
+int findAv1Obu(const Av1TemporalUnitIndex* index, int type, int start)
+{
+    for (int i = start; i < index->count; i++) {
+        if (index->obus[i].type == type) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool isAv1Hdr10PlusMetadata(const uint8_t* data, const Av1Obu* obu)
+{
+    if (obu->type != AV1_OBU_METADATA) {
+        return false;
+    }
+
+    const uint8_t* payload = data + obu->payloadOffset;
+    uint64_t metadataType;
+    int typeBytes = readLeb128(payload, obu->payloadLength, &metadataType);
+    if (typeBytes == 0 || metadataType != METADATA_TYPE_ITUT_T35) {
+        return false;
+    }
+
+    // itu_t_t35_country_code 0xB5 (United States), terminal provider code 0x003C
+    // (Samsung), terminal provider oriented code 0x0001, application identifier 4
+    static const uint8_t hdr10PlusPrefix[] = { 0xB5, 0x00, 0x3C, 0x00, 0x01, 0x04 };
+    return obu->payloadLength - typeBytes >= (int)sizeof(hdr10PlusPrefix) &&
+           memcmp(payload + typeBytes, hdr10PlusPrefix, sizeof(hdr10PlusPrefix)) == 0;
 }
 
 int repackAv1TemporalUnit(uint8_t* data, int length)
 {
-    Obu obus[MAX_OBUS];
-    int count = parseObus(data, length, obus);
-    if (count <= 0) {
+    Av1TemporalUnitIndex index;
+    if (!scanAv1TemporalUnit(data, length, &index)) {
+        return length;
+    }
+    return repackAv1TemporalUnit(data, length, &index);
+}
+
+int repackAv1TemporalUnit(uint8_t* data, int length, const Av1TemporalUnitIndex* index)
+{
+    const Av1Obu* obus = index->obus;
+    int count = index->count;
+    if (count == 0) {
         return length;
     }
 
@@ -133,16 +168,16 @@ int repackAv1TemporalUnit(uint8_t* data, int length)
     int tileGroupIdx = -1;
     for (int i = 0; i < count; i++) {
         switch (obus[i].type) {
-        case OBU_FRAME:
+        case AV1_OBU_FRAME:
             // Already in the merged form the decoder wants
             return length;
-        case OBU_FRAME_HEADER:
+        case AV1_OBU_FRAME_HEADER:
             if (frameHeaderIdx >= 0) {
                 return length;
             }
             frameHeaderIdx = i;
             break;
-        case OBU_TILE_GROUP:
+        case AV1_OBU_TILE_GROUP:
             if (tileGroupIdx >= 0) {
                 return length;
             }
@@ -161,7 +196,7 @@ int repackAv1TemporalUnit(uint8_t* data, int length)
     // the merged frame. Only metadata belongs there.
     int metadataLength = 0;
     for (int i = frameHeaderIdx + 1; i < tileGroupIdx; i++) {
-        if (obus[i].type != OBU_METADATA) {
+        if (obus[i].type != AV1_OBU_METADATA) {
             return length;
         }
         metadataLength += obus[i].headerLength + obus[i].payloadLength;
@@ -170,8 +205,8 @@ int repackAv1TemporalUnit(uint8_t* data, int length)
         return length;
     }
 
-    const Obu& frameHeader = obus[frameHeaderIdx];
-    const Obu& tileGroup = obus[tileGroupIdx];
+    const Av1Obu& frameHeader = obus[frameHeaderIdx];
+    const Av1Obu& tileGroup = obus[tileGroupIdx];
 
     // The merged OBU_FRAME reuses the frame header's OBU header, so the tile group's
     // header has to agree with it. If they disagree we'd silently move the tile group
@@ -250,7 +285,7 @@ int repackAv1TemporalUnit(uint8_t* data, int length)
 
     // Reuse the frame header's OBU header so temporal_id/spatial_id survive, but
     // retype it to OBU_FRAME.
-    data[mergedHeaderOffset] = (data[frameHeader.headerOffset] & ~0x78) | (OBU_FRAME << 3);
+    data[mergedHeaderOffset] = (data[frameHeader.headerOffset] & ~0x78) | (AV1_OBU_FRAME << 3);
     int written = 1;
     if (data[mergedHeaderOffset] & 0x04) {
         data[mergedHeaderOffset + 1] = data[frameHeader.headerOffset + 1];
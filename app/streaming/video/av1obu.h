@@ -2,6 +2,49 @@
 
 #include <stdint.h>
 
+// OBU types (AV1 spec 6.2.2)
+#define AV1_OBU_SEQUENCE_HEADER    1
+#define AV1_OBU_TEMPORAL_DELIMITER 2
+#define AV1_OBU_FRAME_HEADER       3
+#define AV1_OBU_TILE_GROUP         4
+#define AV1_OBU_METADATA           5
+#define AV1_OBU_FRAME              6
+
+// A temporal unit from a streaming host is a handful of OBUs: a delimiter, a
+// sequence header on keyframes, a few metadata OBUs for HDR, and the frame.
+// Anything longer isn't something we need to look inside, so the index stays a
+// fixed size and scanning never allocates.
+#define AV1_MAX_OBUS 16
+
+struct Av1Obu {
+    uint8_t type;
+    uint8_t temporalId;  // 0 without an extension header
+    uint8_t spatialId;
+    int headerOffset;    // start of the OBU header
+    int headerLength;    // header + leb128 size field
+    int sizeBytes;       // length of the leb128 size field as actually encoded
+    int payloadOffset;
+    int payloadLength;
+};
+
+struct Av1TemporalUnitIndex {
+    int count;
+    Av1Obu obus[AV1_MAX_OBUS];
+};
+
+// Indexes the OBUs of a temporal unit in a single pass. Returns false if the data
+// is malformed, has an OBU without a size field (which would run to the end of the
+// buffer, hiding anything after it), or has more than AV1_MAX_OBUS OBUs. The index
+// is only meaningful when this returns true.
+bool scanAv1TemporalUnit(const uint8_t* data, int length, Av1TemporalUnitIndex* index);
+
+// Returns the index of the first OBU of the given type at or after start, or -1.
+int findAv1Obu(const Av1TemporalUnitIndex* index, int type, int start = 0);
+
+// True if the OBU is an ITU-T T.35 metadata OBU carrying HDR10+ (ST 2094-40)
+// dynamic metadata, as laid out by the HDR10+ AV1 Metadata Handling Specification.
+bool isAv1Hdr10PlusMetadata(const uint8_t* data, const Av1Obu* obu);
+
 // Repacks an AV1 temporal unit in place, merging an OBU_FRAME_HEADER and its
 // OBU_TILE_GROUP into a single OBU_FRAME and hoisting any OBU_METADATA that sat
 // between them ahead of the merged frame.
@@ -17,5 +60,9 @@
 //
 // Returns the new length, which is never larger than the original. If the temporal
 // unit doesn't match the layout we rewrite, the buffer is left untouched and the
-// original length is returned.
+// original length is returned. index must come from scanAv1TemporalUnit() on the
+// same data, and no longer describes it once the buffer has been rewritten.
+int repackAv1TemporalUnit(uint8_t* data, int length, const Av1TemporalUnitIndex* index);
+
+// Scans and repacks in one call, for callers with no other use for the index.
 int repackAv1TemporalUnit(uint8_t* data, int length);
@@ -6,8 +6,6 @@
 
 #define SDL_CODE_FRAME_READY 0
 
-#define MAX_SLICES 4
-
 typedef struct _VIDEO_STATS {
     uint32_t receivedFrames;
     uint32_t decodedFrames;
@@ -21,8 +19,12 @@ typedef struct _VIDEO_STATS {
     uint32_t framesWithHostProcessingLatency;  // low-res from RTP
     uint64_t totalReassemblyTimeUs;            // high-res (1us)
     uint64_t totalDecodeTimeUs;                // high-res (1us)
+    uint64_t totalDecodeQueueTimeUs;           // high-res (1us), waiting for the decoder to take the frame
     uint64_t totalPacerTimeUs;                 // high-res (1us)
     uint64_t totalRenderTimeUs;                // high-res (1us)
+    uint32_t presentIntervals;                 // count of intervals between presents
+    uint64_t totalPresentIntervalUs;           // high-res (1us)
+    uint64_t totalPresentIntervalSqUs;         // sum of squared intervals (1us^2), for jitter
     uint32_t lastRtt;                          // low-res from enet (1ms)
     uint32_t lastRttVariance;                  // low-res from enet (1ms)
     double totalFps;                           // high-res
@@ -44,9 +46,16 @@ typedef struct _DECODER_PARAMETERS {
     int frameRate;
     bool enableVsync;
     bool enableFramePacing;
+    bool enableVrrPacing;
+    bool enableFrameThreading;
     bool enableVideoEnhancement;
     bool ignoreAspectRatio;
     bool testOnly;
+
+    // Initialize fully but don't start consuming frames from the connection
+    // until resume() is called. Used to build a decoder before one exists,
+    // which happens on a thread other than the main thread.
+    bool startParked;
 } DECODER_PARAMETERS, *PDECODER_PARAMETERS;
 
 #define WINDOW_STATE_CHANGE_SIZE 0x01
@@ -79,4 +88,13 @@ public:
     virtual void renderFrameOnMainThread() = 0;
     virtual void setHdrMode(bool enabled) = 0;
     virtual bool notifyWindowChanged(PWINDOW_STATE_CHANGE_INFO info) = 0;
+
+    // Stops pulling frames from moonlight-common-c and drops any frames still
+    // queued for decode or presentation, leaving the decoder and renderer
+    // initialized but idle. A parked decoder may outlive its connection.
+    virtual void park() = 0;
+
+    // Restarts frame delivery on a parked decoder. This may only be called
+    // with an established connection.
+    virtual bool resume() = 0;
 };
@@ -0,0 +1,83 @@
+#include "decodethreadpolicy.h"
+
+#include <algorithm>
+
+// The old fixed slice count. We never request fewer slices than this
+// (or than the number of cores, if lower).
+#define DEFAULT_SLICES 4
+
+namespace {
+
+// Rough single-core software decode throughput in luma pixels per second
+// for a high bitrate, low-latency game stream on a recent desktop CPU. These only need
+// to be accurate enough to size the thread pool; the software decode
+// benchmark in tests/software_decode_threading measures the real numbers.
+double pixelsPerSecondPerThread(DecodeThreadPolicy::Codec codec)
+{
+    switch (codec) {
+    case DecodeThreadPolicy::Codec::H264:
+        return 120e6;
+    case DecodeThreadPolicy::Codec::HEVC:
+        return 90e6;
+    case DecodeThreadPolicy::Codec::AV1:
+        return 70e6;
+    }
+
+    return 70e6;
+}
+
+}
+
+DecodeThreadPolicy DecodeThreadPolicy::choose(int cpuCount, Codec codec,
+                                              int width, int height, int fps,
+                                              bool allowFrameThreading)
+{
+    DecodeThreadPolicy policy;
+
+    cpuCount = std::max(cpuCount, 1);
+
+    // Leave a core for the receive, audio, and render threads
+    int usableCores = cpuCount > 2 ? cpuCount - 1 : cpuCount;
+
+    double pixelRate = (double)std::max(width, 0) * std::max(height, 0) * std::max(fps, 1);
+    int neededThreads = std::max(1, (int)((pixelRate + pixelsPerSecondPerThread(codec) - 1) / pixelsPerSecondPerThread(codec)));
+
+    // Ask for one slice per thread we need, but not so many that the
+    // slices get thin. Never go below what we requested before.
+    int maxSlices = std::min({ MAX_SLICES, usableCores, std::max(1, height / MIN_SLICE_HEIGHT) });
+    int minSlices = std::min(DEFAULT_SLICES, cpuCount);
+    policy.slicesPerFrame = std::max(minSlices, std::min(neededThreads, maxSlices));
+
+    switch (codec) {
+    case Codec::H264:
+    case Codec::HEVC:
+        // FFmpeg's H.264 decoder decodes slices in parallel, so slice
+        // threading scales with the slice count at no latency cost. Its
+        // HEVC decoder can only slice-thread WPP streams, which hosts
+        // don't produce, so there the extra slices alone add nothing.
+        policy.threadCount = policy.slicesPerFrame;
+        break;
+
+    case Codec::AV1:
+        // dav1d runs tile, reconstruction, and loop filter work in parallel
+        // inside a frame and honors low delay, so it can use every core we
+        // can spare. Frame threading is never needed.
+        policy.threadCount = std::max(minSlices, std::min(neededThreads + 1, usableCores));
+        return policy;
+    }
+
+    // Frame threading replaces slice threading, so it only helps if it
+    // gets more threads working than slices do
+    int sliceThreads = codec == Codec::HEVC ? 1 : policy.threadCount;
+    if (allowFrameThreading && neededThreads > sliceThreads) {
+        int maxLatencyFrames = MAX_FRAME_THREADING_LATENCY_MS * std::max(fps, 1) / 1000;
+        int frameThreads = std::min({ neededThreads, usableCores, 1 + maxLatencyFrames });
+        if (frameThreads > sliceThreads) {
+            policy.mode = ThreadingMode::Frame;
+            policy.threadCount = frameThreads;
+            policy.addedLatencyFrames = frameThreads - 1;
+        }
+    }
+
+    return policy;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+// Upper bound on the slices per frame we request from the host
+#define MAX_SLICES 16
+
+// Never ask for slices shorter than this, since each one costs the
+// encoder some compression efficiency at the slice boundary
+#define MIN_SLICE_HEIGHT 64
+
+// Frame threading adds (threads - 1) frames of decode latency. Only allow
+// it when that added latency stays within this budget.
+#define MAX_FRAME_THREADING_LATENCY_MS 17
+
+// Picks how the software decoders spread work across CPU cores. This is
+// kept free of FFmpeg and SDL so the decision table can be tested and
+// benchmarked on its own.
+class DecodeThreadPolicy
+{
+public:
+    enum class Codec {
+        H264,
+        HEVC,
+        AV1
+    };
+
+    enum class ThreadingMode {
+        // Each thread decodes its own slices (or tiles) of the same frame
+        Slice,
+
+        // Each thread decodes a different frame, at the cost of latency
+        Frame
+    };
+
+    // cpuCount is the number of logical cores. Frame threading is only
+    // considered when allowFrameThreading is set.
+    static DecodeThreadPolicy choose(int cpuCount, Codec codec,
+                                     int width, int height, int fps,
+                                     bool allowFrameThreading);
+
+    // Slices per frame to request from the host. This never depends on
+    // allowFrameThreading, since it is read from the probe decoder.
+    int slicesPerFrame = 1;
+
+    // Value for AVCodecContext::thread_count
+    int threadCount = 1;
+
+    ThreadingMode mode = ThreadingMode::Slice;
+
+    // Frames of latency added by frame threading
+    int addedLatencyFrames = 0;
+};
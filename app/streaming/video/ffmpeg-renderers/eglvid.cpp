@@ -13,11 +13,26 @@
 
 #include <SDL_syswm.h>
 
+extern "C" {
+#include <libavutil/imgutils.h>
+}
+
 // These are extensions, so some platform headers may not provide them
 #ifndef GL_UNPACK_ROW_LENGTH_EXT
 #define GL_UNPACK_ROW_LENGTH_EXT 0x0CF2
 #endif
 
+// Core in OpenGL ES 3.0, which our GLES2 headers don't cover
+#ifndef GL_PIXEL_UNPACK_BUFFER
+#define GL_PIXEL_UNPACK_BUFFER 0x88EC
+#endif
+#ifndef GL_RG_EXT
+#define GL_RG_EXT 0x8227
+#endif
+#ifndef GL_RG8_EXT
+#define GL_RG8_EXT 0x822B
+#endif
+
 typedef struct _VERTEX
 {
     float x, y;
@@ -26,7 +41,7 @@ typedef struct _VERTEX
 
 /* TODO:
  *  - handle more pixel formats
- *  - handle software decoding
+ *  - handle 10-bit software frames
  */
 
 /* DOC/misc:
@@ -75,10 +90,25 @@ EGLRenderer::EGLRenderer(IFFmpegRenderer *backendRenderer)
         m_eglClientWaitSync(nullptr),
         m_GlesMajorVersion(0),
         m_GlesMinorVersion(0),
-        m_HasExtUnpackSubimage(false)
+        m_HasExtUnpackSubimage(false),
+        m_UploadSlots{},
+        m_UploadSlotIndex(0),
+        m_UploadWidth(0),
+        m_UploadHeight(0),
+        m_UploadFormat(AV_PIX_FMT_NONE),
+        m_UploadPlaneWidths{},
+        m_UploadPlaneHeights{},
+        m_UploadPlaneOffsets{},
+        m_UploadFrameSize(0),
+        m_UploadStagingBuffer(nullptr),
+        m_UploadChromaInternalFormat(0),
+        m_UsePbo(false),
+        m_UsePersistentMapping(false),
+        m_glMapBufferRange(nullptr),
+        m_glUnmapBuffer(nullptr),
+        m_glBufferStorageEXT(nullptr)
 {
-    SDL_assert(backendRenderer);
-    SDL_assert(backendRenderer->canExportEGL());
+    SDL_assert(!backendRenderer || backendRenderer->canExportEGL());
 }
 
 EGLRenderer::~EGLRenderer()
@@ -90,6 +120,7 @@ EGLRenderer::~EGLRenderer()
             SDL_assert(m_eglDestroySync != nullptr);
             m_eglDestroySync(m_EGLDisplay, m_LastRenderSync);
         }
+        destroyUploadRing();
         if (m_ShaderProgram) {
             glDeleteProgram(m_ShaderProgram);
         }
@@ -116,7 +147,12 @@ bool EGLRenderer::prepareDecoderContext(AVCodecContext*, AVDictionary**)
 {
     /* Nothing to do */
 
-    EGL_LOG(Info, "Using EGL renderer");
+    if (m_Backend != nullptr) {
+        EGL_LOG(Info, "Using EGL renderer");
+    }
+    else {
+        EGL_LOG(Info, "Using EGL renderer with software frame upload");
+    }
 
     return true;
 }
@@ -142,12 +178,26 @@ bool EGLRenderer::notifyWindowChanged(PWINDOW_STATE_CHANGE_INFO info)
 
 bool EGLRenderer::isPixelFormatSupported(int videoFormat, AVPixelFormat pixelFormat)
 {
+    if (m_Backend == nullptr) {
+        // Software frames are uploaded as 8-bit NV12. P010 stays with
+        // SdlRenderer, since we don't render HDR and initialize() turns
+        // down 10-bit streams before loading GL.
+        return !(videoFormat & (VIDEO_FORMAT_MASK_10BIT | VIDEO_FORMAT_MASK_YUV444)) &&
+               (pixelFormat == AV_PIX_FMT_YUV420P || pixelFormat == AV_PIX_FMT_YUVJ420P ||
+                pixelFormat == AV_PIX_FMT_NV12);
+    }
+
     // Pixel format support should be determined by the backend renderer
     return m_Backend->isPixelFormatSupported(videoFormat, pixelFormat);
 }
 
 AVPixelFormat EGLRenderer::getPreferredPixelFormat(int videoFormat)
 {
+    if (m_Backend == nullptr) {
+        return (videoFormat & (VIDEO_FORMAT_MASK_10BIT | VIDEO_FORMAT_MASK_YUV444)) ?
+                    AV_PIX_FMT_NONE : AV_PIX_FMT_YUV420P;
+    }
+
     // Pixel format preference should be determined by the backend renderer
     return m_Backend->getPreferredPixelFormat(videoFormat);
 }
@@ -267,7 +317,8 @@ void EGLRenderer::renderOverlay(Overlay::OverlayType type, int viewportWidth, in
 }
 
 int EGLRenderer::loadAndBuildShader(int shaderType,
-                                    const char *file) {
+                                    const char *file,
+                                    const char *defines) {
     GLuint shader = glCreateShader(shaderType);
     if (!shader || shader == GL_INVALID_ENUM) {
         EGL_LOG(Error, "Can't create shader: %d", glGetError());
@@ -275,6 +326,9 @@ int EGLRenderer::loadAndBuildShader(int shaderType,
     }
 
     auto sourceData = Path::readDataFile(file);
+    if (defines != nullptr) {
+        sourceData.prepend(defines);
+    }
     GLint len = sourceData.size();
     const char *buf = sourceData.data();
 
@@ -292,14 +346,15 @@ int EGLRenderer::loadAndBuildShader(int shaderType,
     return shader;
 }
 
-unsigned EGLRenderer::compileShader(const char* vertexShaderSrc, const char* fragmentShaderSrc) {
+unsigned EGLRenderer::compileShader(const char* vertexShaderSrc, const char* fragmentShaderSrc,
+                                    const char* fragmentDefines) {
     unsigned shader = 0;
 
     GLuint vertexShader = loadAndBuildShader(GL_VERTEX_SHADER, vertexShaderSrc);
     if (!vertexShader)
         return false;
 
-    GLuint fragmentShader = loadAndBuildShader(GL_FRAGMENT_SHADER, fragmentShaderSrc);
+    GLuint fragmentShader = loadAndBuildShader(GL_FRAGMENT_SHADER, fragmentShaderSrc, fragmentDefines);
     if (!fragmentShader)
         goto fragError;
 
@@ -342,8 +397,11 @@ bool EGLRenderer::compileShaders() {
     SDL_assert(m_EGLImagePixelFormat != AV_PIX_FMT_NONE);
 
     // XXX: TODO: other formats
-    if (m_EGLImagePixelFormat == AV_PIX_FMT_NV12 || m_EGLImagePixelFormat == AV_PIX_FMT_P010) {
-        m_ShaderProgram = compileShader("egl.vert", "egl_nv12.frag");
+    if (m_EGLImagePixelFormat == AV_PIX_FMT_NV12 || m_EGLImagePixelFormat == AV_PIX_FMT_P010 ||
+            m_EGLImagePixelFormat == AV_PIX_FMT_YUV420P || m_EGLImagePixelFormat == AV_PIX_FMT_YUVJ420P) {
+        // Uploaded software frames are laid out as NV12 too, just in 2D textures
+        m_ShaderProgram = compileShader("egl.vert", "egl_nv12.frag",
+                                        m_Backend == nullptr ? "#define PLANE_TEXTURE_2D\n" : nullptr);
         if (!m_ShaderProgram) {
             return false;
         }
@@ -513,23 +571,27 @@ bool EGLRenderer::initialize(PDECODER_PARAMETERS params)
     }
 
     const EGLExtensions eglExtensions(m_EGLDisplay);
-    if (!eglExtensions.isSupported("EGL_KHR_image_base") &&
-        !eglExtensions.isSupported("EGL_KHR_image")) {
-        EGL_LOG(Error, "EGL_KHR_image unsupported");
-        return false;
-    }
-    else if (!SDL_GL_ExtensionSupported("GL_OES_EGL_image")) {
-        EGL_LOG(Error, "GL_OES_EGL_image unsupported");
-        return false;
-    }
 
-    if (!m_Backend->initializeEGL(this, m_EGLDisplay, eglExtensions))
-        return false;
+    // Software frames are uploaded, so they don't need EGLImage support
+    if (m_Backend != nullptr) {
+        if (!eglExtensions.isSupported("EGL_KHR_image_base") &&
+            !eglExtensions.isSupported("EGL_KHR_image")) {
+            EGL_LOG(Error, "EGL_KHR_image unsupported");
+            return false;
+        }
+        else if (!SDL_GL_ExtensionSupported("GL_OES_EGL_image")) {
+            EGL_LOG(Error, "GL_OES_EGL_image unsupported");
+            return false;
+        }
 
-    if (!(m_glEGLImageTargetTexture2DOES = (typeof(m_glEGLImageTargetTexture2DOES))eglGetProcAddress("glEGLImageTargetTexture2DOES"))) {
-        EGL_LOG(Error,
-                "EGL: cannot retrieve `glEGLImageTargetTexture2DOES` address");
-        return false;
+        if (!m_Backend->initializeEGL(this, m_EGLDisplay, eglExtensions))
+            return false;
+
+        if (!(m_glEGLImageTargetTexture2DOES = (typeof(m_glEGLImageTargetTexture2DOES))eglGetProcAddress("glEGLImageTargetTexture2DOES"))) {
+            EGL_LOG(Error,
+                    "EGL: cannot retrieve `glEGLImageTargetTexture2DOES` address");
+            return false;
+        }
     }
 
     // Vertex arrays are an extension on OpenGL ES 2.0
@@ -574,6 +636,40 @@ bool EGLRenderer::initialize(PDECODER_PARAMETERS params)
         m_eglClientWaitSync = nullptr;
     }
 
+    if (m_Backend == nullptr) {
+        // The interleaved chroma plane needs a two channel texture. Luminance
+        // alpha would land the V samples in .w where the shader doesn't look.
+        if (m_GlesMajorVersion >= 3) {
+            m_UploadChromaInternalFormat = GL_RG8_EXT;
+        }
+        else if (SDL_GL_ExtensionSupported("GL_EXT_texture_rg")) {
+            m_UploadChromaInternalFormat = GL_RG_EXT;
+        }
+        else {
+            EGL_LOG(Error, "GL_EXT_texture_rg unsupported");
+            return false;
+        }
+
+        // Pixel unpack buffers are core in OpenGL ES 3.0. Without them, we
+        // fall back to uploading straight from client memory.
+        if (m_GlesMajorVersion >= 3) {
+            m_glMapBufferRange = (typeof(m_glMapBufferRange))eglGetProcAddress("glMapBufferRange");
+            m_glUnmapBuffer = (typeof(m_glUnmapBuffer))eglGetProcAddress("glUnmapBuffer");
+            m_UsePbo = m_glMapBufferRange != nullptr && m_glUnmapBuffer != nullptr;
+        }
+
+        // Persistent mappings skip the map/unmap per frame, but we can only
+        // tell when the GPU is done reading one with fences.
+        if (m_UsePbo && m_eglClientWaitSync != nullptr && SDL_GL_ExtensionSupported("GL_EXT_buffer_storage")) {
+            m_glBufferStorageEXT = (typeof(m_glBufferStorageEXT))eglGetProcAddress("glBufferStorageEXT");
+            m_UsePersistentMapping = m_glBufferStorageEXT != nullptr;
+        }
+
+        EGL_LOG(Info, "Software frame upload: %s",
+                m_UsePersistentMapping ? "persistent-mapped buffers" :
+                m_UsePbo ? "pixel unpack buffers" : "client memory");
+    }
+
     // SDL always uses swap interval 0 under the hood on Wayland systems,
     // because the compositor guarantees tear-free rendering. In this
     // situation, swap interval > 0 behaves as a frame pacing option
@@ -623,14 +719,17 @@ bool EGLRenderer::initialize(PDECODER_PARAMETERS params)
 }
 
 bool EGLRenderer::setupVideoRenderingState() {
-    // Setup the video plane textures
-    glGenTextures(EGL_MAX_PLANES, m_Textures);
-    for (size_t i = 0; i < EGL_MAX_PLANES; ++i) {
-        glBindTexture(GL_TEXTURE_EXTERNAL_OES, m_Textures[i]);
-        glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    // Setup the video plane textures. Software frames get theirs from
+    // setupUploadRing() once we know the frame dimensions.
+    if (m_Backend != nullptr) {
+        glGenTextures(EGL_MAX_PLANES, m_Textures);
+        for (size_t i = 0; i < EGL_MAX_PLANES; ++i) {
+            glBindTexture(GL_TEXTURE_EXTERNAL_OES, m_Textures[i]);
+            glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_EXTERNAL_OES, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        }
     }
 
     // The viewport should have the aspect ratio of the video stream
@@ -727,13 +826,11 @@ void EGLRenderer::waitToRender()
     // Our fence will wait until the previous frame is drawn (non-blocking swapbuffers case)
     // or until the new back buffer is available (blocking swapbuffers case)
     if (m_LastRenderSync != EGL_NO_SYNC) {
-        SDL_assert(m_eglClientWaitSync != nullptr);
-        m_eglClientWaitSync(m_EGLDisplay, m_LastRenderSync, EGL_SYNC_FLUSH_COMMANDS_BIT, EGL_FOREVER);
-        m_eglDestroySync(m_EGLDisplay, m_LastRenderSync);
-        m_LastRenderSync = EGL_NO_SYNC;
+        waitForFence(m_LastRenderSync);
     }
-    else {
-        // Use glFinish() if fences aren't available
+    else if (m_Backend != nullptr || m_BlockingSwapBuffers) {
+        // Use glFinish() if fences aren't available. Uploaded software frames
+        // don't need it because the upload ring tracks its own buffers.
         glFinish();
     }
 }
@@ -750,6 +847,226 @@ void EGLRenderer::prepareToRender()
     SDL_GL_MakeCurrent(m_Window, nullptr);
 }
 
+EGLSync EGLRenderer::createFence()
+{
+    if (m_eglCreateSync != nullptr) {
+        return m_eglCreateSync(m_EGLDisplay, EGL_SYNC_FENCE, nullptr);
+    }
+    else {
+        SDL_assert(m_eglCreateSyncKHR != nullptr);
+        return m_eglCreateSyncKHR(m_EGLDisplay, EGL_SYNC_FENCE, nullptr);
+    }
+}
+
+void EGLRenderer::waitForFence(EGLSync& sync)
+{
+    if (sync != EGL_NO_SYNC) {
+        SDL_assert(m_eglClientWaitSync != nullptr);
+        m_eglClientWaitSync(m_EGLDisplay, sync, EGL_SYNC_FLUSH_COMMANDS_BIT, EGL_FOREVER);
+        m_eglDestroySync(m_EGLDisplay, sync);
+        sync = EGL_NO_SYNC;
+    }
+}
+
+bool EGLRenderer::setupUploadRing(AVFrame* frame)
+{
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get((AVPixelFormat)frame->format);
+    if (desc == nullptr) {
+        SDL_assert(desc);
+        return false;
+    }
+
+    // Luma and interleaved chroma are packed back to back with no row padding
+    m_UploadFrameSize = 0;
+    for (int i = 0; i < EGL_UPLOAD_PLANES; i++) {
+        m_UploadPlaneWidths[i] = i == 0 ? frame->width : AV_CEIL_RSHIFT(frame->width, desc->log2_chroma_w);
+        m_UploadPlaneHeights[i] = i == 0 ? frame->height : AV_CEIL_RSHIFT(frame->height, desc->log2_chroma_h);
+        m_UploadPlaneOffsets[i] = m_UploadFrameSize;
+        m_UploadFrameSize += (size_t)m_UploadPlaneWidths[i] * m_UploadPlaneHeights[i] * (i == 0 ? 1 : 2);
+    }
+
+    for (UploadSlot& slot : m_UploadSlots) {
+        // Each slot has its own textures, so uploading the next frame never
+        // has to wait for the draw that is still sampling the previous one.
+        glGenTextures(EGL_UPLOAD_PLANES, slot.textures);
+        for (int i = 0; i < EGL_UPLOAD_PLANES; i++) {
+            glBindTexture(GL_TEXTURE_2D, slot.textures[i]);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            if (i == 0) {
+                glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, m_UploadPlaneWidths[i], m_UploadPlaneHeights[i],
+                             0, GL_LUMINANCE, GL_UNSIGNED_BYTE, nullptr);
+            }
+            else {
+                glTexImage2D(GL_TEXTURE_2D, 0, m_UploadChromaInternalFormat, m_UploadPlaneWidths[i], m_UploadPlaneHeights[i],
+                             0, GL_RG_EXT, GL_UNSIGNED_BYTE, nullptr);
+            }
+        }
+
+        if (m_UsePbo) {
+            glGenBuffers(1, &slot.pbo);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+            if (m_UsePersistentMapping) {
+                const GLbitfield flags = GL_MAP_WRITE_BIT_EXT | GL_MAP_PERSISTENT_BIT_EXT | GL_MAP_COHERENT_BIT_EXT;
+                m_glBufferStorageEXT(GL_PIXEL_UNPACK_BUFFER, m_UploadFrameSize, nullptr, flags);
+                slot.mapping = m_glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, m_UploadFrameSize, flags);
+                if (slot.mapping == nullptr) {
+                    EGL_LOG(Warn, "Persistent buffer mapping failed: %d", glGetError());
+                    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+                    // Try again with regular pixel unpack buffers
+                    destroyUploadRing();
+                    m_UsePersistentMapping = false;
+                    return setupUploadRing(frame);
+                }
+            }
+            else {
+                glBufferData(GL_PIXEL_UNPACK_BUFFER, m_UploadFrameSize, nullptr, GL_STREAM_DRAW);
+            }
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+    }
+
+    if (!m_UsePbo) {
+        m_UploadStagingBuffer = (uint8_t*)malloc(m_UploadFrameSize);
+        if (m_UploadStagingBuffer == nullptr) {
+            destroyUploadRing();
+            return false;
+        }
+    }
+
+    GLenum err = glGetError();
+    if (err != GL_NO_ERROR) {
+        EGL_LOG(Error, "Failed to create upload ring: %d", err);
+        destroyUploadRing();
+        return false;
+    }
+
+    m_UploadWidth = frame->width;
+    m_UploadHeight = frame->height;
+    m_UploadFormat = (AVPixelFormat)frame->format;
+    m_UploadSlotIndex = 0;
+
+    EGL_LOG(Info, "Created %d-slot upload ring for %dx%d %s frames",
+            EGL_UPLOAD_RING_SIZE, frame->width, frame->height, desc->name);
+    return true;
+}
+
+void EGLRenderer::destroyUploadRing()
+{
+    for (UploadSlot& slot : m_UploadSlots) {
+        if (slot.fence != EGL_NO_SYNC) {
+            m_eglDestroySync(m_EGLDisplay, slot.fence);
+        }
+        if (slot.mapping != nullptr) {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+            m_glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+        if (slot.pbo != 0) {
+            glDeleteBuffers(1, &slot.pbo);
+        }
+        glDeleteTextures(EGL_UPLOAD_PLANES, slot.textures);
+
+        slot = {};
+    }
+
+    free(m_UploadStagingBuffer);
+    m_UploadStagingBuffer = nullptr;
+
+    m_UploadWidth = m_UploadHeight = 0;
+    m_UploadFormat = AV_PIX_FMT_NONE;
+}
+
+bool EGLRenderer::uploadSoftwareFrame(AVFrame* frame)
+{
+    if (frame->width != m_UploadWidth || frame->height != m_UploadHeight || frame->format != m_UploadFormat) {
+        destroyUploadRing();
+        if (!setupUploadRing(frame)) {
+            return false;
+        }
+    }
+
+    UploadSlot& slot = m_UploadSlots[m_UploadSlotIndex];
+
+    // Wait until the GPU is done with the last frame drawn from this slot.
+    // That was two frames ago, so this rarely has to block.
+    waitForFence(slot.fence);
+
+    uint8_t* dst;
+    if (slot.mapping != nullptr) {
+        dst = (uint8_t*)slot.mapping;
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+    }
+    else if (m_UsePbo) {
+        // Without a fence to wait on, let the driver orphan the old storage
+        // instead of synchronizing with draws that may still be reading it.
+        GLbitfield access = GL_MAP_WRITE_BIT_EXT | GL_MAP_INVALIDATE_BUFFER_BIT_EXT;
+        if (m_eglClientWaitSync != nullptr) {
+            access |= GL_MAP_UNSYNCHRONIZED_BIT_EXT;
+        }
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+        dst = (uint8_t*)m_glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, m_UploadFrameSize, access);
+        if (dst == nullptr) {
+            EGL_LOG(Error, "glMapBufferRange() failed: %d", glGetError());
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+            return false;
+        }
+    }
+    else {
+        dst = m_UploadStagingBuffer;
+    }
+
+    av_image_copy_plane(dst + m_UploadPlaneOffsets[0], m_UploadPlaneWidths[0],
+                        frame->data[0], frame->linesize[0],
+                        m_UploadPlaneWidths[0], m_UploadPlaneHeights[0]);
+    if (frame->format == AV_PIX_FMT_NV12) {
+        av_image_copy_plane(dst + m_UploadPlaneOffsets[1], m_UploadPlaneWidths[1] * 2,
+                            frame->data[1], frame->linesize[1],
+                            m_UploadPlaneWidths[1] * 2, m_UploadPlaneHeights[1]);
+    }
+    else {
+        // Interleave the planar chroma while we're copying it anyway
+        for (int y = 0; y < m_UploadPlaneHeights[1]; y++) {
+            uint8_t* chroma = dst + m_UploadPlaneOffsets[1] + (size_t)y * m_UploadPlaneWidths[1] * 2;
+            const uint8_t* u = frame->data[1] + (ptrdiff_t)y * frame->linesize[1];
+            const uint8_t* v = frame->data[2] + (ptrdiff_t)y * frame->linesize[2];
+            for (int x = 0; x < m_UploadPlaneWidths[1]; x++) {
+                chroma[x * 2] = u[x];
+                chroma[x * 2 + 1] = v[x];
+            }
+        }
+    }
+
+    if (m_UsePbo && slot.mapping == nullptr) {
+        m_glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+
+    // Our rows are tightly packed, so chroma widths may be odd
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (int i = 0; i < EGL_UPLOAD_PLANES; i++) {
+        // With a bound unpack buffer, the pointer is an offset into it
+        const void* pixels = m_UsePbo ?
+                    (const void*)(uintptr_t)m_UploadPlaneOffsets[i] :
+                    (const void*)(dst + m_UploadPlaneOffsets[i]);
+
+        glActiveTexture(GL_TEXTURE0 + i);
+        glBindTexture(GL_TEXTURE_2D, slot.textures[i]);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_UploadPlaneWidths[i], m_UploadPlaneHeights[i],
+                        i == 0 ? GL_LUMINANCE : GL_RG_EXT, GL_UNSIGNED_BYTE, pixels);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    if (m_UsePbo) {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    return true;
+}
+
 void EGLRenderer::renderFrame(AVFrame* frame)
 {
     EGLImage imgs[EGL_MAX_PLANES];
@@ -762,7 +1079,8 @@ void EGLRenderer::renderFrame(AVFrame* frame)
 
     // Find the native read-back format and load the shaders
     if (m_EGLImagePixelFormat == AV_PIX_FMT_NONE) {
-        m_EGLImagePixelFormat = m_Backend->getEGLImagePixelFormat();
+        m_EGLImagePixelFormat = m_Backend != nullptr ?
+                    m_Backend->getEGLImagePixelFormat() : (AVPixelFormat)frame->format;
         EGL_LOG(Info, "EGLImage pixel format: %d", m_EGLImagePixelFormat);
 
         SDL_assert(m_EGLImagePixelFormat != AV_PIX_FMT_NONE);
@@ -786,13 +1104,18 @@ void EGLRenderer::renderFrame(AVFrame* frame)
         }
     }
 
-    ssize_t plane_count = m_Backend->exportEGLImages(frame, m_EGLDisplay, imgs);
-    if (plane_count < 0)
+    if (m_Backend != nullptr) {
+        ssize_t plane_count = m_Backend->exportEGLImages(frame, m_EGLDisplay, imgs);
+        if (plane_count < 0)
+            return;
+        for (ssize_t i = 0; i < plane_count; ++i) {
+            glActiveTexture(GL_TEXTURE0 + i);
+            glBindTexture(GL_TEXTURE_EXTERNAL_OES, m_Textures[i]);
+            m_glEGLImageTargetTexture2DOES(GL_TEXTURE_EXTERNAL_OES, imgs[i]);
+        }
+    }
+    else if (!uploadSoftwareFrame(frame)) {
         return;
-    for (ssize_t i = 0; i < plane_count; ++i) {
-        glActiveTexture(GL_TEXTURE0 + i);
-        glBindTexture(GL_TEXTURE_EXTERNAL_OES, m_Textures[i]);
-        m_glEGLImageTargetTexture2DOES(GL_TEXTURE_EXTERNAL_OES, imgs[i]);
     }
 
     // We already called glClear() after last frame's SDL_GL_SwapWindow()
@@ -817,7 +1140,7 @@ void EGLRenderer::renderFrame(AVFrame* frame)
     glUseProgram(m_ShaderProgram);
 
     // If the frame format has changed, we'll need to recompute the constants
-    if (hasFrameFormatChanged(frame) && (m_EGLImagePixelFormat == AV_PIX_FMT_NV12 || m_EGLImagePixelFormat == AV_PIX_FMT_P010)) {
+    if (hasFrameFormatChanged(frame) && m_EGLImagePixelFormat != AV_PIX_FMT_DRM_PRIME) {
         std::array<float, 9> colorMatrix;
         std::array<float, 3> yuvOffsets;
         std::array<float, 2> chromaOffset;
@@ -837,19 +1160,21 @@ void EGLRenderer::renderFrame(AVFrame* frame)
     glDrawArrays(GL_TRIANGLES, 0, 6);
     m_glBindVertexArrayOES(0);
 
-    if (!m_BlockingSwapBuffers) {
+    if (m_Backend == nullptr) {
+        // The frame was copied into the upload ring, so Pacer can free it
+        // right away. We only need to know when the GPU is done with this slot.
+        if (m_eglClientWaitSync != nullptr) {
+            m_UploadSlots[m_UploadSlotIndex].fence = createFence();
+        }
+        m_UploadSlotIndex = (m_UploadSlotIndex + 1) % EGL_UPLOAD_RING_SIZE;
+    }
+    else if (!m_BlockingSwapBuffers) {
         // If we aren't going to wait on the full swap buffers operation,
         // insert a fence now to let us know when the memory backing our
         // video frame is safe for Pacer to free
         if (m_eglClientWaitSync != nullptr) {
             SDL_assert(m_LastRenderSync == EGL_NO_SYNC);
-            if (m_eglCreateSync != nullptr) {
-                m_LastRenderSync = m_eglCreateSync(m_EGLDisplay, EGL_SYNC_FENCE, nullptr);
-            }
-            else {
-                SDL_assert(m_eglCreateSyncKHR != nullptr);
-                m_LastRenderSync = m_eglCreateSyncKHR(m_EGLDisplay, EGL_SYNC_FENCE, nullptr);
-            }
+            m_LastRenderSync = createFence();
         }
     }
 
@@ -867,13 +1192,7 @@ void EGLRenderer::renderFrame(AVFrame* frame)
         glClear(GL_COLOR_BUFFER_BIT);
         if (m_eglClientWaitSync != nullptr) {
             SDL_assert(m_LastRenderSync == EGL_NO_SYNC);
-            if (m_eglCreateSync != nullptr) {
-                m_LastRenderSync = m_eglCreateSync(m_EGLDisplay, EGL_SYNC_FENCE, nullptr);
-            }
-            else {
-                SDL_assert(m_eglCreateSyncKHR != nullptr);
-                m_LastRenderSync = m_eglCreateSyncKHR(m_EGLDisplay, EGL_SYNC_FENCE, nullptr);
-            }
+            m_LastRenderSync = createFence();
         }
     }
 }
@@ -882,6 +1201,12 @@ bool EGLRenderer::testRenderFrame(AVFrame* frame)
 {
     EGLImage imgs[EGL_MAX_PLANES];
 
+    // Software frames are uploaded, so any format we accept will work
+    if (m_Backend == nullptr) {
+        return frame->format == AV_PIX_FMT_YUV420P || frame->format == AV_PIX_FMT_YUVJ420P ||
+               frame->format == AV_PIX_FMT_NV12;
+    }
+
     // Make sure we can get working EGLImages from the backend renderer.
     // Some devices (Raspberry Pi) will happily decode into DRM formats that
     // its own GL implementation won't accept in eglCreateImage().
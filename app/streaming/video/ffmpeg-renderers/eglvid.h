@@ -8,7 +8,10 @@
 
 class EGLRenderer : public IFFmpegRenderer {
 public:
-    EGLRenderer(IFFmpegRenderer *backendRenderer);
+    // With no backend renderer, frames are software frames that are
+    // uploaded to textures through a ring of pixel unpack buffers, in the
+    // NV12 layout the hardware frames are sampled in.
+    EGLRenderer(IFFmpegRenderer *backendRenderer = nullptr);
     virtual ~EGLRenderer() override;
     virtual bool initialize(PDECODER_PARAMETERS params) override;
     virtual bool prepareDecoderContext(AVCodecContext* context, AVDictionary** options) override;
@@ -25,11 +28,26 @@ public:
 private:
 
     void renderOverlay(Overlay::OverlayType type, int viewportWidth, int viewportHeight);
-    unsigned compileShader(const char* vertexShaderSrc, const char* fragmentShaderSrc);
+    unsigned compileShader(const char* vertexShaderSrc, const char* fragmentShaderSrc,
+                           const char* fragmentDefines = nullptr);
     bool compileShaders();
     bool setupVideoRenderingState();
     bool setupOverlayRenderingState();
-    static int loadAndBuildShader(int shaderType, const char *filename);
+    static int loadAndBuildShader(int shaderType, const char *filename, const char *defines = nullptr);
+    EGLSync createFence();
+    void waitForFence(EGLSync& sync);
+    bool setupUploadRing(AVFrame* frame);
+    void destroyUploadRing();
+    bool uploadSoftwareFrame(AVFrame* frame);
+
+#define EGL_UPLOAD_RING_SIZE 3
+#define EGL_UPLOAD_PLANES 2
+    struct UploadSlot {
+        unsigned pbo;
+        void* mapping;
+        unsigned textures[EGL_UPLOAD_PLANES];
+        EGLSync fence;
+    };
 
     AVPixelFormat m_EGLImagePixelFormat;
     void *m_EGLDisplay;
@@ -58,6 +76,23 @@ private:
     int m_GlesMinorVersion;
     bool m_HasExtUnpackSubimage;
 
+    UploadSlot m_UploadSlots[EGL_UPLOAD_RING_SIZE];
+    int m_UploadSlotIndex;
+    int m_UploadWidth;
+    int m_UploadHeight;
+    AVPixelFormat m_UploadFormat;
+    int m_UploadPlaneWidths[EGL_UPLOAD_PLANES];
+    int m_UploadPlaneHeights[EGL_UPLOAD_PLANES];
+    size_t m_UploadPlaneOffsets[EGL_UPLOAD_PLANES];
+    size_t m_UploadFrameSize;
+    uint8_t* m_UploadStagingBuffer;
+    unsigned m_UploadChromaInternalFormat;
+    bool m_UsePbo;
+    bool m_UsePersistentMapping;
+    PFNGLMAPBUFFERRANGEEXTPROC m_glMapBufferRange;
+    PFNGLUNMAPBUFFEROESPROC m_glUnmapBuffer;
+    PFNGLBUFFERSTORAGEEXTPROC m_glBufferStorageEXT;
+
 #define NV12_PARAM_YUVMAT 0
 #define NV12_PARAM_OFFSET 1
 #define NV12_PARAM_CHROMA_OFFSET 2
@@ -0,0 +1,221 @@
+#include "nullrenderer.h"
+#include "utils.h"
+
+#include <Limelight.h>
+
+#include <QByteArray>
+
+#include <cstdio>
+
+extern "C" {
+#include <libavutil/imgutils.h>
+}
+
+// Enough for 18 minutes at 60 FPS. Longer soak runs keep the most recent.
+#define MAX_PRESENT_RECORDS (1 << 16)
+
+NullRenderer::NullRenderer()
+    : IFFmpegRenderer(RendererType::Null),
+      m_SwFrameMapper(this),
+      m_SimulateUpload(false),
+      m_RecordLock(0),
+      m_PresentedFrames(0),
+      m_TotalLatencyUs(0),
+      m_MaxLatencyUs(0)
+{
+
+}
+
+NullRenderer::~NullRenderer()
+{
+    // Test-only instances never present anything, so they don't clobber
+    // the trace of the real one
+    if (m_PresentedFrames == 0) {
+        return;
+    }
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Null renderer presented %llu frames (decode to present: %.2f ms average, %.2f ms max)",
+                (unsigned long long)m_PresentedFrames,
+                m_TotalLatencyUs / 1000.0 / m_PresentedFrames,
+                m_MaxLatencyUs / 1000.0);
+
+    QByteArray tracePath = qgetenv("NULL_RENDERER_TRACE");
+    if (!tracePath.isEmpty()) {
+        writeTrace(tracePath.constData());
+    }
+}
+
+bool NullRenderer::isEnabled()
+{
+    return qEnvironmentVariableIntValue("NULL_RENDERER") != 0;
+}
+
+bool NullRenderer::initialize(PDECODER_PARAMETERS params)
+{
+    m_SwFrameMapper.setVideoFormat(params->videoFormat);
+
+    if (!Utils::getEnvironmentVariableOverride("NULL_RENDERER_UPLOAD", &m_SimulateUpload)) {
+        m_SimulateUpload = false;
+    }
+
+    // Allocated here rather than in the constructor, since the decoder
+    // creates throwaway instances just to ask about pixel formats
+    m_Records.resize(MAX_PRESENT_RECORDS);
+
+    return true;
+}
+
+bool NullRenderer::prepareDecoderContext(AVCodecContext*, AVDictionary**)
+{
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Using null renderer (upload simulation: %s)",
+                m_SimulateUpload ? "on" : "off");
+
+    return true;
+}
+
+bool NullRenderer::isPixelFormatSupported(int, AVPixelFormat pixelFormat)
+{
+    // Anything in system memory will do
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(pixelFormat);
+    return desc != nullptr && !(desc->flags & AV_PIX_FMT_FLAG_HWACCEL);
+}
+
+bool NullRenderer::notifyWindowChanged(PWINDOW_STATE_CHANGE_INFO)
+{
+    // Nothing we draw depends on the window
+    return true;
+}
+
+bool NullRenderer::testRenderFrame(AVFrame* frame)
+{
+    // Make sure a hardware backend's frames can be read back
+    if (frame->hw_frames_ctx != nullptr) {
+        AVFrame* swFrame = m_SwFrameMapper.getSwFrameFromHwFrame(frame);
+        if (swFrame == nullptr) {
+            return false;
+        }
+
+        av_frame_free(&swFrame);
+    }
+
+    return true;
+}
+
+void NullRenderer::simulateUpload(const AVFrame* frame)
+{
+    AVPixelFormat format = (AVPixelFormat)frame->format;
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(format);
+    if (desc == nullptr) {
+        return;
+    }
+
+    size_t offset = 0;
+    for (int i = 0; i < av_pix_fmt_count_planes(format); i++) {
+        int lineBytes = av_image_get_linesize(format, frame->width, i);
+        if (lineBytes <= 0) {
+            continue;
+        }
+
+        // Only the chroma planes are subsampled
+        int lines = (i == 1 || i == 2) ?
+                        AV_CEIL_RSHIFT(frame->height, desc->log2_chroma_h) :
+                        frame->height;
+
+        size_t planeBytes = (size_t)lineBytes * lines;
+        if (m_UploadBuffer.size() < offset + planeBytes) {
+            m_UploadBuffer.resize(offset + planeBytes);
+        }
+
+        av_image_copy_plane(m_UploadBuffer.data() + offset, lineBytes,
+                            frame->data[i], frame->linesize[i],
+                            lineBytes, lines);
+        offset += planeBytes;
+    }
+}
+
+void NullRenderer::renderFrame(AVFrame* frame)
+{
+    AVFrame* swFrame = nullptr;
+
+    if (frame->hw_frames_ctx != nullptr) {
+        // Reading the frame back is part of what it costs to use
+        // an indirect backend, so it happens whether or not we upload
+        swFrame = m_SwFrameMapper.getSwFrameFromHwFrame(frame);
+        if (swFrame == nullptr) {
+            return;
+        }
+    }
+
+    if (m_SimulateUpload) {
+        simulateUpload(swFrame != nullptr ? swFrame : frame);
+    }
+
+    av_frame_free(&swFrame);
+
+    uint64_t presentTimeUs = LiGetMicroseconds();
+
+    SDL_AtomicLock(&m_RecordLock);
+
+    PresentRecord& record = m_Records[m_PresentedFrames % m_Records.size()];
+    record.pts = frame->pts;
+    record.decodedTimeUs = (uint64_t)frame->pkt_dts;
+    record.presentTimeUs = presentTimeUs;
+    m_PresentedFrames++;
+
+    if (frame->pkt_dts > 0 && (uint64_t)frame->pkt_dts <= presentTimeUs) {
+        uint64_t latencyUs = presentTimeUs - (uint64_t)frame->pkt_dts;
+        m_TotalLatencyUs += latencyUs;
+        m_MaxLatencyUs = SDL_max(m_MaxLatencyUs, latencyUs);
+    }
+
+    SDL_AtomicUnlock(&m_RecordLock);
+}
+
+std::vector<NullRenderer::PresentRecord> NullRenderer::getPresentRecords()
+{
+    std::vector<PresentRecord> records;
+
+    SDL_AtomicLock(&m_RecordLock);
+
+    if (m_PresentedFrames <= m_Records.size()) {
+        records.assign(m_Records.begin(), m_Records.begin() + m_PresentedFrames);
+    }
+    else {
+        // The ring has wrapped, so the oldest record is the next one to be overwritten
+        size_t next = m_PresentedFrames % m_Records.size();
+        records.reserve(m_Records.size());
+        records.insert(records.end(), m_Records.begin() + next, m_Records.end());
+        records.insert(records.end(), m_Records.begin(), m_Records.begin() + next);
+    }
+
+    SDL_AtomicUnlock(&m_RecordLock);
+
+    return records;
+}
+
+void NullRenderer::writeTrace(const char* path)
+{
+    FILE* file = fopen(path, "w");
+    if (file == nullptr) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Unable to open null renderer trace: %s",
+                     path);
+        return;
+    }
+
+    fprintf(file, "pts,decoded_us,present_us\n");
+    for (const PresentRecord& record : getPresentRecords()) {
+        fprintf(file, "%lld,%llu,%llu\n",
+                (long long)record.pts,
+                (unsigned long long)record.decodedTimeUs,
+                (unsigned long long)record.presentTimeUs);
+    }
+
+    fclose(file);
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Wrote null renderer trace: %s",
+                path);
+}
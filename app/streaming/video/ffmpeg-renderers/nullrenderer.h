@@ -0,0 +1,58 @@
+#pragma once
+
+#include "renderer.h"
+#include "swframemapper.h"
+
+#include <vector>
+
+// Renders nothing, so the decode and pacing pipeline can run without a
+// display for soak tests and latency benchmarks. Software frames are taken
+// as they are and hardware frames are mapped into system memory first, just
+// like SdlRenderer would for an indirect backend. Enabled with NULL_RENDERER=1.
+//
+// With NULL_RENDERER_UPLOAD=1, each frame is copied into a staging buffer to
+// stand in for the cost of uploading it to a texture. If NULL_RENDERER_TRACE
+// names a file, the presentation records are written to it as CSV when the
+// renderer is destroyed.
+class NullRenderer : public IFFmpegRenderer
+{
+public:
+    struct PresentRecord
+    {
+        // RTP timestamp of the frame (90 kHz)
+        int64_t pts;
+
+        // When the frame left the decoder and when we were done with it
+        uint64_t decodedTimeUs;
+        uint64_t presentTimeUs;
+    };
+
+    NullRenderer();
+    virtual ~NullRenderer() override;
+    virtual bool initialize(PDECODER_PARAMETERS params) override;
+    virtual bool prepareDecoderContext(AVCodecContext* context, AVDictionary** options) override;
+    virtual void renderFrame(AVFrame* frame) override;
+    virtual bool testRenderFrame(AVFrame* frame) override;
+    virtual bool isPixelFormatSupported(int videoFormat, enum AVPixelFormat pixelFormat) override;
+    virtual bool notifyWindowChanged(PWINDOW_STATE_CHANGE_INFO) override;
+
+    // The most recent presentations, oldest first. Safe to call from any thread.
+    std::vector<PresentRecord> getPresentRecords();
+
+    static bool isEnabled();
+
+private:
+    void simulateUpload(const AVFrame* frame);
+
+    void writeTrace(const char* path);
+
+    SwFrameMapper m_SwFrameMapper;
+    bool m_SimulateUpload;
+    std::vector<uint8_t> m_UploadBuffer;
+
+    SDL_SpinLock m_RecordLock;
+    std::vector<PresentRecord> m_Records;
+    uint64_t m_PresentedFrames;
+    uint64_t m_TotalLatencyUs;
+    uint64_t m_MaxLatencyUs;
+};
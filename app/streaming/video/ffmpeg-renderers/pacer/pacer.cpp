@@ -1,5 +1,7 @@
 #include "pacer.h"
+#include "syntheticvsyncsource.h"
 #include "streaming/streamutils.h"
+#include "utils.h"
 
 #ifdef Q_OS_WIN32
 #define WIN32_LEAN_AND_MEAN
@@ -11,34 +13,58 @@
 #include "waylandvsyncsource.h"
 #endif
 
+#ifdef HAS_X11_PRESENT
+#include "x11presentvsyncsource.h"
+#endif
+
 #include <SDL_syswm.h>
 
+#include <QDeadlineTimer>
+#include <QThread>
+
 // Limit the number of queued frames to prevent excessive memory consumption
 // if the V-Sync source or renderer is blocked for a while. It's important
 // that the sum of all queued frames between both pacing and rendering queues
 // must not exceed the number buffer pool size to avoid running the decoder
 // out of available decoding surfaces.
-#define MAX_QUEUED_FRAMES 3
-static_assert(PACER_MAX_OUTSTANDING_FRAMES == MAX_QUEUED_FRAMES + 2,
-              "PACER_MAX_OUTSTANDING_FRAMES and MAX_QUEUED_FRAMES must agree");
+#define MAX_QUEUED_FRAMES PACER_MAX_QUEUED_FRAMES
 
 // We may be woken up slightly late so don't go all the way
 // up to the next V-sync since we may accidentally step into
 // the next V-sync period. It also takes some amount of time
 // to do the render itself, so we can't render right before
 // V-sync happens.
-#define TIMER_SLACK_MS 3
+#define TIMER_SLACK_US 3000
+
+// OS sleeps overshoot by up to a timer tick, so VRR deadlines are met by
+// sleeping until this close and spinning the rest of the way.
+#define SPIN_THRESHOLD_US 1000
 
-Pacer::Pacer(IFFmpegRenderer* renderer, PVIDEO_STATS videoStats) :
+// Cap VRR presentation this far below the display's maximum refresh rate
+// so we never hit the top of the VRR range, where the display falls back
+// to V-sync (and its latency) or tears.
+#define VRR_CAP_MARGIN_HZ 3
+
+// Present intervals longer than this many frame times are stalls
+// (stream start, reconnects, host hitches), not jitter.
+#define PRESENT_INTERVAL_OUTLIER_FRAMES 4
+
+Pacer::Pacer(IFFmpegRenderer* renderer, PVIDEO_STATS videoStats, FramePool* framePool) :
     m_RenderThread(nullptr),
     m_VsyncThread(nullptr),
     m_DeferredFreeFrame(nullptr),
+    m_FramePool(framePool),
     m_Stopping(false),
     m_VsyncSource(nullptr),
     m_VsyncRenderer(renderer),
     m_MaxVideoFps(0),
     m_DisplayFps(0),
-    m_VideoStats(videoStats)
+    m_VideoStats(videoStats),
+    m_LastVsyncUs(0),
+    m_VsyncPeriodUs(0),
+    m_VrrPacing(false),
+    m_VrrMinIntervalUs(0),
+    m_LastPresentUs(0)
 {
 
 }
@@ -72,13 +98,13 @@ Pacer::~Pacer()
     // Delete any remaining unconsumed frames
     while (!m_RenderQueue.isEmpty()) {
         AVFrame* frame = m_RenderQueue.dequeue();
-        av_frame_free(&frame);
+        freeFrame(&frame);
     }
     while (!m_PacingQueue.isEmpty()) {
         AVFrame* frame = m_PacingQueue.dequeue();
-        av_frame_free(&frame);
+        freeFrame(&frame);
     }
-    av_frame_free(&m_DeferredFreeFrame);
+    freeFrame(&m_DeferredFreeFrame);
 }
 
 void Pacer::renderOnMainThread()
@@ -128,7 +154,10 @@ int Pacer::vsyncThread(void *context)
             break;
         }
 
-        me->handleVsync(1000 / me->m_DisplayFps);
+        me->updateVsyncPeriod(LiGetMicroseconds());
+
+        int64_t untilNextVsyncUs = me->m_VsyncSource->getMicrosUntilNextVsync();
+        me->handleVsync(untilNextVsyncUs >= 0 ? untilNextVsyncUs : (int64_t)me->m_VsyncPeriodUs);
     }
 
     return 0;
@@ -196,9 +225,31 @@ void Pacer::enqueueFrameForRenderingAndUnlock(AVFrame *frame)
     }
 }
 
+void Pacer::updateVsyncPeriod(uint64_t vsyncTimeUs)
+{
+    uint64_t nominalPeriodUs = 1000000 / m_DisplayFps;
+
+    if (m_VsyncPeriodUs == 0) {
+        m_VsyncPeriodUs = nominalPeriodUs;
+    }
+
+    // Track the real period with a moving average over roughly the last
+    // 16 V-syncs. This is what tells 59.94 Hz apart from 60 Hz, which the
+    // integer display mode refresh rate can't. Missed V-syncs and stalls
+    // are far from the nominal period and ignored.
+    if (m_LastVsyncUs != 0) {
+        uint64_t sampleUs = vsyncTimeUs - m_LastVsyncUs;
+        if (sampleUs * 2 >= nominalPeriodUs && sampleUs <= nominalPeriodUs * 2) {
+            m_VsyncPeriodUs = (m_VsyncPeriodUs * 15 + sampleUs) / 16;
+        }
+    }
+
+    m_LastVsyncUs = vsyncTimeUs;
+}
+
 // Called in an arbitrary thread by the IVsyncSource on V-sync
 // or an event synchronized with V-sync
-void Pacer::handleVsync(int timeUntilNextVsyncMillis)
+void Pacer::handleVsync(int64_t timeUntilNextVsyncUs)
 {
     // Make sure initialize() has been called
     SDL_assert(m_MaxVideoFps != 0);
@@ -223,7 +274,7 @@ void Pacer::handleVsync(int timeUntilNextVsyncMillis)
         }
 
         // Keep a rolling 500 ms window of pacing queue history
-        if (m_PacingQueueHistory.count() == m_DisplayFps / 2) {
+        if (m_PacingQueueHistory.count() == SDL_min(m_DisplayFps / 2, m_PacingQueueHistory.capacity())) {
             m_PacingQueueHistory.dequeue();
         }
 
@@ -234,16 +285,24 @@ void Pacer::handleVsync(int timeUntilNextVsyncMillis)
     while (m_PacingQueue.count() > frameDropTarget) {
         AVFrame* frame = m_PacingQueue.dequeue();
 
-        // Drop the lock while we call av_frame_free()
+        // Drop the lock while we free the frame
         m_FrameQueueLock.unlock();
         m_VideoStats->pacerDroppedFrames++;
-        av_frame_free(&frame);
+        freeFrame(&frame);
         m_FrameQueueLock.lock();
     }
 
     if (m_PacingQueue.isEmpty()) {
         // Wait for a frame to arrive or our V-sync timeout to expire
-        if (!m_PacingQueueNotEmpty.wait(&m_FrameQueueLock, SDL_max(timeUntilNextVsyncMillis, TIMER_SLACK_MS) - TIMER_SLACK_MS)) {
+        int64_t waitUs = SDL_max(timeUntilNextVsyncUs, TIMER_SLACK_US) - TIMER_SLACK_US;
+#if QT_VERSION >= QT_VERSION_CHECK(5, 12, 0)
+        QDeadlineTimer deadline(Qt::PreciseTimer);
+        deadline.setPreciseRemainingTime(0, waitUs * 1000, Qt::PreciseTimer);
+        bool signalled = m_PacingQueueNotEmpty.wait(&m_FrameQueueLock, deadline);
+#else
+        bool signalled = m_PacingQueueNotEmpty.wait(&m_FrameQueueLock, (unsigned long)(waitUs / 1000));
+#endif
+        if (!signalled) {
             // Wait timed out - unlock and bail
             m_FrameQueueLock.unlock();
             return;
@@ -259,45 +318,101 @@ void Pacer::handleVsync(int timeUntilNextVsyncMillis)
     enqueueFrameForRenderingAndUnlock(m_PacingQueue.dequeue());
 }
 
-bool Pacer::initialize(SDL_Window* window, int maxVideoFps, bool enablePacing)
+bool Pacer::createVsyncSource(SDL_Window* window)
+{
+    // The null renderer has no display to wait on, so it gets a timer
+    if (m_VsyncRenderer->getRendererType() == IFFmpegRenderer::RendererType::Null) {
+        m_VsyncSource = new SyntheticVsyncSource(this);
+        return true;
+    }
+
+    SDL_SysWMinfo info;
+    SDL_VERSION(&info.version);
+    if (!SDL_GetWindowWMInfo(window, &info)) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "SDL_GetWindowWMInfo() failed: %s",
+                     SDL_GetError());
+        return false;
+    }
+
+    switch (info.subsystem) {
+#ifdef Q_OS_WIN32
+    case SDL_SYSWM_WINDOWS:
+        m_VsyncSource = new DxVsyncSource(this);
+        break;
+#endif
+
+#if defined(SDL_VIDEO_DRIVER_WAYLAND) && defined(HAS_WAYLAND)
+    case SDL_SYSWM_WAYLAND:
+        m_VsyncSource = new WaylandVsyncSource(this);
+        break;
+#endif
+
+#if defined(SDL_VIDEO_DRIVER_X11) && defined(HAS_X11_PRESENT)
+    case SDL_SYSWM_X11:
+        m_VsyncSource = new X11PresentVsyncSource(this);
+        break;
+#endif
+
+    default:
+        // Platforms without a VsyncSource will just render frames
+        // immediately like they used to.
+        break;
+    }
+
+    return true;
+}
+
+bool Pacer::initialize(SDL_Window* window, int maxVideoFps, bool enablePacing, bool enableVrrPacing)
 {
     m_MaxVideoFps = maxVideoFps;
     m_DisplayFps = StreamUtils::getDisplayRefreshRate(window);
     m_RendererAttributes = m_VsyncRenderer->getRendererAttributes();
 
-    if (enablePacing) {
+    // There's no display behind the null renderer, so its refresh rate is
+    // whatever the test wants it to be
+    if (m_VsyncRenderer->getRendererType() == IFFmpegRenderer::RendererType::Null) {
+        int syntheticFps;
+        if (Utils::getEnvironmentVariableOverride("SYNTHETIC_VSYNC_HZ", &syntheticFps) && syntheticFps > 0) {
+            m_DisplayFps = syntheticFps;
+        }
+    }
+
+    // Renderers that force pacing need a V-sync source to drive them
+    if (enableVrrPacing && !(m_RendererAttributes & RENDERER_ATTRIBUTE_FORCE_PACING)) {
+        int capFps = m_DisplayFps - VRR_CAP_MARGIN_HZ;
+
+        // If the stream can't run below the cap, the display is effectively
+        // running at a fixed refresh rate and regular pacing is better.
+        if (m_MaxVideoFps <= capFps) {
+            m_VrrPacing = true;
+            m_VrrMinIntervalUs = 1000000 / capFps;
+            enablePacing = false;
+
+            SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                        "VRR pacing: presenting on decode, capped at %d FPS (%d Hz display) with %d FPS stream",
+                        capFps, m_DisplayFps, m_MaxVideoFps);
+        }
+        else {
+            SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                        "VRR pacing unavailable: %d FPS stream exceeds the %d FPS cap for a %d Hz display",
+                        m_MaxVideoFps, capFps, m_DisplayFps);
+        }
+    }
+
+    if (m_VrrPacing) {
+        // No V-sync source. Frames go straight to the render queue and
+        // renderFrame() enforces the cap.
+    }
+    else if (enablePacing) {
         SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
                     "Frame pacing: target %d Hz with %d FPS stream",
                     m_DisplayFps, m_MaxVideoFps);
 
-        SDL_SysWMinfo info;
-        SDL_VERSION(&info.version);
-        if (!SDL_GetWindowWMInfo(window, &info)) {
-            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
-                         "SDL_GetWindowWMInfo() failed: %s",
-                         SDL_GetError());
+        if (!createVsyncSource(window)) {
             return false;
         }
 
-        switch (info.subsystem) {
-    #ifdef Q_OS_WIN32
-        case SDL_SYSWM_WINDOWS:
-            m_VsyncSource = new DxVsyncSource(this);
-            break;
-    #endif
-
-    #if defined(SDL_VIDEO_DRIVER_WAYLAND) && defined(HAS_WAYLAND)
-        case SDL_SYSWM_WAYLAND:
-            m_VsyncSource = new WaylandVsyncSource(this);
-            break;
-    #endif
-
-        default:
-            // Platforms without a VsyncSource will just render frames
-            // immediately like they used to.
-            break;
-        }
-
         SDL_assert(m_VsyncSource != nullptr || !(m_RendererAttributes & RENDERER_ATTRIBUTE_FORCE_PACING));
 
         if (m_VsyncSource != nullptr && !m_VsyncSource->initialize(window, m_DisplayFps)) {
@@ -329,8 +444,64 @@ void Pacer::signalVsync()
     m_VsyncSignalled.wakeOne();
 }
 
+void Pacer::waitUntil(uint64_t deadlineUs, bool allowSpin)
+{
+    for (;;) {
+        uint64_t nowUs = LiGetMicroseconds();
+        if (nowUs >= deadlineUs) {
+            return;
+        }
+
+        uint64_t remainingUs = deadlineUs - nowUs;
+        if (remainingUs > SPIN_THRESHOLD_US) {
+            SDL_Delay((Uint32)((remainingUs - SPIN_THRESHOLD_US + 999) / 1000));
+        }
+        else if (!allowSpin) {
+            // Sleep the whole milliseconds left and accept being up to 1 ms early
+            if (remainingUs >= 1000) {
+                SDL_Delay((Uint32)(remainingUs / 1000));
+            }
+            return;
+        }
+        else {
+            QThread::yieldCurrentThread();
+        }
+    }
+}
+
+void Pacer::waitForVrrDeadline()
+{
+    // Hold back frames that arrive faster than the cap. Anything slower
+    // than the cap is presented immediately and the display follows it.
+    //
+    // Don't spin when rendering on the main thread, since that stalls the
+    // SDL event loop along with it.
+    uint64_t lastPresentUs = m_LastPresentUs;
+    if (lastPresentUs != 0) {
+        waitUntil(lastPresentUs + m_VrrMinIntervalUs, m_RenderThread != nullptr);
+    }
+}
+
+void Pacer::recordPresentInterval(uint64_t presentTimeUs)
+{
+    // flush() may reset this from the decoder thread at any time
+    uint64_t lastPresentUs = m_LastPresentUs.exchange(presentTimeUs);
+    if (lastPresentUs != 0 && presentTimeUs > lastPresentUs) {
+        uint64_t intervalUs = presentTimeUs - lastPresentUs;
+        if (intervalUs <= PRESENT_INTERVAL_OUTLIER_FRAMES * 1000000ULL / m_MaxVideoFps) {
+            m_VideoStats->presentIntervals++;
+            m_VideoStats->totalPresentIntervalUs += intervalUs;
+            m_VideoStats->totalPresentIntervalSqUs += intervalUs * intervalUs;
+        }
+    }
+}
+
 void Pacer::renderFrame(AVFrame* frame)
 {
+    if (m_VrrPacing) {
+        waitForVrrDeadline();
+    }
+
     // Count time spent in Pacer's queues
     uint64_t beforeRender = LiGetMicroseconds();
     m_VideoStats->totalPacerTimeUs += (beforeRender - (uint64_t)frame->pkt_dts);
@@ -339,6 +510,10 @@ void Pacer::renderFrame(AVFrame* frame)
     m_VsyncRenderer->renderFrame(frame);
     uint64_t afterRender = LiGetMicroseconds();
 
+    // VRR deadlines are measured from the start of the previous present.
+    // Otherwise we measure jitter in when presents complete.
+    recordPresentInterval(m_VrrPacing ? beforeRender : afterRender);
+
     m_VideoStats->totalRenderTimeUs += (afterRender - beforeRender);
     m_VideoStats->renderedFrames++;
 
@@ -346,7 +521,7 @@ void Pacer::renderFrame(AVFrame* frame)
     // doesn't stall or read garbage if the backing buffer gets returned
     // to the pool and the decoder tries to write a new frame into it
     std::swap(frame, m_DeferredFreeFrame);
-    av_frame_free(&frame);
+    freeFrame(&frame);
 
     // Drop frames if we have too many queued up for a while
     m_FrameQueueLock.lock();
@@ -370,7 +545,7 @@ void Pacer::renderFrame(AVFrame* frame)
         }
 
         // Keep a rolling 500 ms window of render queue history
-        if (m_RenderQueueHistory.count() == m_MaxVideoFps / 2) {
+        if (m_RenderQueueHistory.count() == SDL_min(m_MaxVideoFps / 2, m_RenderQueueHistory.capacity())) {
             m_RenderQueueHistory.dequeue();
         }
 
@@ -381,23 +556,55 @@ void Pacer::renderFrame(AVFrame* frame)
     while (m_RenderQueue.count() > frameDropTarget) {
         AVFrame* frame = m_RenderQueue.dequeue();
 
-        // Drop the lock while we call av_frame_free()
+        // Drop the lock while we free the frame
         m_FrameQueueLock.unlock();
         m_VideoStats->pacerDroppedFrames++;
-        av_frame_free(&frame);
+        freeFrame(&frame);
         m_FrameQueueLock.lock();
     }
 
     m_FrameQueueLock.unlock();
 }
 
-void Pacer::dropFrameForEnqueue(QQueue<AVFrame*>& queue)
+void Pacer::dropFrameForEnqueue(FrameQueue& queue)
 {
     SDL_assert(queue.size() <= MAX_QUEUED_FRAMES);
     if (queue.size() == MAX_QUEUED_FRAMES) {
         AVFrame* frame = queue.dequeue();
-        av_frame_free(&frame);
+        freeFrame(&frame);
+    }
+}
+
+void Pacer::freeFrame(AVFrame** frame)
+{
+    if (m_FramePool != nullptr) {
+        m_FramePool->release(frame);
+    }
+    else {
+        av_frame_free(frame);
+    }
+}
+
+void Pacer::flush()
+{
+    m_FrameQueueLock.lock();
+    while (!m_PacingQueue.isEmpty()) {
+        AVFrame* frame = m_PacingQueue.dequeue();
+        freeFrame(&frame);
     }
+    while (!m_RenderQueue.isEmpty()) {
+        AVFrame* frame = m_RenderQueue.dequeue();
+        freeFrame(&frame);
+    }
+
+    // Stale history would make the first frames after a flush look like
+    // a backlog and get dropped
+    m_PacingQueueHistory.clear();
+    m_RenderQueueHistory.clear();
+    m_FrameQueueLock.unlock();
+
+    // The gap until the next frame is not a present interval
+    m_LastPresentUs = 0;
 }
 
 void Pacer::submitFrame(AVFrame* frame)
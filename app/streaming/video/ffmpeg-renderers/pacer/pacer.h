@@ -1,17 +1,29 @@
 #pragma once
 
 #include "../../decoder.h"
+#include "../../fixedqueue.h"
+#include "../../framepool.h"
 #include "../renderer.h"
 
-#include <QQueue>
 #include <QMutex>
 #include <QWaitCondition>
 
+#include <atomic>
+
 // The maximum number of frames pacer will ever hold is:
 // - 3 frames in the pacing queue
 // - 1 frame removed from the render queue in the process of rendering
 // - 1 frame for deferred free
-#define PACER_MAX_OUTSTANDING_FRAMES (3 + 1 + 1)
+#define PACER_MAX_QUEUED_FRAMES 3
+#define PACER_MAX_OUTSTANDING_FRAMES (PACER_MAX_QUEUED_FRAMES + 1 + 1)
+
+// While the renderer stalls, the render queue fills up too, so the most
+// frame shells the pacer can hold at once is:
+// - 3 frames in the pacing queue
+// - 3 frames in the render queue
+// - 1 frame being rendered
+// - 1 frame for deferred free
+#define PACER_MAX_HELD_FRAMES (2 * PACER_MAX_QUEUED_FRAMES + 1 + 1)
 
 class IVsyncSource {
 public:
@@ -26,40 +38,74 @@ public:
         // Synchronous sources must implement waitForVsync()!
         SDL_assert(false);
     }
+
+    // Sources that know when the last V-sync actually happened and how long
+    // the refresh period really is can report the time left until the next
+    // one. Returns -1 if unknown, in which case Pacer assumes a full period
+    // at the display's nominal refresh rate.
+    virtual int64_t getMicrosUntilNextVsync() {
+        return -1;
+    }
 };
 
 class Pacer
 {
 public:
-    Pacer(IFFmpegRenderer* renderer, PVIDEO_STATS videoStats);
+    // Frames are returned to framePool if one is given, and freed otherwise
+    Pacer(IFFmpegRenderer* renderer, PVIDEO_STATS videoStats, FramePool* framePool = nullptr);
 
     ~Pacer();
 
     void submitFrame(AVFrame* frame);
 
-    bool initialize(SDL_Window* window, int maxVideoFps, bool enablePacing);
+    // With enableVrrPacing, frames are presented as soon as they are decoded,
+    // capped just below the display's maximum refresh rate, instead of being
+    // paced to V-sync. Intended for variable refresh rate displays.
+    bool initialize(SDL_Window* window, int maxVideoFps, bool enablePacing, bool enableVrrPacing);
 
     void signalVsync();
 
     void renderOnMainThread();
 
+    // Frees every frame waiting to be paced or rendered
+    void flush();
+
+    // Sleeps until deadlineUs on the LiGetMicroseconds() clock, spinning
+    // through the last stretch for accuracy unless allowSpin is false
+    static void waitUntil(uint64_t deadlineUs, bool allowSpin = true);
+
 private:
+    typedef FixedQueue<AVFrame*, PACER_MAX_QUEUED_FRAMES> FrameQueue;
+
+    // 500 ms of queue lengths at up to 1000 Hz
+    typedef FixedQueue<int, 500> QueueHistory;
+
     static int vsyncThread(void* context);
 
     static int renderThread(void* context);
 
-    void handleVsync(int timeUntilNextVsyncMillis);
+    void handleVsync(int64_t timeUntilNextVsyncUs);
+
+    void updateVsyncPeriod(uint64_t vsyncTimeUs);
+
+    void waitForVrrDeadline();
+
+    void recordPresentInterval(uint64_t presentTimeUs);
+
+    bool createVsyncSource(SDL_Window* window);
 
     void enqueueFrameForRenderingAndUnlock(AVFrame* frame);
 
     void renderFrame(AVFrame* frame);
 
-    void dropFrameForEnqueue(QQueue<AVFrame*>& queue);
+    void dropFrameForEnqueue(FrameQueue& queue);
+
+    void freeFrame(AVFrame** frame);
 
-    QQueue<AVFrame*> m_RenderQueue;
-    QQueue<AVFrame*> m_PacingQueue;
-    QQueue<int> m_PacingQueueHistory;
-    QQueue<int> m_RenderQueueHistory;
+    FrameQueue m_RenderQueue;
+    FrameQueue m_PacingQueue;
+    QueueHistory m_PacingQueueHistory;
+    QueueHistory m_RenderQueueHistory;
     QMutex m_FrameQueueLock;
     QWaitCondition m_RenderQueueNotEmpty;
     QWaitCondition m_PacingQueueNotEmpty;
@@ -67,6 +113,7 @@ private:
     SDL_Thread* m_RenderThread;
     SDL_Thread* m_VsyncThread;
     AVFrame* m_DeferredFreeFrame;
+    FramePool* m_FramePool;
     bool m_Stopping;
 
     IVsyncSource* m_VsyncSource;
@@ -75,4 +122,13 @@ private:
     int m_DisplayFps;
     PVIDEO_STATS m_VideoStats;
     int m_RendererAttributes;
+
+    // V-sync period measured from the V-sync thread's wakeups (microseconds)
+    uint64_t m_LastVsyncUs;
+    uint64_t m_VsyncPeriodUs;
+
+    bool m_VrrPacing;
+    uint64_t m_VrrMinIntervalUs;
+    // Written by the render thread and reset by flush() from the decoder
+    std::atomic<uint64_t> m_LastPresentUs;
 };
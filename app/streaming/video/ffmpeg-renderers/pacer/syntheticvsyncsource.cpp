@@ -0,0 +1,66 @@
+#include "syntheticvsyncsource.h"
+#include "utils.h"
+
+#include <Limelight.h>
+
+SyntheticVsyncSource::SyntheticVsyncSource(Pacer* pacer)
+    : m_Pacer(pacer),
+      m_PeriodUs(0),
+      m_JitterUs(0),
+      m_StartUs(0),
+      m_VsyncCount(0)
+{
+
+}
+
+bool SyntheticVsyncSource::initialize(SDL_Window*, int displayFps)
+{
+    m_PeriodUs = 1000000.0 / displayFps;
+
+    if (!Utils::getEnvironmentVariableOverride("SYNTHETIC_VSYNC_JITTER_US", &m_JitterUs) || m_JitterUs < 0) {
+        m_JitterUs = 0;
+    }
+
+    m_StartUs = LiGetMicroseconds();
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Synthetic V-sync: %d Hz with up to %d us of jitter",
+                displayFps, m_JitterUs);
+    return true;
+}
+
+bool SyntheticVsyncSource::isAsync()
+{
+    // We sleep in waitForVsync() on the Pacer's V-sync thread
+    return false;
+}
+
+void SyntheticVsyncSource::waitForVsync()
+{
+    // Target the V-sync after the last one we reported, unless we've fallen
+    // behind by more than that, in which case the missed ones are gone
+    uint64_t elapsedVsyncs = (uint64_t)((LiGetMicroseconds() - m_StartUs) / m_PeriodUs);
+    m_VsyncCount = SDL_max(m_VsyncCount + 1, elapsedVsyncs + 1);
+
+    uint64_t deadlineUs = m_StartUs + (uint64_t)(m_VsyncCount * m_PeriodUs);
+    if (m_JitterUs > 0) {
+        // Default seeded, so runs see the same sequence of delays
+        deadlineUs += std::uniform_int_distribution<int>(0, m_JitterUs)(m_Random);
+    }
+
+    Pacer::waitUntil(deadlineUs);
+}
+
+int64_t SyntheticVsyncSource::getMicrosUntilNextVsync()
+{
+    if (m_VsyncCount == 0) {
+        return -1;
+    }
+
+    // Measured from the grid rather than our late wakeup, like sources that
+    // report the real time of the vblank
+    uint64_t nextVsyncUs = m_StartUs + (uint64_t)((m_VsyncCount + 1) * m_PeriodUs);
+    uint64_t nowUs = LiGetMicroseconds();
+
+    return nextVsyncUs > nowUs ? (int64_t)(nextVsyncUs - nowUs) : 0;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "pacer.h"
+
+#include <random>
+
+// Synchronous V-sync source driven by a timer instead of a display, used
+// with NullRenderer so frame pacing can be exercised headless. V-syncs fall
+// on an exact grid at the display rate Pacer hands us (which
+// SYNTHETIC_VSYNC_HZ overrides for null rendering), and each wakeup is
+// delayed by a random amount of up to SYNTHETIC_VSYNC_JITTER_US to mimic
+// late notifications from a real compositor or driver. Like a real display,
+// V-syncs that pass while nobody is waiting are skipped rather than queued.
+class SyntheticVsyncSource : public IVsyncSource
+{
+public:
+    SyntheticVsyncSource(Pacer* pacer);
+
+    virtual bool initialize(SDL_Window* window, int displayFps) override;
+
+    virtual bool isAsync() override;
+
+    virtual void waitForVsync() override;
+
+    virtual int64_t getMicrosUntilNextVsync() override;
+
+private:
+    Pacer* m_Pacer;
+    double m_PeriodUs;
+    int m_JitterUs;
+    uint64_t m_StartUs;
+    uint64_t m_VsyncCount;
+    std::minstd_rand m_Random;
+};
@@ -0,0 +1,209 @@
+#include "x11presentvsyncsource.h"
+
+#include <SDL_syswm.h>
+
+#include <time.h>
+
+#ifndef SDL_VIDEO_DRIVER_X11
+#warning Unable to use X11PresentVsyncSource without SDL support
+#else
+
+// Measured periods outside this factor of the nominal period come from
+// MSC jumps (DPMS, the window moving to a CRTC-less fake clock) rather
+// than real refresh timing.
+#define PERIOD_SAMPLE_TOLERANCE 2
+
+X11PresentVsyncSource::X11PresentVsyncSource(Pacer* pacer)
+    : m_Pacer(pacer),
+      m_Connection(nullptr),
+      m_Window(XCB_NONE),
+      m_SpecialEvent(nullptr),
+      m_EventId(0),
+      m_Serial(0),
+      m_DisplayFps(0),
+      m_LastUst(0),
+      m_LastMsc(0),
+      m_NominalPeriodUs(0),
+      m_MeasuredPeriodUs(0),
+      m_PeriodSamples(0)
+{
+
+}
+
+X11PresentVsyncSource::~X11PresentVsyncSource()
+{
+    if (m_SpecialEvent != nullptr) {
+        xcb_present_select_input(m_Connection, m_EventId, m_Window, XCB_PRESENT_EVENT_MASK_NO_EVENT);
+        xcb_unregister_for_special_event(m_Connection, m_SpecialEvent);
+    }
+
+    if (m_Connection != nullptr) {
+        xcb_disconnect(m_Connection);
+    }
+}
+
+bool X11PresentVsyncSource::initialize(SDL_Window* window, int displayFps)
+{
+    SDL_SysWMinfo info;
+
+    SDL_VERSION(&info.version);
+
+    if (!SDL_GetWindowWMInfo(window, &info)) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "SDL_GetWindowWMInfo() failed: %s",
+                     SDL_GetError());
+        return false;
+    }
+
+    // Pacer should not create us for non-X11 windows
+    SDL_assert(info.subsystem == SDL_SYSWM_X11);
+
+    m_Window = (xcb_window_t)info.info.x11.window;
+    m_DisplayFps = displayFps;
+    m_NominalPeriodUs = 1000000 / displayFps;
+
+    m_Connection = xcb_connect(DisplayString(info.info.x11.display), nullptr);
+    if (xcb_connection_has_error(m_Connection)) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Unable to open XCB connection for Present V-sync");
+        return false;
+    }
+
+    const xcb_query_extension_reply_t* ext = xcb_get_extension_data(m_Connection, &xcb_present_id);
+    if (ext == nullptr || !ext->present) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "X server does not support the Present extension");
+        return false;
+    }
+
+    xcb_present_query_version_reply_t* version =
+            xcb_present_query_version_reply(m_Connection,
+                                            xcb_present_query_version(m_Connection,
+                                                                      XCB_PRESENT_MAJOR_VERSION,
+                                                                      XCB_PRESENT_MINOR_VERSION),
+                                            nullptr);
+    if (version == nullptr) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Present version query failed");
+        return false;
+    }
+
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Using X11 Present %u.%u for V-sync",
+                version->major_version, version->minor_version);
+    free(version);
+
+    // Route our PresentCompleteNotify events to a private queue so
+    // waitForVsync() only ever sees events meant for it.
+    m_EventId = xcb_generate_id(m_Connection);
+    m_SpecialEvent = xcb_register_for_special_xge(m_Connection, &xcb_present_id, m_EventId, nullptr);
+    xcb_void_cookie_t cookie = xcb_present_select_input_checked(m_Connection, m_EventId, m_Window,
+                                                                 XCB_PRESENT_EVENT_MASK_COMPLETE_NOTIFY);
+    xcb_generic_error_t* error = xcb_request_check(m_Connection, cookie);
+    if (error != nullptr) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "PresentSelectInput() failed: %d",
+                     error->error_code);
+        free(error);
+        xcb_unregister_for_special_event(m_Connection, m_SpecialEvent);
+        m_SpecialEvent = nullptr;
+        return false;
+    }
+
+    return true;
+}
+
+bool X11PresentVsyncSource::isAsync()
+{
+    // We block in waitForVsync() on the Pacer's V-sync thread
+    return false;
+}
+
+void X11PresentVsyncSource::waitForVsync()
+{
+    uint32_t serial = ++m_Serial;
+
+    // Ask for the vblank after the last one we saw. If we've fallen behind,
+    // the target has already passed and the server completes immediately
+    // with the current MSC, which resynchronizes us. The very first request
+    // targets MSC 0 for the same reason.
+    xcb_present_notify_msc(m_Connection, m_Window, serial,
+                           m_LastMsc != 0 ? m_LastMsc + 1 : 0, 0, 0);
+    xcb_flush(m_Connection);
+
+    for (;;) {
+        xcb_generic_event_t* event = xcb_wait_for_special_event(m_Connection, m_SpecialEvent);
+        if (event == nullptr) {
+            // The connection is broken. Don't spin the V-sync thread.
+            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                         "Lost XCB connection while waiting for V-sync");
+            SDL_Delay(1000 / m_DisplayFps);
+            return;
+        }
+
+        auto presentEvent = (xcb_present_generic_event_t*)event;
+        if (presentEvent->evtype == XCB_PRESENT_COMPLETE_NOTIFY) {
+            auto completeEvent = (xcb_present_complete_notify_event_t*)event;
+            if (completeEvent->kind == XCB_PRESENT_COMPLETE_KIND_NOTIFY_MSC &&
+                    completeEvent->serial == serial) {
+                updateRefreshPeriod(completeEvent->ust, completeEvent->msc);
+                free(event);
+                return;
+            }
+        }
+
+        free(event);
+    }
+}
+
+void X11PresentVsyncSource::updateRefreshPeriod(uint64_t ust, uint64_t msc)
+{
+    if (m_LastUst != 0 && msc > m_LastMsc && ust > m_LastUst) {
+        uint64_t sampleUs = (ust - m_LastUst) / (msc - m_LastMsc);
+
+        if (sampleUs * PERIOD_SAMPLE_TOLERANCE >= m_NominalPeriodUs &&
+                sampleUs <= m_NominalPeriodUs * PERIOD_SAMPLE_TOLERANCE) {
+            // Exponential moving average over roughly the last 8 vblanks
+            if (m_MeasuredPeriodUs == 0) {
+                m_MeasuredPeriodUs = sampleUs;
+            }
+            else {
+                m_MeasuredPeriodUs = (m_MeasuredPeriodUs * 7 + sampleUs) / 8;
+            }
+
+            // Log once after a couple of seconds so the estimate has settled
+            if (++m_PeriodSamples == m_DisplayFps * 2) {
+                SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                            "X11 Present measured refresh rate: %.3f Hz (nominal %d Hz)",
+                            1000000.0 / m_MeasuredPeriodUs,
+                            m_DisplayFps);
+            }
+        }
+    }
+
+    m_LastUst = ust;
+    m_LastMsc = msc;
+}
+
+int64_t X11PresentVsyncSource::getMicrosUntilNextVsync()
+{
+    if (m_LastUst == 0) {
+        return -1;
+    }
+
+    uint64_t periodUs = m_MeasuredPeriodUs != 0 ? m_MeasuredPeriodUs : m_NominalPeriodUs;
+    uint64_t nextVsyncUs = m_LastUst + periodUs;
+    uint64_t nowUs = getMonotonicMicros();
+
+    return nextVsyncUs > nowUs ? (int64_t)(nextVsyncUs - nowUs) : 0;
+}
+
+uint64_t X11PresentVsyncSource::getMonotonicMicros()
+{
+    // The X server reports UST from CLOCK_MONOTONIC
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+#endif
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "pacer.h"
+
+#include <xcb/xcb.h>
+#include <xcb/present.h>
+
+// Synchronous V-sync source for X11 windows built on the Present extension.
+// Each wait asks the server for a PresentCompleteNotify at the next MSC and
+// uses the UST (microseconds, CLOCK_MONOTONIC) it reports for that vblank.
+// The refresh period is measured from consecutive notifications rather than
+// taken from the nominal display mode.
+//
+// We use our own XCB connection so the vsync thread never touches the
+// Display that SDL is driving from the main thread.
+class X11PresentVsyncSource : public IVsyncSource
+{
+public:
+    X11PresentVsyncSource(Pacer* pacer);
+
+    virtual ~X11PresentVsyncSource();
+
+    virtual bool initialize(SDL_Window* window, int displayFps) override;
+
+    virtual bool isAsync() override;
+
+    virtual void waitForVsync() override;
+
+    virtual int64_t getMicrosUntilNextVsync() override;
+
+private:
+    void updateRefreshPeriod(uint64_t ust, uint64_t msc);
+
+    static uint64_t getMonotonicMicros();
+
+    Pacer* m_Pacer;
+    xcb_connection_t* m_Connection;
+    xcb_window_t m_Window;
+    xcb_special_event_t* m_SpecialEvent;
+    uint32_t m_EventId;
+    uint32_t m_Serial;
+    int m_DisplayFps;
+
+    uint64_t m_LastUst;
+    uint64_t m_LastMsc;
+    uint64_t m_NominalPeriodUs;
+    uint64_t m_MeasuredPeriodUs;
+    int m_PeriodSamples;
+};
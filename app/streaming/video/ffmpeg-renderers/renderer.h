@@ -153,6 +153,7 @@ public:
         VDPAU,
         VTSampleLayer,
         VTMetal,
+        Null,
     };
 
     // What the renderer is currently deriving its HDR tone mapping from.
@@ -309,6 +310,8 @@ public:
         return getPreferredPixelFormat(videoFormat) == pixelFormat;
     }
 
+    // Only called when the HDR mode or the host's HDR metadata has changed
+    // since the last call, so renderers can reconfigure unconditionally
     virtual void setHdrMode(bool) {
         // Nothing
     }
@@ -362,6 +365,8 @@ public:
             return "VideoToolbox (AVSampleBufferDisplayLayer)";
         case RendererType::VTMetal:
             return "VideoToolbox (Metal)";
+        case RendererType::Null:
+            return "Null";
         }
     }
 
@@ -150,6 +150,13 @@ bool SdlRenderer::initialize(PDECODER_PARAMETERS params)
         return true;
     }
 
+    // Parked decoders are built off the main thread too, but unlike test-only
+    // renderers they need a real SDL renderer. Let the decoder be built once
+    // the stream starts instead.
+    if (params->startParked) {
+        return false;
+    }
+
     SDL_SysWMinfo info;
     SDL_VERSION(&info.version);
     if (!SDL_GetWindowWMInfo(params->window, &info)) {
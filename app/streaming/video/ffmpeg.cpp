@@ -1,18 +1,20 @@
 #include <Limelight.h>
 #include "ffmpeg.h"
 #include "av1obu.h"
+#include "h264spsfixup.h"
 #include "utils.h"
 #include "streaming/session.h"
 #include "streaming/network/bandwidth.h"
 
-#include <h264_stream.h>
+#include <cmath>
+
 extern "C" {
-#include <libavutil/mastering_display_metadata.h>
 #include <libavutil/pixdesc.h>
 }
 
 #include "ffmpeg-renderers/sdlvid.h"
 #include "ffmpeg-renderers/genhwaccel.h"
+#include "ffmpeg-renderers/nullrenderer.h"
 
 #ifdef Q_OS_WIN32
 #include "ffmpeg-renderers/dxva2.h"
@@ -56,8 +58,6 @@ extern "C" {
 
 #define MAX_DECODER_PASS 2
 
-#define MAX_SPS_EXTRA_SIZE 16
-
 #define FAILED_DECODES_RESET_THRESHOLD 20
 
 bool FFmpegVideoDecoder::isHardwareAccelerated()
@@ -78,6 +78,15 @@ bool FFmpegVideoDecoder::isHdrSupported()
 
 void FFmpegVideoDecoder::setHdrMode(bool enabled)
 {
+    // Hosts repeat HDR mode messages with nothing changed. Only pass real
+    // changes on, since renderers respond by reconfiguring their output.
+    m_HdrMetadata.update(enabled);
+    int version = m_HdrMetadata.version();
+    if (version == m_RendererHdrVersion) {
+        return;
+    }
+
+    m_RendererHdrVersion = version;
     m_FrontendRenderer->setHdrMode(enabled);
 }
 
@@ -100,12 +109,11 @@ int FFmpegVideoDecoder::getDecoderCapabilities()
         capabilities = m_BackendRenderer->getDecoderCapabilities();
 
         if (!isHardwareAccelerated()) {
-            // Slice up to 4 times for parallel CPU decoding, once slice per core
-            int slices = qMin(MAX_SLICES, SDL_GetCPUCount());
+            // Slice for parallel CPU decoding as chosen by the thread policy
             SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
                         "Encoder configured for %d slices per frame",
-                        slices);
-            capabilities |= CAPABILITY_SLICES_PER_FRAME(slices);
+                        m_ThreadPolicy.slicesPerFrame);
+            capabilities |= CAPABILITY_SLICES_PER_FRAME(m_ThreadPolicy.slicesPerFrame);
 
             // Enable HEVC RFI when using the FFmpeg software decoder
             capabilities |= CAPABILITY_REFERENCE_FRAME_INVALIDATION_HEVC;
@@ -237,7 +245,6 @@ FFmpegVideoDecoder::FFmpegVideoDecoder(bool testOnly)
       m_FrontendRenderer(nullptr),
       m_ConsecutiveFailedDecodes(0),
       m_Pacer(nullptr),
-      m_BwTracker(10, 250),
       m_FramesIn(0),
       m_FramesOut(0),
       m_LastFrameNumber(0),
@@ -246,10 +253,12 @@ FFmpegVideoDecoder::FFmpegVideoDecoder(bool testOnly)
       m_NeedsSpsFixup(false),
       m_NeedsAv1ObuRepack(false),
       m_LoggedHdr10PlusMetadata(false),
+      m_RendererHdrVersion(0),
       m_TestOnly(testOnly),
       m_CurrentTestMode(TestMode::TestFrameOnly),
       m_DecoderThread(nullptr),
-      m_VideoEnhancement(&VideoEnhancement::getInstance())
+      m_VideoEnhancement(&VideoEnhancement::getInstance()),
+      m_FramePool(PACER_MAX_HELD_FRAMES + 1)
 {
     SDL_zero(m_ActiveWndVideoStats);
     SDL_zero(m_LastWndVideoStats);
@@ -276,10 +285,8 @@ IFFmpegRenderer* FFmpegVideoDecoder::getBackendRenderer()
     return m_BackendRenderer;
 }
 
-void FFmpegVideoDecoder::reset()
+void FFmpegVideoDecoder::stopDecoderThread()
 {
-    // Terminate the decoder thread before doing anything else.
-    // It might be touching things we're about to free.
     if (m_DecoderThread != nullptr) {
         SDL_AtomicSet(&m_DecoderThreadShouldQuit, 1);
         LiWakeWaitForVideoFrame();
@@ -287,6 +294,50 @@ void FFmpegVideoDecoder::reset()
         SDL_AtomicSet(&m_DecoderThreadShouldQuit, 0);
         m_DecoderThread = nullptr;
     }
+}
+
+void FFmpegVideoDecoder::park()
+{
+    stopDecoderThread();
+
+    // Drop everything belonging to the old stream. The next frame we see
+    // will be an IDR frame requested by whoever resumes us.
+    if (m_VideoDecoderCtx != nullptr) {
+        avcodec_flush_buffers(m_VideoDecoderCtx);
+    }
+    m_FramesIn = m_FramesOut = 0;
+    m_FrameInfoQueue.clear();
+
+    if (m_Pacer != nullptr) {
+        m_Pacer->flush();
+    }
+}
+
+bool FFmpegVideoDecoder::resume()
+{
+    SDL_assert(m_CurrentTestMode != TestMode::TestFrameOnly);
+
+    if (m_DecoderThread != nullptr) {
+        return true;
+    }
+
+    // The decoder thread uses APIs from moonlight-common-c that can only
+    // be legally called with an established connection.
+    m_DecoderThread = SDL_CreateThread(FFmpegVideoDecoder::decoderThreadProcThunk, "FFDecoder", (void*)this);
+    if (m_DecoderThread == nullptr) {
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Failed to create decoder thread: %s", SDL_GetError());
+        return false;
+    }
+
+    return true;
+}
+
+void FFmpegVideoDecoder::reset()
+{
+    // Terminate the decoder thread before doing anything else.
+    // It might be touching things we're about to free.
+    stopDecoderThread();
 
     m_FramesIn = m_FramesOut = 0;
     m_FrameInfoQueue.clear();
@@ -301,7 +352,8 @@ void FFmpegVideoDecoder::reset()
     // need to delete in the renderer destructor.
     avcodec_free_context(&m_VideoDecoderCtx);
 
-    if (m_CurrentTestMode != TestMode::TestFrameOnly) {
+    // Headless test harnesses drive the decoder without a Session
+    if (m_CurrentTestMode != TestMode::TestFrameOnly && Session::get() != nullptr) {
         Session::get()->getOverlayManager().setOverlayRenderer(nullptr);
     }
 
@@ -314,6 +366,9 @@ void FFmpegVideoDecoder::reset()
 
     m_FrontendRenderer = m_BackendRenderer = nullptr;
 
+    // New renderers haven't been told about HDR yet
+    m_RendererHdrVersion = 0;
+
     if (m_CurrentTestMode != TestMode::TestFrameOnly) {
         logVideoStats(m_GlobalVideoStats, "Global video stats");
     }
@@ -372,6 +427,18 @@ bool FFmpegVideoDecoder::createFrontendRenderer(PDECODER_PARAMETERS params, bool
     Q_UNUSED(glIsSlow);
     Q_UNUSED(vulkanIsSlow);
 
+    // Headless runs never reach a display, whatever the backend is. Frames
+    // from a hardware backend are read back by the null renderer instead.
+    if (NullRenderer::isEnabled()) {
+        if (m_BackendRenderer->getRendererType() == IFFmpegRenderer::RendererType::Null) {
+            m_FrontendRenderer = m_BackendRenderer;
+            return true;
+        }
+
+        m_FrontendRenderer = new NullRenderer();
+        return initializeRendererInternal(m_FrontendRenderer, params);
+    }
+
     // For cases where we're already using Vulkan Video decoding, always use the Vulkan renderer too.
     // The alternate frontend logic is primarily for cases where a different renderer like EGL or DRM
     // may provide additional performance or HDR capabilities. Neither of these are true for Vulkan.
@@ -509,9 +576,10 @@ bool FFmpegVideoDecoder::completeInitialization(const AVCodec* decoder, enum AVP
 
     // Don't bother initializing Pacer if we're not actually going to render
     if (testMode != TestMode::TestFrameOnly) {
-        m_Pacer = new Pacer(m_FrontendRenderer, &m_ActiveWndVideoStats);
+        m_Pacer = new Pacer(m_FrontendRenderer, &m_ActiveWndVideoStats, &m_FramePool);
         if (!m_Pacer->initialize(params->window, params->frameRate,
-                                 params->enableFramePacing || (params->enableVsync && (m_FrontendRenderer->getRendererAttributes() & RENDERER_ATTRIBUTE_FORCE_PACING)))) {
+                                 params->enableFramePacing || (params->enableVsync && (m_FrontendRenderer->getRendererAttributes() & RENDERER_ATTRIBUTE_FORCE_PACING)),
+                                 params->enableVrrPacing)) {
             return false;
         }
     }
@@ -539,10 +607,39 @@ bool FFmpegVideoDecoder::completeInitialization(const AVCodec* decoder, enum AVP
     // runs out of output buffers.
     m_VideoDecoderCtx->err_recognition = AV_EF_EXPLODE;
 
-    // Enable slice multi-threading for software decoding
+    // Enable multi-threading for software decoding
     if (!isHardwareAccelerated()) {
-        m_VideoDecoderCtx->thread_type = FF_THREAD_SLICE;
-        m_VideoDecoderCtx->thread_count = qMin(MAX_SLICES, SDL_GetCPUCount());
+        DecodeThreadPolicy::Codec codec;
+        if (params->videoFormat & VIDEO_FORMAT_MASK_H264) {
+            codec = DecodeThreadPolicy::Codec::H264;
+        }
+        else if (params->videoFormat & VIDEO_FORMAT_MASK_H265) {
+            codec = DecodeThreadPolicy::Codec::HEVC;
+        }
+        else {
+            codec = DecodeThreadPolicy::Codec::AV1;
+        }
+
+        m_ThreadPolicy = DecodeThreadPolicy::choose(SDL_GetCPUCount(), codec,
+                                                    params->width, params->height, params->frameRate,
+                                                    params->enableFrameThreading);
+
+        m_VideoDecoderCtx->thread_count = m_ThreadPolicy.threadCount;
+        if (m_ThreadPolicy.mode == DecodeThreadPolicy::ThreadingMode::Frame) {
+            // FFmpeg won't frame-thread in low delay mode
+            m_VideoDecoderCtx->thread_type = FF_THREAD_FRAME;
+            m_VideoDecoderCtx->flags &= ~AV_CODEC_FLAG_LOW_DELAY;
+        }
+        else {
+            m_VideoDecoderCtx->thread_type = FF_THREAD_SLICE;
+        }
+
+        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                    "Software decoding with %d %s threads (%d slices per frame, %d frames of added latency)",
+                    m_ThreadPolicy.threadCount,
+                    m_ThreadPolicy.mode == DecodeThreadPolicy::ThreadingMode::Frame ? "frame" : "slice",
+                    m_ThreadPolicy.slicesPerFrame,
+                    m_ThreadPolicy.addedLatencyFrames);
     }
     else {
         // No threading for HW decode
@@ -751,17 +848,16 @@ bool FFmpegVideoDecoder::completeInitialization(const AVCodec* decoder, enum AVP
         }
 
         // Tell overlay manager to use this frontend renderer
-        Session::get()->getOverlayManager().setOverlayRenderer(m_FrontendRenderer);
+        if (Session::get() != nullptr) {
+            Session::get()->getOverlayManager().setOverlayRenderer(m_FrontendRenderer);
+        }
 
         // Allow the renderer to perform final preparations for rendering
         m_FrontendRenderer->prepareToRender();
 
-        // Only create the decoder thread when instantiating the decoder for real. It will use APIs from
-        // moonlight-common-c that can only be legally called with an established connection.
-        m_DecoderThread = SDL_CreateThread(FFmpegVideoDecoder::decoderThreadProcThunk, "FFDecoder", (void*)this);
-        if (m_DecoderThread == nullptr) {
-            SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
-                         "Failed to create decoder thread: %s", SDL_GetError());
+        // Only create the decoder thread when instantiating the decoder for real. A decoder
+        // built ahead of the connection is started later with resume().
+        if (!params->startParked && !resume()) {
             return false;
         }
 
@@ -791,8 +887,12 @@ void FFmpegVideoDecoder::addVideoStats(VIDEO_STATS& src, VIDEO_STATS& dst)
     dst.pacerDroppedFrames += src.pacerDroppedFrames;
     dst.totalReassemblyTimeUs += src.totalReassemblyTimeUs;
     dst.totalDecodeTimeUs += src.totalDecodeTimeUs;
+    dst.totalDecodeQueueTimeUs += src.totalDecodeQueueTimeUs;
     dst.totalPacerTimeUs += src.totalPacerTimeUs;
     dst.totalRenderTimeUs += src.totalRenderTimeUs;
+    dst.presentIntervals += src.presentIntervals;
+    dst.totalPresentIntervalUs += src.totalPresentIntervalUs;
+    dst.totalPresentIntervalSqUs += src.totalPresentIntervalSqUs;
 
     if (dst.minHostProcessingLatency == 0) {
         dst.minHostProcessingLatency = src.minHostProcessingLatency;
@@ -1007,6 +1107,23 @@ void FFmpegVideoDecoder::stringifyVideoStats(VIDEO_STATS &stats, char *output, i
         offset += ret;
     }
 
+    if (stats.presentIntervals > 1) {
+        // Standard deviation of the time between presents
+        double meanUs = (double)stats.totalPresentIntervalUs / stats.presentIntervals;
+        double varianceUs = (double)stats.totalPresentIntervalSqUs / stats.presentIntervals - meanUs * meanUs;
+
+        ret = snprintf(&output[offset],
+                       length - offset,
+                       "· Jitter **%.2f**ms ",
+                       std::sqrt(qMax(varianceUs, 0.0)) / 1000.0);
+        if (ret < 0 || ret >= length - offset) {
+            SDL_assert(false);
+            return;
+        }
+
+        offset += ret;
+    }
+
     if (stats.framesWithHostProcessingLatency > 0) {
         ret = snprintf(&output[offset],
                        length - offset,
@@ -1021,12 +1138,32 @@ void FFmpegVideoDecoder::stringifyVideoStats(VIDEO_STATS &stats, char *output, i
 
         offset += ret;
     }
+
+    AUDIO_STATS audioStats;
+    if (Session::get() != nullptr && Session::get()->getAudioStats(audioStats)) {
+        ret = snprintf(&output[offset],
+                       length - offset,
+                       "\n {18}Audio  Buffer **%u**/%ums · Underruns %u · Overruns %u · FEC %u · PLC %u · Lost %u ",
+                       audioStats.bufferedMs,
+                       audioStats.targetMs,
+                       audioStats.underruns,
+                       audioStats.overruns,
+                       audioStats.fecFrames,
+                       audioStats.concealedFrames,
+                       audioStats.lostFrames);
+        if (ret < 0 || ret >= length - offset) {
+            SDL_assert(false);
+            return;
+        }
+
+        offset += ret;
+    }
 }
 
 void FFmpegVideoDecoder::logVideoStats(VIDEO_STATS& stats, const char* title)
 {
     if (stats.renderedFps > 0 || stats.renderedFrames != 0) {
-        char videoStatsStr[512];
+        char videoStatsStr[1024];
         stringifyVideoStats(stats, videoStatsStr, sizeof(videoStatsStr));
 
         SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
@@ -1404,6 +1541,11 @@ bool FFmpegVideoDecoder::tryInitializeRendererForUnknownDecoder(const AVCodec* d
     if (decoder_pix_fmts == NULL) {
         // Supported output pixel formats are unknown. We'll just try DRM/SDL and hope it can cope.
 
+        if (NullRenderer::isEnabled() && tryInitializeRenderer(decoder, AV_PIX_FMT_NONE, params, nullptr, nullptr,
+                                  []() -> IFFmpegRenderer* { return new NullRenderer(); })) {
+            return true;
+        }
+
 #ifdef HAVE_DRM
         if ((glIsSlow || vulkanIsSlow) && tryInitializeRenderer(decoder, AV_PIX_FMT_NONE, params, nullptr, nullptr,
                                   []() -> IFFmpegRenderer* { return new DrmRenderer(); })) {
@@ -1450,6 +1592,16 @@ bool FFmpegVideoDecoder::tryInitializeRendererForUnknownDecoder(const AVCodec* d
         return false;
     }
 
+    // Software frames go straight to the null renderer when running headless
+    if (NullRenderer::isEnabled()) {
+        for (int i = 0; decoder_pix_fmts[i] != AV_PIX_FMT_NONE; i++) {
+            TRY_PREFERRED_PIXEL_FORMAT(NullRenderer);
+        }
+        for (int i = 0; decoder_pix_fmts[i] != AV_PIX_FMT_NONE; i++) {
+            TRY_SUPPORTED_NON_PREFERRED_PIXEL_FORMAT(NullRenderer);
+        }
+    }
+
     // Check if any of our decoders prefer any of the pixel formats first
     for (int i = 0; decoder_pix_fmts[i] != AV_PIX_FMT_NONE; i++) {
 #ifdef HAVE_DRM
@@ -1461,6 +1613,9 @@ bool FFmpegVideoDecoder::tryInitializeRendererForUnknownDecoder(const AVCodec* d
         }
 #endif
         if (!glIsSlow) {
+#ifdef HAVE_EGL
+            TRY_PREFERRED_PIXEL_FORMAT(EGLRenderer);
+#endif
             TRY_PREFERRED_PIXEL_FORMAT(SdlRenderer);
         }
     }
@@ -1476,6 +1631,9 @@ bool FFmpegVideoDecoder::tryInitializeRendererForUnknownDecoder(const AVCodec* d
         }
 #endif
         if (!glIsSlow) {
+#ifdef HAVE_EGL
+            TRY_SUPPORTED_NON_PREFERRED_PIXEL_FORMAT(EGLRenderer);
+#endif
             TRY_SUPPORTED_NON_PREFERRED_PIXEL_FORMAT(SdlRenderer);
         }
     }
@@ -1808,77 +1966,8 @@ bool FFmpegVideoDecoder::initialize(PDECODER_PARAMETERS params)
 void FFmpegVideoDecoder::writeBuffer(PLENTRY entry, int& offset)
 {
     if (m_NeedsSpsFixup && entry->bufferType == BUFFER_TYPE_SPS) {
-        h264_stream_t* stream = h264_new();
-        int nalStart, nalEnd;
-        bool needsFixup;
-
-        // Read the old NALU
-        find_nal_unit((uint8_t*)entry->data, entry->length, &nalStart, &nalEnd);
-        read_nal_unit(stream,
-                      (unsigned char *)&entry->data[nalStart],
-                      nalEnd - nalStart);
-
-        SDL_assert(nalStart == 3 || nalStart == 4); // 3 or 4 byte Annex B start sequence
-        SDL_assert(nalEnd == entry->length);
-
-        // Fixup the SPS to what OS X needs to use hardware acceleration
-        // This is also critical for decoding latency on the Pi 2.
-        needsFixup = (stream->sps->num_ref_frames != 1 || stream->sps->vui.max_dec_frame_buffering != 1);
-#ifndef QT_DEBUG
-        if (needsFixup)
-#endif
-        {
-            stream->sps->num_ref_frames = 1;
-            stream->sps->vui.max_dec_frame_buffering = 1;
-
-            // NVENC doesn't seem to add bitstream restrictions anymore (591.59),
-            // so we need to add them ourselves if not present to ensure that
-            // the max_dec_frame_buffering option actually takes effect.
-            // We use the defaults for everything except max_dec_frame_buffering.
-            if (!stream->sps->vui.bitstream_restriction_flag) {
-                stream->sps->vui.bitstream_restriction_flag = 1;
-                stream->sps->vui.motion_vectors_over_pic_boundaries_flag = 1;
-                stream->sps->vui.max_bytes_per_pic_denom = 2;
-                stream->sps->vui.max_bits_per_mb_denom = 1;
-                stream->sps->vui.log2_max_mv_length_horizontal = 16;
-                stream->sps->vui.log2_max_mv_length_vertical = 16;
-                stream->sps->vui.num_reorder_frames = 0;
-            }
-
-            int initialOffset = offset;
-
-            // Copy the modified NALU data. This clobbers byte 0 and starts NALU data at byte 1.
-            // Since it prepended one extra byte, subtract one from the returned length.
-            offset += write_nal_unit(stream, (uint8_t*)&m_DecodeBuffer.data()[initialOffset + nalStart - 1],
-                                     MAX_SPS_EXTRA_SIZE + entry->length - nalStart) - 1;
-
-            // Copy the NALU prefix over from the original SPS
-            memcpy(&m_DecodeBuffer.data()[initialOffset], entry->data, nalStart);
-            offset += nalStart;
-
-#ifdef QT_DEBUG
-            // If we didn't need a fixup, the SPS should have stayed the exact same
-            if (!needsFixup) {
-                SDL_assert(offset - initialOffset == entry->length);
-                SDL_assert(memcmp(&m_DecodeBuffer.data()[initialOffset], entry->data, entry->length) == 0);
-            }
-            else {
-                // The SPS should never get smaller with a fixup
-                SDL_assert(offset - initialOffset >= entry->length);
-            }
-#endif
-        }
-#ifndef QT_DEBUG
-        else {
-            // Write the SPS as-is if it required no modification
-            memcpy(&m_DecodeBuffer.data()[offset],
-                   entry->data,
-                   entry->length);
-            offset += entry->length;
-        }
-#endif
-
-        h264_free(stream);
+        offset += fixupH264Sps(reinterpret_cast<const uint8_t*>(entry->data), entry->length,
+                               reinterpret_cast<uint8_t*>(&m_DecodeBuffer.data()[offset]));
     }
     else {
         // Write the buffer as-is
@@ -1917,7 +2006,7 @@ void FFmpegVideoDecoder::decoderThreadProc()
 
             // We have output frames to receive. Let's poll until we get one,
             // and submit new input data if/when we get it.
-            AVFrame* frame = av_frame_alloc();
+            AVFrame* frame = m_FramePool.acquire();
             if (!frame) {
                 // Failed to allocate a frame but we did submit,
                 // so we can return DR_OK
@@ -1933,59 +2022,23 @@ void FFmpegVideoDecoder::decoderThreadProc()
                     SDL_assert(m_FrameInfoQueue.size() == m_FramesIn - m_FramesOut);
                     m_FramesOut++;
 
+                    if (m_FramesOut == 1 && Session::get() != nullptr) {
+                        Session::get()->notifyFirstFrameDecoded();
+                    }
+
                     // Log the first frame that carries ST 2094-40, so a user reporting
                     // "HDR10+ does nothing" can be told apart from a host that never sent
                     // any. Once per session is enough; this is the decoder hot path.
-                    //
-                    // Also say whether anything downstream will use it: a renderer that
-                    // reports Unsupported never tone maps HDR itself, so the metadata
-                    // arriving is not the same as the metadata mattering.
+                    // AV1 gets this from the OBU index in processAv1TemporalUnit() instead.
 #if LIBAVUTIL_VERSION_INT >= AV_VERSION_INT(56, 25, 100)
-                    if (!m_LoggedHdr10PlusMetadata &&
+                    if (!m_LoggedHdr10PlusMetadata && !(m_VideoFormat & VIDEO_FORMAT_MASK_AV1) &&
                             av_frame_get_side_data(frame, AV_FRAME_DATA_DYNAMIC_HDR_PLUS) != nullptr) {
-                        bool rendererUsesIt = m_FrontendRenderer != nullptr &&
-                                m_FrontendRenderer->getActiveToneMappingSource() != IFFmpegRenderer::ToneMappingSource::Unsupported;
-                        SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
-                                    "Received HDR10+ dynamic metadata from the %s bitstream%s",
-                                    (m_VideoFormat & VIDEO_FORMAT_MASK_AV1) ? "AV1" : "HEVC",
-                                    rendererUsesIt ? "" : " (ignored: the current renderer does not tone map HDR)");
-                        m_LoggedHdr10PlusMetadata = true;
+                        logHdr10PlusMetadata();
                     }
 #endif
 
-                    // Attach HDR metadata to the frame if it's not already present. We will defer to
-                    // any metadata contained in the bitstream itself since that is guaranteed to be
-                    // correctly synchronized to each frame, unlike our async HDR metadata message.
-                    SS_HDR_METADATA hdrMetadata;
-                    if (LiGetHdrMetadata(&hdrMetadata)) {
-                        if (av_frame_get_side_data(frame, AV_FRAME_DATA_MASTERING_DISPLAY_METADATA) == nullptr) {
-                            auto mdm = av_mastering_display_metadata_create_side_data(frame);
-
-                            mdm->display_primaries[0][0] = av_make_q(hdrMetadata.displayPrimaries[0].x, 50000);
-                            mdm->display_primaries[0][1] = av_make_q(hdrMetadata.displayPrimaries[0].y, 50000);
-                            mdm->display_primaries[1][0] = av_make_q(hdrMetadata.displayPrimaries[1].x, 50000);
-                            mdm->display_primaries[1][1] = av_make_q(hdrMetadata.displayPrimaries[1].y, 50000);
-                            mdm->display_primaries[2][0] = av_make_q(hdrMetadata.displayPrimaries[2].x, 50000);
-                            mdm->display_primaries[2][1] = av_make_q(hdrMetadata.displayPrimaries[2].y, 50000);
-
-                            mdm->white_point[0] = av_make_q(hdrMetadata.whitePoint.x, 50000);
-                            mdm->white_point[1] = av_make_q(hdrMetadata.whitePoint.y, 50000);
-
-                            mdm->min_luminance = av_make_q(hdrMetadata.minDisplayLuminance, 10000);
-                            mdm->max_luminance = av_make_q(hdrMetadata.maxDisplayLuminance, 1);
-
-                            mdm->has_luminance = hdrMetadata.maxDisplayLuminance != 0 ? 1 : 0;
-                            mdm->has_primaries = hdrMetadata.displayPrimaries[0].x != 0 ? 1 : 0;
-                        }
-
-                        if ((hdrMetadata.maxContentLightLevel != 0 || hdrMetadata.maxFrameAverageLightLevel != 0) &&
-                                av_frame_get_side_data(frame, AV_FRAME_DATA_CONTENT_LIGHT_LEVEL) == nullptr) {
-                            auto clm = av_content_light_metadata_create_side_data(frame);
-
-                            clm->MaxCLL = hdrMetadata.maxContentLightLevel;
-                            clm->MaxFALL = hdrMetadata.maxFrameAverageLightLevel;
-                        }
-                    }
+                    // Attach the host's HDR metadata unless the bitstream carried its own
+                    m_HdrMetadata.attachToFrame(frame);
 
                     // Some encoders (like RDNA3's AV1 encoder) include excess padding and expect us
                     // to crop it off. If we find our received frame looks close to our requested
@@ -2153,11 +2206,71 @@ void FFmpegVideoDecoder::decoderThreadProc()
             } while (err == AVERROR(EAGAIN) && !SDL_AtomicGet(&m_DecoderThreadShouldQuit));
 
             if (err != 0) {
-                // Free the frame if we failed to submit it
-                av_frame_free(&frame);
+                // Return the frame if we failed to submit it
+                m_FramePool.release(&frame);
+            }
+        }
+    }
+}
+
+void FFmpegVideoDecoder::logHdr10PlusMetadata()
+{
+    // Also say whether anything downstream will use it: a renderer that
+    // reports Unsupported never tone maps HDR itself, so the metadata
+    // arriving is not the same as the metadata mattering.
+    bool rendererUsesIt = m_FrontendRenderer != nullptr &&
+            m_FrontendRenderer->getActiveToneMappingSource() != IFFmpegRenderer::ToneMappingSource::Unsupported;
+    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
+                "Received HDR10+ dynamic metadata from the %s bitstream%s",
+                (m_VideoFormat & VIDEO_FORMAT_MASK_AV1) ? "AV1" : "HEVC",
+                rendererUsesIt ? "" : " (ignored: the current renderer does not tone map HDR)");
+    m_LoggedHdr10PlusMetadata = true;
+}
+
+// Everything that needs the structure of an AV1 temporal unit shares one scan
+// of it, and frames nothing needs to look inside aren't scanned at all.
+// Returns the new length of the temporal unit.
+int FFmpegVideoDecoder::processAv1TemporalUnit(PDECODE_UNIT du, int length)
+{
+    uint8_t* data = reinterpret_cast<uint8_t*>(m_DecodeBuffer.data());
+    bool checkKeyframe = du->frameType == FRAME_TYPE_IDR;
+    // HDR10+ metadata rides along with every frame, keyframes included, and
+    // keyframes get scanned anyway. Looking only there means a host that never
+    // sends any costs us nothing beyond that scan.
+    bool checkHdr10Plus = checkKeyframe && (m_VideoFormat & VIDEO_FORMAT_MASK_10BIT) && !m_LoggedHdr10PlusMetadata;
+    if (!m_NeedsAv1ObuRepack && !checkKeyframe) {
+        return length;
+    }
+
+    Av1TemporalUnitIndex index;
+    if (!scanAv1TemporalUnit(data, length, &index)) {
+        return length;
+    }
+
+    // A decoder can't start from an IDR frame without a sequence header, and
+    // FFmpeg only reports that as a generic decode failure
+    if (checkKeyframe && findAv1Obu(&index, AV1_OBU_SEQUENCE_HEADER) < 0) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "AV1 IDR frame %d has no sequence header",
+                    du->frameNumber);
+    }
+
+    // Read from the bitstream itself, so it doesn't depend on the decoder
+    // passing the metadata through as frame side data
+    if (checkHdr10Plus) {
+        for (int i = findAv1Obu(&index, AV1_OBU_METADATA); i >= 0; i = findAv1Obu(&index, AV1_OBU_METADATA, i + 1)) {
+            if (isAv1Hdr10PlusMetadata(data, &index.obus[i])) {
+                logHdr10PlusMetadata();
+                break;
             }
         }
     }
+
+    if (m_NeedsAv1ObuRepack) {
+        length = repackAv1TemporalUnit(data, length, &index);
+    }
+
+    return length;
 }
 
 int FFmpegVideoDecoder::submitDecodeUnit(PDECODE_UNIT du)
@@ -2183,25 +2296,47 @@ int FFmpegVideoDecoder::submitDecodeUnit(PDECODE_UNIT du)
         m_LastFrameNumber = du->frameNumber;
     }
 
-    m_BwTracker.AddBytes(du->fullLength);
+    BandwidthCalculator::instance()->addBytes(BandwidthCalculator::Video, du->fullLength);
 
     // Flip stats windows roughly every second
     if (LiGetMicroseconds() > m_ActiveWndVideoStats.measurementStartUs + 1000000) {
+        Session* session = Session::get();
+
         // Update overlay stats if it's enabled
-        if (Session::get()->getOverlayManager().isOverlayEnabled(Overlay::OverlayDebug)) {
+        if (session != nullptr && session->getOverlayManager().isOverlayEnabled(Overlay::OverlayDebug)) {
             VIDEO_STATS lastTwoWndStats = {};
             addVideoStats(m_LastWndVideoStats, lastTwoWndStats);
             addVideoStats(m_ActiveWndVideoStats, lastTwoWndStats);
 
             stringifyVideoStats(lastTwoWndStats,
-                                Session::get()->getOverlayManager().getOverlayText(Overlay::OverlayDebug),
-                                Session::get()->getOverlayManager().getOverlayMaxTextLength());
-            Session::get()->getOverlayManager().setOverlayTextUpdated(Overlay::OverlayDebug);
+                                session->getOverlayManager().getOverlayText(Overlay::OverlayDebug),
+                                session->getOverlayManager().getOverlayMaxTextLength());
+            session->getOverlayManager().setOverlayTextUpdated(Overlay::OverlayDebug);
         }
 
         // Accumulate these values into the global stats
         addVideoStats(m_ActiveWndVideoStats, m_GlobalVideoStats);
 
+        // Let the client-side ABR judge the window that just closed
+        AbrController::Sample abrSample;
+        abrSample.timestampMs = SDL_GetTicks();
+        abrSample.frameRate = m_StreamFps;
+        abrSample.totalFrames = m_ActiveWndVideoStats.totalFrames;
+        abrSample.networkDroppedFrames = m_ActiveWndVideoStats.networkDroppedFrames;
+        abrSample.receivedFrames = m_ActiveWndVideoStats.receivedFrames;
+        abrSample.totalDecodeQueueTimeUs = m_ActiveWndVideoStats.totalDecodeQueueTimeUs;
+        abrSample.decodedFrames = m_ActiveWndVideoStats.decodedFrames;
+        abrSample.totalDecodeTimeUs = m_ActiveWndVideoStats.totalDecodeTimeUs;
+        abrSample.renderedFrames = m_ActiveWndVideoStats.renderedFrames;
+        abrSample.pacerDroppedFrames = m_ActiveWndVideoStats.pacerDroppedFrames;
+        abrSample.totalPacerTimeUs = m_ActiveWndVideoStats.totalPacerTimeUs;
+        abrSample.presentIntervals = m_ActiveWndVideoStats.presentIntervals;
+        abrSample.totalPresentIntervalUs = m_ActiveWndVideoStats.totalPresentIntervalUs;
+        abrSample.totalPresentIntervalSqUs = m_ActiveWndVideoStats.totalPresentIntervalSqUs;
+        if (session != nullptr) {
+            session->submitClientAbrSample(abrSample);
+        }
+
         // Move this window into the last window slot and clear it for next window
         SDL_memcpy(&m_LastWndVideoStats, &m_ActiveWndVideoStats, sizeof(m_ActiveWndVideoStats));
         SDL_zero(m_ActiveWndVideoStats);
@@ -2223,6 +2358,11 @@ int FFmpegVideoDecoder::submitDecodeUnit(PDECODE_UNIT du)
     m_ActiveWndVideoStats.receivedFrames++;
     m_ActiveWndVideoStats.totalFrames++;
 
+    // A decoder that keeps up takes each frame about as soon as it's queued,
+    // however many frames it has in flight. Time spent waiting here is what
+    // tells a decoder that's falling behind from one that's merely pipelined.
+    m_ActiveWndVideoStats.totalDecodeQueueTimeUs += (LiGetMicroseconds() - du->enqueueTimeUs);
+
     int requiredBufferSize = du->fullLength;
     if (du->frameType == FRAME_TYPE_IDR) {
         // Add some extra space in case we need to do an SPS fixup
@@ -2238,8 +2378,8 @@ int FFmpegVideoDecoder::submitDecodeUnit(PDECODE_UNIT du)
         entry = entry->next;
     }
 
-    if (m_NeedsAv1ObuRepack) {
-        offset = repackAv1TemporalUnit(reinterpret_cast<uint8_t*>(m_DecodeBuffer.data()), offset);
+    if (m_VideoFormat & VIDEO_FORMAT_MASK_AV1) {
+        offset = processAv1TemporalUnit(du, offset);
     }
 
     m_Pkt->data = reinterpret_cast<uint8_t*>(m_DecodeBuffer.data());
@@ -2281,6 +2421,15 @@ int FFmpegVideoDecoder::submitDecodeUnit(PDECODE_UNIT du)
         return DR_NEED_IDR;
     }
 
+    // Only a decoder that lost frames to errors gets this far behind. Those
+    // frames are never coming out, so stop waiting for the oldest.
+    if (m_FrameInfoQueue.isFull()) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Decoder has not output frame %d; no longer waiting for it",
+                    m_FrameInfoQueue.dequeue().frameNumber);
+        m_FramesOut++;
+    }
+
     m_FrameInfoQueue.enqueue(*du);
 
     m_FramesIn++;
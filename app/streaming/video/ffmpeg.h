@@ -1,11 +1,13 @@
 #pragma once
 
 #include <functional>
-#include <QQueue>
 #include <set>
 
-#include "../bwtracker.h"
 #include "decoder.h"
+#include "decodethreadpolicy.h"
+#include "fixedqueue.h"
+#include "framepool.h"
+#include "hdrmetadatastate.h"
 #include "ffmpeg-renderers/renderer.h"
 #include "ffmpeg-renderers/pacer/pacer.h"
 #include "streaming/video/videoenhancement.h"
@@ -30,6 +32,8 @@ public:
     virtual void renderFrameOnMainThread() override;
     virtual void setHdrMode(bool enabled) override;
     virtual bool notifyWindowChanged(PWINDOW_STATE_CHANGE_INFO info) override;
+    virtual void park() override;
+    virtual bool resume() override;
 
     virtual IFFmpegRenderer* getBackendRenderer();
 
@@ -96,8 +100,14 @@ private:
 
     void reset();
 
+    void stopDecoderThread();
+
     void writeBuffer(PLENTRY entry, int& offset);
 
+    void logHdr10PlusMetadata();
+
+    int processAv1TemporalUnit(PDECODE_UNIT du, int length);
+
     static
     enum AVPixelFormat ffGetFormat(AVCodecContext* context,
                                    const enum AVPixelFormat* pixFmts);
@@ -115,7 +125,6 @@ private:
     IFFmpegRenderer* m_FrontendRenderer;
     int m_ConsecutiveFailedDecodes;
     Pacer* m_Pacer;
-    BandwidthTracker m_BwTracker;
     VIDEO_STATS m_ActiveWndVideoStats;
     VIDEO_STATS m_LastWndVideoStats;
     VIDEO_STATS m_GlobalVideoStats;
@@ -129,17 +138,25 @@ private:
     int m_OriginalVideoWidth;
     int m_OriginalVideoHeight;
     int m_VideoFormat;
+    DecodeThreadPolicy m_ThreadPolicy;
     bool m_NeedsSpsFixup;
     bool m_NeedsAv1ObuRepack;
     bool m_LoggedHdr10PlusMetadata;
+    HdrMetadataState m_HdrMetadata;
+    int m_RendererHdrVersion;
     bool m_TestOnly;
     TestMode m_CurrentTestMode;
     SDL_Thread* m_DecoderThread;
     SDL_atomic_t m_DecoderThreadShouldQuit;
     VideoEnhancement* m_VideoEnhancement;
 
-    // Data buffers in the queued DU are not valid
-    QQueue<DECODE_UNIT> m_FrameInfoQueue;
+    // Output frame shells. The decoder thread holds one while the pacer
+    // holds the rest, up to PACER_MAX_HELD_FRAMES of them.
+    FramePool m_FramePool;
+
+    // Data buffers in the queued DU are not valid. Sized well past the
+    // deepest frame threading or hardware decode queue.
+    FixedQueue<DECODE_UNIT, 64> m_FrameInfoQueue;
 
     static const uint8_t k_H264TestFrame[];
     static const uint8_t k_HEVCMainTestFrame[];
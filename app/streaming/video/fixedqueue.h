@@ -0,0 +1,76 @@
+#pragma once
+
+#include "SDL_compat.h"
+
+// A FIFO queue with storage for Capacity elements inline, for the per-frame
+// paths where a QQueue's occasional reallocation is unwelcome. Callers are
+// responsible for never enqueuing onto a full queue, which asserts.
+//
+// Not thread-safe, just like QQueue.
+template <typename T, int Capacity>
+class FixedQueue
+{
+public:
+    class const_iterator
+    {
+    public:
+        const_iterator(const FixedQueue* queue, int index) : m_Queue(queue), m_Index(index) {}
+
+        const T& operator*() const { return m_Queue->at(m_Index); }
+        const_iterator& operator++() { m_Index++; return *this; }
+        bool operator!=(const const_iterator& other) const { return m_Index != other.m_Index; }
+
+    private:
+        const FixedQueue* m_Queue;
+        int m_Index;
+    };
+
+    bool isEmpty() const { return m_Count == 0; }
+    bool isFull() const { return m_Count == Capacity; }
+    int size() const { return m_Count; }
+    int count() const { return m_Count; }
+    static constexpr int capacity() { return Capacity; }
+
+    void enqueue(const T& value)
+    {
+        SDL_assert(m_Count < Capacity);
+        m_Items[(m_Head + m_Count) % Capacity] = value;
+        m_Count++;
+    }
+
+    T dequeue()
+    {
+        SDL_assert(m_Count > 0);
+        T value = m_Items[m_Head];
+        m_Head = (m_Head + 1) % Capacity;
+        m_Count--;
+        return value;
+    }
+
+    const T& head() const
+    {
+        SDL_assert(m_Count > 0);
+        return m_Items[m_Head];
+    }
+
+    // The i-th oldest element
+    const T& at(int i) const
+    {
+        SDL_assert(i >= 0 && i < m_Count);
+        return m_Items[(m_Head + i) % Capacity];
+    }
+
+    void clear()
+    {
+        m_Head = 0;
+        m_Count = 0;
+    }
+
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, m_Count); }
+
+private:
+    T m_Items[Capacity] {};
+    int m_Head = 0;
+    int m_Count = 0;
+};
@@ -0,0 +1,65 @@
+#include "framepool.h"
+
+FramePool::FramePool(int capacity)
+    : m_Lock(SDL_CreateMutex()),
+      m_Capacity(capacity),
+      m_Allocations(0)
+{
+    // Reserved up front so returning a shell never grows the vector
+    m_Free.reserve(capacity);
+}
+
+FramePool::~FramePool()
+{
+    if (m_Allocations > m_Capacity) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Frame pool allocated %d frames beyond its capacity of %d",
+                    m_Allocations - m_Capacity,
+                    m_Capacity);
+    }
+
+    for (AVFrame* frame : m_Free) {
+        av_frame_free(&frame);
+    }
+
+    SDL_DestroyMutex(m_Lock);
+}
+
+AVFrame* FramePool::acquire()
+{
+    SDL_LockMutex(m_Lock);
+    if (!m_Free.empty()) {
+        AVFrame* frame = m_Free.back();
+        m_Free.pop_back();
+        SDL_UnlockMutex(m_Lock);
+        return frame;
+    }
+
+    // Every shell is in flight. That's expected while warming up.
+    m_Allocations++;
+    SDL_assert(m_Allocations <= m_Capacity);
+    SDL_UnlockMutex(m_Lock);
+
+    return av_frame_alloc();
+}
+
+void FramePool::release(AVFrame** frame)
+{
+    if (*frame == nullptr) {
+        return;
+    }
+
+    // Unref outside the lock, since returning hardware surfaces to their
+    // pool can take a while
+    av_frame_unref(*frame);
+
+    SDL_LockMutex(m_Lock);
+    if ((int)m_Free.size() < m_Capacity) {
+        m_Free.push_back(*frame);
+        *frame = nullptr;
+    }
+    SDL_UnlockMutex(m_Lock);
+
+    // Only overflow shells are left to free
+    av_frame_free(frame);
+}
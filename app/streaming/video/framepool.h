@@ -0,0 +1,36 @@
+#pragma once
+
+#include "SDL_compat.h"
+
+#include <vector>
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+// Recycles AVFrame shells between the decoder thread, which fills them, and
+// the pacer, which releases them once rendered or dropped.
+//
+// The number of frames in flight is bounded by the pacer's queues, so a pool
+// of that size stops allocating once it has handed out each shell once.
+// Allocations past that point mean a frame leaked or the bound is wrong,
+// which asserts in debug builds and falls back to av_frame_alloc() otherwise.
+class FramePool
+{
+public:
+    explicit FramePool(int capacity);
+    ~FramePool();
+
+    // Returns an empty frame, or nullptr if allocation failed
+    AVFrame* acquire();
+
+    // Unreferences the frame's buffers and takes the shell back. Sets *frame
+    // to nullptr, so it is a drop-in for av_frame_free().
+    void release(AVFrame** frame);
+
+private:
+    SDL_mutex* m_Lock;
+    const int m_Capacity;
+    std::vector<AVFrame*> m_Free;
+    int m_Allocations;
+};
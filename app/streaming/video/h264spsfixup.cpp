@@ -0,0 +1,77 @@
+#include "h264spsfixup.h"
+
+#include "SDL_compat.h"
+
+#include <h264_stream.h>
+#include <string.h>
+
+int fixupH264Sps(const uint8_t* data, int length, uint8_t* out)
+{
+    h264_stream_t* stream = h264_new();
+    int nalStart, nalEnd;
+    bool needsFixup;
+    int written;
+
+    // Read the old NALU
+    find_nal_unit((uint8_t*)data, length, &nalStart, &nalEnd);
+    read_nal_unit(stream,
+                  (unsigned char *)&data[nalStart],
+                  nalEnd - nalStart);
+
+    SDL_assert(nalStart == 3 || nalStart == 4); // 3 or 4 byte Annex B start sequence
+    SDL_assert(nalEnd == length);
+
+    needsFixup = (stream->sps->num_ref_frames != 1 || stream->sps->vui.max_dec_frame_buffering != 1);
+#ifndef QT_DEBUG
+    if (needsFixup)
+#endif
+    {
+        stream->sps->num_ref_frames = 1;
+        stream->sps->vui.max_dec_frame_buffering = 1;
+
+        // NVENC doesn't seem to add bitstream restrictions anymore (591.59),
+        // so we need to add them ourselves if not present to ensure that
+        // the max_dec_frame_buffering option actually takes effect.
+        // We use the defaults for everything except max_dec_frame_buffering.
+        if (!stream->sps->vui.bitstream_restriction_flag) {
+            stream->sps->vui.bitstream_restriction_flag = 1;
+            stream->sps->vui.motion_vectors_over_pic_boundaries_flag = 1;
+            stream->sps->vui.max_bytes_per_pic_denom = 2;
+            stream->sps->vui.max_bits_per_mb_denom = 1;
+            stream->sps->vui.log2_max_mv_length_horizontal = 16;
+            stream->sps->vui.log2_max_mv_length_vertical = 16;
+            stream->sps->vui.num_reorder_frames = 0;
+        }
+
+        // Copy the modified NALU data. This clobbers byte 0 and starts NALU data at byte 1.
+        // Since it prepended one extra byte, subtract one from the returned length.
+        written = write_nal_unit(stream, &out[nalStart - 1],
+                                 MAX_SPS_EXTRA_SIZE + length - nalStart) - 1;
+
+        // Copy the NALU prefix over from the original SPS
+        memcpy(out, data, nalStart);
+        written += nalStart;
+
+#ifdef QT_DEBUG
+        // If we didn't need a fixup, the SPS should have stayed the exact same
+        if (!needsFixup) {
+            SDL_assert(written == length);
+            SDL_assert(memcmp(out, data, length) == 0);
+        }
+        else {
+            // The SPS should never get smaller with a fixup
+            SDL_assert(written >= length);
+        }
+#endif
+    }
+#ifndef QT_DEBUG
+    else {
+        // Write the SPS as-is if it required no modification
+        memcpy(out, data, length);
+        written = length;
+    }
+#endif
+
+    h264_free(stream);
+    return written;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdint.h>
+
+// The most a fixed up SPS can grow by
+#define MAX_SPS_EXTRA_SIZE 16
+
+// Rewrites an Annex B H.264 SPS to what OS X needs to use hardware
+// acceleration: a single reference frame and a single frame of decoder
+// buffering. This is also critical for decoding latency on the Pi 2.
+//
+// out must have room for length + MAX_SPS_EXTRA_SIZE bytes. Returns the
+// number of bytes written. An SPS that already matches is copied as-is.
+int fixupH264Sps(const uint8_t* data, int length, uint8_t* out);
@@ -0,0 +1,160 @@
+#include "hdrmetadatastate.h"
+
+#include <string.h>
+
+extern "C" {
+#include <libavutil/mastering_display_metadata.h>
+}
+
+HdrMetadataState::HdrMetadataState()
+    : m_Lock(SDL_CreateMutex()),
+      m_Enabled(false),
+      m_HasMetadata(false),
+      m_MasteringDisplay(nullptr),
+      m_ContentLight(nullptr),
+      m_FrameVersion(0),
+      m_FrameMasteringDisplay(nullptr),
+      m_FrameContentLight(nullptr)
+{
+    SDL_AtomicSet(&m_Version, 0);
+    memset(&m_Metadata, 0, sizeof(m_Metadata));
+}
+
+HdrMetadataState::~HdrMetadataState()
+{
+    clearFrameRefs();
+    av_buffer_unref(&m_MasteringDisplay);
+    av_buffer_unref(&m_ContentLight);
+    SDL_DestroyMutex(m_Lock);
+}
+
+bool HdrMetadataState::update(bool enabled)
+{
+    SS_HDR_METADATA metadata;
+    bool hasMetadata = LiGetHdrMetadata(&metadata);
+    if (!hasMetadata) {
+        memset(&metadata, 0, sizeof(metadata));
+    }
+
+    SDL_LockMutex(m_Lock);
+
+    if (SDL_AtomicGet(&m_Version) != 0 &&
+            enabled == m_Enabled &&
+            hasMetadata == m_HasMetadata &&
+            memcmp(&metadata, &m_Metadata, sizeof(metadata)) == 0) {
+        SDL_UnlockMutex(m_Lock);
+        return false;
+    }
+
+    m_Enabled = enabled;
+    m_HasMetadata = hasMetadata;
+    m_Metadata = metadata;
+
+    av_buffer_unref(&m_MasteringDisplay);
+    av_buffer_unref(&m_ContentLight);
+
+    if (hasMetadata) {
+        // The same layout av_mastering_display_metadata_create_side_data() would
+        // give each frame, built once for all of them
+        m_MasteringDisplay = av_buffer_allocz(sizeof(AVMasteringDisplayMetadata));
+        if (m_MasteringDisplay != nullptr) {
+            auto mdm = reinterpret_cast<AVMasteringDisplayMetadata*>(m_MasteringDisplay->data);
+
+            for (int i = 0; i < 3; i++) {
+                mdm->display_primaries[i][0] = av_make_q(metadata.displayPrimaries[i].x, 50000);
+                mdm->display_primaries[i][1] = av_make_q(metadata.displayPrimaries[i].y, 50000);
+            }
+
+            mdm->white_point[0] = av_make_q(metadata.whitePoint.x, 50000);
+            mdm->white_point[1] = av_make_q(metadata.whitePoint.y, 50000);
+
+            mdm->min_luminance = av_make_q(metadata.minDisplayLuminance, 10000);
+            mdm->max_luminance = av_make_q(metadata.maxDisplayLuminance, 1);
+
+            mdm->has_luminance = metadata.maxDisplayLuminance != 0 ? 1 : 0;
+            mdm->has_primaries = metadata.displayPrimaries[0].x != 0 ? 1 : 0;
+        }
+
+        if (metadata.maxContentLightLevel != 0 || metadata.maxFrameAverageLightLevel != 0) {
+            m_ContentLight = av_buffer_allocz(sizeof(AVContentLightMetadata));
+            if (m_ContentLight != nullptr) {
+                auto clm = reinterpret_cast<AVContentLightMetadata*>(m_ContentLight->data);
+
+                clm->MaxCLL = metadata.maxContentLightLevel;
+                clm->MaxFALL = metadata.maxFrameAverageLightLevel;
+            }
+        }
+    }
+
+    // Published under the lock, so a reader that sees the new version also
+    // sees the buffers that go with it
+    SDL_AtomicAdd(&m_Version, 1);
+
+    SDL_UnlockMutex(m_Lock);
+    return true;
+}
+
+void HdrMetadataState::attachToFrame(AVFrame* frame)
+{
+    int version = SDL_AtomicGet(&m_Version);
+    if (version != m_FrameVersion) {
+        clearFrameRefs();
+
+        SDL_LockMutex(m_Lock);
+        m_FrameVersion = SDL_AtomicGet(&m_Version);
+        if (m_MasteringDisplay != nullptr) {
+            m_FrameMasteringDisplay = av_buffer_ref(m_MasteringDisplay);
+        }
+        if (m_ContentLight != nullptr) {
+            m_FrameContentLight = av_buffer_ref(m_ContentLight);
+        }
+        SDL_UnlockMutex(m_Lock);
+    }
+
+    if (m_FrameMasteringDisplay == nullptr && m_FrameContentLight == nullptr) {
+        return;
+    }
+
+    // One pass over the frame's side data for both types
+    bool hasMasteringDisplay = false;
+    bool hasContentLight = false;
+    for (int i = 0; i < frame->nb_side_data; i++) {
+        switch (frame->side_data[i]->type) {
+        case AV_FRAME_DATA_MASTERING_DISPLAY_METADATA:
+            hasMasteringDisplay = true;
+            break;
+        case AV_FRAME_DATA_CONTENT_LIGHT_LEVEL:
+            hasContentLight = true;
+            break;
+        default:
+            break;
+        }
+    }
+
+    // The frame takes ownership of a new reference on success
+    if (!hasMasteringDisplay && m_FrameMasteringDisplay != nullptr) {
+        AVBufferRef* ref = av_buffer_ref(m_FrameMasteringDisplay);
+        if (ref != nullptr &&
+                av_frame_new_side_data_from_buf(frame, AV_FRAME_DATA_MASTERING_DISPLAY_METADATA, ref) == nullptr) {
+            av_buffer_unref(&ref);
+        }
+    }
+    if (!hasContentLight && m_FrameContentLight != nullptr) {
+        AVBufferRef* ref = av_buffer_ref(m_FrameContentLight);
+        if (ref != nullptr &&
+                av_frame_new_side_data_from_buf(frame, AV_FRAME_DATA_CONTENT_LIGHT_LEVEL, ref) == nullptr) {
+            av_buffer_unref(&ref);
+        }
+    }
+}
+
+int HdrMetadataState::version()
+{
+    return SDL_AtomicGet(&m_Version);
+}
+
+void HdrMetadataState::clearFrameRefs()
+{
+    av_buffer_unref(&m_FrameMasteringDisplay);
+    av_buffer_unref(&m_FrameContentLight);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <Limelight.h>
+#include "SDL_compat.h"
+
+extern "C" {
+#include <libavutil/frame.h>
+}
+
+// The host's HDR mastering display and content light metadata as frame side
+// data, rebuilt only when the host reports a change.
+//
+// update() runs when common-c reports an HDR mode change. It converts the
+// metadata once into ref-counted side data buffers and bumps the version.
+// attachToFrame() runs for every decoded frame on the decoder thread and only
+// takes references to those buffers, so a session whose metadata never changes
+// does the conversion exactly once.
+class HdrMetadataState
+{
+public:
+    HdrMetadataState();
+    ~HdrMetadataState();
+
+    // Re-reads the host's metadata. Returns true and bumps the version if
+    // anything differs from the last call, including whether HDR is enabled.
+    bool update(bool enabled);
+
+    // Attaches the current metadata to a decoded frame unless the bitstream
+    // already supplied its own, since that is guaranteed to be in sync with the
+    // frame unlike the host's asynchronous HDR message. Decoder thread only.
+    void attachToFrame(AVFrame* frame);
+
+    // 0 until the first update(). Consumers that apply HDR state can compare it
+    // against the version they last applied to skip redundant work.
+    int version();
+
+private:
+    void clearFrameRefs();
+
+    SDL_mutex* m_Lock;
+    SDL_atomic_t m_Version;
+
+    // Guarded by m_Lock
+    bool m_Enabled;
+    bool m_HasMetadata;
+    SS_HDR_METADATA m_Metadata;
+    AVBufferRef* m_MasteringDisplay;
+    AVBufferRef* m_ContentLight;
+
+    // The decoder thread's own references, refreshed when the version moves
+    int m_FrameVersion;
+    AVBufferRef* m_FrameMasteringDisplay;
+    AVBufferRef* m_FrameContentLight;
+};
@@ -34,6 +34,13 @@ public:
         return false;
     }
 
+    // Frames are pushed to us by moonlight-common-c, so there is
+    // no decoder thread to stop or start
+    virtual void park() override {}
+    virtual bool resume() override {
+        return true;
+    }
+
 private:
     static void slLogCallback(void* context, ESLVideoLog logLevel, const char* message);
 
@@ -0,0 +1,162 @@
+#include "harness.h"
+
+#include "streaming/video/av1obu.h"
+
+#include <QByteArray>
+
+#include <cstring>
+
+namespace {
+
+// OBU header bytes with obu_has_size_field set
+const char kTemporalDelimiter = 0x12;
+const char kFrameHeader = 0x1A;
+const char kTileGroup = 0x22;
+const char kMetadata = 0x2A;
+const char kFrame = 0x32;
+
+void appendLeb128(QByteArray& out, quint64 value)
+{
+    do {
+        quint8 byte = value & 0x7F;
+        value >>= 7;
+        if (value != 0) {
+            byte |= 0x80;
+        }
+        out.append((char)byte);
+    } while (value != 0);
+}
+
+void appendObu(QByteArray& out, char header, const QByteArray& payload)
+{
+    out.append(header);
+    appendLeb128(out, payload.size());
+    out.append(payload);
+}
+
+QByteArray filler(int length, quint8 seed)
+{
+    QByteArray bytes(length, Qt::Uninitialized);
+    for (int i = 0; i < length; i++) {
+        bytes[i] = (char)(seed + i * 31);
+    }
+    return bytes;
+}
+
+// An HDR temporal unit as NVENC sends it: the frame header and tile group
+// split, with the mastering display and content light metadata between them
+QByteArray splitTemporalUnit(int tileGroupBytes)
+{
+    QByteArray frameHeader = filler(24, 7);
+    frameHeader[frameHeader.size() - 1] = 0x40; // Payload bits, then the trailing one bit
+
+    QByteArray tu;
+    appendObu(tu, kTemporalDelimiter, QByteArray());
+    appendObu(tu, kFrameHeader, frameHeader);
+    appendObu(tu, kMetadata, filler(26, 3));
+    appendObu(tu, kMetadata, filler(6, 5));
+    appendObu(tu, kTileGroup, filler(tileGroupBytes, 11));
+    return tu;
+}
+
+// An SDR temporal unit that is already in the merged form
+QByteArray mergedTemporalUnit(int frameBytes)
+{
+    QByteArray tu;
+    appendObu(tu, kTemporalDelimiter, QByteArray());
+    appendObu(tu, kFrame, filler(frameBytes, 13));
+    return tu;
+}
+
+class Av1RepackBenchmark : public Bench::Benchmark
+{
+public:
+    explicit Av1RepackBenchmark(QByteArray input)
+        : m_Input(std::move(input)),
+          m_Work(m_Input.size(), Qt::Uninitialized)
+    {
+    }
+
+    void run(qint64 iterations) override
+    {
+        for (qint64 i = 0; i < iterations; i++) {
+            // The repack is in place, so each iteration starts from a fresh copy
+            memcpy(m_Work.data(), m_Input.constData(), m_Input.size());
+            int length = repackAv1TemporalUnit(reinterpret_cast<uint8_t*>(m_Work.data()), m_Work.size());
+            Bench::doNotOptimize(length);
+        }
+    }
+
+    qint64 bytesPerIteration() const override
+    {
+        return m_Input.size();
+    }
+
+private:
+    QByteArray m_Input;
+    QByteArray m_Work;
+};
+
+// A 1080p frame at a typical streaming bitrate, and a large 4K keyframe
+class Av1RepackSplit1080p : public Av1RepackBenchmark
+{
+public:
+    Av1RepackSplit1080p() : Av1RepackBenchmark(splitTemporalUnit(40 * 1024)) {}
+};
+
+class Av1RepackSplit4kKeyframe : public Av1RepackBenchmark
+{
+public:
+    Av1RepackSplit4kKeyframe() : Av1RepackBenchmark(splitTemporalUnit(1024 * 1024)) {}
+};
+
+// The common SDR case, where only the parse runs
+class Av1RepackMerged1080p : public Av1RepackBenchmark
+{
+public:
+    Av1RepackMerged1080p() : Av1RepackBenchmark(mergedTemporalUnit(40 * 1024)) {}
+};
+
+// Just the index every AV1 frame gets on the decoder thread, for the
+// checks that don't rewrite anything
+class Av1ScanBenchmark : public Bench::Benchmark
+{
+public:
+    explicit Av1ScanBenchmark(QByteArray input)
+        : m_Input(std::move(input))
+    {
+    }
+
+    void run(qint64 iterations) override
+    {
+        for (qint64 i = 0; i < iterations; i++) {
+            Av1TemporalUnitIndex index;
+            bool valid = scanAv1TemporalUnit(reinterpret_cast<const uint8_t*>(m_Input.constData()), m_Input.size(), &index);
+            Bench::doNotOptimize(valid);
+            Bench::doNotOptimize(index);
+        }
+    }
+
+private:
+    QByteArray m_Input;
+};
+
+class Av1ScanSplit1080p : public Av1ScanBenchmark
+{
+public:
+    Av1ScanSplit1080p() : Av1ScanBenchmark(splitTemporalUnit(40 * 1024)) {}
+};
+
+class Av1ScanMerged1080p : public Av1ScanBenchmark
+{
+public:
+    Av1ScanMerged1080p() : Av1ScanBenchmark(mergedTemporalUnit(40 * 1024)) {}
+};
+
+}
+
+BENCHMARK("av1_repack/split_1080p", Av1RepackSplit1080p);
+BENCHMARK("av1_repack/split_4k_keyframe", Av1RepackSplit4kKeyframe);
+BENCHMARK("av1_repack/merged_1080p", Av1RepackMerged1080p);
+BENCHMARK("av1_scan/split_1080p", Av1ScanSplit1080p);
+BENCHMARK("av1_scan/merged_1080p", Av1ScanMerged1080p);
@@ -0,0 +1,109 @@
+#include "harness.h"
+
+#include "streaming/bwtracker.h"
+
+#include <atomic>
+#include <thread>
+
+namespace {
+
+// Roughly one video packet, which is what the receive path records per call
+const size_t kPacketBytes = 1400;
+
+class BwTrackerAddBytes : public Bench::Benchmark
+{
+public:
+    void run(qint64 iterations) override
+    {
+        for (qint64 i = 0; i < iterations; i++) {
+            m_Tracker.AddBytes(kPacketBytes);
+        }
+    }
+
+private:
+    BandwidthTracker m_Tracker;
+};
+
+class BwTrackerGetAverage : public Bench::Benchmark
+{
+public:
+    void setUp() override
+    {
+        for (int i = 0; i < 10000; i++) {
+            m_Tracker.AddBytes(kPacketBytes);
+        }
+    }
+
+    void run(qint64 iterations) override
+    {
+        for (qint64 i = 0; i < iterations; i++) {
+            Bench::doNotOptimize(m_Tracker.GetAverageMbps());
+        }
+    }
+
+private:
+    BandwidthTracker m_Tracker;
+};
+
+class BwTrackerGetStats : public Bench::Benchmark
+{
+public:
+    void setUp() override
+    {
+        for (int i = 0; i < 10000; i++) {
+            m_Tracker.AddBytes(kPacketBytes);
+        }
+    }
+
+    void run(qint64 iterations) override
+    {
+        for (qint64 i = 0; i < iterations; i++) {
+            Bench::doNotOptimize(m_Tracker.GetStats());
+        }
+    }
+
+private:
+    BandwidthTracker m_Tracker;
+};
+
+// AddBytes() while the stats overlay polls the averages from another
+// thread as fast as it can, the worst case for contention on the buckets
+class BwTrackerAddBytesContended : public Bench::Benchmark
+{
+public:
+    void setUp() override
+    {
+        m_Stopping = false;
+        m_Reader = std::thread([this]() {
+            while (!m_Stopping.load(std::memory_order_relaxed)) {
+                Bench::doNotOptimize(m_Tracker.GetAverageMbps());
+                Bench::doNotOptimize(m_Tracker.GetPeakMbps());
+            }
+        });
+    }
+
+    void run(qint64 iterations) override
+    {
+        for (qint64 i = 0; i < iterations; i++) {
+            m_Tracker.AddBytes(kPacketBytes);
+        }
+    }
+
+    void tearDown() override
+    {
+        m_Stopping = true;
+        m_Reader.join();
+    }
+
+private:
+    BandwidthTracker m_Tracker;
+    std::atomic<bool> m_Stopping;
+    std::thread m_Reader;
+};
+
+}
+
+BENCHMARK("bwtracker/add_bytes", BwTrackerAddBytes);
+BENCHMARK("bwtracker/get_average_mbps", BwTrackerGetAverage);
+BENCHMARK("bwtracker/get_stats", BwTrackerGetStats);
+BENCHMARK("bwtracker/add_bytes_contended", BwTrackerAddBytesContended);
@@ -0,0 +1,67 @@
+#include "harness.h"
+
+#include "streaming/clipboardipc.h"
+
+#include <QByteArray>
+
+namespace {
+
+class DecodeMessageBenchmark : public Bench::Benchmark
+{
+public:
+    explicit DecodeMessageBenchmark(QByteArray encoded)
+        : m_Encoded(std::move(encoded))
+    {
+    }
+
+    void run(qint64 iterations) override
+    {
+        for (qint64 i = 0; i < iterations; i++) {
+            ClipboardIpc::Message message;
+            qsizetype consumed = 0;
+            QString error;
+            ClipboardIpc::DecodeResult result =
+                ClipboardIpc::decodeMessage(m_Encoded.constData(), m_Encoded.size(),
+                                            message, consumed, error);
+            if (result != ClipboardIpc::DecodeResult::Complete) {
+                qFatal("decodeMessage() failed: %s", qPrintable(error));
+            }
+            Bench::doNotOptimize(message.frame.constData());
+        }
+    }
+
+    qint64 bytesPerIteration() const override
+    {
+        return m_Encoded.size();
+    }
+
+private:
+    QByteArray m_Encoded;
+};
+
+// A clipboard frame from the host carrying a 64 KB text payload
+class DecodeHostFrame : public DecodeMessageBenchmark
+{
+public:
+    DecodeHostFrame()
+        : DecodeMessageBenchmark(ClipboardIpc::encodeHostFrame(2, QByteArray(64 * 1024, 'x')))
+    {
+    }
+};
+
+// The small message a file transfer sends many times a second
+class DecodeProgress : public DecodeMessageBenchmark
+{
+public:
+    DecodeProgress()
+        : DecodeMessageBenchmark(ClipboardIpc::encodeProgress(4, true,
+                                                              5LL * 1024 * 1024 * 1024,
+                                                              6LL * 1024 * 1024 * 1024))
+    {
+    }
+};
+
+}
+
+BENCHMARK("clipboard_ipc/decode_host_frame_64k", DecodeHostFrame);
+BENCHMARK("clipboard_ipc/decode_progress", DecodeProgress);
@@ -0,0 +1,100 @@
+#include "harness.h"
+
+#include "streaming/input/cursorshapeclassifier.h"
+
+#include <QByteArray>
+
+namespace {
+
+struct Cursor
+{
+    int width;
+    int height;
+    int hotspotX;
+    int hotspotY;
+    QByteArray bgra;
+};
+
+void plotRow(Cursor& cursor, int y, int x0, int width)
+{
+    for (int x = x0; x < x0 + width; x++) {
+        int index = (y * cursor.width + x) * 4;
+        for (int i = 0; i < 4; i++) {
+            cursor.bgra[index + i] = (char)0xFF;
+        }
+    }
+}
+
+// The standard Windows arrow at 100% scale
+Cursor makeArrow()
+{
+    Cursor cursor { 32, 32, 0, 0, QByteArray(32 * 32 * 4, 0) };
+    for (int y = 0; y < 19; y++) {
+        if (y < 12) {
+            plotRow(cursor, y, 0, 1 + 10 * y / 11);
+        }
+        else {
+            plotRow(cursor, y, 3, qMax(1, 6 - (y - 12) * 4 / 7));
+        }
+    }
+    return cursor;
+}
+
+// The 64x64 I-beam Sunshine sends at 200% scale
+Cursor makeIBeam()
+{
+    Cursor cursor { 64, 64, 10, 18, QByteArray(64 * 64 * 4, 0) };
+    for (int y = 0; y < 36; y++) {
+        if (y < 5 || y >= 31) {
+            plotRow(cursor, y, 0, 21);
+        }
+        else {
+            plotRow(cursor, y, 8, 5);
+        }
+    }
+    return cursor;
+}
+
+class CursorShapeBenchmark : public Bench::Benchmark
+{
+public:
+    explicit CursorShapeBenchmark(Cursor cursor)
+        : m_Cursor(std::move(cursor))
+    {
+    }
+
+    void run(qint64 iterations) override
+    {
+        for (qint64 i = 0; i < iterations; i++) {
+            CursorShapeMetrics metrics = measureCursorShape(m_Cursor.width, m_Cursor.height,
+                                                            m_Cursor.hotspotX, m_Cursor.hotspotY,
+                                                            m_Cursor.bgra);
+            Bench::doNotOptimize(classifyCursorShape(metrics));
+        }
+    }
+
+    qint64 bytesPerIteration() const override
+    {
+        return m_Cursor.bgra.size();
+    }
+
+private:
+    Cursor m_Cursor;
+};
+
+class CursorShapeArrow : public CursorShapeBenchmark
+{
+public:
+    CursorShapeArrow() : CursorShapeBenchmark(makeArrow()) {}
+};
+
+class CursorShapeIBeam : public CursorShapeBenchmark
+{
+public:
+    CursorShapeIBeam() : CursorShapeBenchmark(makeIBeam()) {}
+};
+
+}
+
+BENCHMARK("cursor_shape/arrow_32", CursorShapeArrow);
+BENCHMARK("cursor_shape/ibeam_64", CursorShapeIBeam);
@@ -0,0 +1,177 @@
+#include "harness.h"
+
+#include "streaming/video/ffmpeg-renderers/nullrenderer.h"
+#include "streaming/video/ffmpeg-renderers/pacer/pacer.h"
+
+#include <QSemaphore>
+
+#include <chrono>
+
+// The pacer timestamps frames with the common-c clock. Supplying it here
+// keeps the benchmark from linking the whole protocol library.
+extern "C" uint64_t LiGetMicroseconds(void)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+namespace {
+
+// Renders nothing, but tells the submitting thread the frame got through
+class HandoffRenderer : public IFFmpegRenderer
+{
+public:
+    HandoffRenderer() : IFFmpegRenderer(RendererType::Unknown) {}
+
+    bool initialize(PDECODER_PARAMETERS) override
+    {
+        return true;
+    }
+
+    bool prepareDecoderContext(AVCodecContext*, AVDictionary**) override
+    {
+        return true;
+    }
+
+    void renderFrame(AVFrame*) override
+    {
+        m_Rendered.release();
+    }
+
+    QSemaphore m_Rendered;
+};
+
+// One frame from the decoder thread through the pacer's render queue to the
+// render thread and back. With pacing off this is the whole cost the pacer
+// adds to every frame.
+class PacerHandoff : public Bench::Benchmark
+{
+public:
+    PacerHandoff() : m_FramePool(PACER_MAX_HELD_FRAMES + 1) {}
+
+    void setUp() override
+    {
+        // Without a window the pacer complains about the display mode
+        SDL_LogSetAllPriority(SDL_LOG_PRIORITY_CRITICAL);
+
+        memset(&m_VideoStats, 0, sizeof(m_VideoStats));
+        m_Pacer = new Pacer(&m_Renderer, &m_VideoStats, &m_FramePool);
+        if (!m_Pacer->initialize(nullptr, 120, false, false)) {
+            qFatal("Pacer::initialize() failed");
+        }
+    }
+
+    void run(qint64 iterations) override
+    {
+        for (qint64 i = 0; i < iterations; i++) {
+            AVFrame* frame = m_FramePool.acquire();
+            frame->pkt_dts = LiGetMicroseconds();
+            m_Pacer->submitFrame(frame);
+            m_Renderer.m_Rendered.acquire();
+        }
+    }
+
+    void tearDown() override
+    {
+        delete m_Pacer;
+        m_Pacer = nullptr;
+        SDL_LogSetAllPriority(SDL_LOG_PRIORITY_INFO);
+    }
+
+private:
+    HandoffRenderer m_Renderer;
+    FramePool m_FramePool;
+    VIDEO_STATS m_VideoStats;
+    Pacer* m_Pacer = nullptr;
+};
+
+// The null renderer, but it also tells the submitting thread when it's done
+class SignalingNullRenderer : public NullRenderer
+{
+public:
+    void renderFrame(AVFrame* frame) override
+    {
+        NullRenderer::renderFrame(frame);
+        m_Rendered.release();
+    }
+
+    QSemaphore m_Rendered;
+};
+
+// A 1080p frame through the pacer into the null renderer with upload
+// simulation on, which is the per-frame CPU cost a headless soak run pays
+// on top of decoding
+class PacerNullRender : public Bench::Benchmark
+{
+public:
+    PacerNullRender() : m_FramePool(PACER_MAX_HELD_FRAMES + 1) {}
+
+    void setUp() override
+    {
+        SDL_LogSetAllPriority(SDL_LOG_PRIORITY_CRITICAL);
+
+        m_Source = av_frame_alloc();
+        m_Source->format = AV_PIX_FMT_YUV420P;
+        m_Source->width = 1920;
+        m_Source->height = 1080;
+        if (av_frame_get_buffer(m_Source, 0) < 0) {
+            qFatal("av_frame_get_buffer() failed");
+        }
+
+        DECODER_PARAMETERS params;
+        SDL_zero(params);
+        params.videoFormat = VIDEO_FORMAT_H264;
+        m_Renderer = new SignalingNullRenderer();
+        qputenv("NULL_RENDERER_UPLOAD", "1");
+        m_Renderer->initialize(&params);
+        qunsetenv("NULL_RENDERER_UPLOAD");
+
+        memset(&m_VideoStats, 0, sizeof(m_VideoStats));
+        m_Pacer = new Pacer(m_Renderer, &m_VideoStats, &m_FramePool);
+        if (!m_Pacer->initialize(nullptr, 120, false, false)) {
+            qFatal("Pacer::initialize() failed");
+        }
+    }
+
+    void run(qint64 iterations) override
+    {
+        for (qint64 i = 0; i < iterations; i++) {
+            AVFrame* frame = m_FramePool.acquire();
+            av_frame_ref(frame, m_Source);
+            frame->pkt_dts = LiGetMicroseconds();
+            m_Pacer->submitFrame(frame);
+            m_Renderer->m_Rendered.acquire();
+        }
+    }
+
+    void tearDown() override
+    {
+        delete m_Pacer;
+        m_Pacer = nullptr;
+
+        // Its destructor logs a summary, so this goes while logging is still quiet
+        delete m_Renderer;
+        m_Renderer = nullptr;
+
+        av_frame_free(&m_Source);
+        SDL_LogSetAllPriority(SDL_LOG_PRIORITY_INFO);
+    }
+
+    qint64 bytesPerIteration() const override
+    {
+        // Luma plus two quarter size chroma planes
+        return 1920 * 1080 * 3 / 2;
+    }
+
+private:
+    FramePool m_FramePool;
+    VIDEO_STATS m_VideoStats;
+    AVFrame* m_Source = nullptr;
+    SignalingNullRenderer* m_Renderer = nullptr;
+    Pacer* m_Pacer = nullptr;
+};
+
+}
+
+BENCHMARK("pacer/submit_to_render", PacerHandoff);
+BENCHMARK("pacer/null_render_1080p", PacerNullRender);
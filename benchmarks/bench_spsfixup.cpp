@@ -0,0 +1,107 @@
+#include "harness.h"
+
+#include "streaming/video/h264spsfixup.h"
+
+#include <h264_stream.h>
+
+#include <QByteArray>
+
+namespace {
+
+// Builds the Annex B SPS a host sends for a 1080p High profile stream. With
+// bitstreamRestriction false it matches what recent NVENC drivers emit,
+// which the fixup has to extend.
+QByteArray makeSps(int numRefFrames, bool bitstreamRestriction)
+{
+    h264_stream_t* stream = h264_new();
+    stream->nal->nal_ref_idc = 3;
+    stream->nal->nal_unit_type = NAL_UNIT_TYPE_SPS;
+
+    sps_t* sps = stream->sps;
+    sps->profile_idc = 100;
+    sps->constraint_set4_flag = 1;
+    sps->constraint_set5_flag = 1;
+    sps->level_idc = 42;
+    sps->chroma_format_idc = 1;
+    sps->log2_max_frame_num_minus4 = 4;
+    sps->pic_order_cnt_type = 2;
+    sps->num_ref_frames = numRefFrames;
+    sps->pic_width_in_mbs_minus1 = 1920 / 16 - 1;
+    sps->pic_height_in_map_units_minus1 = 1088 / 16 - 1;
+    sps->frame_mbs_only_flag = 1;
+    sps->direct_8x8_inference_flag = 1;
+    sps->frame_cropping_flag = 1;
+    sps->frame_crop_bottom_offset = 4;
+    sps->vui_parameters_present_flag = 1;
+    sps->vui.video_signal_type_present_flag = 1;
+    sps->vui.video_format = 5;
+    sps->vui.colour_description_present_flag = 1;
+    sps->vui.colour_primaries = 1;
+    sps->vui.transfer_characteristics = 1;
+    sps->vui.matrix_coefficients = 1;
+    sps->vui.timing_info_present_flag = 1;
+    sps->vui.num_units_in_tick = 1;
+    sps->vui.time_scale = 240;
+    if (bitstreamRestriction) {
+        sps->vui.bitstream_restriction_flag = 1;
+        sps->vui.motion_vectors_over_pic_boundaries_flag = 1;
+        sps->vui.max_bytes_per_pic_denom = 2;
+        sps->vui.max_bits_per_mb_denom = 1;
+        sps->vui.log2_max_mv_length_horizontal = 16;
+        sps->vui.log2_max_mv_length_vertical = 16;
+        sps->vui.max_dec_frame_buffering = numRefFrames;
+    }
+
+    // write_nal_unit() writes a zero byte ahead of the NALU, which lands
+    // on the last byte of the start code and is then replaced
+    QByteArray nal(256, 0);
+    int length = write_nal_unit(stream, reinterpret_cast<uint8_t*>(nal.data()) + 3, nal.size() - 3);
+    h264_free(stream);
+
+    nal[3] = 1;
+    nal.resize(length > 0 ? 3 + length : 0);
+    return nal;
+}
+
+class SpsFixupBenchmark : public Bench::Benchmark
+{
+public:
+    SpsFixupBenchmark(int numRefFrames, bool bitstreamRestriction)
+        : m_Sps(makeSps(numRefFrames, bitstreamRestriction)),
+          m_Out(m_Sps.size() + MAX_SPS_EXTRA_SIZE, 0)
+    {
+    }
+
+    void run(qint64 iterations) override
+    {
+        for (qint64 i = 0; i < iterations; i++) {
+            int length = fixupH264Sps(reinterpret_cast<const uint8_t*>(m_Sps.constData()), m_Sps.size(),
+                                      reinterpret_cast<uint8_t*>(m_Out.data()));
+            Bench::doNotOptimize(length);
+        }
+    }
+
+private:
+    QByteArray m_Sps;
+    QByteArray m_Out;
+};
+
+// Every IDR frame from NVENC carries one of these
+class SpsFixupNvenc : public SpsFixupBenchmark
+{
+public:
+    SpsFixupNvenc() : SpsFixupBenchmark(4, false) {}
+};
+
+// A host that already asks for one reference frame, so release builds
+// only parse it and copy it through
+class SpsFixupUnchanged : public SpsFixupBenchmark
+{
+public:
+    SpsFixupUnchanged() : SpsFixupBenchmark(1, true) {}
+};
+
+}
+
+BENCHMARK("h264_sps_fixup/nvenc", SpsFixupNvenc);
+BENCHMARK("h264_sps_fixup/unchanged", SpsFixupUnchanged);
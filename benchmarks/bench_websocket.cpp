@@ -0,0 +1,85 @@
+#include "harness.h"
+
+#include "streaming/filemappingwebsocket.h"
+
+#include <QByteArray>
+
+namespace {
+
+const int kFrameCount = 64;
+const int kPayloadBytes = 16 * 1024;
+
+// A burst of binary frames as they sit in the receive buffer after one
+// large read from the file mapping host
+QByteArray makeFrames(bool masked)
+{
+    const char mask[4] = { 0x37, (char)0xFA, 0x21, 0x3D };
+
+    QByteArray buffer;
+    for (int i = 0; i < kFrameCount; i++) {
+        buffer.append((char)0x82);
+        buffer.append((char)((masked ? 0x80 : 0x00) | 126));
+        buffer.append((char)(kPayloadBytes >> 8));
+        buffer.append((char)(kPayloadBytes & 0xFF));
+        if (masked) {
+            buffer.append(mask, sizeof(mask));
+        }
+        for (int j = 0; j < kPayloadBytes; j++) {
+            char byte = (char)(i + j * 7);
+            buffer.append(masked ? (char)(byte ^ mask[j % 4]) : byte);
+        }
+    }
+    return buffer;
+}
+
+class TakeFrameBenchmark : public Bench::Benchmark
+{
+public:
+    explicit TakeFrameBenchmark(bool masked)
+        : m_Input(makeFrames(masked))
+    {
+    }
+
+    void run(qint64 iterations) override
+    {
+        for (qint64 i = 0; i < iterations; i++) {
+            // The first takeFrame() detaches the copy, just as the socket
+            // buffer is its own allocation in the real reader
+            QByteArray buffer = m_Input;
+            FileMappingWebSocket::Frame frame;
+            bool needMore = false;
+            while (!buffer.isEmpty()) {
+                QString error = FileMappingWebSocket::takeFrame(buffer, frame, needMore);
+                if (!error.isEmpty() || needMore) {
+                    qFatal("takeFrame() failed: %s", qPrintable(error));
+                }
+                Bench::doNotOptimize(frame.payload.constData());
+            }
+        }
+    }
+
+    qint64 bytesPerIteration() const override
+    {
+        return m_Input.size();
+    }
+
+private:
+    QByteArray m_Input;
+};
+
+class TakeFrameUnmasked : public TakeFrameBenchmark
+{
+public:
+    TakeFrameUnmasked() : TakeFrameBenchmark(false) {}
+};
+
+class TakeFrameMasked : public TakeFrameBenchmark
+{
+public:
+    TakeFrameMasked() : TakeFrameBenchmark(true) {}
+};
+
+}
+
+BENCHMARK("websocket/take_frame_64x16k", TakeFrameUnmasked);
+BENCHMARK("websocket/take_frame_64x16k_masked", TakeFrameMasked);
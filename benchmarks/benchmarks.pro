@@ -0,0 +1,73 @@
+QT += core network
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = moonlight-benchmarks
+TEMPLATE = app
+
+INCLUDEPATH += \
+    $$PWD/../app \
+    $$PWD/../h264bitstream
+
+# h264bitstream is small enough to build in directly rather than
+# depending on the subproject's output layout
+SOURCES += \
+    main.cpp \
+    harness.cpp \
+    bench_av1obu.cpp \
+    bench_bwtracker.cpp \
+    bench_clipboardipc.cpp \
+    bench_cursorshape.cpp \
+    bench_spsfixup.cpp \
+    bench_websocket.cpp \
+    ../app/streaming/bwtracker.cpp \
+    ../app/streaming/clipboardblobtransfer.cpp \
+    ../app/streaming/clipboardipc.cpp \
+    ../app/streaming/filemappingwebsocket.cpp \
+    ../app/streaming/input/cursorshapeclassifier.cpp \
+    ../app/streaming/video/av1obu.cpp \
+    ../app/streaming/video/h264spsfixup.cpp \
+    ../h264bitstream/h264_nal.c \
+    ../h264bitstream/h264_stream.c
+
+HEADERS += \
+    harness.h \
+    ../app/streaming/bwtracker.h \
+    ../app/streaming/clipboardblobtransfer.h \
+    ../app/streaming/clipboardipc.h \
+    ../app/streaming/filemappingwebsocket.h \
+    ../app/streaming/input/cursorshapeclassifier.h \
+    ../app/streaming/video/av1obu.h \
+    ../app/streaming/video/h264spsfixup.h
+
+# Dependencies come from pkg-config, rather than the prebuilt libs/ trees
+# the app links on Windows and macOS
+CONFIG += link_pkgconfig
+PKGCONFIG += sdl2 SDL2_ttf libavcodec libavutil
+
+INCLUDEPATH += $$PWD/../moonlight-common-c/moonlight-common-c/src
+
+# The pacer pulls in the D3D V-sync source on Windows
+!win32 {
+    SOURCES += \
+        bench_pacer.cpp \
+        ../app/streaming/streamutils.cpp \
+        ../app/streaming/video/framepool.cpp \
+        ../app/streaming/video/ffmpeg-renderers/nullrenderer.cpp \
+        ../app/streaming/video/ffmpeg-renderers/swframemapper.cpp \
+        ../app/streaming/video/ffmpeg-renderers/pacer/pacer.cpp \
+        ../app/streaming/video/ffmpeg-renderers/pacer/syntheticvsyncsource.cpp
+
+    HEADERS += \
+        ../app/streaming/streamutils.h \
+        ../app/streaming/video/fixedqueue.h \
+        ../app/streaming/video/framepool.h \
+        ../app/streaming/video/ffmpeg-renderers/nullrenderer.h \
+        ../app/streaming/video/ffmpeg-renderers/swframemapper.h \
+        ../app/streaming/video/ffmpeg-renderers/pacer/pacer.h \
+        ../app/streaming/video/ffmpeg-renderers/pacer/syntheticvsyncsource.h
+}
+
+macx {
+    LIBS += -framework ApplicationServices
+}
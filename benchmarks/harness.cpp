@@ -0,0 +1,253 @@
+#include "harness.h"
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
+#include <QSysInfo>
+#include <QThread>
+
+#include <algorithm>
+#include <cmath>
+
+namespace Bench {
+
+namespace {
+
+// Bumped if the meaning of the saved numbers changes
+const int kJsonVersion = 1;
+
+// A change must also exceed this many MADs to count, so noisy
+// benchmarks don't flap
+const double kNoiseMads = 3.0;
+
+// Sorted by name, so runs and reports come out in a stable order
+QMap<QString, Factory>& registry()
+{
+    static QMap<QString, Factory> benchmarks;
+    return benchmarks;
+}
+
+double percentile(QVector<double> values, double fraction)
+{
+    if (values.isEmpty()) {
+        return 0;
+    }
+
+    std::sort(values.begin(), values.end());
+    double position = fraction * (values.size() - 1);
+    int lower = (int)std::floor(position);
+    int upper = (int)std::ceil(position);
+    return values[lower] + (values[upper] - values[lower]) * (position - lower);
+}
+
+void summarize(Result& result, qint64 bytesPerIteration)
+{
+    result.medianNs = percentile(result.samples, 0.5);
+    result.p90Ns = percentile(result.samples, 0.9);
+    result.minNs = *std::min_element(result.samples.cbegin(), result.samples.cend());
+
+    double total = 0;
+    QVector<double> deviations;
+    for (double sample : std::as_const(result.samples)) {
+        total += sample;
+        deviations.append(std::abs(sample - result.medianNs));
+    }
+    result.meanNs = total / result.samples.size();
+    result.madNs = percentile(deviations, 0.5);
+
+    if (bytesPerIteration > 0 && result.medianNs > 0) {
+        result.mbPerSecond = bytesPerIteration / result.medianNs * 1e9 / (1024 * 1024);
+    }
+}
+
+qint64 timeIterations(Benchmark& benchmark, qint64 iterations)
+{
+    QElapsedTimer timer;
+    timer.start();
+    benchmark.run(iterations);
+    return timer.nsecsElapsed();
+}
+
+}
+
+Registration::Registration(const char* name, Factory factory)
+{
+    registry().insert(QString::fromLatin1(name), std::move(factory));
+}
+
+QStringList registeredNames()
+{
+    return registry().keys();
+}
+
+Result run(const QString& name, const Options& options)
+{
+    std::unique_ptr<Benchmark> benchmark = registry().value(name)();
+    benchmark->setUp();
+
+    Result result;
+    result.name = name;
+
+    // Find an iteration count that makes a sample long enough for the
+    // timer and scheduler noise not to matter
+    const qint64 minSampleNs = qint64(options.minSampleMs) * 1000000;
+    qint64 iterations = 1;
+    for (;;) {
+        qint64 elapsedNs = timeIterations(*benchmark, iterations);
+        if (elapsedNs >= minSampleNs) {
+            break;
+        }
+
+        // Aim a little past the target, but never grow more than 10x at
+        // once in case the first runs were unrepresentatively fast
+        double scale = elapsedNs > 0 ? 1.2 * minSampleNs / elapsedNs : 10.0;
+        iterations = std::max(iterations * 2, (qint64)(iterations * std::min(scale, 10.0)));
+    }
+
+    QElapsedTimer warmup;
+    warmup.start();
+    while (warmup.elapsed() < options.warmupMs) {
+        benchmark->run(iterations);
+    }
+
+    result.iterations = iterations;
+    for (int i = 0; i < options.repetitions; i++) {
+        result.samples.append((double)timeIterations(*benchmark, iterations) / iterations);
+    }
+
+    benchmark->tearDown();
+    summarize(result, benchmark->bytesPerIteration());
+    return result;
+}
+
+bool writeJson(const QString& path, const QVector<Result>& results, QString& error)
+{
+    QJsonArray benchmarks;
+    for (const Result& result : results) {
+        QJsonArray samples;
+        for (double sample : result.samples) {
+            samples.append(sample);
+        }
+
+        QJsonObject entry;
+        entry["name"] = result.name;
+        entry["iterations"] = result.iterations;
+        entry["median_ns"] = result.medianNs;
+        entry["mad_ns"] = result.madNs;
+        entry["min_ns"] = result.minNs;
+        entry["mean_ns"] = result.meanNs;
+        entry["p90_ns"] = result.p90Ns;
+        if (result.mbPerSecond > 0) {
+            entry["mb_per_s"] = result.mbPerSecond;
+        }
+        entry["samples_ns"] = samples;
+        benchmarks.append(entry);
+    }
+
+    // Numbers only compare meaningfully on the same machine, so record
+    // enough to tell when they don't
+    QJsonObject machine;
+    machine["os"] = QSysInfo::prettyProductName();
+    machine["cpu_arch"] = QSysInfo::currentCpuArchitecture();
+    machine["cpu_count"] = QThread::idealThreadCount();
+    machine["host"] = QSysInfo::machineHostName();
+
+    QJsonObject root;
+    root["version"] = kJsonVersion;
+    root["machine"] = machine;
+    root["benchmarks"] = benchmarks;
+
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        error = file.errorString();
+        return false;
+    }
+
+    QByteArray json = QJsonDocument(root).toJson(QJsonDocument::Indented);
+    if (file.write(json) != json.size()) {
+        error = file.errorString();
+        return false;
+    }
+
+    return true;
+}
+
+bool readJson(const QString& path, QHash<QString, Result>& results, QString& error)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        error = file.errorString();
+        return false;
+    }
+
+    QJsonParseError parseError;
+    QJsonDocument document = QJsonDocument::fromJson(file.readAll(), &parseError);
+    if (document.isNull()) {
+        error = parseError.errorString();
+        return false;
+    }
+
+    QJsonObject root = document.object();
+    if (root["version"].toInt() != kJsonVersion) {
+        error = QStringLiteral("Unsupported results version %1").arg(root["version"].toInt());
+        return false;
+    }
+
+    const QJsonArray benchmarks = root["benchmarks"].toArray();
+    for (const QJsonValue& value : benchmarks) {
+        QJsonObject entry = value.toObject();
+
+        Result result;
+        result.name = entry["name"].toString();
+        result.iterations = entry["iterations"].toVariant().toLongLong();
+        result.medianNs = entry["median_ns"].toDouble();
+        result.madNs = entry["mad_ns"].toDouble();
+        result.minNs = entry["min_ns"].toDouble();
+        result.meanNs = entry["mean_ns"].toDouble();
+        result.p90Ns = entry["p90_ns"].toDouble();
+        result.mbPerSecond = entry["mb_per_s"].toDouble();
+        const QJsonArray samples = entry["samples_ns"].toArray();
+        for (const QJsonValue& sample : samples) {
+            result.samples.append(sample.toDouble());
+        }
+
+        if (!result.name.isEmpty()) {
+            results.insert(result.name, result);
+        }
+    }
+
+    return true;
+}
+
+QVector<Comparison> compare(const QVector<Result>& results,
+                            const QHash<QString, Result>& baseline,
+                            double thresholdPercent)
+{
+    QVector<Comparison> comparisons;
+
+    for (const Result& result : results) {
+        auto base = baseline.constFind(result.name);
+        if (base == baseline.constEnd() || base->medianNs <= 0) {
+            continue;
+        }
+
+        Comparison comparison;
+        comparison.name = result.name;
+        comparison.baselineNs = base->medianNs;
+        comparison.currentNs = result.medianNs;
+        comparison.deltaPercent = (result.medianNs - base->medianNs) * 100.0 / base->medianNs;
+
+        double noiseNs = kNoiseMads * std::max(result.madNs, base->madNs);
+        double deltaNs = result.medianNs - base->medianNs;
+        comparison.regression = comparison.deltaPercent > thresholdPercent && deltaNs > noiseNs;
+        comparison.improvement = comparison.deltaPercent < -thresholdPercent && -deltaNs > noiseNs;
+        comparisons.append(comparison);
+    }
+
+    return comparisons;
+}
+
+} // namespace Bench
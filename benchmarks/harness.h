@@ -0,0 +1,123 @@
+#pragma once
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include <functional>
+#include <memory>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace Bench {
+
+// Keeps the compiler from optimizing away a result nothing else reads
+template <typename T>
+inline void doNotOptimize(const T& value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+    _ReadWriteBarrier();
+#endif
+}
+
+// One measured operation. The harness constructs a fresh instance for each
+// run and calls run() with growing iteration counts until a sample is long
+// enough to time reliably.
+class Benchmark
+{
+public:
+    virtual ~Benchmark() = default;
+
+    // Untimed preparation of inputs
+    virtual void setUp() {}
+
+    // Performs the operation iterations times
+    virtual void run(qint64 iterations) = 0;
+
+    virtual void tearDown() {}
+
+    // Bytes processed per iteration, to report throughput. Zero if
+    // throughput means nothing for this operation.
+    virtual qint64 bytesPerIteration() const { return 0; }
+};
+
+using Factory = std::function<std::unique_ptr<Benchmark>()>;
+
+// Registers a benchmark at static initialization time. Use BENCHMARK().
+struct Registration
+{
+    Registration(const char* name, Factory factory);
+};
+
+#define BENCHMARK_CONCAT_INNER(a, b) a##b
+#define BENCHMARK_CONCAT(a, b) BENCHMARK_CONCAT_INNER(a, b)
+#define BENCHMARK(name, type) \
+    static const Bench::Registration BENCHMARK_CONCAT(s_Registration, __LINE__)( \
+        name, []() { return std::unique_ptr<Bench::Benchmark>(new type()); })
+
+struct Options
+{
+    // Untimed running before the first sample, to warm caches, branch
+    // predictors and CPU clocks
+    int warmupMs = 200;
+
+    int repetitions = 15;
+
+    // Iterations per sample are doubled until a sample takes this long
+    int minSampleMs = 20;
+};
+
+struct Result
+{
+    QString name;
+    qint64 iterations = 0;
+
+    // Nanoseconds per iteration, one per repetition
+    QVector<double> samples;
+
+    // Summary of samples. The median and the median absolute deviation
+    // are what comparisons use, since a single preempted sample would
+    // skew a mean and standard deviation.
+    double medianNs = 0;
+    double madNs = 0;
+    double minNs = 0;
+    double meanNs = 0;
+    double p90Ns = 0;
+
+    // Throughput at the median, or 0 if the benchmark has no byte count
+    double mbPerSecond = 0;
+};
+
+struct Comparison
+{
+    QString name;
+    double baselineNs = 0;
+    double currentNs = 0;
+    double deltaPercent = 0;
+    bool regression = false;
+    bool improvement = false;
+};
+
+QStringList registeredNames();
+
+Result run(const QString& name, const Options& options);
+
+bool writeJson(const QString& path, const QVector<Result>& results, QString& error);
+
+bool readJson(const QString& path, QHash<QString, Result>& results, QString& error);
+
+// A benchmark regressed if its median got slower by more than
+// thresholdPercent and by more than its noise. Benchmarks missing from the
+// baseline are skipped.
+QVector<Comparison> compare(const QVector<Result>& results,
+                            const QHash<QString, Result>& baseline,
+                            double thresholdPercent);
+
+} // namespace Bench
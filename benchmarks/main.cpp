@@ -0,0 +1,148 @@
+// Micro-benchmarks for the streaming hot paths.
+//
+//   moonlight-benchmarks                           run everything
+//   moonlight-benchmarks --filter av1              run benchmarks matching a regex
+//   moonlight-benchmarks --json baseline.json      save results
+//   moonlight-benchmarks --baseline baseline.json  fail on regressions against saved results
+//
+// Baselines are only meaningful on the machine that produced them. Save one
+// from the target branch, then compare a change against it on the same box.
+
+#include "harness.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QRegularExpression>
+#include <QTextStream>
+
+namespace {
+
+QString formatNs(double ns)
+{
+    if (ns >= 1e6) {
+        return QString::number(ns / 1e6, 'f', 2) + " ms";
+    }
+    else if (ns >= 1e3) {
+        return QString::number(ns / 1e3, 'f', 2) + " us";
+    }
+    return QString::number(ns, 'f', 1) + " ns";
+}
+
+int intOption(const QCommandLineParser& parser, const QString& name, int defaultValue, QTextStream& err, bool& ok)
+{
+    if (!parser.isSet(name)) {
+        return defaultValue;
+    }
+
+    bool valid;
+    int value = parser.value(name).toInt(&valid);
+    if (!valid || value < 0) {
+        err << "Invalid value for --" << name << ": " << parser.value(name) << '\n';
+        ok = false;
+    }
+    return value;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Micro-benchmarks for Moonlight's streaming hot paths");
+    parser.addHelpOption();
+    parser.addOption({"list", "List benchmarks and exit."});
+    parser.addOption({"filter", "Only run benchmarks whose name matches <regex>.", "regex"});
+    parser.addOption({"repetitions", "Timed samples per benchmark (default 15).", "count"});
+    parser.addOption({"warmup-ms", "Untimed warm-up per benchmark (default 200).", "ms"});
+    parser.addOption({"min-sample-ms", "Minimum duration of one sample (default 20).", "ms"});
+    parser.addOption({"json", "Write results to <file>, for use as a baseline.", "file"});
+    parser.addOption({"baseline", "Compare results against a saved <file>.", "file"});
+    parser.addOption({"threshold", "Slowdown in percent that counts as a regression (default 10).", "percent"});
+    parser.process(app);
+
+    QStringList names = Bench::registeredNames();
+    if (parser.isSet("filter")) {
+        QRegularExpression filter(parser.value("filter"));
+        if (!filter.isValid()) {
+            err << "Invalid filter: " << filter.errorString() << '\n';
+            return 1;
+        }
+        names = names.filter(filter);
+    }
+
+    if (parser.isSet("list")) {
+        for (const QString& name : std::as_const(names)) {
+            out << name << '\n';
+        }
+        return 0;
+    }
+
+    bool ok = true;
+    Bench::Options options;
+    options.repetitions = intOption(parser, "repetitions", options.repetitions, err, ok);
+    options.warmupMs = intOption(parser, "warmup-ms", options.warmupMs, err, ok);
+    options.minSampleMs = intOption(parser, "min-sample-ms", options.minSampleMs, err, ok);
+    bool validThreshold = true;
+    double threshold = parser.isSet("threshold") ? parser.value("threshold").toDouble(&validThreshold) : 10.0;
+    if (!ok || !validThreshold || options.repetitions == 0) {
+        err << "Invalid options\n";
+        return 1;
+    }
+
+    // Load the baseline first, so a bad path fails before a long run
+    QHash<QString, Bench::Result> baseline;
+    QString error;
+    if (parser.isSet("baseline") && !Bench::readJson(parser.value("baseline"), baseline, error)) {
+        err << "Unable to read baseline " << parser.value("baseline") << ": " << error << '\n';
+        return 1;
+    }
+
+    out << QString("%1 %2 %3 %4 %5 %6\n")
+           .arg("benchmark", -36).arg("median", 12).arg("mad", 10)
+           .arg("min", 12).arg("p90", 12).arg("MB/s", 10);
+    out.flush();
+
+    QVector<Bench::Result> results;
+    for (const QString& name : std::as_const(names)) {
+        Bench::Result result = Bench::run(name, options);
+        out << QString("%1 %2 %3 %4 %5 %6\n")
+               .arg(name, -36)
+               .arg(formatNs(result.medianNs), 12)
+               .arg(formatNs(result.madNs), 10)
+               .arg(formatNs(result.minNs), 12)
+               .arg(formatNs(result.p90Ns), 12)
+               .arg(result.mbPerSecond > 0 ? QString::number(result.mbPerSecond, 'f', 1) : QString("-"), 10);
+        out.flush();
+        results.append(result);
+    }
+
+    if (parser.isSet("json") && !Bench::writeJson(parser.value("json"), results, error)) {
+        err << "Unable to write " << parser.value("json") << ": " << error << '\n';
+        ok = false;
+    }
+
+    if (!baseline.isEmpty()) {
+        out << '\n' << QString("%1 %2 %3 %4\n")
+               .arg("benchmark", -36).arg("baseline", 12).arg("current", 12).arg("change", 9);
+
+        const QVector<Bench::Comparison> comparisons = Bench::compare(results, baseline, threshold);
+        for (const Bench::Comparison& comparison : comparisons) {
+            out << QString("%1 %2 %3 %4%%5\n")
+                   .arg(comparison.name, -36)
+                   .arg(formatNs(comparison.baselineNs), 12)
+                   .arg(formatNs(comparison.currentNs), 12)
+                   .arg(QString::number(comparison.deltaPercent, 'f', 1), 8)
+                   .arg(comparison.regression ? "  REGRESSED" : comparison.improvement ? "  improved" : "");
+            ok &= !comparison.regression;
+        }
+    }
+
+    out << (ok ? "PASS\n" : "FAILED\n");
+    out.flush();
+    err.flush();
+    return ok ? 0 : 1;
+}
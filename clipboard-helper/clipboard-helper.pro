@@ -11,12 +11,15 @@ INCLUDEPATH += $$PWD/../app
 
 SOURCES += \
     main.cpp \
+    ../app/streaming/clipboardblobtransfer.cpp \
     ../app/streaming/clipboardipc.cpp \
     ../app/streaming/clipboardsync.cpp
 
 macx:SOURCES += macos.mm
 
 HEADERS += \
+    ../app/streaming/clipboardblobtransfer.h \
+    ../app/streaming/clipboardhash.h \
     ../app/streaming/clipboardipc.h \
     ../app/streaming/clipboardlogging.h \
     ../app/streaming/clipboardsync.h
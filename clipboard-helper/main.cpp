@@ -10,8 +10,11 @@
 #include <QThread>
 
 #include <cstdio>
-#include <iostream>
-#include <string>
+
+#ifdef Q_OS_WIN
+#include <fcntl.h>
+#include <io.h>
+#endif
 
 #ifdef Q_OS_MACOS
 extern "C" void ClipboardHelperSetBackgroundActivationPolicy();
@@ -22,19 +25,49 @@ class StdinReaderThread : public QThread
     Q_OBJECT
 
 signals:
-    void lineReceived(QByteArray line);
+    void messageReceived(QByteArray message);
 
 protected:
     void run() override
     {
-        std::string line;
-        while (std::getline(std::cin, line)) {
-            if (!line.empty() && line.back() == '\r') {
-                line.pop_back();
+        // Read the fixed header, then exactly the payload it announces, so
+        // each message costs two reads and one allocation.
+        for (;;) {
+            QByteArray message(ClipboardIpc::HEADER_BYTES, Qt::Uninitialized);
+            if (!readFully(message.data(), ClipboardIpc::HEADER_BYTES)) {
+                break;
+            }
+
+            quint32 payloadLength = 0;
+            QString error;
+            if (!ClipboardIpc::readHeader(message.constData(), payloadLength, error)) {
+                // The stream cannot be resynchronised; hand the bad header
+                // to the controller so it reports the error, then stop.
+                emit messageReceived(message);
+                break;
+            }
+
+            message.resize(ClipboardIpc::HEADER_BYTES + static_cast<int>(payloadLength));
+            if (!readFully(message.data() + ClipboardIpc::HEADER_BYTES, payloadLength)) {
+                break;
+            }
+            emit messageReceived(message);
+        }
+        emit messageReceived(ClipboardIpc::encodeStop(0));
+    }
+
+private:
+    static bool readFully(char* data, size_t length)
+    {
+        while (length > 0) {
+            size_t n = fread(data, 1, length, stdin);
+            if (n == 0) {
+                return false;
             }
-            emit lineReceived(QByteArray(line.data(), static_cast<int>(line.size())));
+            data += n;
+            length -= n;
         }
-        emit lineReceived(ClipboardIpc::encodeStop(0));
+        return true;
     }
 };
 
@@ -49,12 +82,12 @@ public:
     }
 
 public slots:
-    void handleLine(const QByteArray& line)
+    void handleMessage(const QByteArray& bytes)
     {
         ClipboardIpc::Message message;
         QString error;
-        if (!ClipboardIpc::decodeLine(line, message, error)) {
-            writeProtocolLine(ClipboardIpc::encodeError(0, QStringLiteral("bad-message"), error));
+        if (!ClipboardIpc::decodeMessage(bytes, message, error)) {
+            writeProtocolMessage(ClipboardIpc::encodeError(0, QStringLiteral("bad-message"), error));
             return;
         }
 
@@ -70,7 +103,7 @@ public slots:
 
         if (message.type == ClipboardIpc::MessageType::HostFrame) {
             if (m_ClipboardEngine == nullptr) {
-                writeProtocolLine(ClipboardIpc::encodeError(message.sequence,
+                writeProtocolMessage(ClipboardIpc::encodeError(message.sequence,
                                                             QStringLiteral("not-ready"),
                                                             QStringLiteral("clipboard sync is not configured")));
                 return;
@@ -79,7 +112,7 @@ public slots:
             return;
         }
 
-        writeProtocolLine(ClipboardIpc::encodeError(message.sequence,
+        writeProtocolMessage(ClipboardIpc::encodeError(message.sequence,
                                                     QStringLiteral("unexpected-message"),
                                                     QStringLiteral("message type is not valid for helper input")));
     }
@@ -91,7 +124,7 @@ private:
                 config.serverCertPem.isEmpty() ||
                 config.clientCertPem.isEmpty() ||
                 config.clientKeyPem.isEmpty()) {
-            writeProtocolLine(ClipboardIpc::encodeError(sequence,
+            writeProtocolMessage(ClipboardIpc::encodeError(sequence,
                                                         QStringLiteral("bad-config"),
                                                         QStringLiteral("missing host address, port, or certificate data")));
             return;
@@ -106,7 +139,7 @@ private:
         if (context.serverCertificate.isNull() ||
                 context.clientCertificate.isNull() ||
                 context.clientPrivateKey.isNull()) {
-            writeProtocolLine(ClipboardIpc::encodeError(sequence,
+            writeProtocolMessage(ClipboardIpc::encodeError(sequence,
                                                         QStringLiteral("bad-config"),
                                                         QStringLiteral("certificate or private key data is unreadable")));
             return;
@@ -116,27 +149,32 @@ private:
             m_ClipboardEngine = new ClipboardSync(context, this);
             connect(m_ClipboardEngine, &ClipboardSync::outboundFrame,
                     this, &ClipboardHelperController::sendLocalFrame);
+            connect(m_ClipboardEngine, &ClipboardSync::transferProgress,
+                    this, &ClipboardHelperController::sendProgress);
             m_ClipboardEngine->start();
         }
         else {
             m_ClipboardEngine->setHostContext(context);
         }
 
-        writeProtocolLine(ClipboardIpc::encodeReady(sequence));
+        writeProtocolMessage(ClipboardIpc::encodeReady(sequence));
     }
 
     void sendLocalFrame(const QByteArray& frame)
     {
-        writeProtocolLine(ClipboardIpc::encodeLocalFrame(m_NextSequence++, frame));
+        writeProtocolMessage(ClipboardIpc::encodeLocalFrame(m_NextSequence++, frame));
     }
 
-    void writeProtocolLine(const QByteArray& line)
+    void sendProgress(bool upload, qint64 transferred, qint64 total)
     {
-        QByteArray out = line;
-        out.append('\n');
-        size_t written = fwrite(out.constData(), 1, static_cast<size_t>(out.size()), stdout);
+        writeProtocolMessage(ClipboardIpc::encodeProgress(m_NextSequence++, upload, transferred, total));
+    }
+
+    void writeProtocolMessage(const QByteArray& message)
+    {
+        size_t written = fwrite(message.constData(), 1, static_cast<size_t>(message.size()), stdout);
         fflush(stdout);
-        if (written != static_cast<size_t>(out.size())) {
+        if (written != static_cast<size_t>(message.size())) {
             QCoreApplication::quit();
         }
     }
@@ -147,6 +185,11 @@ private:
 
 int main(int argc, char* argv[])
 {
+#ifdef Q_OS_WIN
+    // The protocol is binary; CRT text mode would mangle 0x0A/0x1A bytes.
+    _setmode(_fileno(stdin), _O_BINARY);
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
     QGuiApplication app(argc, argv);
 #ifdef Q_OS_MACOS
     ClipboardHelperSetBackgroundActivationPolicy();
@@ -156,8 +199,8 @@ int main(int argc, char* argv[])
 
     ClipboardHelperController controller;
     StdinReaderThread stdinThread;
-    QObject::connect(&stdinThread, &StdinReaderThread::lineReceived,
-                     &controller, &ClipboardHelperController::handleLine,
+    QObject::connect(&stdinThread, &StdinReaderThread::messageReceived,
+                     &controller, &ClipboardHelperController::handleMessage,
                      Qt::QueuedConnection);
 
     stdinThread.start();
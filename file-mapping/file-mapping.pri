@@ -9,6 +9,7 @@ SOURCES += \
     $$PWD/mount/macfuse_mount_provider.cpp \
     $$PWD/mount/mount_coordinator.cpp \
     $$PWD/mount/macos_finder_mirror_provider.cpp \
+    $$PWD/mount/mirror_sync_engine.cpp \
     $$PWD/mount/mount_provider.cpp \
     $$PWD/mount/mount_provider_factory.cpp \
     $$PWD/mount/mount_session.cpp \
@@ -28,6 +29,7 @@ HEADERS += \
     $$PWD/mount/macfuse_mount_provider.h \
     $$PWD/mount/mount_coordinator.h \
     $$PWD/mount/macos_finder_mirror_provider.h \
+    $$PWD/mount/mirror_sync_engine.h \
     $$PWD/mount/macfuse_runtime_abi.h \
     $$PWD/mount/mount_errors.h \
     $$PWD/mount/mount_provider.h \
@@ -0,0 +1,524 @@
+#include "mirror_sync_engine.h"
+
+#include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMutexLocker>
+#include <QQueue>
+#include <QSaveFile>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <utility>
+
+namespace FileMapping {
+
+namespace {
+const int kManifestVersion = 1;
+
+// Reads answered faster than this double the chunk size, slower ones halve it
+const qint64 kFastReadMs = 50;
+const qint64 kSlowReadMs = 500;
+
+QString skippedFileText(const QString& reason)
+{
+    return QStringLiteral("This host file was not copied into the local snapshot.\n\nReason: %1\n\nTry opening a smaller folder or increase the Moonlight file mapping mirror limits for testing.\n").arg(reason);
+}
+
+QString joinPath(const QString& parent, const QString& name)
+{
+    return parent.isEmpty() ? name : parent + QLatin1Char('/') + name;
+}
+
+// Picks a name that no earlier sibling has taken. Names are compared
+// case-insensitively since Finder and Explorer default to that.
+QString uniqueChildName(QSet<QString>& usedNames, const QString& requestedName)
+{
+    const QString safe = MirrorSyncEngine::safeName(requestedName, QStringLiteral("item"));
+    if (!usedNames.contains(safe.toLower())) {
+        usedNames.insert(safe.toLower());
+        return safe;
+    }
+
+    const QFileInfo info(safe);
+    const QString base = info.completeBaseName().isEmpty() ? safe : info.completeBaseName();
+    const QString suffix = info.suffix().isEmpty() ? QString() : QStringLiteral(".") + info.suffix();
+    for (int i = 2; i < 10000; ++i) {
+        const QString candidate = QStringLiteral("%1 %2%3").arg(base).arg(i).arg(suffix);
+        if (!usedNames.contains(candidate.toLower())) {
+            usedNames.insert(candidate.toLower());
+            return candidate;
+        }
+    }
+
+    return safe + QStringLiteral(" copy");
+}
+
+bool removeFile(const QString& path)
+{
+    // Mirrored files are read-only, which blocks removal on Windows
+    QFile::setPermissions(path, QFile::permissions(path) | QFileDevice::WriteOwner);
+    return QFile::remove(path);
+}
+} // namespace
+
+MirrorSyncEngine::MirrorSyncEngine(RemoteVfs& vfs, QString rootPath, MirrorLimits limits)
+    : m_Vfs(vfs),
+      m_RootPath(std::move(rootPath)),
+      m_Limits(limits)
+{
+}
+
+Error MirrorSyncEngine::sync(const QStringList& keepPaths)
+{
+    m_OldManifest = loadManifest();
+    m_ExpectedFiles = QSet<QString>(keepPaths.begin(), keepPaths.end());
+    m_ExpectedFiles.insert(manifestFileName());
+
+    Error error = enumerate();
+
+    // Keep what we already have if the sync failed part way, so the next
+    // attempt can pick up from there
+    Manifest manifest = m_NewManifest;
+    if (!error.ok()) {
+        for (auto mapping = m_OldManifest.cbegin(); mapping != m_OldManifest.cend(); ++mapping) {
+            for (auto entry = mapping->cbegin(); entry != mapping->cend(); ++entry) {
+                if (!manifest.value(mapping.key()).contains(entry.key())) {
+                    manifest[mapping.key()].insert(entry.key(), entry.value());
+                }
+            }
+        }
+    }
+    else {
+        removeStaleFiles();
+    }
+
+    if (!saveManifest(manifest) && error.ok()) {
+        error = Error::make(ErrorKind::Internal, QStringLiteral("Could not save the local host files manifest."));
+    }
+    return error;
+}
+
+QStringList MirrorSyncEngine::warnings() const
+{
+    QMutexLocker locker(&m_Lock);
+    return m_Warnings;
+}
+
+MirrorSyncStats MirrorSyncEngine::stats() const
+{
+    QMutexLocker locker(&m_Lock);
+    return m_Stats;
+}
+
+QString MirrorSyncEngine::manifestFileName()
+{
+    return QStringLiteral(".moonlight-manifest.json");
+}
+
+QString MirrorSyncEngine::safeName(const QString& name, const QString& fallback)
+{
+    QString safe = name.trimmed();
+    if (safe.isEmpty()) {
+        safe = fallback;
+    }
+
+    static const QString invalidChars = QStringLiteral("\\/:*?\"<>|");
+    for (int i = 0; i < safe.size(); ++i) {
+        if (safe.at(i).unicode() < 32 || invalidChars.contains(safe.at(i))) {
+            safe[i] = QLatin1Char('_');
+        }
+    }
+
+    while (safe.endsWith(QLatin1Char('.')) || safe.endsWith(QLatin1Char(' '))) {
+        safe.chop(1);
+    }
+
+    if (safe.isEmpty() || safe == QStringLiteral(".") || safe == QStringLiteral("..")) {
+        safe = fallback;
+    }
+    return safe.left(160);
+}
+
+bool MirrorSyncEngine::writeTextFile(const QString& path, const QString& text)
+{
+    QFile file(path);
+    if (file.exists()) {
+        // Left read-only by a previous sync
+        QFile::setPermissions(path, QFile::permissions(path) | QFileDevice::WriteOwner);
+    }
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text)) {
+        return false;
+    }
+    file.write(text.toUtf8());
+    file.close();
+    return true;
+}
+
+void MirrorSyncEngine::makeReadOnly(const QString& path, bool directory)
+{
+    QFileDevice::Permissions permissions = QFileDevice::ReadOwner | QFileDevice::ReadGroup | QFileDevice::ReadOther;
+    if (directory) {
+        permissions |= QFileDevice::ExeOwner | QFileDevice::ExeGroup | QFileDevice::ExeOther;
+    }
+    QFile::setPermissions(path, permissions);
+}
+
+MirrorSyncEngine::Manifest MirrorSyncEngine::loadManifest() const
+{
+    Manifest manifest;
+    QFile file(absolutePath(manifestFileName()));
+    if (!file.open(QIODevice::ReadOnly)) {
+        return manifest;
+    }
+
+    const QJsonObject root = QJsonDocument::fromJson(file.readAll()).object();
+    if (root.value(QStringLiteral("version")).toInt() != kManifestVersion) {
+        return manifest;
+    }
+
+    const QJsonObject mappings = root.value(QStringLiteral("mappings")).toObject();
+    for (auto mapping = mappings.constBegin(); mapping != mappings.constEnd(); ++mapping) {
+        const QJsonObject items = mapping.value().toObject();
+        QHash<QString, ManifestEntry>& entries = manifest[mapping.key()];
+        for (auto item = items.constBegin(); item != items.constEnd(); ++item) {
+            const QJsonObject object = item.value().toObject();
+            ManifestEntry entry;
+            entry.path = object.value(QStringLiteral("path")).toString();
+            entry.size = static_cast<quint64>(object.value(QStringLiteral("size")).toDouble());
+            entry.modifiedMs = static_cast<qint64>(object.value(QStringLiteral("mtime")).toDouble(-1));
+            if (!entry.path.isEmpty()) {
+                entries.insert(item.key(), entry);
+            }
+        }
+    }
+    return manifest;
+}
+
+bool MirrorSyncEngine::saveManifest(const Manifest& manifest) const
+{
+    QJsonObject mappings;
+    for (auto mapping = manifest.cbegin(); mapping != manifest.cend(); ++mapping) {
+        QJsonObject items;
+        for (auto entry = mapping->cbegin(); entry != mapping->cend(); ++entry) {
+            QJsonObject object;
+            object.insert(QStringLiteral("path"), entry->path);
+            object.insert(QStringLiteral("size"), static_cast<double>(entry->size));
+            object.insert(QStringLiteral("mtime"), static_cast<double>(entry->modifiedMs));
+            items.insert(entry.key(), object);
+        }
+        mappings.insert(mapping.key(), items);
+    }
+
+    QJsonObject root;
+    root.insert(QStringLiteral("version"), kManifestVersion);
+    root.insert(QStringLiteral("mappings"), mappings);
+
+    QSaveFile file(absolutePath(manifestFileName()));
+    if (!file.open(QIODevice::WriteOnly)) {
+        return false;
+    }
+    file.write(QJsonDocument(root).toJson(QJsonDocument::Compact));
+    return file.commit();
+}
+
+Error MirrorSyncEngine::enumerate()
+{
+    struct DirJob {
+        VfsItem item;
+        QString path;
+        int depth;
+    };
+
+    // Transfers only run beside enumeration if the VFS takes concurrent
+    // requests. Otherwise each file is copied as soon as it is found.
+    const int workers = qMin(m_Limits.workers, m_Vfs.maxConcurrentRequests() - 1);
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(1, workers));
+
+    VfsItem rootItem;
+    rootItem.id = VfsItemId::root();
+    rootItem.directory = true;
+
+    QQueue<DirJob> dirs;
+    dirs.enqueue({ rootItem, QString(), 0 });
+
+    while (!dirs.isEmpty() && !m_Failed) {
+        const DirJob dir = dirs.dequeue();
+        if (dir.depth > m_Limits.maxDepth) {
+            const QString marker = joinPath(dir.path, QStringLiteral("Moonlight folder depth limit.txt"));
+            writeTextFile(absolutePath(marker), skippedFileText(QStringLiteral("folder depth limit reached")));
+            m_ExpectedFiles.insert(marker);
+
+            QMutexLocker locker(&m_Lock);
+            m_Warnings.append(QStringLiteral("%1: skipped because the folder is too deep").arg(absolutePath(dir.path)));
+            continue;
+        }
+
+        ChildrenResult children = m_Vfs.children(dir.item.id);
+        if (!children.ok()) {
+            fail(children.error);
+            break;
+        }
+
+        // Reserve the names the caller writes into the root
+        QSet<QString> usedNames;
+        if (dir.path.isEmpty()) {
+            for (const QString& path : std::as_const(m_ExpectedFiles)) {
+                usedNames.insert(path.toLower());
+            }
+        }
+
+        for (const VfsItem& item : children.items) {
+            const QString path = joinPath(dir.path, uniqueChildName(usedNames, item.displayName));
+            if (item.directory) {
+                if (!QDir().mkpath(absolutePath(path))) {
+                    fail(Error::make(ErrorKind::Internal, QStringLiteral("Could not create local folder: %1").arg(absolutePath(path))));
+                    break;
+                }
+                m_ExpectedDirs.insert(path);
+                dirs.enqueue({ item, path, dir.depth + 1 });
+                continue;
+            }
+
+            if (m_ReservedFiles >= m_Limits.maxFiles) {
+                skipFile(path, QStringLiteral("skipped because the file count limit was reached"),
+                         QStringLiteral("file count limit reached"));
+                continue;
+            }
+            if (item.size > m_Limits.maxFileBytes) {
+                skipFile(path, QStringLiteral("skipped because the file is too large"),
+                         QStringLiteral("file exceeds the per-file mirror limit"));
+                continue;
+            }
+            if (m_ReservedBytes + item.size > m_Limits.maxBytes) {
+                skipFile(path, QStringLiteral("skipped because the snapshot size limit was reached"),
+                         QStringLiteral("snapshot size limit reached"));
+                continue;
+            }
+
+            ++m_ReservedFiles;
+            m_ReservedBytes += item.size;
+            m_ExpectedFiles.insert(path);
+
+            if (isUnchanged(item, path)) {
+                recordFile(item, path);
+                QMutexLocker locker(&m_Lock);
+                ++m_Stats.filesUnchanged;
+                continue;
+            }
+
+            const FileJob job { item, path };
+            if (workers > 0) {
+                pool.start([this, job]() {
+                    if (!m_Failed) {
+                        const Error error = transfer(job);
+                        if (!error.ok()) {
+                            fail(error);
+                        }
+                    }
+                });
+            }
+            else {
+                const Error error = transfer(job);
+                if (!error.ok()) {
+                    fail(error);
+                    break;
+                }
+            }
+        }
+    }
+
+    pool.waitForDone();
+
+    QMutexLocker locker(&m_Lock);
+    return m_Error;
+}
+
+bool MirrorSyncEngine::isUnchanged(const VfsItem& item, const QString& path) const
+{
+    const auto mapping = m_OldManifest.constFind(item.mappingId);
+    if (mapping == m_OldManifest.constEnd()) {
+        return false;
+    }
+    const auto entry = mapping->constFind(item.id.value);
+    if (entry == mapping->constEnd()) {
+        return false;
+    }
+
+    const qint64 modifiedMs = item.modifiedAt.isValid() ? item.modifiedAt.toMSecsSinceEpoch() : -1;
+    if (entry->path != path || entry->size != item.size || entry->modifiedMs != modifiedMs) {
+        return false;
+    }
+
+    // The local copy must still be the one we wrote
+    const QFileInfo local(absolutePath(path));
+    return local.isFile() && static_cast<quint64>(local.size()) == item.size;
+}
+
+void MirrorSyncEngine::skipFile(const QString& path, const QString& warning, const QString& reason)
+{
+    const QString marker = path + QStringLiteral(".moonlight-skipped.txt");
+    m_ExpectedFiles.insert(marker);
+    writeTextFile(absolutePath(marker), skippedFileText(reason));
+
+    QMutexLocker locker(&m_Lock);
+    m_Warnings.append(QStringLiteral("%1: %2").arg(absolutePath(path), warning));
+}
+
+Error MirrorSyncEngine::transfer(const FileJob& job)
+{
+    const QString localPath = absolutePath(job.path);
+    OpenResult open = m_Vfs.open(job.item.id);
+    if (!open.ok()) {
+        return open.error;
+    }
+
+    // Download next to the old copy and swap it in once complete, so a
+    // failed transfer leaves the previous version in place
+    const QString partialPath = localPath + QStringLiteral(".moonlight-partial");
+    QFile file(partialPath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        m_Vfs.close(open.handle);
+        return Error::make(ErrorKind::Internal, QStringLiteral("Could not create local file: %1").arg(localPath));
+    }
+
+    quint64 offset = 0;
+    quint32 chunkBytes = m_Limits.chunkBytes;
+    bool truncated = false;
+    Error result = Error::none();
+    for (;;) {
+        if (m_Failed) {
+            result = Error::make(ErrorKind::Cancelled, QStringLiteral("Host files sync was cancelled."));
+            break;
+        }
+        if (offset >= m_Limits.maxFileBytes) {
+            // The file grew past the limit since it was listed
+            truncated = true;
+            QMutexLocker locker(&m_Lock);
+            m_Warnings.append(QStringLiteral("%1: truncated because the file exceeds the per-file mirror limit").arg(localPath));
+            break;
+        }
+
+        const quint32 readLength = static_cast<quint32>(qMin<quint64>(chunkBytes, m_Limits.maxFileBytes - offset));
+        QElapsedTimer timer;
+        timer.start();
+        ReadResult read = m_Vfs.read(open.handle, offset, readLength);
+        if (!read.ok()) {
+            result = read.error;
+            break;
+        }
+        if (read.data.isEmpty()) {
+            break;
+        }
+        if (file.write(read.data) != read.data.size()) {
+            result = Error::make(ErrorKind::Internal, QStringLiteral("Could not write local file: %1").arg(localPath));
+            break;
+        }
+
+        const quint64 bytesRead = static_cast<quint64>(read.data.size());
+        offset += bytesRead;
+
+        // Hosts may return less than we asked for, so only a short read
+        // at or past the listed size marks the end of the file
+        if (bytesRead < readLength && offset >= job.item.size) {
+            break;
+        }
+
+        const qint64 elapsedMs = timer.elapsed();
+        if (elapsedMs < kFastReadMs) {
+            chunkBytes = qMin(chunkBytes * 2, qMax(m_Limits.maxChunkBytes, m_Limits.chunkBytes));
+        }
+        else if (elapsedMs > kSlowReadMs) {
+            chunkBytes = qMax(chunkBytes / 2, m_Limits.chunkBytes);
+        }
+    }
+
+    file.close();
+    m_Vfs.close(open.handle);
+    if (!result.ok()) {
+        QFile::remove(partialPath);
+        return result;
+    }
+
+    if (QFileInfo::exists(localPath) && !removeFile(localPath)) {
+        QFile::remove(partialPath);
+        return Error::make(ErrorKind::Internal, QStringLiteral("Could not replace local file: %1").arg(localPath));
+    }
+    if (!QFile::rename(partialPath, localPath)) {
+        QFile::remove(partialPath);
+        return Error::make(ErrorKind::Internal, QStringLiteral("Could not write local file: %1").arg(localPath));
+    }
+    makeReadOnly(localPath, false);
+
+    // Truncated copies stay out of the manifest so they are fetched again
+    if (!truncated) {
+        recordFile(job.item, job.path);
+    }
+
+    QMutexLocker locker(&m_Lock);
+    ++m_Stats.filesFetched;
+    m_Stats.bytesFetched += offset;
+    return Error::none();
+}
+
+void MirrorSyncEngine::recordFile(const VfsItem& item, const QString& path)
+{
+    ManifestEntry entry;
+    entry.path = path;
+    entry.size = item.size;
+    entry.modifiedMs = item.modifiedAt.isValid() ? item.modifiedAt.toMSecsSinceEpoch() : -1;
+
+    QMutexLocker locker(&m_Lock);
+    m_NewManifest[item.mappingId].insert(item.id.value, entry);
+}
+
+void MirrorSyncEngine::fail(const Error& error)
+{
+    QMutexLocker locker(&m_Lock);
+    if (m_Error.ok()) {
+        m_Error = error;
+    }
+    m_Failed = true;
+}
+
+void MirrorSyncEngine::removeStaleFiles()
+{
+    const QDir root(m_RootPath);
+    QStringList staleDirs;
+    QDirIterator it(m_RootPath,
+                    QDir::Files | QDir::Dirs | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot,
+                    QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        const QString path = it.next();
+        const QString relative = root.relativeFilePath(path);
+        if (it.fileInfo().isDir() && !it.fileInfo().isSymLink()) {
+            if (!m_ExpectedDirs.contains(relative)) {
+                staleDirs.append(path);
+            }
+        }
+        else if (!m_ExpectedFiles.contains(relative) && removeFile(path)) {
+            QMutexLocker locker(&m_Lock);
+            ++m_Stats.filesRemoved;
+        }
+    }
+
+    // Children before their parents
+    std::sort(staleDirs.begin(), staleDirs.end(), [](const QString& a, const QString& b) {
+        return a.size() > b.size();
+    });
+    for (const QString& path : std::as_const(staleDirs)) {
+        QDir().rmdir(path);
+    }
+}
+
+QString MirrorSyncEngine::absolutePath(const QString& path) const
+{
+    return path.isEmpty() ? m_RootPath : QDir(m_RootPath).filePath(path);
+}
+
+} // namespace FileMapping
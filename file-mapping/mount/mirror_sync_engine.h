@@ -0,0 +1,107 @@
+#pragma once
+
+#include <atomic>
+
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+
+#include "../vfs/remote_vfs.h"
+
+namespace FileMapping {
+
+struct MirrorLimits {
+    int maxDepth = 8;
+    int maxFiles = 2048;
+    quint64 maxBytes = 512ULL * 1024ULL * 1024ULL;
+    quint64 maxFileBytes = 128ULL * 1024ULL * 1024ULL;
+
+    // Reads start at chunkBytes and grow up to maxChunkBytes while the
+    // host keeps answering quickly
+    quint32 chunkBytes = 64U * 1024U;
+    quint32 maxChunkBytes = 4U * 1024U * 1024U;
+
+    // Files transferred at once, if the VFS allows concurrent requests
+    int workers = 4;
+};
+
+struct MirrorSyncStats {
+    int filesFetched = 0;
+    int filesUnchanged = 0;
+    int filesRemoved = 0;
+    quint64 bytesFetched = 0;
+};
+
+// Keeps a local folder in sync with a RemoteVfs tree.
+//
+// A manifest of the size and modification time of every mirrored file is
+// kept next to the files, grouped by mapping, so a sync only transfers
+// files that changed since the last one and removes those the host no
+// longer has. Directories are enumerated breadth-first on the calling
+// thread while a bounded pool of workers transfers files behind it.
+class MirrorSyncEngine
+{
+public:
+    MirrorSyncEngine(RemoteVfs& vfs, QString rootPath, MirrorLimits limits);
+
+    // Brings the local folder up to date. keepPaths are root-relative
+    // files owned by the caller that must survive stale file removal.
+    // If this fails, files synced so far are kept for the next attempt.
+    Error sync(const QStringList& keepPaths);
+
+    QStringList warnings() const;
+    MirrorSyncStats stats() const;
+
+    static QString manifestFileName();
+    static QString safeName(const QString& name, const QString& fallback);
+    static bool writeTextFile(const QString& path, const QString& text);
+    static void makeReadOnly(const QString& path, bool directory);
+
+private:
+    struct ManifestEntry {
+        QString path;
+        quint64 size = 0;
+        qint64 modifiedMs = -1;
+    };
+
+    // Entries by item ID, grouped by mapping ID
+    using Manifest = QHash<QString, QHash<QString, ManifestEntry>>;
+
+    struct FileJob {
+        VfsItem item;
+        QString path;
+    };
+
+    Manifest loadManifest() const;
+    bool saveManifest(const Manifest& manifest) const;
+
+    Error enumerate();
+    bool isUnchanged(const VfsItem& item, const QString& path) const;
+    void skipFile(const QString& path, const QString& warning, const QString& reason);
+    Error transfer(const FileJob& job);
+    void recordFile(const VfsItem& item, const QString& path);
+    void fail(const Error& error);
+    void removeStaleFiles();
+    QString absolutePath(const QString& path) const;
+
+    RemoteVfs& m_Vfs;
+    QString m_RootPath;
+    MirrorLimits m_Limits;
+    Manifest m_OldManifest;
+    QSet<QString> m_ExpectedFiles;
+    QSet<QString> m_ExpectedDirs;
+    int m_ReservedFiles = 0;
+    quint64 m_ReservedBytes = 0;
+
+    // Shared with the transfer workers
+    mutable QMutex m_Lock;
+    Manifest m_NewManifest;
+    QStringList m_Warnings;
+    MirrorSyncStats m_Stats;
+    Error m_Error;
+    std::atomic<bool> m_Failed { false };
+};
+
+} // namespace FileMapping
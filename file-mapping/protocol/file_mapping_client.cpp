@@ -4,4 +4,9 @@ namespace FileMapping {
 
 ProtocolClient::~ProtocolClient() = default;
 
+int ProtocolClient::maxConcurrentRequests() const
+{
+    return 1;
+}
+
 } // namespace FileMapping
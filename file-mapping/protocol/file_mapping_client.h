@@ -23,6 +23,10 @@ public:
                             quint64 offset,
                             quint32 length,
                             int timeoutMs) = 0;
+
+    // How many list/stat/read calls may be in flight at once from
+    // different threads. Clients returning more than 1 must be thread-safe.
+    virtual int maxConcurrentRequests() const;
 };
 
 using ProtocolClientPtr = std::shared_ptr<ProtocolClient>;
@@ -1,6 +1,7 @@
 #include "protocol_remote_vfs.h"
 
 #include <QByteArray>
+#include <QMutexLocker>
 #include <QStringList>
 
 #include <utility>
@@ -156,6 +157,7 @@ OpenResult ProtocolRemoteVfs::open(const VfsItemId& id)
         return result;
     }
 
+    QMutexLocker locker(&m_HandleLock);
     result.handle.id = m_NextHandleId++;
     result.handle.item = itemResult.item;
     m_OpenHandles.insert(result.handle.id, result.handle);
@@ -169,12 +171,16 @@ ReadResult ProtocolRemoteVfs::read(const ReadHandle& handle, quint64 offset, qui
         result.error = Error::make(ErrorKind::Unavailable, QStringLiteral("File mapping protocol client is not available"));
         return result;
     }
-    if (!handle.isValid() || !m_OpenHandles.contains(handle.id)) {
+
+    ReadHandle current;
+    {
+        QMutexLocker locker(&m_HandleLock);
+        current = m_OpenHandles.value(handle.id);
+    }
+    if (!handle.isValid() || !current.isValid()) {
         result.error = Error::make(ErrorKind::NotFound, QStringLiteral("Read handle is not open"));
         return result;
     }
-
-    const ReadHandle current = m_OpenHandles.value(handle.id);
     if (current.item.directory) {
         result.error = Error::make(ErrorKind::Unsupported, QStringLiteral("Cannot read a directory"));
         return result;
@@ -184,9 +190,15 @@ ReadResult ProtocolRemoteVfs::read(const ReadHandle& handle, quint64 offset, qui
 
 void ProtocolRemoteVfs::close(const ReadHandle& handle)
 {
+    QMutexLocker locker(&m_HandleLock);
     m_OpenHandles.remove(handle.id);
 }
 
+int ProtocolRemoteVfs::maxConcurrentRequests() const
+{
+    return m_Client ? m_Client->maxConcurrentRequests() : RemoteVfs::maxConcurrentRequests();
+}
+
 VfsItemId ProtocolRemoteVfs::mappingId(const QString& mappingId)
 {
     return { QStringLiteral("mapping:%1").arg(encodePart(mappingId)) };
@@ -4,6 +4,7 @@
 #include "remote_vfs.h"
 
 #include <QHash>
+#include <QMutex>
 
 namespace FileMapping {
 
@@ -18,6 +19,7 @@ public:
     OpenResult open(const VfsItemId& id) override;
     ReadResult read(const ReadHandle& handle, quint64 offset, quint32 length) override;
     void close(const ReadHandle& handle) override;
+    int maxConcurrentRequests() const override;
 
     static VfsItemId mappingId(const QString& mappingId);
     static VfsItemId nodeId(const QString& mappingId, const QString& remotePath);
@@ -43,6 +45,7 @@ private:
 
     ProtocolClientPtr m_Client;
     int m_TimeoutMs;
+    QMutex m_HandleLock;
     quint64 m_NextHandleId = 1;
     QHash<quint64, ReadHandle> m_OpenHandles;
 };
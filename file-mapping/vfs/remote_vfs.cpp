@@ -4,4 +4,9 @@ namespace FileMapping {
 
 RemoteVfs::~RemoteVfs() = default;
 
+int RemoteVfs::maxConcurrentRequests() const
+{
+    return 1;
+}
+
 } // namespace FileMapping
@@ -38,6 +38,10 @@ public:
     virtual OpenResult open(const VfsItemId& id) = 0;
     virtual ReadResult read(const ReadHandle& handle, quint64 offset, quint32 length) = 0;
     virtual void close(const ReadHandle& handle) = 0;
+
+    // How many calls may be in flight at once from different threads.
+    // Implementations returning more than 1 must be thread-safe.
+    virtual int maxConcurrentRequests() const;
 };
 
 } // namespace FileMapping
@@ -16,6 +16,11 @@ win32:!winrt {
     app.depends += AntiHooking
 }
 
+# Micro-benchmarks are opt-in with CONFIG+=benchmarks
+CONFIG(benchmarks) {
+    SUBDIRS += benchmarks
+}
+
 # Support debug and release builds from command line for CI
 CONFIG += debug_and_release
 
@@ -0,0 +1,16 @@
+QT += core
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = abr_controller
+TEMPLATE = app
+
+INCLUDEPATH += \
+    $$PWD/../../app
+
+SOURCES += \
+    main.cpp \
+    ../../app/streaming/abrcontroller.cpp
+
+HEADERS += \
+    ../../app/streaming/abrcontroller.h
@@ -0,0 +1,408 @@
+#include "streaming/abrcontroller.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QStringList>
+#include <QTextStream>
+#include <QVector>
+
+namespace {
+
+const int kFrameRate = 60;
+const uint32_t kWindowMs = 1000;
+
+bool require(bool condition, const QString& message, QTextStream& err)
+{
+    if (!condition) {
+        err << "FAIL: " << message << '\n';
+    }
+    return condition;
+}
+
+AbrController::Config testConfig()
+{
+    AbrController::Config config;
+    config.minBitrateKbps = 5000;
+    config.maxBitrateKbps = 20000;
+    return config;
+}
+
+// A second of video where frames waited queueMs on average for the decoder
+// to take them and decodeMs to come out of it, otherwise clean unless the
+// caller breaks it
+AbrController::Sample window(uint32_t timestampMs, double queueMs, double decodeMs, int frameRate = kFrameRate)
+{
+    AbrController::Sample sample;
+    sample.timestampMs = timestampMs;
+    sample.frameRate = frameRate;
+    sample.totalFrames = frameRate;
+    sample.receivedFrames = frameRate;
+    sample.totalDecodeQueueTimeUs = (uint64_t)(queueMs * 1000) * frameRate;
+    sample.decodedFrames = frameRate;
+    sample.totalDecodeTimeUs = (uint64_t)(decodeMs * 1000) * frameRate;
+    sample.renderedFrames = frameRate;
+    sample.totalPacerTimeUs = 1000000ULL / frameRate / 4 * frameRate;
+
+    // Perfectly steady presentation
+    const uint64_t intervalUs = 1000000 / frameRate;
+    sample.presentIntervals = frameRate;
+    sample.totalPresentIntervalUs = intervalUs * frameRate;
+    sample.totalPresentIntervalSqUs = intervalUs * intervalUs * frameRate;
+    return sample;
+}
+
+AbrController::Sample healthy(uint32_t timestampMs)
+{
+    return window(timestampMs, 0.2, 5.0);
+}
+
+// The decoder can't keep up, so frames pile up in front of it
+AbrController::Sample overloaded(uint32_t timestampMs)
+{
+    return window(timestampMs, 20.0, 20.0);
+}
+
+// A 120 FPS hardware decoder holding a couple of frames in flight. Each frame
+// takes longer than its budget to come out, but the decoder takes every one
+// right away.
+AbrController::Sample pipelinedHardware(uint32_t timestampMs)
+{
+    return window(timestampMs, 0.3, 20.0, 120);
+}
+
+// Software decoding with frame threading at 60 FPS, about a frame of latency
+AbrController::Sample frameThreaded(uint32_t timestampMs)
+{
+    return window(timestampMs, 0.5, 17.0);
+}
+
+// The same decoder at a bitrate it can't sustain
+AbrController::Sample frameThreadedBehind(uint32_t timestampMs)
+{
+    return window(timestampMs, 25.0, 45.0);
+}
+
+struct Trace
+{
+    AbrController controller;
+    uint32_t nowMs = 0;
+    QVector<AbrController::Decision> changes;
+
+    explicit Trace(int initialBitrateKbps, const AbrController::Config& config = testConfig())
+        : controller(config, initialBitrateKbps)
+    {
+    }
+
+    AbrController::Decision feed(const AbrController::Sample& sample)
+    {
+        AbrController::Decision decision = controller.update(sample);
+        if (decision.action != AbrController::Action::Hold) {
+            changes.append(decision);
+        }
+        nowMs = sample.timestampMs + kWindowMs;
+        return decision;
+    }
+
+    // Feeds count windows made by the given generator
+    void run(int count, AbrController::Sample (*make)(uint32_t))
+    {
+        for (int i = 0; i < count; i++) {
+            feed(make(nowMs));
+        }
+    }
+};
+
+bool checkSteadyStates(QTextStream& err)
+{
+    bool ok = true;
+
+    Trace trace(20000);
+    trace.run(120, healthy);
+    ok &= require(trace.changes.isEmpty(), "healthy stream at max bitrate changed bitrate", err);
+
+    // Idle windows are neither healthy nor stressed
+    Trace idle(10000);
+    for (int i = 0; i < 30; i++) {
+        AbrController::Sample sample;
+        sample.timestampMs = idle.nowMs;
+        sample.frameRate = kFrameRate;
+        AbrController::Decision decision = idle.feed(sample);
+        ok &= require(decision.health == AbrController::Health::Idle, "empty window not classified idle", err);
+    }
+    ok &= require(idle.changes.isEmpty(), "idle stream changed bitrate", err);
+
+    return ok;
+}
+
+bool checkOverload(QTextStream& err)
+{
+    bool ok = true;
+
+    // A single slow window is a spike, not overload
+    Trace spike(20000);
+    spike.run(5, healthy);
+    spike.run(1, overloaded);
+    spike.run(5, healthy);
+    ok &= require(spike.changes.isEmpty(), "single overloaded window changed bitrate", err);
+
+    // Two in a row with something in between isn't sustained either
+    Trace broken(20000);
+    broken.run(1, overloaded);
+    broken.feed(window(broken.nowMs, 8.0, 12.0));
+    broken.run(1, overloaded);
+    ok &= require(broken.changes.isEmpty(), "overload streak survived a neutral window", err);
+
+    // Sustained overload backs off, once per dwell time, down to the minimum
+    Trace trace(20000);
+    trace.run(2, overloaded);
+    ok &= require(trace.changes.size() == 1, "sustained overload didn't lower bitrate", err);
+    if (!ok) {
+        return false;
+    }
+
+    const AbrController::Decision& first = trace.changes[0];
+    ok &= require(first.action == AbrController::Action::Decrease, "overload decision isn't a decrease", err);
+    ok &= require(first.health == AbrController::Health::Overloaded, "overload decision has the wrong health", err);
+    ok &= require(first.bitrateKbps == 15000, QString("overload lowered to %1 Kbps").arg(first.bitrateKbps), err);
+    ok &= require(QString(first.reason).contains("waited 20.0 ms for the decoder"), QString("reason is \"%1\"").arg(first.reason), err);
+
+    trace.run(4, overloaded);
+    ok &= require(trace.changes.size() == 1, "changed again within the dwell time", err);
+
+    trace.run(1, overloaded);
+    ok &= require(trace.changes.size() == 2 && trace.changes[1].bitrateKbps == 11250,
+                  "didn't back off again after the dwell time", err);
+
+    trace.run(60, overloaded);
+    ok &= require(trace.controller.bitrateKbps() == 5000, "overload didn't settle at the minimum", err);
+    for (const AbrController::Decision& decision : trace.changes) {
+        ok &= require(decision.bitrateKbps >= 5000, "went below the minimum", err);
+    }
+
+    // The pacer dropping frames and a render backlog are overload too
+    Trace drops(20000);
+    for (int i = 0; i < 2; i++) {
+        AbrController::Sample sample = healthy(drops.nowMs);
+        sample.pacerDroppedFrames = 10;
+        drops.feed(sample);
+    }
+    ok &= require(drops.changes.size() == 1 && QString(drops.changes[0].reason).contains("pacer dropped"),
+                  "pacer drops didn't lower bitrate", err);
+
+    Trace backlog(20000);
+    for (int i = 0; i < 2; i++) {
+        AbrController::Sample sample = healthy(backlog.nowMs);
+        sample.totalPacerTimeUs = 50000ULL * kFrameRate;
+        backlog.feed(sample);
+    }
+    ok &= require(backlog.changes.size() == 1 && QString(backlog.changes[0].reason).contains("waited 50.0 ms"),
+                  "render backlog didn't lower bitrate", err);
+
+    return ok;
+}
+
+bool checkPipelinedDecoders(QTextStream& err)
+{
+    bool ok = true;
+
+    // Decode latency above the frame budget is not overload as long as the
+    // decoder keeps up. Neither of these should ever lower the bitrate, and
+    // both should climb back to the maximum from below.
+    Trace hardware(20000);
+    hardware.run(120, pipelinedHardware);
+    ok &= require(hardware.changes.isEmpty(), "pipelined 120 FPS hardware decoder changed bitrate", err);
+
+    Trace threaded(10000);
+    threaded.run(120, frameThreaded);
+    for (const AbrController::Decision& decision : threaded.changes) {
+        ok &= require(decision.action == AbrController::Action::Increase,
+                      QString("frame threaded decoder lowered bitrate: %1").arg(decision.reason), err);
+    }
+    ok &= require(threaded.controller.bitrateKbps() == 20000,
+                  QString("frame threaded decoder ended at %1 Kbps").arg(threaded.controller.bitrateKbps()), err);
+
+    // Once it really falls behind, it's overloaded like any other decoder
+    Trace behind(20000);
+    behind.run(60, frameThreaded);
+    behind.run(2, frameThreadedBehind);
+    ok &= require(behind.changes.size() == 1 && behind.changes[0].health == AbrController::Health::Overloaded,
+                  "frame threaded decoder falling behind didn't lower bitrate", err);
+
+    return ok;
+}
+
+bool checkCongestion(QTextStream& err)
+{
+    bool ok = true;
+
+    Trace trace(20000);
+    for (int i = 0; i < 2; i++) {
+        AbrController::Sample sample = healthy(trace.nowMs);
+        sample.networkDroppedFrames = 6;
+        trace.feed(sample);
+    }
+    ok &= require(trace.changes.size() == 1, "network loss didn't lower bitrate", err);
+    if (!ok) {
+        return false;
+    }
+    ok &= require(trace.changes[0].health == AbrController::Health::Congested, "loss not classified as congestion", err);
+    ok &= require(trace.changes[0].bitrateKbps == 17000,
+                  QString("congestion lowered to %1 Kbps").arg(trace.changes[0].bitrateKbps), err);
+
+    // Congestion sets no ceiling, so recovery goes all the way back up
+    trace.run(60, healthy);
+    ok &= require(trace.controller.bitrateKbps() == 20000, "didn't recover from congestion to the maximum", err);
+
+    return ok;
+}
+
+bool checkRecovery(QTextStream& err)
+{
+    bool ok = true;
+
+    Trace trace(20000);
+    trace.run(2, overloaded);
+    trace.run(5, overloaded);
+    ok &= require(trace.controller.bitrateKbps() == 11250, "overload setup failed", err);
+    int decreases = trace.changes.size();
+
+    // Nine healthy windows aren't enough, the tenth is
+    trace.run(9, healthy);
+    ok &= require(trace.changes.size() == decreases, "raised bitrate before enough healthy windows", err);
+    trace.run(1, healthy);
+    ok &= require(trace.changes.size() == decreases + 1 &&
+                  trace.changes.last().action == AbrController::Action::Increase &&
+                  trace.changes.last().bitrateKbps == 13250,
+                  "didn't raise bitrate after ten healthy windows", err);
+
+    // Increases stop short of the bitrate that overloaded most recently
+    trace.run(30, healthy);
+    ok &= require(trace.controller.bitrateKbps() == 13500,
+                  QString("recovered to %1 Kbps under the ceiling").arg(trace.controller.bitrateKbps()), err);
+
+    // Until the ceiling expires
+    trace.run(60, healthy);
+    ok &= require(trace.controller.bitrateKbps() == 20000, "didn't recover to the maximum after the ceiling expired", err);
+
+    return ok;
+}
+
+bool checkExternalChanges(QTextStream& err)
+{
+    bool ok = true;
+
+    // The host's ABR moved the bitrate. Healthy windows counted before that
+    // don't count toward the next increase.
+    Trace trace(10000);
+    trace.run(9, healthy);
+    trace.controller.syncBitrateKbps(12000);
+    trace.run(1, healthy);
+    ok &= require(trace.changes.isEmpty(), "healthy windows survived an external change", err);
+    trace.run(9, healthy);
+    ok &= require(trace.changes.size() == 1 && trace.changes[0].bitrateKbps == 14000,
+                  "didn't continue from the externally set bitrate", err);
+
+    // The user lowered the bitrate, so that is the new maximum
+    Trace user(20000);
+    user.controller.setMaxBitrateKbps(8000);
+    user.controller.syncBitrateKbps(8000);
+    user.run(60, healthy);
+    ok &= require(user.changes.isEmpty(), "went above the bitrate the user picked", err);
+
+    return ok;
+}
+
+// A recorded trace, one window per line:
+// timestampMs,frameRate,totalFrames,networkDroppedFrames,receivedFrames,totalDecodeQueueTimeUs,
+// decodedFrames,totalDecodeTimeUs,renderedFrames,pacerDroppedFrames,totalPacerTimeUs
+// [,presentIntervals,totalPresentIntervalUs,totalPresentIntervalSqUs]
+bool replayTrace(const QString& path, int initialBitrateKbps, QTextStream& out, QTextStream& err)
+{
+    QFile file(path);
+    if (!require(file.open(QIODevice::ReadOnly | QIODevice::Text), path + ": can't open", err)) {
+        return false;
+    }
+
+    AbrController::Config config;
+    config.maxBitrateKbps = initialBitrateKbps;
+    config.minBitrateKbps = qMax(1000, initialBitrateKbps / 4);
+    AbrController controller(config, initialBitrateKbps);
+
+    bool ok = true;
+    int windows = 0;
+    QTextStream in(&file);
+    while (!in.atEnd()) {
+        QString line = in.readLine().trimmed();
+        if (line.isEmpty() || line.startsWith('#')) {
+            continue;
+        }
+
+        QStringList fields = line.split(',');
+        if (!require(fields.size() == 11 || fields.size() == 14,
+                     QString("%1: malformed line \"%2\"").arg(path, line), err)) {
+            ok = false;
+            continue;
+        }
+
+        AbrController::Sample sample;
+        sample.timestampMs = fields[0].toUInt();
+        sample.frameRate = fields[1].toInt();
+        sample.totalFrames = fields[2].toUInt();
+        sample.networkDroppedFrames = fields[3].toUInt();
+        sample.receivedFrames = fields[4].toUInt();
+        sample.totalDecodeQueueTimeUs = fields[5].toULongLong();
+        sample.decodedFrames = fields[6].toUInt();
+        sample.totalDecodeTimeUs = fields[7].toULongLong();
+        sample.renderedFrames = fields[8].toUInt();
+        sample.pacerDroppedFrames = fields[9].toUInt();
+        sample.totalPacerTimeUs = fields[10].toULongLong();
+        if (fields.size() == 14) {
+            sample.presentIntervals = fields[11].toUInt();
+            sample.totalPresentIntervalUs = fields[12].toULongLong();
+            sample.totalPresentIntervalSqUs = fields[13].toULongLong();
+        }
+
+        AbrController::Decision decision = controller.update(sample);
+        if (decision.action != AbrController::Action::Hold) {
+            out << path << ": " << sample.timestampMs << " ms: "
+                << (decision.action == AbrController::Action::Increase ? "raise" : "lower")
+                << " to " << decision.bitrateKbps << " Kbps: " << decision.reason << '\n';
+        }
+
+        ok &= require(decision.bitrateKbps >= qMin(config.minBitrateKbps, config.maxBitrateKbps) &&
+                      decision.bitrateKbps <= config.maxBitrateKbps,
+                      QString("%1: bitrate %2 Kbps out of range").arg(path).arg(decision.bitrateKbps), err);
+        windows++;
+    }
+
+    out << path << ": " << windows << " windows replayed, ending at " << controller.bitrateKbps() << " Kbps\n";
+    return ok;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    bool ok = true;
+    ok &= checkSteadyStates(err);
+    ok &= checkOverload(err);
+    ok &= checkPipelinedDecoders(err);
+    ok &= checkCongestion(err);
+    ok &= checkRecovery(err);
+    ok &= checkExternalChanges(err);
+
+    // Recorded stats traces to replay, if any, starting from 20 Mbps
+    const QStringList traces = app.arguments().mid(1);
+    for (const QString& path : traces) {
+        ok &= replayTrace(path, 20000, out, err);
+    }
+
+    out << (ok ? "PASS\n" : "FAILED\n");
+    out.flush();
+    err.flush();
+    return ok ? 0 : 1;
+}
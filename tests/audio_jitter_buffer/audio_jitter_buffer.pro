@@ -0,0 +1,18 @@
+QT += core
+CONFIG += c++17 console link_pkgconfig
+CONFIG -= app_bundle
+
+TARGET = audio_jitter_buffer
+TEMPLATE = app
+
+PKGCONFIG += sdl2
+
+INCLUDEPATH += \
+    $$PWD/../../app
+
+SOURCES += \
+    main.cpp \
+    ../../app/streaming/audio/renderers/jitterbuffer.cpp
+
+HEADERS += \
+    ../../app/streaming/audio/renderers/jitterbuffer.h
@@ -0,0 +1,402 @@
+#include "streaming/audio/renderers/jitterbuffer.h"
+
+#include <QCoreApplication>
+#include <QTextStream>
+
+#include <cmath>
+#include <functional>
+#include <vector>
+
+namespace {
+// 5 ms Opus frames in stereo, pulled 10 ms at a time, as on most desktops
+constexpr Uint32 kSampleRate = 48000;
+constexpr Uint32 kChannels = 2;
+constexpr Uint32 kFrameSamples = 240;
+constexpr Uint32 kPeriodFrames = 480;
+constexpr Uint64 kFrameUs = 5000;
+constexpr Uint64 kPeriodUs = 10000;
+
+// Target with no jitter: a device period plus a frame in flight
+constexpr Uint32 kBaseTargetFrames = kPeriodFrames + kFrameSamples;
+
+// Depth errors the buffer deliberately leaves alone (MIN_STRETCH_BAND_MS
+// is smaller than a frame here)
+constexpr Uint32 kStretchBandFrames = kFrameSamples;
+
+bool require(bool condition, const QString& message, QTextStream& err)
+{
+    if (!condition) {
+        err << "FAIL: " << message << '\n';
+    }
+    return condition;
+}
+
+// Plays a 440 Hz tone through a buffer on a simulated clock. Frames are
+// written as the receive thread would get them and the device pulls one
+// period every 10 ms, unless it is stalled.
+class Stream
+{
+public:
+    Stream()
+        : initialized(false),
+          deviceStalled(false),
+          silentReads(0),
+          maxStep(0.0f),
+          m_NowUs(1000000),
+          m_NextFrameUs(m_NowUs),
+          m_NextReadUs(m_NowUs),
+          m_Phase(0.0),
+          m_Output(kPeriodFrames * kChannels),
+          m_LastSample(0.0f),
+          m_HaveLastSample(false)
+    {
+        initialized = buffer.initialize(kSampleRate, kChannels, kFrameSamples, kPeriodFrames);
+    }
+
+    // Frames keep their 5 ms schedule, each arriving lateUs behind it.
+    // Late frames hold back the ones behind them, like a real socket.
+    // Short frames leave the buffer with less audio than time has passed.
+    void play(Uint64 durationUs, const std::function<Uint64(Uint64 scheduledUs)>& lateUs = nullptr,
+              Uint32 frameSamples = kFrameSamples)
+    {
+        const Uint64 endUs = m_NextFrameUs + durationUs;
+        while (m_NextFrameUs < endUs) {
+            const Uint64 arrivalUs = SDL_max(m_NowUs, m_NextFrameUs + (lateUs ? lateUs(m_NextFrameUs) : 0));
+            advanceTo(arrivalUs);
+            write(frameSamples);
+            m_NextFrameUs += kFrameUs;
+        }
+        advanceTo(endUs);
+    }
+
+    // No frames at all for durationUs, as when the host stops sending
+    void pause(Uint64 durationUs)
+    {
+        advanceTo(m_NowUs + durationUs);
+        m_NextFrameUs = m_NowUs;
+    }
+
+    // Writes frames right now, outside the schedule
+    void write(Uint32 frames)
+    {
+        m_Samples.resize(frames * kChannels);
+        for (Uint32 i = 0; i < frames; i++) {
+            const float sample = (float)std::sin(m_Phase);
+            for (Uint32 ch = 0; ch < kChannels; ch++) {
+                m_Samples[i * kChannels + ch] = sample;
+            }
+            m_Phase += 2 * M_PI * 440 / kSampleRate;
+        }
+        buffer.write(m_Samples.data(), frames, m_NowUs);
+    }
+
+    // Depth before each read since the last call
+    std::vector<Uint32> takeDepths()
+    {
+        std::vector<Uint32> depths;
+        depths.swap(m_Depths);
+        return depths;
+    }
+
+    // Frames each read since the last call took out of the buffer
+    std::vector<Uint32> takeConsumed()
+    {
+        std::vector<Uint32> consumed;
+        consumed.swap(m_Consumed);
+        return consumed;
+    }
+
+    void resetStep()
+    {
+        maxStep = 0.0f;
+        m_HaveLastSample = false;
+    }
+
+    AudioJitterBuffer buffer;
+    bool initialized;
+    bool deviceStalled;
+    int silentReads;
+    float maxStep;
+
+private:
+    // Lets the device pull every period that falls due up to t
+    void advanceTo(Uint64 t)
+    {
+        while (m_NextReadUs <= t) {
+            if (!deviceStalled) {
+                read();
+            }
+            m_NextReadUs += kPeriodUs;
+        }
+        m_NowUs = t;
+    }
+
+    void read()
+    {
+        const Uint32 before = buffer.getBufferedFrames();
+        buffer.read(m_Output.data(), kPeriodFrames);
+        m_Depths.push_back(before);
+        m_Consumed.push_back(before - buffer.getBufferedFrames());
+
+        bool silent = true;
+        for (float sample : m_Output) {
+            silent &= sample == 0.0f;
+        }
+        if (silent) {
+            silentReads++;
+            m_HaveLastSample = false;
+            return;
+        }
+
+        // The biggest jump between neighbouring samples. A clean tone moves
+        // at most 2 * pi * 440 / 48000 per sample, and stretching only scales
+        // that by the stretch ratio.
+        for (Uint32 i = 0; i < kPeriodFrames; i++) {
+            const float sample = m_Output[i * kChannels];
+            if (m_HaveLastSample) {
+                maxStep = SDL_max(maxStep, std::fabs(sample - m_LastSample));
+            }
+            m_LastSample = sample;
+            m_HaveLastSample = true;
+        }
+    }
+
+    Uint64 m_NowUs;
+    Uint64 m_NextFrameUs;
+    Uint64 m_NextReadUs;
+    double m_Phase;
+    std::vector<float> m_Output;
+    std::vector<float> m_Samples;
+    std::vector<Uint32> m_Depths;
+    std::vector<Uint32> m_Consumed;
+    float m_LastSample;
+    bool m_HaveLastSample;
+};
+
+const float kToneStep = (float)(2 * M_PI * 440 / kSampleRate);
+
+double average(const std::vector<Uint32>& values)
+{
+    double sum = 0;
+    for (Uint32 value : values) {
+        sum += value;
+    }
+    return values.empty() ? 0 : sum / values.size();
+}
+
+bool runSteadyChecks(QTextStream& out, QTextStream& err)
+{
+    bool ok = true;
+    Stream stream;
+    if (!require(stream.initialized, QStringLiteral("buffer failed to initialize"), err)) {
+        return false;
+    }
+
+    ok &= require(stream.buffer.getTargetFrames() == kBaseTargetFrames,
+                  QStringLiteral("initial target is %1 frames, not %2").arg(stream.buffer.getTargetFrames()).arg(kBaseTargetFrames), err);
+
+    stream.play(3000000);
+    stream.takeDepths();
+    stream.resetStep();
+    stream.play(1000000);
+    const double depth = average(stream.takeDepths());
+
+    ok &= require(stream.buffer.getUnderruns() == 0 && stream.buffer.getOverruns() == 0,
+                  QStringLiteral("steady stream underran or overran"), err);
+    ok &= require(stream.buffer.getTargetFrames() == kBaseTargetFrames,
+                  QStringLiteral("target moved without any jitter"), err);
+    ok &= require(depth >= kBaseTargetFrames && depth <= kBaseTargetFrames + kStretchBandFrames + kFrameSamples,
+                  QStringLiteral("steady depth %1 frames is not at the %2 frame target").arg(depth).arg(kBaseTargetFrames), err);
+    ok &= require(stream.maxStep <= kToneStep * 1.01f,
+                  QStringLiteral("steady playback distorted the tone"), err);
+
+    out << "steady target_frames=" << stream.buffer.getTargetFrames()
+        << " depth_frames=" << QString::number(depth, 'f', 1) << '\n';
+    return ok;
+}
+
+bool runUnderrunChecks(QTextStream& out, QTextStream& err)
+{
+    bool ok = true;
+    Stream stream;
+    if (!require(stream.initialized, QStringLiteral("buffer failed to initialize"), err)) {
+        return false;
+    }
+    stream.play(1000000);
+
+    // A host stall too long to be jitter: one underrun, silence while it
+    // lasts, and the target stays where it was
+    const int silentBefore = stream.silentReads;
+    stream.pause(300000);
+    ok &= require(stream.buffer.getUnderruns() == 1,
+                  QStringLiteral("a stall counted %1 underruns, not 1").arg(stream.buffer.getUnderruns()), err);
+    ok &= require(stream.silentReads - silentBefore >= 28,
+                  QStringLiteral("a 300 ms stall played only %1 silent periods").arg(stream.silentReads - silentBefore), err);
+    ok &= require(stream.buffer.getTargetFrames() == kBaseTargetFrames,
+                  QStringLiteral("a stall longer than any jitter moved the target"), err);
+
+    // Playback refills to the target and resumes within a couple of periods
+    const int silentAtResume = stream.silentReads;
+    stream.play(1000000);
+    ok &= require(stream.silentReads - silentAtResume <= 2,
+                  QStringLiteral("took %1 silent periods to resume").arg(stream.silentReads - silentAtResume), err);
+    ok &= require(stream.buffer.getUnderruns() == 1,
+                  QStringLiteral("playback kept underrunning after a stall"), err);
+
+    // A hiccup short enough to be jitter underruns once and raises the
+    // target, so the next one like it is absorbed
+    const Uint32 underruns = stream.buffer.getUnderruns();
+    stream.pause(40000);
+    ok &= require(stream.buffer.getUnderruns() == underruns + 1,
+                  QStringLiteral("a 40 ms hiccup did not underrun a 15 ms buffer"), err);
+    stream.play(300000);
+    const Uint32 raisedTarget = stream.buffer.getTargetFrames();
+    ok &= require(raisedTarget > kBaseTargetFrames + kSampleRate * 30 / 1000,
+                  QStringLiteral("a 40 ms hiccup only raised the target to %1 frames").arg(raisedTarget), err);
+    ok &= require(raisedTarget <= kSampleRate * 100 / 1000,
+                  QStringLiteral("target %1 frames is above the 100 ms cap").arg(raisedTarget), err);
+    stream.pause(30000);
+    stream.play(1000000);
+    ok &= require(stream.buffer.getUnderruns() == underruns + 1,
+                  QStringLiteral("a repeat hiccup underran despite the raised target"), err);
+
+    out << "underrun underruns=" << stream.buffer.getUnderruns()
+        << " raised_target_frames=" << raisedTarget << '\n';
+    return ok;
+}
+
+bool runOverrunChecks(QTextStream& out, QTextStream& err)
+{
+    bool ok = true;
+    Stream stream;
+    if (!require(stream.initialized, QStringLiteral("buffer failed to initialize"), err)) {
+        return false;
+    }
+    stream.play(1000000);
+
+    // The device stalls while audio keeps arriving. Its first read back
+    // drops straight to the target instead of stretching for a minute.
+    stream.deviceStalled = true;
+    stream.play(200000);
+    const Uint32 backlog = stream.buffer.getBufferedFrames();
+    stream.deviceStalled = false;
+    stream.takeConsumed();
+    stream.play(kPeriodUs);
+    const std::vector<Uint32> consumed = stream.takeConsumed();
+    ok &= require(stream.buffer.getOverruns() == 1,
+                  QStringLiteral("a 200 ms device stall counted %1 overruns, not 1").arg(stream.buffer.getOverruns()), err);
+    ok &= require(consumed.size() == 1 && consumed.front() > backlog - kBaseTargetFrames,
+                  QStringLiteral("the first read after a stall did not skip back to the target"), err);
+
+    stream.play(1000000);
+    ok &= require(stream.buffer.getUnderruns() == 0 && stream.buffer.getOverruns() == 1,
+                  QStringLiteral("playback did not settle after a device stall"), err);
+
+    // A stall longer than the ring drops new frames instead of
+    // overwriting ones the device hasn't read
+    stream.deviceStalled = true;
+    stream.play(1000000);
+    const Uint32 dropped = stream.buffer.getOverruns() - 1;
+    ok &= require(dropped > 0,
+                  QStringLiteral("a full ring accepted every frame"), err);
+    ok &= require(stream.buffer.getBufferedFrames() <= kSampleRate,
+                  QStringLiteral("ring holds %1 frames after filling up").arg(stream.buffer.getBufferedFrames()), err);
+    // Frames keep being dropped until the device's first read frees space
+    stream.deviceStalled = false;
+    stream.play(100000);
+    const Uint32 overruns = stream.buffer.getOverruns();
+    stream.play(1000000);
+    ok &= require(stream.buffer.getUnderruns() == 0 && stream.buffer.getOverruns() == overruns,
+                  QStringLiteral("playback did not recover from a full ring"), err);
+
+    out << "overrun backlog_frames=" << backlog << " dropped_frames=" << dropped << '\n';
+    return ok;
+}
+
+bool runConvergenceChecks(QTextStream& out, QTextStream& err)
+{
+    bool ok = true;
+    Stream stream;
+    if (!require(stream.initialized, QStringLiteral("buffer failed to initialize"), err)) {
+        return false;
+    }
+    stream.play(2000000);
+    stream.takeDepths();
+    stream.play(1000000);
+    const double baseline = average(stream.takeDepths());
+
+    // 10 ms too much, as after a burst: consumed slightly faster until the
+    // depth is back, without skipping anything or bending the tone
+    stream.write(2 * kFrameSamples);
+    stream.takeConsumed();
+    stream.resetStep();
+    stream.play(500000);
+    const std::vector<Uint32> fastReads = stream.takeConsumed();
+    ok &= require(!fastReads.empty() && fastReads.front() > kPeriodFrames,
+                  QStringLiteral("reads did not speed up above the target"), err);
+    stream.play(2500000);
+    stream.takeDepths();
+    stream.play(1000000);
+    const double aboveSettled = average(stream.takeDepths());
+    ok &= require(std::fabs(aboveSettled - baseline) <= kStretchBandFrames,
+                  QStringLiteral("depth settled at %1 frames, %2 from its usual %3")
+                      .arg(aboveSettled).arg(aboveSettled - baseline).arg(baseline), err);
+    ok &= require(stream.buffer.getUnderruns() == 0 && stream.buffer.getOverruns() == 0,
+                  QStringLiteral("converging from above dropped or skipped audio"), err);
+    ok &= require(stream.maxStep <= kToneStep * 1.01f,
+                  QStringLiteral("stretching distorted the tone (step %1)").arg(stream.maxStep), err);
+
+    // 20 ms too little. That only fits without an underrun when the target
+    // is well above a device period, so raise it with a hiccup first.
+    stream.pause(40000);
+    stream.play(100000);
+    const Uint32 underruns = stream.buffer.getUnderruns();
+    stream.play(8 * kFrameUs, nullptr, kFrameSamples / 2);
+    stream.takeConsumed();
+    stream.play(100000);
+    const std::vector<Uint32> slowReads = stream.takeConsumed();
+    bool slowed = !slowReads.empty();
+    for (Uint32 consumed : slowReads) {
+        slowed &= consumed < kPeriodFrames;
+    }
+    ok &= require(slowed, QStringLiteral("reads did not slow down below the target"), err);
+
+    // The hiccup's jitter ages out, and the depth follows the target down
+    stream.resetStep();
+    stream.play(8000000);
+    stream.takeDepths();
+    stream.play(1000000);
+    const double belowSettled = average(stream.takeDepths());
+    const Uint32 target = stream.buffer.getTargetFrames();
+    ok &= require(std::fabs(belowSettled - target) <= kStretchBandFrames + kFrameSamples,
+                  QStringLiteral("depth settled at %1 frames against a %2 frame target").arg(belowSettled).arg(target), err);
+    ok &= require(stream.buffer.getUnderruns() == underruns,
+                  QStringLiteral("tracking the target caused an underrun"), err);
+    ok &= require(stream.maxStep <= kToneStep * 1.01f,
+                  QStringLiteral("stretching distorted the tone (step %1)").arg(stream.maxStep), err);
+
+    out << "convergence baseline_frames=" << QString::number(baseline, 'f', 1)
+        << " above_settled_frames=" << QString::number(aboveSettled, 'f', 1)
+        << " below_settled_frames=" << QString::number(belowSettled, 'f', 1)
+        << " target_frames=" << target << '\n';
+    return ok;
+}
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    bool ok = true;
+    ok &= runSteadyChecks(out, err);
+    ok &= runUnderrunChecks(out, err);
+    ok &= runOverrunChecks(out, err);
+    ok &= runConvergenceChecks(out, err);
+
+    out << (ok ? "PASS\n" : "FAILED\n");
+    out.flush();
+    err.flush();
+    return ok ? 0 : 1;
+}
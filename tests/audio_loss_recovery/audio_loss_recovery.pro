@@ -0,0 +1,18 @@
+QT += core
+CONFIG += c++17 console link_pkgconfig
+CONFIG -= app_bundle
+
+TARGET = audio_loss_recovery
+TEMPLATE = app
+
+PKGCONFIG += opus
+
+INCLUDEPATH += \
+    $$PWD/../../app
+
+SOURCES += \
+    main.cpp \
+    ../../app/streaming/audio/lossrecovery.cpp
+
+HEADERS += \
+    ../../app/streaming/audio/lossrecovery.h
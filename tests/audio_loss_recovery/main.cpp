@@ -0,0 +1,536 @@
+#include "streaming/audio/lossrecovery.h"
+
+#include <QCoreApplication>
+#include <QTextStream>
+
+#include <opus.h>
+#include <opus_multistream.h>
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+namespace {
+constexpr int kSampleRate = 48000;
+
+// 10 ms, the shortest frame SILK can code and so the shortest with LBRR
+constexpr int kFrameSamples = 480;
+constexpr int kMaxPacketSize = 1500;
+constexpr int kMaxDecodeSamples = 5760;
+
+typedef std::vector<unsigned char> Packet;
+
+// SILK-only narrowband 10 ms mono (RFC 6716 3.1, config 0). A SILK frame
+// starts with its VAD flag and then its LBRR flag.
+const Packet kLbrrPacket = { 0x00, 0xC0, 0x5A, 0x3C, 0x99, 0x21 };
+const Packet kPlainPacket = { 0x00, 0x80, 0x5A, 0x3C, 0x99, 0x21 };
+
+// CELT-only fullband 10 ms (config 30). CELT has no LBRR, whatever the bits
+// in the first byte happen to be.
+const Packet kCeltPacket = { 0xF0, 0xC0, 0x5A, 0x3C, 0x99, 0x21 };
+
+bool require(bool condition, const QString& message, QTextStream& err)
+{
+    if (!condition) {
+        err << "FAIL: " << message << '\n';
+    }
+    return condition;
+}
+
+struct Totals
+{
+    int fec;
+    int concealed;
+    int skipped;
+
+    bool operator==(const Totals& other) const
+    {
+        return fec == other.fec && concealed == other.concealed && skipped == other.skipped;
+    }
+};
+
+QString describe(const Totals& totals)
+{
+    return QStringLiteral("fec=%1 concealed=%2 skipped=%3").arg(totals.fec).arg(totals.concealed).arg(totals.skipped);
+}
+
+struct Trace
+{
+    const char* name;
+
+    // One character per packet: '.' arrived, 'x' was lost, and 'm' arrived
+    // or was lost while audio was muted
+    const char* pattern;
+
+    Totals withLbrr;
+    Totals withoutLbrr;
+};
+
+// At 10 ms frames, up to 10 frames of a burst are rebuilt
+const Trace kTraces[] = {
+    { "clean", "................", { 0, 0, 0 }, { 0, 0, 0 } },
+    { "single", "..x....x....x...", { 3, 0, 0 }, { 0, 3, 0 } },
+    { "pairs", "..xx....xxx.....", { 2, 3, 0 }, { 0, 5, 0 } },
+    { "limit", "..xxxxxxxxxx....", { 1, 9, 0 }, { 0, 10, 0 } },
+    { "long", ".xxxxxxxxxxxxxxxxxxxxxxxxx.", { 1, 9, 15 }, { 0, 10, 15 } },
+    { "leading", "xxx........", { 1, 2, 0 }, { 0, 3, 0 } },
+    { "trailing", "........xxx", { 0, 0, 0 }, { 0, 0, 0 } },
+    { "muted", "..xxmm..xx..x..", { 2, 1, 0 }, { 0, 3, 0 } },
+    { "lost_while_muted", "..xmxx..", { 1, 1, 0 }, { 0, 2, 0 } },
+};
+
+void appendFrameLength(Packet& packet, int length)
+{
+    // RFC 6716 3.2.1
+    if (length < 252) {
+        packet.push_back((unsigned char)length);
+    }
+    else {
+        int first = 252 + (length & 0x3);
+        packet.push_back((unsigned char)first);
+        packet.push_back((unsigned char)((length - first) >> 2));
+    }
+}
+
+enum class Framing { Compact, Vbr, PaddedVbr, Cbr };
+
+// Rewrites a packet with self-delimiting framing (RFC 6716 appendix B), the
+// way every stream but the last is sent in a multistream packet. Compact
+// picks the smallest frame count code, the others force code 3.
+bool selfDelimit(const Packet& packet, Framing framing, Packet& out)
+{
+    unsigned char toc;
+    const unsigned char* frames[48];
+    opus_int16 sizes[48];
+    int count = opus_packet_parse(packet.data(), (opus_int32)packet.size(), &toc, frames, sizes, nullptr);
+    if (count <= 0) {
+        return false;
+    }
+
+    bool equalSizes = true;
+    for (int i = 1; i < count; i++) {
+        equalSizes &= sizes[i] == sizes[0];
+    }
+
+    out.clear();
+    toc &= ~0x3;
+    if (framing == Framing::Compact && count == 1) {
+        out.push_back(toc);
+        appendFrameLength(out, sizes[0]);
+    }
+    else if (framing == Framing::Compact && count == 2 && equalSizes) {
+        out.push_back(toc | 1);
+        appendFrameLength(out, sizes[0]);
+    }
+    else if (framing == Framing::Compact && count == 2) {
+        out.push_back(toc | 2);
+        appendFrameLength(out, sizes[0]);
+        appendFrameLength(out, sizes[1]);
+    }
+    else if (framing == Framing::Cbr) {
+        if (!equalSizes) {
+            return false;
+        }
+        out.push_back(toc | 3);
+        out.push_back((unsigned char)count);
+        appendFrameLength(out, sizes[0]);
+    }
+    else {
+        int padding = framing == Framing::PaddedVbr ? 300 : 0;
+        out.push_back(toc | 3);
+        out.push_back((unsigned char)(0x80 | (padding > 0 ? 0x40 : 0) | count));
+        if (padding > 0) {
+            int remaining = padding;
+            while (remaining >= 255) {
+                out.push_back(255);
+                remaining -= 254;
+            }
+            out.push_back((unsigned char)remaining);
+        }
+        for (int i = 0; i < count; i++) {
+            appendFrameLength(out, sizes[i]);
+        }
+        for (int i = 0; i < count; i++) {
+            out.insert(out.end(), frames[i], frames[i] + sizes[i]);
+        }
+        out.insert(out.end(), padding, 0);
+        return true;
+    }
+
+    for (int i = 0; i < count; i++) {
+        out.insert(out.end(), frames[i], frames[i] + sizes[i]);
+    }
+    return true;
+}
+
+// Builds a multistream packet carrying the same coded audio in every stream
+bool buildMultistream(const Packet& packet, int streams, Framing framing, Packet& out)
+{
+    if (streams <= 1) {
+        out = packet;
+        return true;
+    }
+
+    Packet delimited;
+    if (!selfDelimit(packet, framing, delimited)) {
+        return false;
+    }
+
+    out.clear();
+    for (int i = 0; i < streams - 1; i++) {
+        out.insert(out.end(), delimited.begin(), delimited.end());
+    }
+    out.insert(out.end(), packet.begin(), packet.end());
+    return true;
+}
+
+// Replays a loss pattern the way Session::arDecodeAndPlaySample() feeds it
+// to the recovery, with every arriving packet being the given one
+Totals replay(const char* pattern, const Packet& packet, int streams, int& recoveries)
+{
+    AudioLossRecovery recovery;
+    recovery.initialize(kSampleRate, kFrameSamples, streams);
+
+    Totals totals = {};
+    recoveries = 0;
+    for (const char* c = pattern; *c != '\0'; c++) {
+        if (*c == 'x') {
+            recovery.packetLost();
+        }
+        else if (*c == 'm') {
+            recovery.reset();
+        }
+        else {
+            AudioLossRecovery::Plan plan = recovery.packetReceived(packet.data(), (int)packet.size());
+            totals.fec += plan.decodeFec ? 1 : 0;
+            totals.concealed += plan.concealedFrames;
+            totals.skipped += plan.skippedFrames;
+            if (plan.decodeFec || plan.concealedFrames > 0 || plan.skippedFrames > 0) {
+                recoveries++;
+            }
+        }
+    }
+    return totals;
+}
+
+int countBursts(const char* pattern)
+{
+    int bursts = 0;
+    int pending = 0;
+    for (const char* c = pattern; *c != '\0'; c++) {
+        if (*c == 'x') {
+            pending++;
+        }
+        else if (*c == 'm') {
+            pending = 0;
+        }
+        else if (pending > 0) {
+            bursts++;
+            pending = 0;
+        }
+    }
+    return bursts;
+}
+
+bool runTraceChecks(QTextStream& out, QTextStream& err)
+{
+    bool ok = true;
+
+    struct Source
+    {
+        const char* name;
+        const Packet* packet;
+        bool hasLbrr;
+    };
+    const Source sources[] = {
+        { "lbrr", &kLbrrPacket, true },
+        { "plain", &kPlainPacket, false },
+        { "celt", &kCeltPacket, false },
+    };
+
+    for (const Trace& trace : kTraces) {
+        for (const Source& source : sources) {
+            for (int streams : { 1, 2, 4 }) {
+                Packet wire;
+                if (!require(buildMultistream(*source.packet, streams, Framing::Compact, wire),
+                             QStringLiteral("could not build a %1 stream %2 packet").arg(streams).arg(source.name), err)) {
+                    ok = false;
+                    continue;
+                }
+
+#ifdef OPUS_SET_DRED_DURATION_REQUEST
+                const Totals& expected = source.hasLbrr ? trace.withLbrr : trace.withoutLbrr;
+#else
+                // Without opus_packet_has_lbrr(), every recovery tries FEC
+                const Totals& expected = trace.withLbrr;
+#endif
+
+                int recoveries;
+                Totals totals = replay(trace.pattern, wire, streams, recoveries);
+                ok &= require(totals == expected,
+                              QStringLiteral("%1 trace over %2 packets with %3 streams gave %4, expected %5")
+                                  .arg(trace.name).arg(source.name).arg(streams)
+                                  .arg(describe(totals)).arg(describe(expected)), err);
+
+                // Each burst is resolved once, by the packet right after it
+                ok &= require(recoveries == countBursts(trace.pattern),
+                              QStringLiteral("%1 trace over %2 packets with %3 streams recovered %4 bursts, expected %5")
+                                  .arg(trace.name).arg(source.name).arg(streams)
+                                  .arg(recoveries).arg(countBursts(trace.pattern)), err);
+            }
+        }
+
+        int recoveries;
+        out << "trace=" << trace.name
+            << " lbrr " << describe(replay(trace.pattern, kLbrrPacket, 1, recoveries))
+            << " plain " << describe(replay(trace.pattern, kPlainPacket, 1, recoveries)) << '\n';
+    }
+
+    return ok;
+}
+
+#ifdef OPUS_SET_DRED_DURATION_REQUEST
+// A voiced buzz with a syllable-rate envelope and some breath noise, so the
+// encoder sees active speech and codes LBRR for it
+void speechLike(float* pcm, int frames, int& position, unsigned int& seed)
+{
+    const double pi = 3.14159265358979323846;
+    for (int i = 0; i < frames; i++, position++) {
+        double t = (double)position / kSampleRate;
+        double envelope = 0.6 + 0.4 * std::sin(2 * pi * 3 * t);
+        double buzz = 0;
+        for (int k = 1; k <= 12; k++) {
+            buzz += std::sin(2 * pi * 140 * k * t) / k;
+        }
+        seed = seed * 1664525 + 1013904223;
+        double noise = (int)(seed >> 16) / 32768.0 - 1.0;
+        pcm[i] = (float)(0.2 * envelope * buzz + 0.02 * noise);
+    }
+}
+
+bool encodeStream(int application, int frameSamples, bool fec, int count, std::vector<Packet>& packets, QTextStream& err)
+{
+    int error;
+    OpusEncoder* encoder = opus_encoder_create(kSampleRate, 1, application, &error);
+    if (!require(encoder != nullptr, QStringLiteral("opus_encoder_create() failed: %1").arg(error), err)) {
+        return false;
+    }
+
+    opus_encoder_ctl(encoder, OPUS_SET_BITRATE(24000));
+    opus_encoder_ctl(encoder, OPUS_SET_SIGNAL(OPUS_SIGNAL_VOICE));
+    opus_encoder_ctl(encoder, OPUS_SET_INBAND_FEC(fec ? 1 : 0));
+    opus_encoder_ctl(encoder, OPUS_SET_PACKET_LOSS_PERC(fec ? 20 : 0));
+
+    std::vector<float> pcm(frameSamples);
+    int position = 0;
+    unsigned int seed = 1;
+    bool ok = true;
+    packets.clear();
+    for (int i = 0; i < count && ok; i++) {
+        speechLike(pcm.data(), frameSamples, position, seed);
+        Packet packet(kMaxPacketSize);
+        int length = opus_encode_float(encoder, pcm.data(), frameSamples, packet.data(), kMaxPacketSize);
+        ok &= require(length > 0, QStringLiteral("opus_encode_float() failed: %1").arg(length), err);
+        packet.resize(length > 0 ? length : 0);
+        packets.push_back(packet);
+    }
+
+    opus_encoder_destroy(encoder);
+    return ok;
+}
+
+bool repacketize(const std::vector<Packet>& packets, size_t first, int count, Packet& out)
+{
+    OpusRepacketizer* rp = opus_repacketizer_create();
+    bool ok = true;
+    for (int i = 0; i < count && ok; i++) {
+        const Packet& packet = packets[first + i];
+        ok = opus_repacketizer_cat(rp, packet.data(), (opus_int32)packet.size()) == OPUS_OK;
+    }
+    if (ok) {
+        out.resize(kMaxPacketSize * count);
+        int length = opus_repacketizer_out(rp, out.data(), (opus_int32)out.size());
+        ok = length > 0;
+        out.resize(ok ? length : 0);
+    }
+    opus_repacketizer_destroy(rp);
+    return ok;
+}
+
+// Checks packetHasLbrr() against opus_packet_has_lbrr() on the standard
+// framed packet, with the packet sent in every stream of a multistream one.
+// The decoder has to accept the multistream packet, or it wasn't built right.
+bool checkPacket(const Packet& packet, Framing framing, int streams, OpusMSDecoder* decoder,
+                 int& withLbrr, QTextStream& err)
+{
+    Packet wire;
+    if (!buildMultistream(packet, streams, framing, wire)) {
+        // Only CBR framing can refuse, for frames of different sizes
+        return true;
+    }
+
+    bool expected = opus_packet_has_lbrr(packet.data(), (opus_int32)packet.size()) > 0;
+    withLbrr += expected ? 1 : 0;
+
+    bool ok = true;
+    if (decoder != nullptr) {
+        static float pcm[kMaxDecodeSamples * 4];
+        int decoded = opus_multistream_decode_float(decoder, wire.data(), (opus_int32)wire.size(), pcm, kMaxDecodeSamples, 0);
+        ok &= require(decoded > 0, QStringLiteral("hand built %1 stream packet didn't decode: %2").arg(streams).arg(decoded), err);
+    }
+    ok &= require(AudioLossRecovery::packetHasLbrr(wire.data(), (int)wire.size(), streams) == expected,
+                  QStringLiteral("%1 stream packet with framing %2 should%3 have LBRR")
+                      .arg(streams).arg((int)framing).arg(expected ? "" : " not"), err);
+    return ok;
+}
+
+bool runEncoderChecks(QTextStream& out, QTextStream& err)
+{
+    bool ok = true;
+    const int streams = 4;
+    const unsigned char mapping[streams] = { 0, 1, 2, 3 };
+
+    int error;
+    OpusMSDecoder* decoder = opus_multistream_decoder_create(kSampleRate, streams, streams, 0, mapping, &error);
+    if (!require(decoder != nullptr, QStringLiteral("opus_multistream_decoder_create() failed: %1").arg(error), err)) {
+        return false;
+    }
+
+    std::vector<Packet> fecPackets;
+    std::vector<Packet> celtPackets;
+    if (!encodeStream(OPUS_APPLICATION_VOIP, kFrameSamples, true, 200, fecPackets, err) ||
+            !encodeStream(OPUS_APPLICATION_RESTRICTED_LOWDELAY, kFrameSamples / 2, true, 200, celtPackets, err)) {
+        opus_multistream_decoder_destroy(decoder);
+        return false;
+    }
+
+    // One frame per packet, as the host sends them
+    int fecWithLbrr = 0;
+    int celtWithLbrr = 0;
+    int checked = 0;
+    for (const Packet& packet : fecPackets) {
+        for (int count : { 1, 2, streams }) {
+            int ignored = 0;
+            ok &= checkPacket(packet, Framing::Compact, count, count == streams ? decoder : nullptr,
+                              count == 1 ? fecWithLbrr : ignored, err);
+            checked++;
+        }
+    }
+    for (const Packet& packet : celtPackets) {
+        ok &= checkPacket(packet, Framing::Compact, streams, decoder, celtWithLbrr, err);
+        checked++;
+    }
+
+    // Several frames per packet, in every framing the parser handles
+    int multiframeWithLbrr = 0;
+    for (size_t i = 0; i + 3 <= fecPackets.size(); i += 3) {
+        for (int count : { 2, 3 }) {
+            Packet combined;
+            if (!repacketize(fecPackets, i, count, combined)) {
+                // Mode or bandwidth changed between the frames
+                continue;
+            }
+            for (Framing framing : { Framing::Compact, Framing::Vbr, Framing::PaddedVbr, Framing::Cbr }) {
+                ok &= checkPacket(combined, framing, streams, decoder, multiframeWithLbrr, err);
+                checked++;
+            }
+        }
+    }
+
+    // An empty first frame is DTX, which never has LBRR
+    const Packet dtxPacket = { (unsigned char)(fecPackets.back()[0] & ~0x3) };
+    int dtxWithLbrr = 0;
+    ok &= checkPacket(dtxPacket, Framing::Compact, streams, decoder, dtxWithLbrr, err);
+
+    // Make sure both outcomes were actually covered
+    ok &= require(fecWithLbrr > 0, QStringLiteral("the FEC encoder never coded LBRR"), err);
+    ok &= require(fecWithLbrr < (int)fecPackets.size(), QStringLiteral("every FEC packet had LBRR, even the first"), err);
+    ok &= require(celtWithLbrr == 0, QStringLiteral("CELT packets can't have LBRR"), err);
+
+    // Replay a lossy stretch of the real stream. FEC must be chosen exactly
+    // for the bursts whose next packet has LBRR, and the 15 frame burst is
+    // past the concealment limit.
+    std::string pattern(fecPackets.size(), '.');
+    for (size_t i = 7; i < pattern.size(); i += 17) {
+        pattern[i] = 'x';
+    }
+    pattern.replace(50, 3, "xxx");
+    pattern.replace(120, 15, std::string(15, 'x'));
+
+    for (int count : { 1, streams }) {
+        AudioLossRecovery recovery;
+        recovery.initialize(kSampleRate, kFrameSamples, count);
+
+        Totals totals = {};
+        Totals expected = {};
+        int pending = 0;
+        for (size_t i = 0; i < pattern.size(); i++) {
+            if (pattern[i] == 'x') {
+                recovery.packetLost();
+                pending++;
+                continue;
+            }
+
+            Packet wire;
+            buildMultistream(fecPackets[i], count, Framing::Compact, wire);
+            AudioLossRecovery::Plan plan = recovery.packetReceived(wire.data(), (int)wire.size());
+            totals.fec += plan.decodeFec ? 1 : 0;
+            totals.concealed += plan.concealedFrames;
+            totals.skipped += plan.skippedFrames;
+
+            if (pending > 0) {
+                bool lbrr = opus_packet_has_lbrr(fecPackets[i].data(), (opus_int32)fecPackets[i].size()) > 0;
+                ok &= require(plan.decodeFec == lbrr,
+                              QStringLiteral("packet %1 after a loss %2 LBRR but FEC was%3 chosen")
+                                  .arg(i).arg(lbrr ? "has" : "has no").arg(plan.decodeFec ? "" : " not"), err);
+                int recoverable = qMin(pending, 10);
+                expected.fec += lbrr ? 1 : 0;
+                expected.concealed += lbrr ? recoverable - 1 : recoverable;
+                expected.skipped += pending - recoverable;
+                pending = 0;
+            }
+        }
+
+        ok &= require(totals == expected,
+                      QStringLiteral("encoded stream replay with %1 streams gave %2, expected %3")
+                          .arg(count).arg(describe(totals)).arg(describe(expected)), err);
+        ok &= require(totals.fec > 0 && totals.concealed > 0 && totals.skipped == 5,
+                      QStringLiteral("encoded stream replay didn't cover FEC, PLC and gaps: %1").arg(describe(totals)), err);
+
+        out << "encoded_replay streams=" << count << ' ' << describe(totals) << '\n';
+    }
+
+    out << "encoded_packets checked=" << checked
+        << " fec_with_lbrr=" << fecWithLbrr << '/' << fecPackets.size()
+        << " multiframe_with_lbrr=" << multiframeWithLbrr
+        << " celt_with_lbrr=" << celtWithLbrr << '/' << celtPackets.size() << '\n';
+
+    opus_multistream_decoder_destroy(decoder);
+    return ok;
+}
+#else
+bool runEncoderChecks(QTextStream& out, QTextStream&)
+{
+    out << "encoded_packets=skipped (libopus is older than 1.5 and has no opus_packet_has_lbrr())\n";
+    return true;
+}
+#endif
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    out << "libopus=" << opus_get_version_string() << '\n';
+
+    bool ok = true;
+    ok &= runTraceChecks(out, err);
+    ok &= runEncoderChecks(out, err);
+
+    out << (ok ? "PASS\n" : "FAILED\n");
+    out.flush();
+    err.flush();
+    return ok ? 0 : 1;
+}
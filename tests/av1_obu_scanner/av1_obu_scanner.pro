@@ -0,0 +1,16 @@
+QT += core
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = av1_obu_scanner
+TEMPLATE = app
+
+INCLUDEPATH += \
+    $$PWD/../../app
+
+SOURCES += \
+    main.cpp \
+    ../../app/streaming/video/av1obu.cpp
+
+HEADERS += \
+    ../../app/streaming/video/av1obu.h
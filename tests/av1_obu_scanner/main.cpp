@@ -0,0 +1,425 @@
+#include "streaming/video/av1obu.h"
+
+#include <QByteArray>
+#include <QCoreApplication>
+#include <QFile>
+#include <QRandomGenerator>
+#include <QTextStream>
+#include <QVector>
+
+namespace {
+
+// OBU header bytes with obu_has_size_field set
+const char kTemporalDelimiter = 0x12;
+const char kSequenceHeader = 0x0A;
+const char kFrameHeader = 0x1A;
+const char kTileGroup = 0x22;
+const char kMetadata = 0x2A;
+const char kFrame = 0x32;
+
+// Bytes past the end of the buffer that the parser must never touch
+const int kGuardBytes = 32;
+const char kGuardByte = (char)0xA5;
+
+bool require(bool condition, const QString& message, QTextStream& err)
+{
+    if (!condition) {
+        err << "FAIL: " << message << '\n';
+    }
+    return condition;
+}
+
+void appendLeb128(QByteArray& out, quint64 value)
+{
+    do {
+        quint8 byte = value & 0x7F;
+        value >>= 7;
+        if (value != 0) {
+            byte |= 0x80;
+        }
+        out.append((char)byte);
+    } while (value != 0);
+}
+
+void appendObu(QByteArray& out, char header, const QByteArray& payload, char extension = 0)
+{
+    out.append(header);
+    if (header & 0x04) {
+        out.append(extension);
+    }
+    appendLeb128(out, payload.size());
+    out.append(payload);
+}
+
+QByteArray filler(int length, quint8 seed)
+{
+    QByteArray bytes(length, Qt::Uninitialized);
+    for (int i = 0; i < length; i++) {
+        bytes[i] = (char)(seed + i * 31);
+    }
+    return bytes;
+}
+
+QByteArray hdr10PlusPayload()
+{
+    // metadata_type 4 (ITU-T T.35), then the HDR10+ T.35 prefix and some
+    // ST 2094-40 bits
+    QByteArray payload = QByteArray::fromHex("04b5003c00010401");
+    payload.append(filler(20, 9));
+    return payload;
+}
+
+QByteArray frameHeaderPayload()
+{
+    QByteArray payload = filler(24, 7);
+    payload[payload.size() - 1] = 0x40; // Payload bits, then the trailing one bit
+    return payload;
+}
+
+// An HDR keyframe as NVENC sends it: the frame header and tile group split,
+// with HDR10+ and mastering display metadata between them
+QByteArray splitKeyframe()
+{
+    QByteArray tu;
+    appendObu(tu, kTemporalDelimiter, QByteArray());
+    appendObu(tu, kSequenceHeader, filler(12, 1));
+    appendObu(tu, kFrameHeader, frameHeaderPayload());
+    appendObu(tu, kMetadata, hdr10PlusPayload());
+    appendObu(tu, kMetadata, QByteArray::fromHex("02") + filler(24, 3));
+    appendObu(tu, kTileGroup, filler(300, 11));
+    return tu;
+}
+
+QByteArray mergedFrame()
+{
+    QByteArray tu;
+    appendObu(tu, kTemporalDelimiter, QByteArray());
+    appendObu(tu, kFrame, filler(200, 13));
+    return tu;
+}
+
+// The same split layout with extension headers, which carry the temporal and
+// spatial ids
+QByteArray layeredFrame()
+{
+    const char extension = (char)((2 << 5) | (1 << 3));
+
+    QByteArray tu;
+    appendObu(tu, kTemporalDelimiter, QByteArray());
+    appendObu(tu, kFrameHeader | 0x04, frameHeaderPayload(), extension);
+    appendObu(tu, kTileGroup | 0x04, filler(100, 5), extension);
+    return tu;
+}
+
+bool runStructureChecks(QTextStream& err)
+{
+    bool ok = true;
+
+    QByteArray tu = splitKeyframe();
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(tu.constData());
+    Av1TemporalUnitIndex index;
+    ok &= require(scanAv1TemporalUnit(data, tu.size(), &index) && index.count == 6,
+                  "split keyframe scans to six OBUs", err);
+    if (!ok) {
+        return false;
+    }
+
+    const int types[] = { AV1_OBU_TEMPORAL_DELIMITER, AV1_OBU_SEQUENCE_HEADER, AV1_OBU_FRAME_HEADER,
+                          AV1_OBU_METADATA, AV1_OBU_METADATA, AV1_OBU_TILE_GROUP };
+    int expectedOffset = 0;
+    for (int i = 0; i < index.count; i++) {
+        const Av1Obu& obu = index.obus[i];
+        ok &= require(obu.type == types[i], QStringLiteral("OBU %1 type").arg(i), err);
+        ok &= require(obu.headerOffset == expectedOffset, QStringLiteral("OBU %1 offset").arg(i), err);
+        ok &= require(obu.payloadOffset == obu.headerOffset + obu.headerLength,
+                      QStringLiteral("OBU %1 payload offset").arg(i), err);
+        expectedOffset = obu.payloadOffset + obu.payloadLength;
+    }
+    ok &= require(expectedOffset == tu.size(), "OBUs cover the temporal unit", err);
+    ok &= require(index.obus[5].payloadLength == 300 && index.obus[5].sizeBytes == 2,
+                  "tile group size", err);
+
+    ok &= require(findAv1Obu(&index, AV1_OBU_SEQUENCE_HEADER) == 1, "sequence header found", err);
+    ok &= require(findAv1Obu(&index, AV1_OBU_METADATA, 4) == 4, "search from a start index", err);
+    ok &= require(findAv1Obu(&index, AV1_OBU_FRAME) == -1, "missing type not found", err);
+
+    ok &= require(isAv1Hdr10PlusMetadata(data, &index.obus[3]), "HDR10+ T.35 metadata detected", err);
+    ok &= require(!isAv1Hdr10PlusMetadata(data, &index.obus[4]), "mastering display isn't HDR10+", err);
+    ok &= require(!isAv1Hdr10PlusMetadata(data, &index.obus[2]), "frame header isn't HDR10+", err);
+
+    // The repack from the index must match the original scan-and-repack, and
+    // leave the metadata ahead of a single merged frame
+    QByteArray viaIndex = tu;
+    QByteArray direct = tu;
+    int indexLength = repackAv1TemporalUnit(reinterpret_cast<uint8_t*>(viaIndex.data()), viaIndex.size(), &index);
+    int directLength = repackAv1TemporalUnit(reinterpret_cast<uint8_t*>(direct.data()), direct.size());
+    ok &= require(indexLength == directLength && viaIndex == direct, "indexed repack matches", err);
+
+    Av1TemporalUnitIndex repacked;
+    ok &= require(scanAv1TemporalUnit(reinterpret_cast<const uint8_t*>(viaIndex.constData()), indexLength, &repacked) &&
+                  repacked.count == 5 &&
+                  repacked.obus[2].type == AV1_OBU_METADATA &&
+                  repacked.obus[3].type == AV1_OBU_METADATA &&
+                  repacked.obus[4].type == AV1_OBU_FRAME,
+                  "repacked keyframe layout", err);
+
+    QByteArray merged = mergedFrame();
+    ok &= require(scanAv1TemporalUnit(reinterpret_cast<const uint8_t*>(merged.constData()), merged.size(), &index) &&
+                  index.count == 2 && index.obus[1].type == AV1_OBU_FRAME,
+                  "merged frame scans", err);
+
+    QByteArray layered = layeredFrame();
+    ok &= require(scanAv1TemporalUnit(reinterpret_cast<const uint8_t*>(layered.constData()), layered.size(), &index) &&
+                  index.count == 3 &&
+                  index.obus[1].temporalId == 2 && index.obus[1].spatialId == 1 &&
+                  index.obus[0].temporalId == 0 && index.obus[0].spatialId == 0,
+                  "temporal and spatial ids", err);
+
+    // Rejections: no size field, forbidden bit, truncated payload, too many OBUs
+    QByteArray noSize = QByteArray::fromHex("1000") + filler(8, 1);
+    QByteArray forbidden = QByteArray::fromHex("9200");
+    QByteArray truncated = tu.left(tu.size() - 1);
+    QByteArray tooMany;
+    for (int i = 0; i < AV1_MAX_OBUS + 1; i++) {
+        appendObu(tooMany, kMetadata, filler(4, i));
+    }
+    for (const QByteArray& bad : { noSize, forbidden, truncated, tooMany }) {
+        ok &= require(!scanAv1TemporalUnit(reinterpret_cast<const uint8_t*>(bad.constData()), bad.size(), &index),
+                      QStringLiteral("rejects %1").arg(QString::fromLatin1(bad.left(4).toHex())), err);
+    }
+
+    ok &= require(scanAv1TemporalUnit(nullptr, 0, &index) && index.count == 0, "empty temporal unit", err);
+
+    return ok;
+}
+
+// Checks one input against everything the scanner and repack promise, with
+// guard bytes after it to catch reads or writes past the end
+bool checkInvariants(const QByteArray& input, QString& failure)
+{
+    QByteArray guarded = input;
+    guarded.append(QByteArray(kGuardBytes, kGuardByte));
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(guarded.constData());
+
+    Av1TemporalUnitIndex index;
+    if (!scanAv1TemporalUnit(data, input.size(), &index)) {
+        return true;
+    }
+
+    if (index.count < 0 || index.count > AV1_MAX_OBUS) {
+        failure = "OBU count out of range";
+        return false;
+    }
+
+    int expectedOffset = 0;
+    for (int i = 0; i < index.count; i++) {
+        const Av1Obu& obu = index.obus[i];
+        if (obu.headerOffset != expectedOffset ||
+                obu.payloadOffset != obu.headerOffset + obu.headerLength ||
+                obu.payloadLength < 0 ||
+                obu.sizeBytes < 1 || obu.sizeBytes > 8 ||
+                obu.type > 15 || obu.temporalId > 7 || obu.spatialId > 3) {
+            failure = QStringLiteral("OBU %1 is inconsistent").arg(i);
+            return false;
+        }
+        expectedOffset = obu.payloadOffset + obu.payloadLength;
+    }
+    if (expectedOffset != input.size()) {
+        failure = "OBUs don't cover the input";
+        return false;
+    }
+
+    // Exercises the lookups on whatever was found
+    for (int i = 0; i < index.count; i++) {
+        isAv1Hdr10PlusMetadata(data, &index.obus[i]);
+    }
+
+    QByteArray viaIndex = guarded;
+    QByteArray direct = guarded;
+    int indexLength = repackAv1TemporalUnit(reinterpret_cast<uint8_t*>(viaIndex.data()), input.size(), &index);
+    int directLength = repackAv1TemporalUnit(reinterpret_cast<uint8_t*>(direct.data()), input.size());
+    if (indexLength != directLength || viaIndex != direct) {
+        failure = "indexed repack differs";
+        return false;
+    }
+    if (indexLength > input.size() || indexLength < 0) {
+        failure = "repack grew the temporal unit";
+        return false;
+    }
+    if (viaIndex.right(kGuardBytes) != QByteArray(kGuardBytes, kGuardByte)) {
+        failure = "repack wrote past the end";
+        return false;
+    }
+
+    // A rewrite must still be something the scanner (and a decoder) can walk
+    Av1TemporalUnitIndex repacked;
+    if (indexLength != input.size() &&
+            !scanAv1TemporalUnit(reinterpret_cast<const uint8_t*>(viaIndex.constData()), indexLength, &repacked)) {
+        failure = "repacked temporal unit doesn't scan";
+        return false;
+    }
+
+    return true;
+}
+
+QByteArray mutate(const QByteArray& seed, QRandomGenerator& random)
+{
+    QByteArray out = seed;
+    int mutations = 1 + random.bounded(4);
+    for (int m = 0; m < mutations; m++) {
+        switch (random.bounded(6)) {
+        case 0:
+            // Flip a bit, which is how header and leb128 bits go bad
+            if (!out.isEmpty()) {
+                int position = random.bounded(out.size());
+                out[position] = (char)(out[position] ^ (1 << random.bounded(8)));
+            }
+            break;
+        case 1:
+            // Overwrite a byte
+            if (!out.isEmpty()) {
+                out[random.bounded(out.size())] = (char)random.bounded(256);
+            }
+            break;
+        case 2:
+            out.truncate(random.bounded(out.size() + 1));
+            break;
+        case 3:
+            out.insert(random.bounded(out.size() + 1), (char)random.bounded(256));
+            break;
+        case 4:
+            // Duplicate a slice, which tends to produce well-formed OBUs in
+            // unexpected orders
+            if (!out.isEmpty()) {
+                int start = random.bounded(out.size());
+                int length = random.bounded(out.size() - start) + 1;
+                out.insert(random.bounded(out.size() + 1), out.mid(start, length));
+            }
+            break;
+        default:
+            // Make a leb128 size field over-long, which AV1 permits
+            for (int i = 0; i + 1 < out.size(); i++) {
+                if ((quint8)out[i] & 0x02 && !(out[i] & 0x80) && random.bounded(2) == 0) {
+                    out[i + 1] = (char)(out[i + 1] | 0x80);
+                    out.insert(i + 2, (char)0x00);
+                    break;
+                }
+            }
+            break;
+        }
+    }
+    return out;
+}
+
+bool runFuzz(const QVector<QByteArray>& seeds, int iterations, QTextStream& out, QTextStream& err)
+{
+    // Fixed seed, so a failure reproduces
+    QRandomGenerator random(0x41563101);
+    int accepted = 0;
+
+    for (int i = 0; i < iterations; i++) {
+        QByteArray input;
+        if (random.bounded(8) == 0) {
+            input = QByteArray(random.bounded(64), Qt::Uninitialized);
+            for (int j = 0; j < input.size(); j++) {
+                input[j] = (char)random.bounded(256);
+            }
+        }
+        else {
+            input = mutate(seeds[random.bounded(seeds.size())], random);
+        }
+
+        Av1TemporalUnitIndex index;
+        if (scanAv1TemporalUnit(reinterpret_cast<const uint8_t*>(input.constData()), input.size(), &index)) {
+            accepted++;
+        }
+
+        QString failure;
+        if (!checkInvariants(input, failure)) {
+            err << "FAIL: fuzz iteration " << i << ": " << failure << '\n'
+                << "  input: " << input.toHex() << '\n';
+            return false;
+        }
+    }
+
+    out << "Fuzzed " << iterations << " inputs, " << accepted << " scanned\n";
+    return true;
+}
+
+// Reads each frame of an IVF file, which is how AV1 streams are usually
+// recorded. Each frame is one temporal unit.
+bool readIvf(const QString& path, QVector<QByteArray>& temporalUnits, QTextStream& err)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        err << "FAIL: unable to open " << path << '\n';
+        return false;
+    }
+
+    QByteArray contents = file.readAll();
+    if (contents.size() < 32 || !contents.startsWith("DKIF")) {
+        err << "FAIL: " << path << " is not an IVF file\n";
+        return false;
+    }
+
+    const uchar* bytes = reinterpret_cast<const uchar*>(contents.constData());
+    int headerLength = bytes[6] | (bytes[7] << 8);
+    int position = headerLength;
+    while (position + 12 <= contents.size()) {
+        quint32 frameLength = bytes[position] | (bytes[position + 1] << 8) |
+                              (bytes[position + 2] << 16) | ((quint32)bytes[position + 3] << 24);
+        position += 12;
+        if (frameLength > (quint32)(contents.size() - position)) {
+            break;
+        }
+        temporalUnits.append(contents.mid(position, frameLength));
+        position += frameLength;
+    }
+
+    return true;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    bool ok = true;
+    ok &= runStructureChecks(err);
+
+    QVector<QByteArray> seeds = { splitKeyframe(), mergedFrame(), layeredFrame() };
+
+    // Recorded streams (IVF) to check and to seed the fuzzer with, if any
+    const QStringList streams = app.arguments().mid(1);
+    for (const QString& path : streams) {
+        QVector<QByteArray> temporalUnits;
+        ok &= readIvf(path, temporalUnits, err);
+
+        int scanned = 0;
+        for (const QByteArray& tu : std::as_const(temporalUnits)) {
+            Av1TemporalUnitIndex index;
+            if (scanAv1TemporalUnit(reinterpret_cast<const uint8_t*>(tu.constData()), tu.size(), &index)) {
+                scanned++;
+            }
+
+            QString failure;
+            ok &= require(checkInvariants(tu, failure), path + ": " + failure, err);
+        }
+        out << path << ": " << scanned << " of " << temporalUnits.size() << " temporal units scanned\n";
+
+        // Keep the fuzz corpus small enough that every seed gets mutated
+        for (int i = 0; i < temporalUnits.size() && i < 64; i++) {
+            seeds.append(temporalUnits[i]);
+        }
+    }
+
+    ok &= runFuzz(seeds, 200000, out, err);
+
+    out << (ok ? "PASS\n" : "FAILED\n");
+    out.flush();
+    err.flush();
+    return ok ? 0 : 1;
+}
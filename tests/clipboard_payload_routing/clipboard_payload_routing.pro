@@ -9,4 +9,10 @@ INCLUDEPATH += \
     $$PWD/../../app
 
 SOURCES += \
-    main.cpp
+    main.cpp \
+    ../../app/streaming/clipboardblobtransfer.cpp \
+    ../../app/streaming/clipboardipc.cpp
+
+HEADERS += \
+    ../../app/streaming/clipboardblobtransfer.h \
+    ../../app/streaming/clipboardipc.h
@@ -10,16 +10,21 @@ INCLUDEPATH += \
 
 SOURCES += \
     main.cpp \
+    ../../file-mapping/protocol/file_mapping_client.cpp \
     ../../file-mapping/vfs/remote_vfs.cpp \
+    ../../file-mapping/vfs/protocol_remote_vfs.cpp \
     ../../file-mapping/mount/mount_provider.cpp \
     ../../file-mapping/mount/mount_coordinator.cpp \
     ../../file-mapping/mount/macos_finder_mirror_provider.cpp \
+    ../../file-mapping/mount/mirror_sync_engine.cpp \
     ../../file-mapping/mount/windows_explorer_mirror_provider.cpp
 
 HEADERS += \
+    ../../file-mapping/protocol/file_mapping_client.h \
     ../../file-mapping/protocol/file_mapping_errors.h \
     ../../file-mapping/protocol/file_mapping_messages.h \
     ../../file-mapping/vfs/remote_vfs.h \
+    ../../file-mapping/vfs/protocol_remote_vfs.h \
     ../../file-mapping/vfs/vfs_handle.h \
     ../../file-mapping/vfs/vfs_item.h \
     ../../file-mapping/mount/mount_errors.h \
@@ -27,4 +32,5 @@ HEADERS += \
     ../../file-mapping/mount/mount_session.h \
     ../../file-mapping/mount/mount_coordinator.h \
     ../../file-mapping/mount/macos_finder_mirror_provider.h \
+    ../../file-mapping/mount/mirror_sync_engine.h \
     ../../file-mapping/mount/windows_explorer_mirror_provider.h
@@ -1,15 +1,26 @@
 #include "mount/macos_finder_mirror_provider.h"
+#include "mount/mirror_sync_engine.h"
 #include "mount/mount_coordinator.h"
 #include "mount/windows_explorer_mirror_provider.h"
+#include "protocol/file_mapping_client.h"
+#include "vfs/protocol_remote_vfs.h"
 #include "vfs/remote_vfs.h"
 
 #include <QCoreApplication>
+#include <QDateTime>
 #include <QDir>
+#include <QDirIterator>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QFileInfo>
 #include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QTemporaryDir>
 #include <QTextStream>
+#include <QThread>
 
+#include <memory>
 #include <utility>
 
 using namespace FileMapping;
@@ -62,6 +73,7 @@ public:
         }
         result.handle.id = ++m_NextHandleId;
         result.handle.item = m_Items.value(itemId.value);
+        ++m_Opens;
         return result;
     }
 
@@ -80,6 +92,37 @@ public:
     {
     }
 
+    int opens() const
+    {
+        return m_Opens;
+    }
+
+    void replaceFile(const QString& itemId, const QByteArray& data)
+    {
+        VfsItem& item = m_Items[itemId];
+        item.size = static_cast<quint64>(data.size());
+        m_Data.insert(itemId, data);
+
+        QList<VfsItem>& siblings = m_Children[item.parentId.value];
+        for (VfsItem& sibling : siblings) {
+            if (sibling.id.value == itemId) {
+                sibling = item;
+            }
+        }
+    }
+
+    void removeFile(const QString& itemId)
+    {
+        const VfsItem item = m_Items.take(itemId);
+        QList<VfsItem>& siblings = m_Children[item.parentId.value];
+        for (int i = siblings.size() - 1; i >= 0; --i) {
+            if (siblings[i].id.value == itemId) {
+                siblings.removeAt(i);
+            }
+        }
+        m_Data.remove(itemId);
+    }
+
 private:
     static VfsItemId id(const QString& value)
     {
@@ -113,6 +156,145 @@ private:
     QHash<QString, QList<VfsItem>> m_Children;
     QHash<QString, QByteArray> m_Data;
     quint64 m_NextHandleId = 0;
+    int m_Opens = 0;
+};
+
+// A 10k-file tree served with a simulated network round trip on every
+// request, for timing cold and warm syncs through ProtocolRemoteVfs
+class SyntheticProtocolClient : public ProtocolClient
+{
+public:
+    static const int kDirectories = 100;
+    static const int kFilesPerDirectory = 100;
+    static const unsigned long kLatencyUs = 300;
+
+    explicit SyntheticProtocolClient(int maxConcurrentRequests)
+        : m_MaxConcurrentRequests(maxConcurrentRequests),
+          m_BaseTime(QDateTime::fromMSecsSinceEpoch(1700000000000LL))
+    {
+    }
+
+    Capability fetchCapability(int) override
+    {
+        Capability capability;
+        capability.available = true;
+        capability.enabled = true;
+        capability.listening = true;
+        return capability;
+    }
+
+    Error connectSession(const Capability&, int) override
+    {
+        return Error::none();
+    }
+
+    QList<RemoteMapping> mappings() const override
+    {
+        RemoteMapping mapping;
+        mapping.id = QStringLiteral("synthetic");
+        mapping.displayName = QStringLiteral("Synthetic");
+        return { mapping };
+    }
+
+    ListResult list(const QString& mappingId, const QString& path, int) override
+    {
+        QThread::usleep(kLatencyUs);
+
+        ListResult result;
+        if (path.isEmpty()) {
+            for (int dir = 0; dir < kDirectories; ++dir) {
+                RemoteEntry entry;
+                entry.mappingId = mappingId;
+                entry.path = QStringLiteral("folder %1").arg(dir);
+                entry.displayName = entry.path;
+                entry.directory = true;
+                result.entries.append(entry);
+            }
+        }
+        else {
+            const int dir = path.mid(7).toInt();
+            for (int file = 0; file < kFilesPerDirectory; ++file) {
+                result.entries.append(fileEntry(dir * kFilesPerDirectory + file));
+            }
+        }
+        return result;
+    }
+
+    StatResult stat(const QString&, const QString& path, int) override
+    {
+        QThread::usleep(kLatencyUs);
+
+        const RemoteEntry entry = fileEntry(fileIndex(path));
+        StatResult result;
+        result.stat.exists = true;
+        result.stat.size = entry.size;
+        result.stat.modifiedAt = entry.modifiedAt;
+        return result;
+    }
+
+    ReadResult read(const QString&, const QString& path, quint64 offset, quint32 length, int) override
+    {
+        QThread::usleep(kLatencyUs);
+
+        ReadResult result;
+        const QByteArray data = fileData(fileIndex(path));
+        if (offset < static_cast<quint64>(data.size())) {
+            result.data = data.mid(static_cast<int>(offset), static_cast<int>(length));
+        }
+        return result;
+    }
+
+    int maxConcurrentRequests() const override
+    {
+        return m_MaxConcurrentRequests;
+    }
+
+    // Simulates an edit on the host
+    void touch(int index)
+    {
+        QMutexLocker locker(&m_Lock);
+        ++m_Generations[index];
+    }
+
+    static int fileCount()
+    {
+        return kDirectories * kFilesPerDirectory;
+    }
+
+    QByteArray fileData(int index) const
+    {
+        const int generation = this->generation(index);
+        return QByteArray(512 + (index * 37) % 4096 + generation, static_cast<char>('a' + (index + generation) % 26));
+    }
+
+private:
+    // Paths look like "folder 42/file 4242.txt"
+    static int fileIndex(const QString& path)
+    {
+        return path.section(QLatin1Char('/'), 1).mid(5).chopped(4).toInt();
+    }
+
+    int generation(int index) const
+    {
+        QMutexLocker locker(&m_Lock);
+        return m_Generations.value(index);
+    }
+
+    RemoteEntry fileEntry(int index) const
+    {
+        RemoteEntry entry;
+        entry.mappingId = QStringLiteral("synthetic");
+        entry.displayName = QStringLiteral("file %1.txt").arg(index);
+        entry.path = QStringLiteral("folder %1/%2").arg(index / kFilesPerDirectory).arg(entry.displayName);
+        entry.size = static_cast<quint64>(fileData(index).size());
+        entry.modifiedAt = m_BaseTime.addSecs(generation(index));
+        return entry;
+    }
+
+    int m_MaxConcurrentRequests;
+    QDateTime m_BaseTime;
+    mutable QMutex m_Lock;
+    QHash<int, int> m_Generations;
 };
 
 class CountingMountProvider : public MountProvider
@@ -201,6 +383,79 @@ bool require(bool condition, const QString& message, QTextStream& err)
     return condition;
 }
 
+int countFiles(const QString& rootPath)
+{
+    int count = 0;
+    QDirIterator it(rootPath, QDir::Files | QDir::Hidden, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        ++count;
+    }
+    return count;
+}
+
+bool verifySyntheticTreeSync(QTextStream& out, QTextStream& err)
+{
+    MirrorLimits limits;
+    limits.maxFiles = 20000;
+
+    bool ok = true;
+    const int files = SyntheticProtocolClient::fileCount();
+    qint64 coldMs[2] = {};
+    qint64 warmMs[2] = {};
+    qint64 changedMs = 0;
+    for (int pipelined = 0; pipelined < 2; ++pipelined) {
+        QTemporaryDir dir;
+        auto client = std::make_shared<SyntheticProtocolClient>(pipelined ? limits.workers + 1 : 1);
+        ProtocolRemoteVfs vfs(client);
+
+        QElapsedTimer timer;
+        timer.start();
+        MirrorSyncEngine cold(vfs, dir.path(), limits);
+        ok &= require(cold.sync({}).ok(), QStringLiteral("cold sync failed"), err);
+        coldMs[pipelined] = timer.elapsed();
+        ok &= require(cold.stats().filesFetched == files, QStringLiteral("cold sync fetched %1 files").arg(cold.stats().filesFetched), err);
+        ok &= require(countFiles(dir.path()) == files + 1, QStringLiteral("cold sync left %1 files").arg(countFiles(dir.path())), err);
+
+        QByteArray data;
+        ok &= require(readAll(QDir(dir.path()).filePath(QStringLiteral("Synthetic/folder 42/file 4242.txt")), data) &&
+                      data == client->fileData(4242),
+                      QStringLiteral("synthetic file contents mismatch"), err);
+
+        timer.restart();
+        MirrorSyncEngine warm(vfs, dir.path(), limits);
+        ok &= require(warm.sync({}).ok(), QStringLiteral("warm sync failed"), err);
+        warmMs[pipelined] = timer.elapsed();
+        ok &= require(warm.stats().filesFetched == 0 && warm.stats().filesUnchanged == files,
+                      QStringLiteral("warm sync fetched %1 files").arg(warm.stats().filesFetched), err);
+
+        if (!pipelined) {
+            continue;
+        }
+
+        for (int i = 0; i < 10; ++i) {
+            client->touch(i * 997);
+        }
+        timer.restart();
+        MirrorSyncEngine changed(vfs, dir.path(), limits);
+        ok &= require(changed.sync({}).ok(), QStringLiteral("incremental sync failed"), err);
+        changedMs = timer.elapsed();
+        ok &= require(changed.stats().filesFetched == 10, QStringLiteral("incremental sync fetched %1 files").arg(changed.stats().filesFetched), err);
+        ok &= require(readAll(QDir(dir.path()).filePath(QStringLiteral("Synthetic/folder 9/file 997.txt")), data) &&
+                      data == client->fileData(997),
+                      QStringLiteral("changed file was not refreshed"), err);
+    }
+
+    out << "synthetic_files=" << files
+        << " cold_serial_ms=" << coldMs[0]
+        << " cold_pipelined_ms=" << coldMs[1]
+        << " warm_serial_ms=" << warmMs[0]
+        << " warm_pipelined_ms=" << warmMs[1]
+        << " changed_10_ms=" << changedMs << '\n';
+
+    return ok;
+}
+
 bool verifyCoordinatorStopsAfterNativeMount(const MountRequest& request, QTextStream& err)
 {
     auto nativeProvider = std::make_shared<CountingMountProvider>(QStringLiteral("native Finder provider"), true);
@@ -274,9 +529,31 @@ int main(int argc, char* argv[])
         out << "reveal=" << (reveal.ok() ? QStringLiteral("passed") : QStringLiteral("failed")) << '\n';
     }
 
+    // A re-mount only fetches what changed on the host
+    coordinator.unmount(request.hostUuid, request.sessionId);
+    ok &= require(QFileInfo::exists(QDir(docs).filePath(QStringLiteral("hello.txt"))), QStringLiteral("snapshot was not kept after unmount"), err);
+
+    const int opensBeforeWarm = vfs->opens();
+    result = coordinator.ensureMounted(request);
+    ok &= require(result.ok() && result.status.displayPath == rootPath, QStringLiteral("warm re-mount failed: %1").arg(result.error.message), err);
+    ok &= require(vfs->opens() == opensBeforeWarm, QStringLiteral("warm re-mount fetched unchanged files"), err);
+    ok &= require(readAll(QDir(docs).filePath(QStringLiteral("nested/deep.txt")), data) && data == QByteArray("deep contents\n"), QStringLiteral("warm re-mount lost nested/deep.txt"), err);
+
+    coordinator.unmount(request.hostUuid, request.sessionId);
+    vfs->replaceFile(QStringLiteral("hello"), "hello again from host\n");
+    vfs->removeFile(QStringLiteral("deep"));
+    const int opensBeforeChange = vfs->opens();
+    result = coordinator.ensureMounted(request);
+    ok &= require(result.ok(), QStringLiteral("re-mount after host changes failed: %1").arg(result.error.message), err);
+    ok &= require(vfs->opens() == opensBeforeChange + 1, QStringLiteral("re-mount fetched %1 files instead of 1").arg(vfs->opens() - opensBeforeChange), err);
+    ok &= require(readAll(QDir(docs).filePath(QStringLiteral("hello.txt")), data) && data == QByteArray("hello again from host\n"), QStringLiteral("changed hello.txt was not refreshed"), err);
+    ok &= require(!QFileInfo::exists(QDir(docs).filePath(QStringLiteral("nested/deep.txt"))), QStringLiteral("file removed on host is still in the snapshot"), err);
+
+    ok &= verifySyntheticTreeSync(out, err);
+
     if (!keepSnapshot) {
         coordinator.unmount(request.hostUuid, request.sessionId);
-        ok &= require(!QFileInfo::exists(rootPath), QStringLiteral("snapshot folder was not removed on unmount"), err);
+        QDir(rootPath).removeRecursively();
     }
 
     if (!ok) {
@@ -10,7 +10,9 @@ INCLUDEPATH += \
 
 SOURCES += \
     main.cpp \
+    ../../app/streaming/filemappingrpcchannel.cpp \
     ../../app/streaming/filemappingwebsocket.cpp
 
 HEADERS += \
+    ../../app/streaming/filemappingrpcchannel.h \
     ../../app/streaming/filemappingwebsocket.h
@@ -1,8 +1,16 @@
+#include "streaming/filemappingrpcchannel.h"
 #include "streaming/filemappingwebsocket.h"
 
+#include <QAtomicInt>
 #include <QCoreApplication>
+#include <QJsonDocument>
 #include <QList>
+#include <QSemaphore>
+#include <QSslSocket>
+#include <QTcpServer>
+#include <QTcpSocket>
 #include <QTextStream>
+#include <QThread>
 
 namespace {
 QByteArray serverFrame(bool fin, quint8 opcode, const QByteArray& payload)
@@ -43,6 +51,86 @@ bool readMessage(QByteArray& buffer, QByteArray& out, QString& error, QList<QByt
     error = reader.read(buffer, out, needMore, pongPayloads);
     return error.isEmpty() && !needMore;
 }
+// Several threads call at once through one channel, and a stand-in host
+// answers newest first. Every caller must still get its own reply.
+bool verifyPipelinedCalls(QTextStream& err)
+{
+    const int calls = 4;
+    QSemaphore listening;
+    quint16 port = 0;
+
+    QThread* host = QThread::create([&listening, &port, calls]() {
+        QTcpServer server;
+        server.listen(QHostAddress::LocalHost);
+        port = server.serverPort();
+        listening.release();
+        if (!server.waitForNewConnection(5000)) {
+            return;
+        }
+
+        QTcpSocket* socket = server.nextPendingConnection();
+        QByteArray buffer;
+        QList<QJsonObject> requests;
+        while (requests.size() < calls && socket->waitForReadyRead(5000)) {
+            buffer += socket->readAll();
+            FileMappingWebSocket::Frame frame;
+            bool needMore = false;
+            while (FileMappingWebSocket::takeFrame(buffer, frame, needMore).isEmpty() && !needMore) {
+                requests.append(QJsonDocument::fromJson(frame.payload).object());
+            }
+        }
+
+        for (int i = requests.size() - 1; i >= 0; --i) {
+            const QJsonObject reply {
+                { QStringLiteral("type"), QStringLiteral("result") },
+                { QStringLiteral("id"), requests[i].value(QStringLiteral("id")) },
+                { QStringLiteral("n"), requests[i].value(QStringLiteral("n")) }
+            };
+            socket->write(serverFrame(true, 0x1, QJsonDocument(reply).toJson(QJsonDocument::Compact)));
+        }
+        socket->waitForBytesWritten(5000);
+
+        // Stay up until the client hangs up
+        socket->waitForDisconnected(5000);
+    });
+    host->start();
+    listening.acquire();
+
+    bool ok = true;
+    QSslSocket* socket = new QSslSocket();
+    socket->connectToHost(QHostAddress(QHostAddress::LocalHost), port);
+    ok &= require(socket->waitForConnected(5000), QStringLiteral("could not connect to the stand-in host"), err);
+
+    QAtomicInt matched;
+    {
+        FileMappingRpcChannel channel(socket, QByteArray());
+        QList<QThread*> callers;
+        for (int i = 0; i < calls; ++i) {
+            callers.append(QThread::create([&channel, &matched, i]() {
+                QJsonObject reply;
+                const QJsonObject request {
+                    { QStringLiteral("type"), QStringLiteral("stat") },
+                    { QStringLiteral("n"), i }
+                };
+                if (channel.call(request, reply, 5000) && reply.value(QStringLiteral("n")).toInt(-1) == i) {
+                    matched.ref();
+                }
+            }));
+            callers.last()->start();
+        }
+        for (QThread* caller : callers) {
+            caller->wait();
+            delete caller;
+        }
+    }
+
+    host->wait();
+    delete host;
+
+    ok &= require(matched.loadAcquire() == calls,
+                  QStringLiteral("%1 of %2 pipelined calls got their own reply").arg(matched.loadAcquire()).arg(calls), err);
+    return ok;
+}
 } // namespace
 
 int main(int argc, char* argv[])
@@ -97,6 +185,8 @@ int main(int argc, char* argv[])
     ok &= require(error.isEmpty() && !needMore, QStringLiteral("incremental read failed: %1").arg(error), err);
     ok &= require(payload == R"({"type":"result"})", QStringLiteral("incremental payload mismatch"), err);
 
+    ok &= verifyPipelinedCalls(err);
+
     if (!ok) {
         return 1;
     }
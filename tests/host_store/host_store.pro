@@ -0,0 +1,30 @@
+QT += core network
+CONFIG += c++17 console link_pkgconfig
+CONFIG -= app_bundle
+
+TARGET = host_store
+TEMPLATE = app
+
+PKGCONFIG += openssl
+
+INCLUDEPATH += \
+    $$PWD/../../app \
+    $$PWD/../../moonlight-common-c/moonlight-common-c/src
+
+SOURCES += \
+    main.cpp \
+    ../../app/path.cpp \
+    ../../app/backend/hoststore.cpp \
+    ../../app/backend/identitymanager.cpp \
+    ../../app/backend/nvaddress.cpp \
+    ../../app/backend/nvapp.cpp \
+    ../../app/backend/nvcomputer.cpp \
+    ../../app/backend/nvhttp.cpp \
+    ../../app/backend/nvxmlparser.cpp \
+    ../../app/settings/compatfetcher.cpp
+
+HEADERS += \
+    ../../app/backend/hoststore.h \
+    ../../app/backend/nvcomputer.h \
+    ../../app/backend/nvhttp.h \
+    ../../app/settings/compatfetcher.h
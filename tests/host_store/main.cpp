@@ -0,0 +1,289 @@
+#include "backend/hoststore.h"
+#include "path.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QSettings>
+#include <QTemporaryDir>
+#include <QTextStream>
+
+// NvHTTP::startApp() is the only caller and it is never reached here
+extern "C" const char* LiGetLaunchUrlQueryParameters(void)
+{
+    return "";
+}
+
+namespace {
+bool require(bool condition, const QString& message, QTextStream& err)
+{
+    if (!condition) {
+        err << "FAIL: " << message << '\n';
+    }
+    return condition;
+}
+
+struct HostSpec
+{
+    QString name;
+    QString uuid;
+    int appCount;
+};
+
+NvComputer makeHost(const HostSpec& spec)
+{
+    NvComputer computer;
+    computer.name = spec.name;
+    computer.uuid = spec.uuid;
+    computer.hasCustomName = false;
+    computer.isNvidiaServerSoftware = false;
+    computer.localAddress = NvAddress(QStringLiteral("192.168.1.20"), 47989);
+    computer.macAddress = QByteArray::fromHex("0c9d92415a7e");
+    for (int i = 0; i < spec.appCount; i++) {
+        NvApp app;
+        app.id = 1000 + i;
+        app.name = QStringLiteral("App %1").arg(i);
+        computer.appList.append(app);
+    }
+    return computer;
+}
+
+const HostSpec HOSTS[] = {
+    { QStringLiteral("Living Room"), QStringLiteral("5D1C7A4E-92B3-4F0A-8E61-3B7C2D9F0A14"), 12 },
+    { QStringLiteral("Office"), QStringLiteral("0A3F7B22-6C1D-4E8B-9F20-1D5E8C3A7B60"), 3 },
+    { QStringLiteral("Laptop"), QStringLiteral("E7B4C9D1-2A6F-4B3E-8C5D-9F1A0B2C3D4E"), 0 },
+};
+
+QString storePath()
+{
+    return Path::getDataDir() + QStringLiteral("/hosts.db");
+}
+
+QString corruptPath()
+{
+    return storePath() + QStringLiteral(".corrupt");
+}
+
+void reset()
+{
+    QFile::remove(storePath());
+    QFile::remove(corruptPath());
+    QSettings().clear();
+}
+
+void writeLegacyHosts(const QList<HostSpec>& specs)
+{
+    QSettings settings;
+    settings.beginWriteArray(QStringLiteral("hosts"));
+    for (int i = 0; i < specs.count(); i++) {
+        settings.setArrayIndex(i);
+        settings.setValue(QStringLiteral("hostname"), specs[i].name);
+        settings.setValue(QStringLiteral("uuid"), specs[i].uuid);
+    }
+    settings.endArray();
+    settings.sync();
+}
+
+int legacyHostCount()
+{
+    QSettings settings;
+    int count = settings.beginReadArray(QStringLiteral("hosts"));
+    settings.endArray();
+    return count;
+}
+
+void writeStore(int hostCount)
+{
+    HostStore store;
+    qDeleteAll(store.load());
+    for (int i = 0; i < hostCount; i++) {
+        store.updateHost(makeHost(HOSTS[i]), true);
+    }
+    store.commit();
+}
+
+QByteArray readFile(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return {};
+    }
+    return file.readAll();
+}
+
+void writeFile(const QString& path, const QByteArray& data)
+{
+    QFile file(path);
+    if (file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        file.write(data);
+    }
+}
+
+const NvComputer* findHost(const QVector<NvComputer*>& hosts, const QString& uuid)
+{
+    for (const NvComputer* computer : hosts) {
+        if (computer->uuid == uuid) {
+            return computer;
+        }
+    }
+    return nullptr;
+}
+
+bool runRoundTripChecks(QTextStream& out, QTextStream& err)
+{
+    bool ok = true;
+    reset();
+
+    writeStore(3);
+
+    HostStore store;
+    QVector<NvComputer*> hosts = store.load();
+    ok &= require(hosts.count() == 3, "round trip should load 3 hosts", err);
+    for (const HostSpec& spec : HOSTS) {
+        const NvComputer* computer = findHost(hosts, spec.uuid);
+        ok &= require(computer != nullptr, "round trip lost " + spec.name, err);
+        if (computer != nullptr) {
+            ok &= require(computer->name == spec.name, "round trip changed the name of " + spec.name, err);
+            ok &= require(computer->appList.count() == spec.appCount, "round trip changed the apps of " + spec.name, err);
+            ok &= require(computer->localAddress.address() == QStringLiteral("192.168.1.20") &&
+                          computer->localAddress.port() == 47989,
+                          "round trip changed the address of " + spec.name, err);
+        }
+    }
+
+    // Removing a host and committing again must drop just that host
+    store.removeHost(HOSTS[1].uuid);
+    ok &= require(store.commit(), "commit after removal failed", err);
+    qDeleteAll(hosts);
+
+    HostStore reloaded;
+    hosts = reloaded.load();
+    ok &= require(hosts.count() == 2 && findHost(hosts, HOSTS[1].uuid) == nullptr,
+                  "removed host should be gone after reload", err);
+    ok &= require(!QFile::exists(corruptPath()), "a healthy store should not be set aside", err);
+    qDeleteAll(hosts);
+
+    out << "round_trip " << (ok ? "ok" : "failed") << '\n';
+    return ok;
+}
+
+bool runMigrationChecks(QTextStream& out, QTextStream& err)
+{
+    bool ok = true;
+    reset();
+
+    writeLegacyHosts({ HOSTS[0], HOSTS[1] });
+
+    HostStore store;
+    QVector<NvComputer*> hosts = store.load();
+    ok &= require(hosts.count() == 2, "migration should import 2 hosts", err);
+    ok &= require(QFile::exists(storePath()), "migration should write the store", err);
+    ok &= require(legacyHostCount() == 2, "migration must keep the legacy hosts for downgrades", err);
+    qDeleteAll(hosts);
+
+    // Once the store exists, the legacy copy is no longer consulted
+    writeLegacyHosts({ HOSTS[0], HOSTS[1], HOSTS[2] });
+    HostStore reloaded;
+    hosts = reloaded.load();
+    ok &= require(hosts.count() == 2, "a healthy store should win over the legacy hosts", err);
+    qDeleteAll(hosts);
+
+    out << "migration " << (ok ? "ok" : "failed") << '\n';
+    return ok;
+}
+
+bool runCorruptChecks(QTextStream& out, QTextStream& err)
+{
+    bool ok = true;
+    const QByteArray garbage("this is not a host store");
+
+    // With a legacy copy, the hosts come back from it
+    reset();
+    writeLegacyHosts({ HOSTS[0], HOSTS[2] });
+    writeFile(storePath(), garbage);
+    {
+        HostStore store;
+        QVector<NvComputer*> hosts = store.load();
+        ok &= require(hosts.count() == 2, "corrupt store should fall back to the legacy hosts", err);
+        ok &= require(readFile(corruptPath()) == garbage, "corrupt store should be renamed aside", err);
+        qDeleteAll(hosts);
+
+        HostStore reloaded;
+        hosts = reloaded.load();
+        ok &= require(hosts.count() == 2, "recovered hosts should be written to a new store", err);
+        qDeleteAll(hosts);
+    }
+
+    // Without one, the next commit must not destroy the original
+    reset();
+    writeFile(storePath(), garbage);
+    {
+        HostStore store;
+        QVector<NvComputer*> hosts = store.load();
+        ok &= require(hosts.isEmpty(), "corrupt store without legacy hosts should load nothing", err);
+        store.updateHost(makeHost(HOSTS[1]), true);
+        ok &= require(store.commit(), "commit after setting the corrupt store aside failed", err);
+        ok &= require(readFile(corruptPath()) == garbage, "commit must not touch the set-aside store", err);
+        qDeleteAll(hosts);
+    }
+
+    out << "corrupt " << (ok ? "ok" : "failed") << '\n';
+    return ok;
+}
+
+bool runTruncatedChecks(QTextStream& out, QTextStream& err)
+{
+    bool ok = true;
+    reset();
+
+    writeStore(3);
+    QByteArray full = readFile(storePath());
+    QByteArray truncated = full.left(full.size() - 16);
+    writeFile(storePath(), truncated);
+
+    // The last host only survives through the legacy copy
+    writeLegacyHosts({ HOSTS[0], HOSTS[2] });
+
+    HostStore store;
+    QVector<NvComputer*> hosts = store.load();
+    ok &= require(hosts.count() == 3, "truncated store should keep its hosts and recover the rest", err);
+    for (const HostSpec& spec : HOSTS) {
+        ok &= require(findHost(hosts, spec.uuid) != nullptr, "truncated store lost " + spec.name, err);
+    }
+    ok &= require(readFile(corruptPath()) == truncated, "truncated store should be copied aside", err);
+    qDeleteAll(hosts);
+
+    out << "truncated " << (ok ? "ok" : "failed") << '\n';
+    return ok;
+}
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    QTemporaryDir dir;
+    if (!dir.isValid()) {
+        err << "FAIL: could not create a temporary directory\n";
+        return 1;
+    }
+
+    // Keep both the store and the legacy settings inside the temp dir
+    QCoreApplication::setOrganizationName(QStringLiteral("HostStoreTest"));
+    QCoreApplication::setApplicationName(QStringLiteral("host_store"));
+    QSettings::setDefaultFormat(QSettings::IniFormat);
+    QSettings::setPath(QSettings::IniFormat, QSettings::UserScope, dir.path());
+    Path::initialize(true, dir.path());
+
+    bool ok = true;
+    ok &= runRoundTripChecks(out, err);
+    ok &= runMigrationChecks(out, err);
+    ok &= runCorruptChecks(out, err);
+    ok &= runTruncatedChecks(out, err);
+
+    out << (ok ? "PASS\n" : "FAILED\n");
+    out.flush();
+    err.flush();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,575 @@
+#include "streaming/session.h"
+#include "streaming/video/ffmpeg.h"
+#include "streaming/video/ffmpeg-renderers/nullrenderer.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QQueue>
+#include <QStringList>
+#include <QTextStream>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+
+#include <chrono>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavcodec/bsf.h>
+#include <libavformat/avformat.h>
+#include <libavutil/opt.h>
+#include <libavutil/pixdesc.h>
+}
+
+namespace {
+bool require(bool condition, const QString& message, QTextStream& err)
+{
+    if (!condition) {
+        err << "FAIL: " << message << '\n';
+    }
+    return condition;
+}
+
+struct Packet {
+    QByteArray data;
+    bool keyframe;
+};
+
+struct Stream {
+    QString name;
+    int videoFormat = 0;
+    int width = 0;
+    int height = 0;
+    int fps = 0;
+    QVector<Packet> packets;
+};
+
+// A frame waiting in the fake connection's queue. The handle we give the
+// decoder is the frame itself.
+struct QueuedFrame {
+    DECODE_UNIT du;
+    LENTRY entry;
+    QByteArray data;
+};
+
+// Stands in for moonlight-common-c's decode unit queue, which the decoder
+// thread pulls from exactly as it would during a stream
+class FakeVideoQueue
+{
+public:
+    void push(const Packet& packet, int frameNumber, uint32_t rtpTimestamp, uint64_t nowUs)
+    {
+        QueuedFrame* frame = new QueuedFrame();
+        frame->data = packet.data;
+
+        SDL_zero(frame->entry);
+        frame->entry.data = frame->data.data();
+        frame->entry.length = frame->data.size();
+        frame->entry.bufferType = BUFFER_TYPE_PICDATA;
+
+        SDL_zero(frame->du);
+        frame->du.frameNumber = frameNumber;
+        frame->du.frameType = packet.keyframe ? FRAME_TYPE_IDR : FRAME_TYPE_PFRAME;
+        frame->du.receiveTimeUs = nowUs;
+        frame->du.enqueueTimeUs = nowUs;
+        frame->du.rtpTimestamp = rtpTimestamp;
+        frame->du.fullLength = frame->data.size();
+        frame->du.bufferList = &frame->entry;
+
+        QMutexLocker locker(&m_Lock);
+        m_Pending.enqueue(frame);
+        m_Changed.wakeAll();
+    }
+
+    bool next(VIDEO_FRAME_HANDLE* handle, PDECODE_UNIT* du, bool wait)
+    {
+        QMutexLocker locker(&m_Lock);
+        while (wait && m_Pending.isEmpty() && !m_Woken) {
+            m_Changed.wait(&m_Lock);
+        }
+        m_Woken = false;
+
+        if (m_Pending.isEmpty()) {
+            return false;
+        }
+
+        QueuedFrame* frame = m_Pending.dequeue();
+        *handle = frame;
+        *du = &frame->du;
+        return true;
+    }
+
+    void wake()
+    {
+        QMutexLocker locker(&m_Lock);
+        m_Woken = true;
+        m_Changed.wakeAll();
+    }
+
+    void complete(VIDEO_FRAME_HANDLE handle, int status)
+    {
+        delete static_cast<QueuedFrame*>(handle);
+
+        QMutexLocker locker(&m_Lock);
+        m_Completed++;
+        if (status != DR_OK) {
+            m_Failed++;
+        }
+    }
+
+    void requestIdr()
+    {
+        QMutexLocker locker(&m_Lock);
+        m_IdrRequests++;
+    }
+
+    // Drops whatever the decoder didn't take and clears the counters
+    void reset()
+    {
+        QMutexLocker locker(&m_Lock);
+        qDeleteAll(m_Pending);
+        m_Pending.clear();
+        m_Woken = false;
+        m_Completed = m_Failed = m_IdrRequests = 0;
+    }
+
+    int completed()
+    {
+        QMutexLocker locker(&m_Lock);
+        return m_Completed;
+    }
+
+    int failed()
+    {
+        QMutexLocker locker(&m_Lock);
+        return m_Failed;
+    }
+
+    int idrRequests()
+    {
+        QMutexLocker locker(&m_Lock);
+        return m_IdrRequests;
+    }
+
+private:
+    QMutex m_Lock;
+    QWaitCondition m_Changed;
+    QQueue<QueuedFrame*> m_Pending;
+    bool m_Woken = false;
+    int m_Completed = 0;
+    int m_Failed = 0;
+    int m_IdrRequests = 0;
+};
+
+FakeVideoQueue s_VideoQueue;
+}
+
+// The parts of moonlight-common-c the decoder uses, backed by the fake
+// queue so the test doesn't need a host
+extern "C" uint64_t LiGetMicroseconds(void)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+extern "C" bool LiWaitForNextVideoFrame(VIDEO_FRAME_HANDLE* frameHandle, PDECODE_UNIT* decodeUnit)
+{
+    return s_VideoQueue.next(frameHandle, decodeUnit, true);
+}
+
+extern "C" bool LiPollNextVideoFrame(VIDEO_FRAME_HANDLE* frameHandle, PDECODE_UNIT* decodeUnit)
+{
+    return s_VideoQueue.next(frameHandle, decodeUnit, false);
+}
+
+extern "C" void LiWakeWaitForVideoFrame(void)
+{
+    s_VideoQueue.wake();
+}
+
+extern "C" void LiCompleteVideoFrame(VIDEO_FRAME_HANDLE handle, int drStatus)
+{
+    s_VideoQueue.complete(handle, drStatus);
+}
+
+extern "C" void LiRequestIdrFrame(void)
+{
+    s_VideoQueue.requestIdr();
+}
+
+extern "C" bool LiGetEstimatedRttInfo(uint32_t*, uint32_t*)
+{
+    return false;
+}
+
+extern "C" bool LiGetCurrentHostDisplayHdrMode(void)
+{
+    return false;
+}
+
+extern "C" bool LiGetHdrMetadata(PSS_HDR_METADATA)
+{
+    return false;
+}
+
+// There's no Session while the decoder runs headless, so these are never
+// called. They only have to exist for the decoder and SdlRenderer to link.
+Session* Session::s_ActiveSession = nullptr;
+void Session::flushWindowEvents() {}
+void Session::notifyFirstFrameDecoded() {}
+bool Session::getAudioStats(AUDIO_STATS&) { return false; }
+void Session::submitClientAbrSample(const AbrController::Sample&) {}
+
+bool Overlay::OverlayManager::isOverlayEnabled(OverlayType) { return false; }
+char* Overlay::OverlayManager::getOverlayText(OverlayType) { return nullptr; }
+int Overlay::OverlayManager::getOverlayMaxTextLength() { return 0; }
+void Overlay::OverlayManager::setOverlayTextUpdated(OverlayType) {}
+SDL_Surface* Overlay::OverlayManager::getUpdatedOverlaySurface(OverlayType) { return nullptr; }
+void Overlay::OverlayManager::setOverlayRenderer(IOverlayRenderer*) {}
+
+namespace {
+const int kWidth = 1280;
+const int kHeight = 720;
+const int kFrameRate = 60;
+const int kSoakSeconds = 5;
+
+// Late V-sync wakeups, like a busy compositor would give us
+const int kVsyncJitterUs = 1000;
+
+int videoFormatFor(AVCodecID codecId, bool tenBit)
+{
+    switch (codecId) {
+    case AV_CODEC_ID_H264:
+        return tenBit ? 0 : VIDEO_FORMAT_H264;
+    case AV_CODEC_ID_HEVC:
+        return tenBit ? VIDEO_FORMAT_H265_MAIN10 : VIDEO_FORMAT_H265;
+    case AV_CODEC_ID_AV1:
+        return tenBit ? VIDEO_FORMAT_AV1_MAIN10 : VIDEO_FORMAT_AV1_MAIN8;
+    default:
+        return 0;
+    }
+}
+
+// Encodes a few seconds of moving gradient with the first software encoder
+// for the codec that will open. Returns false if there isn't one.
+bool encodeSyntheticStream(AVCodecID codecId, Stream& stream)
+{
+    const AVCodec* encoder;
+    void* iterator = nullptr;
+    while ((encoder = av_codec_iterate(&iterator))) {
+        if (!av_codec_is_encoder(encoder) || encoder->id != codecId ||
+                (encoder->capabilities & AV_CODEC_CAP_HARDWARE)) {
+            continue;
+        }
+
+        AVCodecContext* ctx = avcodec_alloc_context3(encoder);
+        ctx->width = kWidth;
+        ctx->height = kHeight;
+        ctx->pix_fmt = AV_PIX_FMT_YUV420P;
+        ctx->time_base = AVRational{1, kFrameRate};
+        ctx->framerate = AVRational{kFrameRate, 1};
+        ctx->bit_rate = 5000000;
+
+        // Like a streaming host: an IDR every second and no reordering
+        ctx->gop_size = kFrameRate;
+        ctx->max_b_frames = 0;
+
+        // Whichever of these the encoder knows about
+        av_opt_set(ctx->priv_data, "preset", "ultrafast", 0);
+        av_opt_set(ctx->priv_data, "tune", "zerolatency", 0);
+        av_opt_set(ctx->priv_data, "usage", "realtime", 0);
+        av_opt_set(ctx->priv_data, "cpu-used", "8", 0);
+
+        if (avcodec_open2(ctx, encoder, nullptr) < 0) {
+            avcodec_free_context(&ctx);
+            continue;
+        }
+
+        stream.name = QStringLiteral("synthetic-%1").arg(encoder->name);
+        stream.videoFormat = videoFormatFor(codecId, false);
+        stream.width = kWidth;
+        stream.height = kHeight;
+        stream.fps = kFrameRate;
+        stream.packets.clear();
+
+        AVFrame* frame = av_frame_alloc();
+        frame->format = ctx->pix_fmt;
+        frame->width = ctx->width;
+        frame->height = ctx->height;
+        av_frame_get_buffer(frame, 0);
+
+        AVPacket* pkt = av_packet_alloc();
+        const int frames = kFrameRate * kSoakSeconds;
+        for (int i = 0; i <= frames; i++) {
+            if (i < frames) {
+                av_frame_make_writable(frame);
+                for (int y = 0; y < kHeight; y++) {
+                    for (int x = 0; x < kWidth; x++) {
+                        frame->data[0][y * frame->linesize[0] + x] = (uint8_t)(x + y + 4 * i);
+                    }
+                }
+                for (int plane = 1; plane < 3; plane++) {
+                    for (int y = 0; y < kHeight / 2; y++) {
+                        memset(&frame->data[plane][y * frame->linesize[plane]], 128 + plane * i % 64, kWidth / 2);
+                    }
+                }
+                frame->pts = i;
+            }
+
+            // A null frame at the end drains the encoder
+            if (avcodec_send_frame(ctx, i < frames ? frame : nullptr) < 0) {
+                break;
+            }
+
+            while (avcodec_receive_packet(ctx, pkt) == 0) {
+                stream.packets.append({ QByteArray((const char*)pkt->data, pkt->size),
+                                        (pkt->flags & AV_PKT_FLAG_KEY) != 0 });
+                av_packet_unref(pkt);
+            }
+        }
+
+        av_packet_free(&pkt);
+        av_frame_free(&frame);
+        avcodec_free_context(&ctx);
+        return !stream.packets.isEmpty();
+    }
+
+    return false;
+}
+
+// Reads a recorded stream, converted to the Annex B form a host sends
+bool readRecordedStream(const QString& path, Stream& stream, QTextStream& err)
+{
+    AVFormatContext* format = nullptr;
+    if (avformat_open_input(&format, path.toUtf8().constData(), nullptr, nullptr) < 0 ||
+            avformat_find_stream_info(format, nullptr) < 0) {
+        err << "Unable to open " << path << '\n';
+        avformat_close_input(&format);
+        return false;
+    }
+
+    int index = av_find_best_stream(format, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (index < 0) {
+        err << "No video stream in " << path << '\n';
+        avformat_close_input(&format);
+        return false;
+    }
+
+    AVStream* video = format->streams[index];
+    const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get((AVPixelFormat)video->codecpar->format);
+    stream.name = path;
+    stream.videoFormat = videoFormatFor(video->codecpar->codec_id, desc != nullptr && desc->comp[0].depth > 8);
+    stream.width = video->codecpar->width;
+    stream.height = video->codecpar->height;
+    stream.fps = video->avg_frame_rate.num > 0 && video->avg_frame_rate.den > 0 ?
+                     qRound(av_q2d(video->avg_frame_rate)) : kFrameRate;
+    if (stream.videoFormat == 0 || stream.fps <= 0) {
+        err << "Unsupported video stream in " << path << '\n';
+        avformat_close_input(&format);
+        return false;
+    }
+
+    // Containers store H.264 and HEVC length prefixed. AV1 is already in
+    // the low overhead OBU format we get from a host.
+    const char* filterName = video->codecpar->codec_id == AV_CODEC_ID_H264 ? "h264_mp4toannexb" :
+                             video->codecpar->codec_id == AV_CODEC_ID_HEVC ? "hevc_mp4toannexb" : "null";
+    AVBSFContext* bsf = nullptr;
+    if (av_bsf_alloc(av_bsf_get_by_name(filterName), &bsf) < 0 ||
+            avcodec_parameters_copy(bsf->par_in, video->codecpar) < 0 ||
+            av_bsf_init(bsf) < 0) {
+        err << "Unable to convert " << path << '\n';
+        av_bsf_free(&bsf);
+        avformat_close_input(&format);
+        return false;
+    }
+
+    AVPacket* pkt = av_packet_alloc();
+    stream.packets.clear();
+    bool eof = false;
+    while (!eof) {
+        eof = av_read_frame(format, pkt) < 0;
+        if (!eof && pkt->stream_index != index) {
+            av_packet_unref(pkt);
+            continue;
+        }
+
+        av_bsf_send_packet(bsf, eof ? nullptr : pkt);
+        while (av_bsf_receive_packet(bsf, pkt) == 0) {
+            stream.packets.append({ QByteArray((const char*)pkt->data, pkt->size),
+                                    (pkt->flags & AV_PKT_FLAG_KEY) != 0 });
+            av_packet_unref(pkt);
+        }
+    }
+
+    av_packet_free(&pkt);
+    av_bsf_free(&bsf);
+    avformat_close_input(&format);
+    return !stream.packets.isEmpty();
+}
+
+// Streams the packets in real time into a fully initialized decoder that
+// renders into the null renderer, paced by synthetic V-sync at the stream's
+// frame rate, then checks what was presented
+bool runSoak(const Stream& stream, QTextStream& out, QTextStream& err)
+{
+    bool ok = true;
+
+    s_VideoQueue.reset();
+    qputenv("SYNTHETIC_VSYNC_HZ", QByteArray::number(stream.fps));
+
+    DECODER_PARAMETERS params;
+    SDL_zero(params);
+    params.window = nullptr;
+    params.vds = StreamingPreferences::VDS_FORCE_SOFTWARE;
+    params.renderer = StreamingPreferences::RS_AUTO;
+    params.videoFormat = stream.videoFormat;
+    params.width = stream.width;
+    params.height = stream.height;
+    params.frameRate = stream.fps;
+    params.enableVsync = true;
+    params.enableFramePacing = true;
+    params.testOnly = false;
+
+    FFmpegVideoDecoder* decoder = new FFmpegVideoDecoder(false);
+    if (!require(decoder->initialize(&params), QStringLiteral("%1: decoder failed to initialize").arg(stream.name), err)) {
+        delete decoder;
+        return false;
+    }
+
+    NullRenderer* renderer = dynamic_cast<NullRenderer*>(decoder->getBackendRenderer());
+    if (!require(renderer != nullptr, QStringLiteral("%1: not rendering with the null renderer").arg(stream.name), err)) {
+        delete decoder;
+        return false;
+    }
+
+    // Frames arrive on the stream's clock, like they would from a host
+    const double periodUs = 1000000.0 / stream.fps;
+    uint64_t startUs = LiGetMicroseconds();
+    for (int i = 0; i < stream.packets.size(); i++) {
+        Pacer::waitUntil(startUs + (uint64_t)(i * periodUs));
+        s_VideoQueue.push(stream.packets[i], i + 1, (uint32_t)((uint64_t)i * 90000 / stream.fps), LiGetMicroseconds());
+    }
+
+    // Give the last frames time to come out of the decoder and pacer
+    QElapsedTimer drainTimer;
+    drainTimer.start();
+    std::vector<NullRenderer::PresentRecord> records = renderer->getPresentRecords();
+    while ((int)records.size() < stream.packets.size() && drainTimer.elapsed() < 1000) {
+        QThread::msleep(50);
+        records = renderer->getPresentRecords();
+    }
+
+    delete decoder;
+
+    const int fed = stream.packets.size();
+    const int presented = (int)records.size();
+    ok &= require(s_VideoQueue.completed() == fed,
+                  QStringLiteral("%1: decoder took %2 of %3 frames").arg(stream.name).arg(s_VideoQueue.completed()).arg(fed), err);
+    ok &= require(s_VideoQueue.failed() == 0,
+                  QStringLiteral("%1: %2 frames failed to decode").arg(stream.name).arg(s_VideoQueue.failed()), err);
+    ok &= require(s_VideoQueue.idrRequests() == 0,
+                  QStringLiteral("%1: decoder asked for %2 IDR frames").arg(stream.name).arg(s_VideoQueue.idrRequests()), err);
+
+    // The pacer may drop a frame when two land in one V-sync, but a decoder
+    // that keeps up loses very few to that
+    ok &= require(presented >= fed * 9 / 10,
+                  QStringLiteral("%1: presented %2 of %3 frames").arg(stream.name).arg(presented).arg(fed), err);
+    if (presented < 2) {
+        return false;
+    }
+
+    uint64_t totalLatencyUs = 0;
+    uint64_t maxLatencyUs = 0;
+    bool ordered = true;
+    for (int i = 0; i < presented; i++) {
+        const NullRenderer::PresentRecord& record = records[i];
+        if (i > 0 && (record.pts <= records[i - 1].pts || record.presentTimeUs < records[i - 1].presentTimeUs)) {
+            ordered = false;
+        }
+        if (record.presentTimeUs < record.decodedTimeUs) {
+            ordered = false;
+            continue;
+        }
+
+        uint64_t latencyUs = record.presentTimeUs - record.decodedTimeUs;
+        totalLatencyUs += latencyUs;
+        maxLatencyUs = qMax(maxLatencyUs, latencyUs);
+    }
+    ok &= require(ordered, QStringLiteral("%1: frames presented out of order").arg(stream.name), err);
+
+    const double avgLatencyMs = totalLatencyUs / 1000.0 / presented;
+    const double maxLatencyMs = maxLatencyUs / 1000.0;
+    const double intervalMs = (records.back().presentTimeUs - records.front().presentTimeUs) / 1000.0 / (presented - 1);
+    const double periodMs = periodUs / 1000.0;
+
+    // A full pacing queue is the most a frame should wait, and a soak run
+    // that stalls for longer than a few frames has a problem worth seeing
+    ok &= require(avgLatencyMs <= (PACER_MAX_QUEUED_FRAMES + 1) * periodMs,
+                  QStringLiteral("%1: %2 ms average decode to present").arg(stream.name).arg(avgLatencyMs, 0, 'f', 2), err);
+    ok &= require(maxLatencyMs <= 100,
+                  QStringLiteral("%1: %2 ms worst decode to present").arg(stream.name).arg(maxLatencyMs, 0, 'f', 2), err);
+
+    // Presents follow the V-sync grid, so they come at the stream's rate
+    ok &= require(intervalMs >= 0.9 * periodMs && intervalMs <= 1.2 * periodMs,
+                  QStringLiteral("%1: %2 ms between presents").arg(stream.name).arg(intervalMs, 0, 'f', 2), err);
+
+    out << stream.name << ' ' << stream.width << 'x' << stream.height << ' ' << stream.fps << ' '
+        << fed << ' ' << presented << ' '
+        << QString::number(avgLatencyMs, 'f', 2) << ' ' << QString::number(maxLatencyMs, 'f', 2) << ' '
+        << QString::number(intervalMs, 'f', 2) << '\n';
+    out.flush();
+
+    return ok;
+}
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    // Everything the decoder would show goes to the null renderer instead
+    qputenv("NULL_RENDERER", "1");
+    qputenv("NULL_RENDERER_UPLOAD", "1");
+    qputenv("SYNTHETIC_VSYNC_JITTER_US", QByteArray::number(kVsyncJitterUs));
+
+    // The decoder is chatty until it sees its first frame
+    SDL_LogSetAllPriority(SDL_LOG_PRIORITY_WARN);
+
+    bool ok = true;
+    out << "stream resolution fps frames presented avg_latency_ms max_latency_ms present_interval_ms\n";
+
+    // Recorded streams to soak with, if any. Otherwise we make our own with
+    // whatever software encoders this FFmpeg has.
+    QStringList paths = app.arguments().mid(1);
+    if (!paths.isEmpty()) {
+        for (const QString& path : paths) {
+            Stream stream;
+            ok &= require(readRecordedStream(path, stream, err), QStringLiteral("unable to read ") + path, err);
+            if (!stream.packets.isEmpty()) {
+                ok &= runSoak(stream, out, err);
+            }
+        }
+    }
+    else {
+        int streams = 0;
+        for (AVCodecID codecId : {AV_CODEC_ID_H264, AV_CODEC_ID_HEVC, AV_CODEC_ID_AV1}) {
+            Stream stream;
+            if (encodeSyntheticStream(codecId, stream)) {
+                ok &= runSoak(stream, out, err);
+                streams++;
+            }
+        }
+
+        if (streams == 0) {
+            out << "SKIPPED: no H.264, HEVC or AV1 software encoder; pass recorded streams instead\n";
+        }
+    }
+
+    out << (ok ? "PASS\n" : "FAILED\n");
+    out.flush();
+    err.flush();
+    return ok ? 0 : 1;
+}
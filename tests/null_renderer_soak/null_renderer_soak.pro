@@ -0,0 +1,48 @@
+QT += core gui network quick
+CONFIG += c++17 console link_pkgconfig
+CONFIG -= app_bundle
+
+TARGET = null_renderer_soak
+TEMPLATE = app
+
+# The decoder pulls in platform renderers and V-sync sources everywhere
+# but Linux, which is where the GPU-less build agents are anyway
+requires(linux)
+
+PKGCONFIG += sdl2 SDL2_ttf opus libavcodec libavformat libavutil libswscale
+
+INCLUDEPATH += \
+    $$PWD/../../app \
+    $$PWD/../../h264bitstream \
+    $$PWD/../../moonlight-common-c/moonlight-common-c/src \
+    $$PWD/../../qmdnsengine/qmdnsengine/src/include \
+    $$PWD/../../qmdnsengine
+
+SOURCES += \
+    main.cpp \
+    ../../app/wm.cpp \
+    ../../app/streaming/bwtracker.cpp \
+    ../../app/streaming/network/bandwidth.cpp \
+    ../../app/streaming/streamutils.cpp \
+    ../../app/streaming/video/av1obu.cpp \
+    ../../app/streaming/video/decodethreadpolicy.cpp \
+    ../../app/streaming/video/ffmpeg.cpp \
+    ../../app/streaming/video/framepool.cpp \
+    ../../app/streaming/video/h264spsfixup.cpp \
+    ../../app/streaming/video/hdrmetadatastate.cpp \
+    ../../app/streaming/video/videoenhancement.cpp \
+    ../../app/streaming/video/ffmpeg-renderers/genhwaccel.cpp \
+    ../../app/streaming/video/ffmpeg-renderers/nullrenderer.cpp \
+    ../../app/streaming/video/ffmpeg-renderers/sdlvid.cpp \
+    ../../app/streaming/video/ffmpeg-renderers/swframemapper.cpp \
+    ../../app/streaming/video/ffmpeg-renderers/pacer/pacer.cpp \
+    ../../app/streaming/video/ffmpeg-renderers/pacer/syntheticvsyncsource.cpp \
+    ../../h264bitstream/h264_nal.c \
+    ../../h264bitstream/h264_stream.c
+
+HEADERS += \
+    ../../app/streaming/video/ffmpeg.h \
+    ../../app/streaming/video/framepool.h \
+    ../../app/streaming/video/ffmpeg-renderers/nullrenderer.h \
+    ../../app/streaming/video/ffmpeg-renderers/pacer/pacer.h \
+    ../../app/streaming/video/ffmpeg-renderers/pacer/syntheticvsyncsource.h
@@ -0,0 +1,241 @@
+#include "backend/nvxmlparser.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QXmlStreamReader>
+
+namespace {
+bool require(bool condition, const QString& message, QTextStream& err)
+{
+    if (!condition) {
+        err << "FAIL: " << message << '\n';
+    }
+    return condition;
+}
+
+// A /serverinfo response recorded from a Sunshine host, trimmed of
+// identifying values.
+const char SERVER_INFO_XML[] = R"XML(<?xml version="1.0" encoding="utf-8"?>
+<root status_code="200">
+<hostname>客厅主机</hostname>
+<appversion>7.1.431.-1</appversion>
+<GfeVersion>3.23.0.74</GfeVersion>
+<uniqueid>5D1C7A4E-92B3-4F0A-8E61-3B7C2D9F0A14</uniqueid>
+<HttpsPort>47984</HttpsPort>
+<ExternalPort>47989</ExternalPort>
+<MaxLumaPixelsHEVC>1869449984</MaxLumaPixelsHEVC>
+<mac>0c:9d:92:41:5a:7e</mac>
+<Permission>4294967295</Permission>
+<LocalIP>192.168.1.20</LocalIP>
+<ServerCodecModeSupport>3843</ServerCodecModeSupport>
+<SupportedDisplayMode>
+<DisplayMode><Width>3840</Width><Height>2160</Height><RefreshRate>120</RefreshRate></DisplayMode>
+<DisplayMode><Width>2560</Width><Height>1440</Height><RefreshRate>144</RefreshRate></DisplayMode>
+<DisplayMode><Width>1920</Width><Height>1080</Height><RefreshRate>60</RefreshRate></DisplayMode>
+</SupportedDisplayMode>
+<PairStatus>1</PairStatus>
+<currentgame>881448767</currentgame>
+<state>SUNSHINE_SERVER_BUSY</state>
+<gputype>NVIDIA GeForce RTX 4080</gputype>
+<ExternalIP>203.0.113.7</ExternalIP>
+</root>
+)XML";
+
+// The per-tag lookup NvHTTP used before the one-pass parser. Each call
+// re-scans the whole document from the start.
+QString legacyGetXmlString(const QString& xml, const QString& tagName)
+{
+    QXmlStreamReader xmlReader(xml);
+
+    while (!xmlReader.atEnd()) {
+        if (xmlReader.readNext() != QXmlStreamReader::StartElement) {
+            continue;
+        }
+
+        if (xmlReader.name() == tagName) {
+            return xmlReader.readElementText();
+        }
+    }
+
+    return QString();
+}
+
+QByteArray makeAppList(int count)
+{
+    QByteArray xml("<?xml version=\"1.0\" encoding=\"utf-8\"?>\n<root status_code=\"200\">\n");
+    for (int i = 1; i <= count; i++) {
+        xml += "<App>\n<IsHdrSupported>" + QByteArray(i % 3 == 0 ? "1" : "0") + "</IsHdrSupported>\n";
+        // One nameless app, as Sunshine sends for an empty title
+        if (i == 7) {
+            xml += "<AppTitle/>\n";
+        }
+        else {
+            xml += "<AppTitle>游戏 &amp; Game " + QByteArray::number(i) + "</AppTitle>\n";
+        }
+        xml += "<ID>" + QByteArray::number(1000 + i) + "</ID>\n";
+        xml += "<IsAppCollectorGame>" + QByteArray(i % 5 == 0 ? "1" : "0") + "</IsAppCollectorGame>\n</App>\n";
+    }
+    xml += "</root>\n";
+    return xml;
+}
+
+bool runServerInfoChecks(QTextStream& out, QTextStream& err)
+{
+    bool ok = true;
+    const QByteArray xml(SERVER_INFO_XML);
+
+    NvServerInfo info = NvServerInfo::parse(xml);
+    ok &= require(info.status.hasRoot && info.status.code == 200, QStringLiteral("root status not parsed"), err);
+    ok &= require(info.hostname == QStringLiteral("客厅主机"), QStringLiteral("UTF-8 hostname mangled"), err);
+    ok &= require(info.uniqueId == QStringLiteral("5D1C7A4E-92B3-4F0A-8E61-3B7C2D9F0A14"), QStringLiteral("uniqueid"), err);
+    ok &= require(info.httpsPort == QStringLiteral("47984") && info.externalPort == QStringLiteral("47989"),
+                  QStringLiteral("ports"), err);
+    ok &= require(info.externalIp == QStringLiteral("203.0.113.7"), QStringLiteral("ExternalIP after display modes"), err);
+    ok &= require(info.currentGameId() == 881448767, QStringLiteral("current game of a busy host"), err);
+    ok &= require(info.gfeVersion == QStringLiteral("3.23.0.74") && info.appVersion == QStringLiteral("7.1.431.-1"),
+                  QStringLiteral("versions"), err);
+    ok &= require(info.displayModes.size() == 3 &&
+                  info.displayModes[1].width == 2560 &&
+                  info.displayModes[1].height == 1440 &&
+                  info.displayModes[1].refreshRate == 144,
+                  QStringLiteral("display modes"), err);
+
+    // Every field must match what the legacy lookup returns
+    const QString text = QString::fromUtf8(xml);
+    const struct { const char* tag; const QString& value; } fields[] = {
+        { "hostname", info.hostname }, { "uniqueid", info.uniqueId }, { "mac", info.mac },
+        { "LocalIP", info.localIp }, { "ExternalIP", info.externalIp }, { "HttpsPort", info.httpsPort },
+        { "ExternalPort", info.externalPort }, { "state", info.state }, { "PairStatus", info.pairStatus },
+        { "currentgame", info.currentGame }, { "appversion", info.appVersion }, { "GfeVersion", info.gfeVersion },
+        { "gputype", info.gpuType }, { "ServerCodecModeSupport", info.serverCodecModeSupport },
+        { "MaxLumaPixelsHEVC", info.maxLumaPixelsHEVC },
+    };
+    for (const auto& field : fields) {
+        ok &= require(legacyGetXmlString(text, field.tag) == field.value,
+                      QStringLiteral("field differs from legacy lookup: ") + field.tag, err);
+    }
+
+    // Idle hosts keep reporting their last game
+    NvServerInfo idle = NvServerInfo::parse(QByteArray(SERVER_INFO_XML).replace("SUNSHINE_SERVER_BUSY", "SUNSHINE_SERVER_FREE"));
+    ok &= require(idle.currentGameId() == 0, QStringLiteral("idle host reported a current game"), err);
+
+    NvServerInfo error = NvServerInfo::parse("<root status_code=\"4294967295\" status_message=\"Invalid\"/>");
+    ok &= require(error.status.hasRoot && error.status.code == -1 && error.status.message == QStringLiteral("Invalid"),
+                  QStringLiteral("0xFFFFFFFF status code"), err);
+    ok &= require(NvServerInfo::parse("not xml").isNull(), QStringLiteral("garbage has a root"), err);
+
+    const int iterations = 5000;
+    QElapsedTimer timer;
+    timer.start();
+    qint64 checksum = 0;
+    for (int i = 0; i < iterations; i++) {
+        // The old path decoded the reply to a QString, then scanned it once per field
+        const QString decoded = QString::fromUtf8(xml);
+        for (const auto& field : fields) {
+            checksum += legacyGetXmlString(decoded, field.tag).size();
+        }
+        checksum += legacyGetXmlString(decoded, "state").size();
+    }
+    const qint64 legacyNs = timer.nsecsElapsed();
+
+    timer.restart();
+    for (int i = 0; i < iterations; i++) {
+        NvServerInfo parsed = NvServerInfo::parse(xml);
+        checksum -= parsed.hostname.size() + parsed.uniqueId.size() + parsed.mac.size() +
+                parsed.localIp.size() + parsed.externalIp.size() + parsed.httpsPort.size() +
+                parsed.externalPort.size() + 2 * parsed.state.size() + parsed.pairStatus.size() +
+                parsed.currentGame.size() + parsed.appVersion.size() + parsed.gfeVersion.size() +
+                parsed.gpuType.size() + parsed.serverCodecModeSupport.size() + parsed.maxLumaPixelsHEVC.size();
+    }
+    const qint64 onePassNs = timer.nsecsElapsed();
+
+    ok &= require(checksum == 0, QStringLiteral("benchmark results differ"), err);
+    out << "serverinfo_legacy_us=" << QString::number(legacyNs / 1000.0 / iterations, 'f', 2)
+        << " serverinfo_one_pass_us=" << QString::number(onePassNs / 1000.0 / iterations, 'f', 2)
+        << " speedup=" << QString::number((double)legacyNs / onePassNs, 'f', 1) << "x\n";
+
+    return ok;
+}
+
+bool runAppListChecks(QTextStream& out, QTextStream& err)
+{
+    bool ok = true;
+    const int appCount = 200;
+    const QByteArray xml = makeAppList(appCount);
+
+    NvAppListParser whole;
+    whole.addData(xml);
+    ok &= require(whole.finish(), QStringLiteral("applist rejected"), err);
+    ok &= require(whole.status().hasRoot && whole.status().code == 200, QStringLiteral("applist status"), err);
+    const QVector<NvApp> reference = whole.takeApps();
+    ok &= require(reference.size() == appCount, QStringLiteral("wrong app count"), err);
+    if (reference.size() == appCount) {
+        ok &= require(reference[0].id == 1001 && reference[0].name == QStringLiteral("游戏 & Game 1"),
+                      QStringLiteral("first app"), err);
+        ok &= require(!reference[6].name.isNull() && reference[6].name.isEmpty(),
+                      QStringLiteral("<AppTitle/> must be an empty, non-null name"), err);
+        ok &= require(reference[2].hdrSupported && !reference[3].hdrSupported && reference[4].isAppCollectorGame,
+                      QStringLiteral("app flags"), err);
+    }
+
+    // Replaying the response in network-sized chunks must not change the
+    // result, including chunks that split a tag or a multi-byte character.
+    for (int chunkSize : {1, 7, 1460, 16384}) {
+        NvAppListParser streamed;
+        for (int offset = 0; offset < xml.size(); offset += chunkSize) {
+            streamed.addData(xml.mid(offset, chunkSize));
+        }
+        ok &= require(streamed.finish() && streamed.takeApps() == reference,
+                      QStringLiteral("chunked applist differs at chunk size ") + QString::number(chunkSize), err);
+    }
+
+    NvAppListParser invalid;
+    invalid.addData("<root status_code=\"200\"><App><AppTitle>A</AppTitle></App><App><ID>2</ID></App></root>");
+    ok &= require(!invalid.finish(), QStringLiteral("app without an ID was accepted"), err);
+
+    // Malformed XML keeps what came before the error, like the old parsing
+    NvAppListParser malformed;
+    malformed.addData("<root status_code=\"200\"><App><AppTitle>A</AppTitle><ID>1</ID></App><App><ID>2</ID></Ap></root>");
+    ok &= require(malformed.finish(), QStringLiteral("malformed applist rejected"), err);
+    QVector<NvApp> partial = malformed.takeApps();
+    ok &= require(partial.size() == 2 && partial[0].id == 1 && partial[0].name == QStringLiteral("A"),
+                  QStringLiteral("malformed applist lost the apps before the error"), err);
+
+    NvAppListParser truncated;
+    truncated.addData(xml.left(xml.size() / 2));
+    ok &= require(truncated.finish(), QStringLiteral("truncated applist reported as malformed"), err);
+
+    const int iterations = 200;
+    QElapsedTimer timer;
+    timer.start();
+    for (int i = 0; i < iterations; i++) {
+        NvAppListParser parser;
+        for (int offset = 0; offset < xml.size(); offset += 1460) {
+            parser.addData(xml.mid(offset, 1460));
+        }
+        parser.finish();
+        ok &= require(parser.takeApps().size() == appCount, QStringLiteral("benchmark lost apps"), err);
+    }
+    out << "applist_bytes=" << xml.size() << " apps=" << appCount
+        << " streamed_parse_us=" << QString::number(timer.nsecsElapsed() / 1000.0 / iterations, 'f', 1) << '\n';
+
+    return ok;
+}
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    bool ok = true;
+    ok &= runServerInfoChecks(out, err);
+    ok &= runAppListChecks(out, err);
+
+    out << (ok ? "PASS\n" : "FAILED\n");
+    out.flush();
+    err.flush();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,18 @@
+QT += core
+CONFIG += c++17 console
+CONFIG -= app_bundle
+
+TARGET = serverinfo_xml_parsing
+TEMPLATE = app
+
+INCLUDEPATH += \
+    $$PWD/../../app
+
+SOURCES += \
+    main.cpp \
+    ../../app/backend/nvapp.cpp \
+    ../../app/backend/nvxmlparser.cpp
+
+HEADERS += \
+    ../../app/backend/nvapp.h \
+    ../../app/backend/nvxmlparser.h
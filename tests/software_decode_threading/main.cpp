@@ -0,0 +1,254 @@
+#include "streaming/video/decodethreadpolicy.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QSize>
+#include <QStringList>
+#include <QTextStream>
+#include <QThread>
+#include <QVector>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+}
+
+namespace {
+bool require(bool condition, const QString& message, QTextStream& err)
+{
+    if (!condition) {
+        err << "FAIL: " << message << '\n';
+    }
+    return condition;
+}
+
+typedef DecodeThreadPolicy::Codec Codec;
+typedef DecodeThreadPolicy::ThreadingMode ThreadingMode;
+
+const char* codecName(Codec codec)
+{
+    switch (codec) {
+    case Codec::H264:
+        return "h264";
+    case Codec::HEVC:
+        return "hevc";
+    case Codec::AV1:
+        return "av1";
+    }
+
+    return "?";
+}
+
+bool runPolicyChecks(QTextStream& out, QTextStream& err)
+{
+    bool ok = true;
+
+    // Small machines and streams keep the old min(4, cores) slices
+    for (int cpus : {1, 2, 4}) {
+        DecodeThreadPolicy policy = DecodeThreadPolicy::choose(cpus, Codec::H264, 1280, 720, 60, true);
+        ok &= require(policy.slicesPerFrame == qMin(4, cpus) && policy.mode == ThreadingMode::Slice,
+                      QStringLiteral("720p60 H.264 on %1 cores").arg(cpus), err);
+    }
+
+    // 4K120 on a 16-core client must use more than four threads
+    for (Codec codec : {Codec::H264, Codec::HEVC, Codec::AV1}) {
+        DecodeThreadPolicy policy = DecodeThreadPolicy::choose(16, codec, 3840, 2160, 120, false);
+        ok &= require(policy.slicesPerFrame > 4 && policy.slicesPerFrame <= 15,
+                      QStringLiteral("4K120 %1 slices").arg(codecName(codec)), err);
+        ok &= require(policy.mode == ThreadingMode::Slice && policy.addedLatencyFrames == 0,
+                      QStringLiteral("frame threading without the preference"), err);
+        if (codec != Codec::HEVC) {
+            ok &= require(policy.threadCount > 4, QStringLiteral("4K120 %1 threads").arg(codecName(codec)), err);
+        }
+    }
+
+    // Slices requested from the host can't depend on the preference, since
+    // they come from a probe decoder that doesn't know it.
+    for (int cpus : {2, 4, 8, 16, 64}) {
+        for (Codec codec : {Codec::H264, Codec::HEVC, Codec::AV1}) {
+            for (int fps : {30, 60, 120, 240}) {
+                ok &= require(DecodeThreadPolicy::choose(cpus, codec, 3840, 2160, fps, false).slicesPerFrame ==
+                              DecodeThreadPolicy::choose(cpus, codec, 3840, 2160, fps, true).slicesPerFrame,
+                              QStringLiteral("slices depend on the frame threading preference"), err);
+            }
+        }
+    }
+
+    // HEVC uses frame threading when allowed, within the latency budget
+    DecodeThreadPolicy hevc120 = DecodeThreadPolicy::choose(16, Codec::HEVC, 3840, 2160, 120, true);
+    ok &= require(hevc120.mode == ThreadingMode::Frame && hevc120.threadCount == 3 && hevc120.addedLatencyFrames == 2,
+                  QStringLiteral("4K120 HEVC frame threads"), err);
+    DecodeThreadPolicy hevc60 = DecodeThreadPolicy::choose(16, Codec::HEVC, 3840, 2160, 60, true);
+    ok &= require(hevc60.mode == ThreadingMode::Frame && hevc60.addedLatencyFrames == 1,
+                  QStringLiteral("4K60 HEVC may only add one frame"), err);
+    DecodeThreadPolicy hevc30 = DecodeThreadPolicy::choose(16, Codec::HEVC, 3840, 2160, 30, true);
+    ok &= require(hevc30.mode == ThreadingMode::Slice && hevc30.addedLatencyFrames == 0,
+                  QStringLiteral("a frame at 30 FPS exceeds the latency budget"), err);
+    DecodeThreadPolicy hevc720 = DecodeThreadPolicy::choose(16, Codec::HEVC, 1280, 720, 60, true);
+    ok &= require(hevc720.mode == ThreadingMode::Slice, QStringLiteral("one thread keeps up with 720p60 HEVC"), err);
+
+    // H.264 and AV1 never need frame threading on a machine with spare cores
+    ok &= require(DecodeThreadPolicy::choose(16, Codec::H264, 3840, 2160, 120, true).mode == ThreadingMode::Slice,
+                  QStringLiteral("4K120 H.264 frame threaded"), err);
+    ok &= require(DecodeThreadPolicy::choose(16, Codec::AV1, 3840, 2160, 120, true).mode == ThreadingMode::Slice,
+                  QStringLiteral("AV1 frame threaded"), err);
+
+    // Short frames never get slices under the minimum height
+    ok &= require(DecodeThreadPolicy::choose(64, Codec::H264, 640, 360, 480, false).slicesPerFrame <= 360 / MIN_SLICE_HEIGHT,
+                  QStringLiteral("slices thinner than the minimum"), err);
+    ok &= require(DecodeThreadPolicy::choose(128, Codec::AV1, 7680, 4320, 240, false).slicesPerFrame == MAX_SLICES,
+                  QStringLiteral("slice cap"), err);
+
+    out << "cores codec resolution fps slices threads mode latency_frames\n";
+    for (int cpus : {4, 8, 16}) {
+        for (Codec codec : {Codec::H264, Codec::HEVC, Codec::AV1}) {
+            for (QSize size : {QSize(1920, 1080), QSize(2560, 1440), QSize(3840, 2160)}) {
+                for (int fps : {60, 120}) {
+                    DecodeThreadPolicy policy = DecodeThreadPolicy::choose(cpus, codec, size.width(), size.height(), fps, true);
+                    out << cpus << ' ' << codecName(codec) << ' ' << size.width() << 'x' << size.height() << ' ' << fps << ' '
+                        << policy.slicesPerFrame << ' ' << policy.threadCount << ' '
+                        << (policy.mode == ThreadingMode::Frame ? "frame" : "slice") << ' '
+                        << policy.addedLatencyFrames << '\n';
+                }
+            }
+        }
+    }
+
+    return ok;
+}
+
+// Decodes a recorded stream once with the given threading. Returns false
+// if the stream couldn't be decoded.
+bool decodeStream(const QString& path, int threadCount, int threadType, bool lowDelay,
+                  int& frames, double& fps, double& avgLatencyMs, QTextStream& err)
+{
+    AVFormatContext* format = nullptr;
+    if (avformat_open_input(&format, path.toUtf8().constData(), nullptr, nullptr) < 0 ||
+            avformat_find_stream_info(format, nullptr) < 0) {
+        err << "Unable to open " << path << '\n';
+        avformat_close_input(&format);
+        return false;
+    }
+
+    const AVCodec* codec = nullptr;
+    int stream = av_find_best_stream(format, AVMEDIA_TYPE_VIDEO, -1, -1, &codec, 0);
+    AVCodecContext* ctx = stream >= 0 ? avcodec_alloc_context3(codec) : nullptr;
+    if (ctx == nullptr || avcodec_parameters_to_context(ctx, format->streams[stream]->codecpar) < 0) {
+        err << "No decodable video stream in " << path << '\n';
+        avcodec_free_context(&ctx);
+        avformat_close_input(&format);
+        return false;
+    }
+
+    // Match how FFmpegVideoDecoder configures software decoding
+    if (lowDelay) {
+        ctx->flags |= AV_CODEC_FLAG_LOW_DELAY;
+    }
+    ctx->flags |= AV_CODEC_FLAG_OUTPUT_CORRUPT;
+    ctx->flags2 |= AV_CODEC_FLAG2_SHOW_ALL;
+    ctx->thread_count = threadCount;
+    ctx->thread_type = threadType;
+
+    if (avcodec_open2(ctx, codec, nullptr) < 0) {
+        err << "Unable to open decoder for " << path << '\n';
+        avcodec_free_context(&ctx);
+        avformat_close_input(&format);
+        return false;
+    }
+
+    AVPacket* pkt = av_packet_alloc();
+    AVFrame* frame = av_frame_alloc();
+    QVector<qint64> sendTimes;
+    qint64 totalLatencyNs = 0;
+    frames = 0;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    // A null packet at the end drains the frames still in flight
+    bool eof = false;
+    while (!eof) {
+        eof = av_read_frame(format, pkt) < 0;
+        if (!eof && pkt->stream_index != stream) {
+            av_packet_unref(pkt);
+            continue;
+        }
+
+        if (avcodec_send_packet(ctx, eof ? nullptr : pkt) == 0 && !eof) {
+            sendTimes.append(timer.nsecsElapsed());
+        }
+        av_packet_unref(pkt);
+
+        while (avcodec_receive_frame(ctx, frame) == 0) {
+            // Output is in decode order for our streams, so the oldest
+            // outstanding packet is the one that produced this frame
+            if (frames < sendTimes.size()) {
+                totalLatencyNs += timer.nsecsElapsed() - sendTimes[frames];
+            }
+            frames++;
+            av_frame_unref(frame);
+        }
+    }
+
+    qint64 elapsedNs = timer.nsecsElapsed();
+    fps = elapsedNs > 0 ? frames * 1e9 / elapsedNs : 0;
+    avgLatencyMs = frames > 0 ? totalLatencyNs / 1e6 / frames : 0;
+
+    av_frame_free(&frame);
+    av_packet_free(&pkt);
+    avcodec_free_context(&ctx);
+    avformat_close_input(&format);
+    return frames > 0;
+}
+
+// Runs the threads x codec x resolution matrix over recorded streams, one
+// per codec and resolution. These are large, so they're passed on the
+// command line rather than checked in.
+bool runDecodeMatrix(const QStringList& paths, QTextStream& out, QTextStream& err)
+{
+    bool ok = true;
+    const int cpus = QThread::idealThreadCount();
+
+    out << "stream threads mode frames decode_fps avg_latency_ms\n";
+    for (const QString& path : paths) {
+        for (int threads = 1; threads <= cpus; threads *= 2) {
+            for (bool frameThreads : {false, true}) {
+                if (frameThreads && threads == 1) {
+                    continue;
+                }
+
+                int frames;
+                double fps, latencyMs;
+                ok &= require(decodeStream(path, threads, frameThreads ? FF_THREAD_FRAME : FF_THREAD_SLICE,
+                                           !frameThreads, frames, fps, latencyMs, err),
+                              QStringLiteral("decode failed: ") + path, err);
+                out << path << ' ' << threads << ' ' << (frameThreads ? "frame" : "slice") << ' ' << frames << ' '
+                    << QString::number(fps, 'f', 1) << ' ' << QString::number(latencyMs, 'f', 2) << '\n';
+            }
+        }
+    }
+
+    return ok;
+}
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    bool ok = true;
+    ok &= runPolicyChecks(out, err);
+
+    // Recorded streams to benchmark, if any
+    QStringList streams = app.arguments().mid(1);
+    if (!streams.isEmpty()) {
+        ok &= runDecodeMatrix(streams, out, err);
+    }
+
+    out << (ok ? "PASS\n" : "FAILED\n");
+    out.flush();
+    err.flush();
+    return ok ? 0 : 1;
+}
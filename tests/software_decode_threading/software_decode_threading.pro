@@ -0,0 +1,18 @@
+QT += core
+CONFIG += c++17 console link_pkgconfig
+CONFIG -= app_bundle
+
+TARGET = software_decode_threading
+TEMPLATE = app
+
+PKGCONFIG += libavcodec libavformat libavutil
+
+INCLUDEPATH += \
+    $$PWD/../../app
+
+SOURCES += \
+    main.cpp \
+    ../../app/streaming/video/decodethreadpolicy.cpp
+
+HEADERS += \
+    ../../app/streaming/video/decodethreadpolicy.h
@@ -0,0 +1,243 @@
+#include "streaming/video/ffmpeg-renderers/pacer/x11presentvsyncsource.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QProcess>
+#include <QTextStream>
+#include <QThread>
+
+#include <atomic>
+
+namespace {
+// Xvfb has no CRTCs, so Present drives every window from its fake vblank
+// clock, which ticks every 16667 us
+constexpr int kXvfbRefreshHz = 60;
+constexpr int64_t kPeriodUs = 1000000 / kXvfbRefreshHz;
+constexpr int kMeasureMs = 2000;
+
+bool require(bool condition, const QString& message, QTextStream& err)
+{
+    if (!condition) {
+        err << "FAIL: " << message << '\n';
+    }
+    return condition;
+}
+
+uint64_t nowUs()
+{
+    return SDL_GetPerformanceCounter() * 1000000 / SDL_GetPerformanceFrequency();
+}
+
+enum class XvfbResult { Started, NotInstalled, Failed };
+
+// Starts a private Xvfb and points DISPLAY at it. With -displayfd the server
+// picks a free display number and writes it once it accepts connections.
+XvfbResult startXvfb(QProcess& xvfb)
+{
+    xvfb.setProgram(QStringLiteral("Xvfb"));
+    xvfb.setArguments({ QStringLiteral("-displayfd"), QStringLiteral("1"),
+                        QStringLiteral("-nolisten"), QStringLiteral("tcp"),
+                        QStringLiteral("-screen"), QStringLiteral("0"), QStringLiteral("1280x720x24") });
+    xvfb.setStandardErrorFile(QProcess::nullDevice());
+    xvfb.start();
+    if (!xvfb.waitForStarted(5000)) {
+        return xvfb.error() == QProcess::FailedToStart ? XvfbResult::NotInstalled : XvfbResult::Failed;
+    }
+
+    QByteArray display;
+    QElapsedTimer timer;
+    timer.start();
+    while (!display.contains('\n') && timer.elapsed() < 10000) {
+        if (!xvfb.waitForReadyRead(static_cast<int>(10000 - timer.elapsed()))) {
+            break;
+        }
+        display += xvfb.readAllStandardOutput();
+    }
+
+    display = display.trimmed();
+    if (display.isEmpty()) {
+        xvfb.kill();
+        xvfb.waitForFinished();
+        return XvfbResult::Failed;
+    }
+
+    qputenv("DISPLAY", ":" + display);
+    return XvfbResult::Started;
+}
+
+bool runRateChecks(SDL_Window* window, QTextStream& out, QTextStream& err)
+{
+    bool ok = true;
+
+    X11PresentVsyncSource source(nullptr);
+    if (!require(source.initialize(window, kXvfbRefreshHz), QStringLiteral("Present source failed to initialize"), err)) {
+        return false;
+    }
+    ok &= require(!source.isAsync(), QStringLiteral("Present source should be waited on by Pacer"), err);
+    ok &= require(source.getMicrosUntilNextVsync() == -1,
+                  QStringLiteral("Present source predicted a V-sync before seeing one"), err);
+
+    // Give the period estimate a few vblanks to settle
+    for (int i = 0; i < 10; i++) {
+        source.waitForVsync();
+    }
+
+    int callbacks = 0;
+    uint64_t minIntervalUs = UINT64_MAX;
+    uint64_t maxIntervalUs = 0;
+    int64_t minUntilNextUs = INT64_MAX;
+    int64_t maxUntilNextUs = INT64_MIN;
+    const uint64_t startUs = nowUs();
+    uint64_t lastUs = startUs;
+    while (nowUs() - startUs < kMeasureMs * 1000ULL) {
+        source.waitForVsync();
+        const uint64_t callbackUs = nowUs();
+        const int64_t untilNextUs = source.getMicrosUntilNextVsync();
+
+        callbacks++;
+        minIntervalUs = qMin(minIntervalUs, callbackUs - lastUs);
+        maxIntervalUs = qMax(maxIntervalUs, callbackUs - lastUs);
+        minUntilNextUs = qMin(minUntilNextUs, untilNextUs);
+        maxUntilNextUs = qMax(maxUntilNextUs, untilNextUs);
+        lastUs = callbackUs;
+    }
+    const double elapsedMs = (lastUs - startUs) / 1000.0;
+    const double rateHz = callbacks * 1000.0 / elapsedMs;
+
+    // A source that completes early spins the V-sync thread well above the
+    // refresh rate, and one that misses notifications lands well below it
+    ok &= require(rateHz > kXvfbRefreshHz * 0.85 && rateHz < kXvfbRefreshHz * 1.15,
+                  QStringLiteral("callback rate %1 Hz is not close to %2 Hz").arg(rateHz, 0, 'f', 2).arg(kXvfbRefreshHz), err);
+    ok &= require(minIntervalUs > kPeriodUs / 2,
+                  QStringLiteral("a V-sync wait returned after only %1 us").arg(minIntervalUs), err);
+    ok &= require(maxIntervalUs < kPeriodUs * 4,
+                  QStringLiteral("a V-sync wait took %1 us").arg(maxIntervalUs), err);
+
+    // Right after a V-sync, the next one is about a period away
+    ok &= require(minUntilNextUs >= 0 && maxUntilNextUs <= kPeriodUs * 5 / 4,
+                  QStringLiteral("time until next V-sync ranged from %1 to %2 us")
+                      .arg(minUntilNextUs).arg(maxUntilNextUs), err);
+
+    out << "present_vsync_hz=" << QString::number(rateHz, 'f', 2)
+        << " callbacks=" << callbacks
+        << " min_interval_us=" << minIntervalUs
+        << " max_interval_us=" << maxIntervalUs
+        << " until_next_us=" << minUntilNextUs << "-" << maxUntilNextUs << '\n';
+    return ok;
+}
+
+bool runShutdownChecks(SDL_Window* window, QTextStream& out, QTextStream& err)
+{
+    bool ok = true;
+
+    // Torn down before it ever waited
+    {
+        X11PresentVsyncSource source(nullptr);
+        ok &= require(source.initialize(window, kXvfbRefreshHz),
+                      QStringLiteral("Present source failed to initialize"), err);
+    }
+
+    // Torn down after its V-sync thread stops, the way Pacer does it
+    auto source = new X11PresentVsyncSource(nullptr);
+    if (!require(source->initialize(window, kXvfbRefreshHz), QStringLiteral("Present source failed to initialize"), err)) {
+        delete source;
+        return false;
+    }
+
+    std::atomic<bool> stopping(false);
+    std::atomic<int> callbacks(0);
+    QThread* thread = QThread::create([&]() {
+        while (!stopping.load()) {
+            source->waitForVsync();
+            callbacks++;
+        }
+    });
+    thread->start();
+    QThread::msleep(250);
+
+    // The thread only notices between waits, so it must be gone within about
+    // one more vblank. If it isn't, it is stuck inside the source; leak both
+    // rather than pull them out from under it.
+    QElapsedTimer timer;
+    timer.start();
+    stopping = true;
+    const bool joined = thread->wait(static_cast<unsigned long>(kPeriodUs * 4 / 1000));
+    const qint64 joinMs = timer.elapsed();
+    if (!require(joined, QStringLiteral("V-sync thread did not stop within 4 periods"), err)) {
+        return false;
+    }
+    delete thread;
+    ok &= require(callbacks > 0, QStringLiteral("V-sync thread never saw a V-sync"), err);
+
+    timer.restart();
+    delete source;
+    const qint64 teardownMs = timer.elapsed();
+    ok &= require(teardownMs < 100, QStringLiteral("tearing down the source took %1 ms").arg(teardownMs), err);
+
+    // Nothing left behind on the window: a new source still gets V-syncs
+    X11PresentVsyncSource again(nullptr);
+    ok &= require(again.initialize(window, kXvfbRefreshHz),
+                  QStringLiteral("Present source failed to initialize after a teardown"), err);
+    again.waitForVsync();
+    ok &= require(again.getMicrosUntilNextVsync() >= 0,
+                  QStringLiteral("Present source saw no V-sync after a teardown"), err);
+
+    out << "shutdown_join_ms=" << joinMs << " teardown_ms=" << teardownMs
+        << " callbacks=" << callbacks.load() << '\n';
+    return ok;
+}
+}
+
+int main(int argc, char* argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    QProcess xvfb;
+    switch (startXvfb(xvfb)) {
+    case XvfbResult::Started:
+        break;
+    case XvfbResult::NotInstalled:
+        out << "SKIPPED: Xvfb is not installed\n";
+        out << "PASS\n";
+        return 0;
+    case XvfbResult::Failed:
+        err << "FAIL: Xvfb did not start\n";
+        out << "FAILED\n";
+        return 1;
+    }
+
+    bool ok = true;
+    SDL_SetHint(SDL_HINT_VIDEODRIVER, "x11");
+    if (require(SDL_InitSubSystem(SDL_INIT_VIDEO) == 0,
+                QStringLiteral("SDL_InitSubSystem(SDL_INIT_VIDEO) failed: %1").arg(SDL_GetError()), err)) {
+        SDL_Window* window = SDL_CreateWindow("x11_present_vsync",
+                                              SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED,
+                                              640, 360, SDL_WINDOW_SHOWN);
+        if (require(window != nullptr, QStringLiteral("SDL_CreateWindow() failed: %1").arg(SDL_GetError()), err)) {
+            ok &= runRateChecks(window, out, err);
+            ok &= runShutdownChecks(window, out, err);
+            SDL_DestroyWindow(window);
+        }
+        else {
+            ok = false;
+        }
+        SDL_QuitSubSystem(SDL_INIT_VIDEO);
+    }
+    else {
+        ok = false;
+    }
+    SDL_Quit();
+
+    xvfb.terminate();
+    if (!xvfb.waitForFinished(5000)) {
+        xvfb.kill();
+        xvfb.waitForFinished();
+    }
+
+    out << (ok ? "PASS\n" : "FAILED\n");
+    out.flush();
+    err.flush();
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,23 @@
+QT += core gui quick
+CONFIG += c++17 console link_pkgconfig
+CONFIG -= app_bundle
+
+TARGET = x11_present_vsync
+TEMPLATE = app
+
+# Runs against its own Xvfb, which is only packaged for Linux here
+requires(linux)
+
+PKGCONFIG += sdl2 SDL2_ttf x11 xcb xcb-present libavcodec libavutil
+DEFINES += HAS_X11 HAS_X11_PRESENT
+
+INCLUDEPATH += \
+    $$PWD/../../app \
+    $$PWD/../../moonlight-common-c/moonlight-common-c/src
+
+SOURCES += \
+    main.cpp \
+    ../../app/streaming/video/ffmpeg-renderers/pacer/x11presentvsyncsource.cpp
+
+HEADERS += \
+    ../../app/streaming/video/ffmpeg-renderers/pacer/x11presentvsyncsource.h